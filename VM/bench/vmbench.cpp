@@ -0,0 +1,955 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "lua.h"
+#include "lualib.h"
+#include "lvmroblox.h"
+
+#include "Luau/Bytecode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+// VM micro-benchmarks that don't depend on the compiler: bytecode is assembled by hand with BytecodeBuilder below
+// usage: vmbench [iterations]
+
+struct BytecodeBuilder
+{
+    struct Function
+    {
+        uint8_t maxstacksize = 0;
+        uint8_t numparams = 0;
+        uint8_t nups = 0;
+        std::vector<uint32_t> code;
+        std::string constants; // serialized constant table
+        uint32_t constantCount = 0;
+        std::vector<uint32_t> children;
+    };
+
+    std::vector<std::string> strings;
+    std::vector<Function> functions;
+
+    static void writeVarInt(std::string& out, uint32_t value)
+    {
+        do
+        {
+            out += char((value & 127) | ((value > 127) << 7));
+            value >>= 7;
+        } while (value);
+    }
+
+    static uint32_t abc(LuauOpcode op, int a, int b, int c)
+    {
+        return uint32_t(op) | (uint32_t(a) << 8) | (uint32_t(b) << 16) | (uint32_t(c) << 24);
+    }
+
+    static uint32_t ad(LuauOpcode op, int a, int d)
+    {
+        return uint32_t(op) | (uint32_t(a) << 8) | (uint32_t(uint16_t(d)) << 16);
+    }
+
+    uint32_t addString(const std::string& s)
+    {
+        strings.push_back(s);
+        return uint32_t(strings.size()); // string ids are 1-based, 0 is reserved for NULL
+    }
+
+    static uint32_t addNumber(Function& f, double v)
+    {
+        f.constants += char(LBC_CONSTANT_NUMBER);
+        f.constants.append(reinterpret_cast<const char*>(&v), sizeof(v));
+        return f.constantCount++;
+    }
+
+    static uint32_t addStringConstant(Function& f, uint32_t sid)
+    {
+        f.constants += char(LBC_CONSTANT_STRING);
+        writeVarInt(f.constants, sid);
+        return f.constantCount++;
+    }
+
+    static uint32_t addImport(Function& f, uint32_t kname)
+    {
+        uint32_t id = (1u << 30) | (kname << 20);
+        f.constants += char(LBC_CONSTANT_IMPORT);
+        f.constants.append(reinterpret_cast<const char*>(&id), sizeof(id));
+        return f.constantCount++;
+    }
+
+    std::string finish(uint32_t mainid) const
+    {
+        std::string out;
+        out += char(4); // version
+        out += char(1); // types version
+
+        writeVarInt(out, uint32_t(strings.size()));
+        for (const std::string& s : strings)
+        {
+            writeVarInt(out, uint32_t(s.size()));
+            out += s;
+        }
+
+        writeVarInt(out, uint32_t(functions.size()));
+        for (const Function& f : functions)
+        {
+            out += char(f.maxstacksize);
+            out += char(f.numparams);
+            out += char(f.nups);
+            out += char(0); // is_vararg
+            out += char(0); // flags
+            writeVarInt(out, 0); // type info
+
+            writeVarInt(out, uint32_t(f.code.size()));
+            out.append(reinterpret_cast<const char*>(f.code.data()), f.code.size() * sizeof(uint32_t));
+
+            writeVarInt(out, f.constantCount);
+            out += f.constants;
+
+            writeVarInt(out, uint32_t(f.children.size()));
+            for (uint32_t child : f.children)
+                writeVarInt(out, child);
+
+            writeVarInt(out, 0); // linedefined
+            writeVarInt(out, 0); // debugname
+            out += char(0);      // lineinfo
+            out += char(0);      // debuginfo
+        }
+
+        writeVarInt(out, mainid);
+        return out;
+    }
+};
+
+// many functions with string constants and globals; stresses deserialization and string interning
+static std::string makeLoadChunk(int functionCount)
+{
+    BytecodeBuilder bb;
+
+    std::vector<uint32_t> names;
+    for (int i = 0; i < 256; ++i)
+        names.push_back(bb.addString("name" + std::to_string(i)));
+
+    for (int fi = 0; fi < functionCount; ++fi)
+    {
+        BytecodeBuilder::Function f;
+        f.maxstacksize = 4;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            uint32_t kname = BytecodeBuilder::addStringConstant(f, names[(fi * 16 + i) % names.size()]);
+            uint32_t knum = BytecodeBuilder::addNumber(f, double(fi * 16 + i));
+
+            f.code.push_back(BytecodeBuilder::abc(LOP_GETGLOBAL, 0, 0, 0));
+            f.code.push_back(kname);
+            f.code.push_back(BytecodeBuilder::ad(LOP_LOADK, 1, int(knum)));
+            f.code.push_back(BytecodeBuilder::abc(LOP_ADD, 2, 0, 1));
+            f.code.push_back(BytecodeBuilder::abc(LOP_SETGLOBAL, 2, 0, 0));
+            f.code.push_back(kname);
+        }
+
+        f.code.push_back(BytecodeBuilder::abc(LOP_RETURN, 0, 1, 0));
+        bb.functions.push_back(f);
+    }
+
+    BytecodeBuilder::Function main;
+    main.maxstacksize = 1;
+    for (int fi = 0; fi < functionCount; ++fi)
+        main.children.push_back(uint32_t(fi));
+    main.code.push_back(BytecodeBuilder::abc(LOP_RETURN, 0, 1, 0));
+    bb.functions.push_back(main);
+
+    return bb.finish(uint32_t(functionCount));
+}
+
+// local f = function(x) return x + 1 end
+// local t, s = {}, 0
+// for i = 1, n do s += f(i); t[1] = i * 2; s -= t[1] end
+// return s
+static std::string makeRunChunk(int n)
+{
+    BytecodeBuilder bb;
+
+    BytecodeBuilder::Function f;
+    f.maxstacksize = 2;
+    f.numparams = 1;
+    uint32_t kone = BytecodeBuilder::addNumber(f, 1);
+    f.code.push_back(BytecodeBuilder::abc(LOP_ADDK, 1, 0, int(kone)));
+    f.code.push_back(BytecodeBuilder::abc(LOP_RETURN, 1, 2, 0));
+    bb.functions.push_back(f);
+
+    BytecodeBuilder::Function main;
+    main.maxstacksize = 8;
+    main.children.push_back(0);
+    uint32_t klimit = BytecodeBuilder::addNumber(main, n);
+    uint32_t ktwo = BytecodeBuilder::addNumber(main, 2);
+
+    std::vector<uint32_t>& code = main.code;
+    code.push_back(BytecodeBuilder::ad(LOP_NEWCLOSURE, 0, 0));
+    code.push_back(BytecodeBuilder::abc(LOP_NEWTABLE, 1, 0, 0));
+    code.push_back(0);
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 2, 0));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 3, int(klimit)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 4, 1));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 5, 1));
+    size_t prep = code.size();
+    code.push_back(0); // FORNPREP, patched below
+    size_t body = code.size();
+    code.push_back(BytecodeBuilder::abc(LOP_MOVE, 6, 0, 0));
+    code.push_back(BytecodeBuilder::abc(LOP_MOVE, 7, 5, 0));
+    code.push_back(BytecodeBuilder::abc(LOP_CALL, 6, 2, 2));
+    code.push_back(BytecodeBuilder::abc(LOP_ADD, 2, 2, 6));
+    code.push_back(BytecodeBuilder::abc(LOP_MULK, 7, 5, int(ktwo)));
+    code.push_back(BytecodeBuilder::abc(LOP_SETTABLEN, 7, 1, 0));
+    code.push_back(BytecodeBuilder::abc(LOP_GETTABLEN, 6, 1, 0));
+    code.push_back(BytecodeBuilder::abc(LOP_SUB, 2, 2, 6));
+    size_t loop = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_FORNLOOP, 3, int(body) - int(loop + 1)));
+    code[prep] = BytecodeBuilder::ad(LOP_FORNPREP, 3, int(code.size()) - int(prep + 1));
+    code.push_back(BytecodeBuilder::abc(LOP_RETURN, 2, 2, 0));
+    bb.functions.push_back(main);
+
+    return bb.finish(1);
+}
+
+// local s = 0
+// for i = 1, n do s += one(); s -= t.obj:get() end
+// return s
+static std::string makeCallChunk(int n)
+{
+    BytecodeBuilder bb;
+
+    BytecodeBuilder::Function main;
+    main.maxstacksize = 6;
+    uint32_t kone = BytecodeBuilder::addStringConstant(main, bb.addString("one"));
+    uint32_t kt = BytecodeBuilder::addStringConstant(main, bb.addString("t"));
+    uint32_t kobj = BytecodeBuilder::addStringConstant(main, bb.addString("obj"));
+    uint32_t kget = BytecodeBuilder::addStringConstant(main, bb.addString("get"));
+    uint32_t ioone = BytecodeBuilder::addImport(main, kone);
+    uint32_t iot = BytecodeBuilder::addImport(main, kt);
+    uint32_t klimit = BytecodeBuilder::addNumber(main, n);
+
+    std::vector<uint32_t>& code = main.code;
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 0, 0));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 1, int(klimit)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 2, 1));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 3, 1));
+    size_t prep = code.size();
+    code.push_back(0); // FORNPREP, patched below
+    size_t body = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_GETIMPORT, 4, int(ioone)));
+    code.push_back((1u << 30) | (kone << 20));
+    code.push_back(BytecodeBuilder::abc(LOP_CALL, 4, 1, 2));
+    code.push_back(BytecodeBuilder::abc(LOP_ADD, 0, 0, 4));
+    code.push_back(BytecodeBuilder::ad(LOP_GETIMPORT, 4, int(iot)));
+    code.push_back((1u << 30) | (kt << 20));
+    code.push_back(BytecodeBuilder::abc(LOP_GETTABLEKS, 4, 4, 0));
+    code.push_back(kobj);
+    code.push_back(BytecodeBuilder::abc(LOP_NAMECALL, 4, 4, 0));
+    code.push_back(kget);
+    code.push_back(BytecodeBuilder::abc(LOP_CALL, 4, 2, 2));
+    code.push_back(BytecodeBuilder::abc(LOP_SUB, 0, 0, 4));
+    size_t loop = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_FORNLOOP, 1, int(body) - int(loop + 1)));
+    code[prep] = BytecodeBuilder::ad(LOP_FORNPREP, 1, int(code.size()) - int(prep + 1));
+    code.push_back(BytecodeBuilder::abc(LOP_RETURN, 0, 2, 0));
+    bb.functions.push_back(main);
+
+    return bb.finish(0);
+}
+
+// local s = 0
+// for i = 1, n do for k = 1, 4 do local o = objs[k]; s += o.x; o.x = o.x; s -= o:get() end end
+// return s
+static std::string makeFieldChunk(int n)
+{
+    BytecodeBuilder bb;
+
+    BytecodeBuilder::Function main;
+    main.maxstacksize = 11;
+    uint32_t kobjs = BytecodeBuilder::addStringConstant(main, bb.addString("objs"));
+    uint32_t kx = BytecodeBuilder::addStringConstant(main, bb.addString("x"));
+    uint32_t kget = BytecodeBuilder::addStringConstant(main, bb.addString("get"));
+    uint32_t ioobjs = BytecodeBuilder::addImport(main, kobjs);
+    uint32_t klimit = BytecodeBuilder::addNumber(main, n);
+
+    std::vector<uint32_t>& code = main.code;
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 0, 0));
+    code.push_back(BytecodeBuilder::ad(LOP_GETIMPORT, 4, int(ioobjs)));
+    code.push_back((1u << 30) | (kobjs << 20));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 1, int(klimit)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 2, 1));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 3, 1));
+    size_t prep = code.size();
+    code.push_back(0); // FORNPREP, patched below
+    size_t body = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 5, 4));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 6, 1));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 7, 1));
+    size_t innerprep = code.size();
+    code.push_back(0); // FORNPREP, patched below
+    size_t innerbody = code.size();
+    code.push_back(BytecodeBuilder::abc(LOP_GETTABLE, 8, 4, 7));
+    code.push_back(BytecodeBuilder::abc(LOP_GETTABLEKS, 9, 8, 0));
+    code.push_back(kx);
+    code.push_back(BytecodeBuilder::abc(LOP_ADD, 0, 0, 9));
+    code.push_back(BytecodeBuilder::abc(LOP_SETTABLEKS, 9, 8, 0));
+    code.push_back(kx);
+    code.push_back(BytecodeBuilder::abc(LOP_NAMECALL, 9, 8, 0));
+    code.push_back(kget);
+    code.push_back(BytecodeBuilder::abc(LOP_CALL, 9, 2, 2));
+    code.push_back(BytecodeBuilder::abc(LOP_SUB, 0, 0, 9));
+    size_t innerloop = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_FORNLOOP, 5, int(innerbody) - int(innerloop + 1)));
+    code[innerprep] = BytecodeBuilder::ad(LOP_FORNPREP, 5, int(code.size()) - int(innerprep + 1));
+    size_t loop = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_FORNLOOP, 1, int(body) - int(loop + 1)));
+    code[prep] = BytecodeBuilder::ad(LOP_FORNPREP, 1, int(code.size()) - int(prep + 1));
+    code.push_back(BytecodeBuilder::abc(LOP_RETURN, 0, 2, 0));
+    bb.functions.push_back(main);
+
+    return bb.finish(0);
+}
+
+// local keep = {}
+// for i = 1, m do keep[i] = {i} end
+// local s = 0
+// for i = 1, n do s += ({i})[1] end
+// return s
+static std::string makeAllocChunk(int n, int m)
+{
+    BytecodeBuilder bb;
+
+    BytecodeBuilder::Function main;
+    main.maxstacksize = 7;
+    uint32_t klive = BytecodeBuilder::addNumber(main, m);
+    uint32_t klimit = BytecodeBuilder::addNumber(main, n);
+
+    std::vector<uint32_t>& code = main.code;
+    code.push_back(BytecodeBuilder::abc(LOP_NEWTABLE, 0, 0, 0));
+    code.push_back(uint32_t(m));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 2, int(klive)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 3, 1));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 4, 1));
+    size_t keepprep = code.size();
+    code.push_back(0); // FORNPREP, patched below
+    size_t keepbody = code.size();
+    code.push_back(BytecodeBuilder::abc(LOP_NEWTABLE, 5, 0, 0));
+    code.push_back(1);
+    code.push_back(BytecodeBuilder::abc(LOP_SETTABLEN, 4, 5, 0));
+    code.push_back(BytecodeBuilder::abc(LOP_SETTABLE, 5, 0, 4));
+    size_t keeploop = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_FORNLOOP, 2, int(keepbody) - int(keeploop + 1)));
+    code[keepprep] = BytecodeBuilder::ad(LOP_FORNPREP, 2, int(code.size()) - int(keepprep + 1));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 1, 0));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 2, int(klimit)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 3, 1));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 4, 1));
+    size_t prep = code.size();
+    code.push_back(0); // FORNPREP, patched below
+    size_t body = code.size();
+    code.push_back(BytecodeBuilder::abc(LOP_NEWTABLE, 5, 0, 0));
+    code.push_back(1);
+    code.push_back(BytecodeBuilder::abc(LOP_SETTABLEN, 4, 5, 0));
+    code.push_back(BytecodeBuilder::abc(LOP_GETTABLEN, 6, 5, 0));
+    code.push_back(BytecodeBuilder::abc(LOP_ADD, 1, 1, 6));
+    size_t loop = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_FORNLOOP, 2, int(body) - int(loop + 1)));
+    code[prep] = BytecodeBuilder::ad(LOP_FORNPREP, 2, int(code.size()) - int(prep + 1));
+    code.push_back(BytecodeBuilder::abc(LOP_RETURN, 1, 2, 0));
+    bb.functions.push_back(main);
+
+    return bb.finish(0);
+}
+
+// local s = ""
+// for i = 1, n do s = s .. piece end
+// return #s
+static std::string makeConcatChunk(int n, const std::string& piece)
+{
+    BytecodeBuilder bb;
+
+    BytecodeBuilder::Function main;
+    main.maxstacksize = 6;
+    uint32_t kempty = BytecodeBuilder::addStringConstant(main, bb.addString(""));
+    uint32_t kpiece = BytecodeBuilder::addStringConstant(main, bb.addString(piece));
+    uint32_t klimit = BytecodeBuilder::addNumber(main, n);
+
+    std::vector<uint32_t>& code = main.code;
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 0, int(kempty)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 1, int(klimit)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 2, 1));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 3, 1));
+    size_t prep = code.size();
+    code.push_back(0); // FORNPREP, patched below
+    size_t body = code.size();
+    code.push_back(BytecodeBuilder::abc(LOP_MOVE, 4, 0, 0));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 5, int(kpiece)));
+    code.push_back(BytecodeBuilder::abc(LOP_CONCAT, 0, 4, 5));
+    size_t loop = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_FORNLOOP, 1, int(body) - int(loop + 1)));
+    code[prep] = BytecodeBuilder::ad(LOP_FORNPREP, 1, int(code.size()) - int(prep + 1));
+    code.push_back(BytecodeBuilder::abc(LOP_LENGTH, 4, 0, 0));
+    code.push_back(BytecodeBuilder::abc(LOP_RETURN, 4, 2, 0));
+    bb.functions.push_back(main);
+
+    return bb.finish(0);
+}
+
+// local r = 0
+// for i = 1, n do local _, k = subject:func(pattern, replacement); r += k end
+// return r
+static std::string makePatternChunk(int n, const char* func, const std::string& subject, const std::string& pattern, const char* replacement)
+{
+    BytecodeBuilder bb;
+
+    BytecodeBuilder::Function main;
+    main.maxstacksize = 9;
+    uint32_t ksubject = BytecodeBuilder::addStringConstant(main, bb.addString(subject));
+    uint32_t kpattern = BytecodeBuilder::addStringConstant(main, bb.addString(pattern));
+    uint32_t kfunc = BytecodeBuilder::addStringConstant(main, bb.addString(func));
+    uint32_t krepl = replacement ? BytecodeBuilder::addStringConstant(main, bb.addString(replacement)) : 0;
+    uint32_t klimit = BytecodeBuilder::addNumber(main, n);
+
+    std::vector<uint32_t>& code = main.code;
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 0, int(ksubject)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 1, 0));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 2, int(klimit)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 3, 1));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 4, 1));
+    size_t prep = code.size();
+    code.push_back(0); // FORNPREP, patched below
+    size_t body = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 7, int(kpattern)));
+    if (replacement)
+        code.push_back(BytecodeBuilder::ad(LOP_LOADK, 8, int(krepl)));
+    code.push_back(BytecodeBuilder::abc(LOP_NAMECALL, 5, 0, 0));
+    code.push_back(kfunc);
+    code.push_back(BytecodeBuilder::abc(LOP_CALL, 5, replacement ? 4 : 3, 3));
+    code.push_back(BytecodeBuilder::abc(LOP_ADD, 1, 1, 6));
+    size_t loop = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_FORNLOOP, 2, int(body) - int(loop + 1)));
+    code[prep] = BytecodeBuilder::ad(LOP_FORNPREP, 2, int(code.size()) - int(prep + 1));
+    code.push_back(BytecodeBuilder::abc(LOP_RETURN, 1, 2, 0));
+    bb.functions.push_back(main);
+
+    return bb.finish(0);
+}
+
+// local r = 0
+// for i = 1, n do r += #subject:func(arg) end
+// return r
+static std::string makeLengthChunk(int n, const char* func, const std::string& subject, const char* arg)
+{
+    BytecodeBuilder bb;
+
+    BytecodeBuilder::Function main;
+    main.maxstacksize = 8;
+    uint32_t ksubject = BytecodeBuilder::addStringConstant(main, bb.addString(subject));
+    uint32_t kfunc = BytecodeBuilder::addStringConstant(main, bb.addString(func));
+    uint32_t karg = arg ? BytecodeBuilder::addStringConstant(main, bb.addString(arg)) : 0;
+    uint32_t klimit = BytecodeBuilder::addNumber(main, n);
+
+    std::vector<uint32_t>& code = main.code;
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 0, int(ksubject)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 1, 0));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 2, int(klimit)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 3, 1));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 4, 1));
+    size_t prep = code.size();
+    code.push_back(0); // FORNPREP, patched below
+    size_t body = code.size();
+    if (arg)
+        code.push_back(BytecodeBuilder::ad(LOP_LOADK, 7, int(karg)));
+    code.push_back(BytecodeBuilder::abc(LOP_NAMECALL, 5, 0, 0));
+    code.push_back(kfunc);
+    code.push_back(BytecodeBuilder::abc(LOP_CALL, 5, arg ? 3 : 2, 2));
+    code.push_back(BytecodeBuilder::abc(LOP_LENGTH, 5, 5, 0));
+    code.push_back(BytecodeBuilder::abc(LOP_ADD, 1, 1, 5));
+    size_t loop = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_FORNLOOP, 2, int(body) - int(loop + 1)));
+    code[prep] = BytecodeBuilder::ad(LOP_FORNPREP, 2, int(code.size()) - int(prep + 1));
+    code.push_back(BytecodeBuilder::abc(LOP_RETURN, 1, 2, 0));
+    bb.functions.push_back(main);
+
+    return bb.finish(0);
+}
+
+// local r = 0
+// for i = 1, n do r += #subject:sub(i, i + len - 1) end
+// return r
+static std::string makeSubChunk(int n, const std::string& subject, int len)
+{
+    BytecodeBuilder bb;
+
+    BytecodeBuilder::Function main;
+    main.maxstacksize = 9;
+    uint32_t ksubject = BytecodeBuilder::addStringConstant(main, bb.addString(subject));
+    uint32_t kfunc = BytecodeBuilder::addStringConstant(main, bb.addString("sub"));
+    uint32_t klast = BytecodeBuilder::addNumber(main, len - 1);
+    uint32_t klimit = BytecodeBuilder::addNumber(main, n);
+
+    std::vector<uint32_t>& code = main.code;
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 0, int(ksubject)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 1, 0));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 2, int(klimit)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 3, 1));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 4, 1));
+    size_t prep = code.size();
+    code.push_back(0); // FORNPREP, patched below
+    size_t body = code.size();
+    code.push_back(BytecodeBuilder::abc(LOP_MOVE, 7, 4, 0));
+    code.push_back(BytecodeBuilder::abc(LOP_ADDK, 8, 4, int(klast)));
+    code.push_back(BytecodeBuilder::abc(LOP_NAMECALL, 5, 0, 0));
+    code.push_back(kfunc);
+    code.push_back(BytecodeBuilder::abc(LOP_CALL, 5, 4, 2));
+    code.push_back(BytecodeBuilder::abc(LOP_LENGTH, 5, 5, 0));
+    code.push_back(BytecodeBuilder::abc(LOP_ADD, 1, 1, 5));
+    size_t loop = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_FORNLOOP, 2, int(body) - int(loop + 1)));
+    code[prep] = BytecodeBuilder::ad(LOP_FORNPREP, 2, int(code.size()) - int(prep + 1));
+    code.push_back(BytecodeBuilder::abc(LOP_RETURN, 1, 2, 0));
+    bb.functions.push_back(main);
+
+    return bb.finish(0);
+}
+
+// local r = 0
+// for i = 1, n do r += #format:format(i, i * 0.125, "name") end
+// return r
+static std::string makeFormatChunk(int n, const char* format)
+{
+    BytecodeBuilder bb;
+
+    BytecodeBuilder::Function main;
+    main.maxstacksize = 10;
+    uint32_t kformat = BytecodeBuilder::addStringConstant(main, bb.addString(format));
+    uint32_t kfunc = BytecodeBuilder::addStringConstant(main, bb.addString("format"));
+    uint32_t kname = BytecodeBuilder::addStringConstant(main, bb.addString("name"));
+    uint32_t keighth = BytecodeBuilder::addNumber(main, 0.125);
+    uint32_t klimit = BytecodeBuilder::addNumber(main, n);
+
+    std::vector<uint32_t>& code = main.code;
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 0, int(kformat)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 1, 0));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 2, int(klimit)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 3, 1));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 4, 1));
+    size_t prep = code.size();
+    code.push_back(0); // FORNPREP, patched below
+    size_t body = code.size();
+    code.push_back(BytecodeBuilder::abc(LOP_MOVE, 7, 4, 0));
+    code.push_back(BytecodeBuilder::abc(LOP_MULK, 8, 4, int(keighth)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 9, int(kname)));
+    code.push_back(BytecodeBuilder::abc(LOP_NAMECALL, 5, 0, 0));
+    code.push_back(kfunc);
+    code.push_back(BytecodeBuilder::abc(LOP_CALL, 5, 5, 2));
+    code.push_back(BytecodeBuilder::abc(LOP_LENGTH, 5, 5, 0));
+    code.push_back(BytecodeBuilder::abc(LOP_ADD, 1, 1, 5));
+    size_t loop = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_FORNLOOP, 2, int(body) - int(loop + 1)));
+    code[prep] = BytecodeBuilder::ad(LOP_FORNPREP, 2, int(code.size()) - int(prep + 1));
+    code.push_back(BytecodeBuilder::abc(LOP_RETURN, 1, 2, 0));
+    bb.functions.push_back(main);
+
+    return bb.finish(0);
+}
+
+// local r = 0
+// for i = 1, n do local a, b = utf8.func(subject); r += result == 1 ? a : b end
+// return r
+static std::string makeUtf8Chunk(int n, const char* func, const std::string& subject, int result)
+{
+    BytecodeBuilder bb;
+
+    BytecodeBuilder::Function main;
+    main.maxstacksize = 7;
+    uint32_t ksubject = BytecodeBuilder::addStringConstant(main, bb.addString(subject));
+    uint32_t kutf8 = BytecodeBuilder::addStringConstant(main, bb.addString("utf8"));
+    uint32_t kfunc = BytecodeBuilder::addStringConstant(main, bb.addString(func));
+    uint32_t iutf8 = BytecodeBuilder::addImport(main, kutf8);
+    uint32_t klimit = BytecodeBuilder::addNumber(main, n);
+
+    std::vector<uint32_t>& code = main.code;
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 0, int(ksubject)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 1, 0));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADK, 2, int(klimit)));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 3, 1));
+    code.push_back(BytecodeBuilder::ad(LOP_LOADN, 4, 1));
+    size_t prep = code.size();
+    code.push_back(0); // FORNPREP, patched below
+    size_t body = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_GETIMPORT, 5, int(iutf8)));
+    code.push_back((1u << 30) | (kutf8 << 20));
+    code.push_back(BytecodeBuilder::abc(LOP_GETTABLEKS, 5, 5, 0));
+    code.push_back(kfunc);
+    code.push_back(BytecodeBuilder::abc(LOP_MOVE, 6, 0, 0));
+    code.push_back(BytecodeBuilder::abc(LOP_CALL, 5, 2, result + 1));
+    code.push_back(BytecodeBuilder::abc(LOP_ADD, 1, 1, 4 + result));
+    size_t loop = code.size();
+    code.push_back(BytecodeBuilder::ad(LOP_FORNLOOP, 2, int(body) - int(loop + 1)));
+    code[prep] = BytecodeBuilder::ad(LOP_FORNPREP, 2, int(code.size()) - int(prep + 1));
+    code.push_back(BytecodeBuilder::abc(LOP_RETURN, 1, 2, 0));
+    bb.functions.push_back(main);
+
+    return bb.finish(0);
+}
+
+static std::string makeText(size_t size, const char* phrase)
+{
+    std::string text;
+    while (text.size() < size)
+        text += phrase;
+    text.resize(size);
+    return text;
+}
+
+// benchmark columns: bytecode as is, verified at load time, and verified with superinstruction fusion
+enum Mode
+{
+    Baseline,
+    Verified,
+    Fused,
+};
+
+static int one(lua_State* L)
+{
+    lua_pushnumber(L, 1);
+    return 1;
+}
+
+static int get(lua_State* L)
+{
+    lua_pushnumber(L, 2);
+    return 1;
+}
+
+// pooled states use the size-class allocator of roblox_vm_newstate, others the default one that goes to malloc
+static lua_State* newState(Mode mode, bool pooled = false)
+{
+    lua_State* L = pooled ? lua_newstate(roblox_vm_pool_alloc, NULL) : luaL_newstate();
+    luaL_openlibs(L);
+    luau_setverify(L, mode != Baseline);
+    luau_setfusion(L, mode == Fused);
+
+    // globals for makeCallChunk; sandboxing makes the environment safe so that imports are resolved at load time
+    lua_pushcfunction(L, one, "one");
+    lua_setglobal(L, "one");
+    lua_newtable(L);
+    lua_newtable(L);
+    lua_pushcfunction(L, get, "get");
+    lua_setfield(L, -2, "get");
+    lua_setfield(L, -2, "obj");
+    lua_setglobal(L, "t");
+
+    // objs[k] for makeFieldChunk is an object of its own class; objects and classes have different layouts so that slot hints don't match
+    lua_createtable(L, 4, 0);
+    for (int k = 1; k <= 4; ++k)
+    {
+        lua_newtable(L);
+        for (int i = 1; i < k; ++i)
+        {
+            lua_pushboolean(L, true);
+            lua_setfield(L, -2, std::string(i, 'p').c_str());
+        }
+        lua_pushnumber(L, k);
+        lua_setfield(L, -2, "x");
+
+        lua_newtable(L);
+        lua_newtable(L);
+        for (int i = 1; i <= k; ++i)
+        {
+            lua_pushboolean(L, true);
+            lua_setfield(L, -2, std::string(i, 'm').c_str());
+        }
+        lua_pushcfunction(L, get, "get");
+        lua_setfield(L, -2, "get");
+        lua_setfield(L, -2, "__index");
+        lua_setmetatable(L, -2);
+
+        lua_rawseti(L, -2, k);
+    }
+    lua_setglobal(L, "objs");
+
+    luaL_sandbox(L);
+
+    return L;
+}
+
+static double benchLoad(const std::string& chunk, Mode mode, bool cache, bool mapped, int iterations)
+{
+    lua_State* L = newState(mode);
+    luau_setloadcache(L, cache ? 16 : 0);
+
+    double start = lua_clock();
+    for (int i = 0; i < iterations; ++i)
+    {
+        int status = mapped ? luau_loadmapped(L, "=load", chunk.data(), chunk.size(), 0, NULL, NULL)
+                            : luau_load(L, "=load", chunk.data(), chunk.size(), 0);
+
+        if (status != 0)
+        {
+            fprintf(stderr, "load failed: %s\n", lua_tostring(L, -1));
+            exit(1);
+        }
+
+        lua_pop(L, 1);
+    }
+    double time = lua_clock() - start;
+
+    lua_close(L);
+    return time / iterations;
+}
+
+static double benchRun(
+    const std::string& chunk, Mode mode, int iterations, double expected, bool profile, bool generational, bool pooled = false)
+{
+    lua_State* L = newState(mode, pooled);
+
+    if (generational)
+        lua_gc(L, LUA_GCGEN, 0);
+
+    if (luau_load(L, "=run", chunk.data(), chunk.size(), 0) != 0)
+    {
+        fprintf(stderr, "load failed: %s\n", lua_tostring(L, -1));
+        exit(1);
+    }
+
+    // samples are requested at 1 kHz from another thread, the way an embedder drives the profiler
+    std::atomic<bool> stop(false);
+    std::thread sampler;
+
+    if (profile)
+    {
+        lua_profilerstart(L, 1 << 16);
+        sampler = std::thread(
+            [&]
+            {
+                while (!stop)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    lua_profilerrequest(L);
+                }
+            }
+        );
+    }
+
+    double start = lua_clock();
+    for (int i = 0; i < iterations; ++i)
+    {
+        lua_pushvalue(L, -1);
+        if (lua_pcall(L, 0, 1, 0) != 0)
+        {
+            fprintf(stderr, "run failed: %s\n", lua_tostring(L, -1));
+            exit(1);
+        }
+
+        if (lua_tonumber(L, -1) != expected)
+        {
+            fprintf(stderr, "run returned %f, expected %f\n", lua_tonumber(L, -1), expected);
+            exit(1);
+        }
+
+        lua_pop(L, 1);
+    }
+    double time = lua_clock() - start;
+
+    if (profile)
+    {
+        stop = true;
+        sampler.join();
+    }
+
+    lua_close(L);
+    return time / iterations;
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 20;
+
+    std::string loadChunk = makeLoadChunk(2000);
+
+    const int n = 1000000;
+    std::string runChunk = makeRunChunk(n);
+    std::string callChunk = makeCallChunk(n);
+    std::string fieldChunk = makeFieldChunk(n / 4);
+    std::string allocChunk = makeAllocChunk(n, n / 5);
+
+    // 1 MB strings accumulated from small and large pieces
+    const int mb = 1 << 20;
+    std::string concatSmallChunk = makeConcatChunk(mb / 64, std::string(64, 'x'));
+    std::string concatLargeChunk = makeConcatChunk(mb / 1024, std::string(1024, 'x'));
+
+    // pattern searches over 4 KB of text: a number after a run of words, whitespace runs, and a backtracking worst case
+    std::string words;
+    double spaceRuns = 0;
+    for (; words.size() < 4096; spaceRuns += 4)
+        words += "lorem ipsum  dolor\tsit ";
+    std::string digits = words + "12345";
+    std::string as(32, 'a');
+    std::string findChunk = makePatternChunk(1000, "find", digits, "%d+", NULL);
+    std::string gsubChunk = makePatternChunk(1000, "gsub", words, "%s+", " ");
+    std::string backtrackChunk = makePatternChunk(100, "gsub", as, "a*a*a*c", "");
+
+    // slices of a 1 MB string: short ones are interned, long ones share the contents of the string
+    std::string mbText = makeText(mb, "Lorem ipsum dolor sit amet, ");
+    std::string lines = makeText(mb, "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore\n");
+    std::string subShortChunk = makeSubChunk(100000, mbText, 32);
+    std::string subLongChunk = makeSubChunk(100000, mbText, 4096);
+    std::string splitLinesChunk = makeLengthChunk(10, "split", lines, "\n");
+    double lineCount = 1;
+    for (char ch : lines)
+        lineCount += ch == '\n';
+
+    // format strings with conversions that skip snprintf, and with ones that still need it for the floating point number
+    std::string formatPlainChunk = makeFormatChunk(100000, "%d: %s (%s)");
+    std::string formatWidthChunk = makeFormatChunk(100000, "%5d|%8.3f|%s");
+    // UTF-8 text in ASCII and in a mix with two and three byte characters
+    std::string utf8Ascii = makeText(mb, "Lorem ipsum dolor sit amet, ");
+    std::string utf8Mixed = makeText(mb, "Lorem ipsum \xD0\xB4\xD0\xBE\xD0\xBB\xD0\xBE\xD1\x80 sit \xE2\x82\xAC amet, ");
+    utf8Mixed.resize(utf8Mixed.rfind(',')); // don't cut a character short
+    double utf8AsciiLength = double(utf8Ascii.size());
+    double utf8MixedLength = 0;
+    for (char ch : utf8Mixed)
+        utf8MixedLength += (ch & 0xC0) != 0x80;
+    std::string utf8LenAsciiChunk = makeUtf8Chunk(10, "len", utf8Ascii, 1);
+    std::string utf8LenMixedChunk = makeUtf8Chunk(10, "len", utf8Mixed, 1);
+    std::string utf8CodepointsChunk = makeUtf8Chunk(1, "codepoints", utf8Mixed, 2);
+
+    double formatPlainLength = 0, formatWidthLength = 0;
+    for (int i = 1; i <= 100000; i++)
+    {
+        char buf[64];
+        formatPlainLength += snprintf(buf, sizeof(buf), "%d: %.15g (%s)", i, i * 0.125, "name");
+        formatWidthLength += snprintf(buf, sizeof(buf), "%5d|%8.3f|%s", i, i * 0.125, "name");
+    }
+
+    // each iteration adds f(i) = i + 1 and subtracts t[1] = i * 2
+    double expected = 0;
+    for (int i = 1; i <= n; ++i)
+        expected += double(i + 1) - double(i * 2);
+
+    printf("%-24s %12s %12s %12s\n", "benchmark", "baseline", "verified", "fused");
+
+    printf("%-24s", "load (2000 functions)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchLoad(loadChunk, mode, false, false, iterations) * 1e3);
+    printf("\n%-24s", "load (cached)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchLoad(loadChunk, mode, true, false, iterations) * 1e3);
+    printf("\n%-24s", "load (mapped)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchLoad(loadChunk, mode, false, true, iterations) * 1e3);
+    printf("\n%-24s", "run (1M iterations)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(runChunk, mode, iterations, expected, false, false) * 1e3);
+    printf("\n%-24s", "run (profiled at 1 kHz)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(runChunk, mode, iterations, expected, true, false) * 1e3);
+    printf("\n%-24s", "calls (1M iterations)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(callChunk, mode, iterations, -double(n), false, false) * 1e3);
+    printf("\n%-24s", "fields (4 classes)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(fieldChunk, mode, iterations, double(n / 2), false, false) * 1e3);
+    printf("\n%-24s", "alloc (incr., malloc)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(allocChunk, mode, iterations, double(n) * (n + 1) / 2, false, false) * 1e3);
+    printf("\n%-24s", "alloc (incr., pooled)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(allocChunk, mode, iterations, double(n) * (n + 1) / 2, false, false, true) * 1e3);
+    printf("\n%-24s", "alloc (gen., malloc)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(allocChunk, mode, iterations, double(n) * (n + 1) / 2, false, true) * 1e3);
+    printf("\n%-24s", "alloc (gen., pooled)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(allocChunk, mode, iterations, double(n) * (n + 1) / 2, false, true, true) * 1e3);
+    printf("\n%-24s", "concat (1MB, 64B pieces)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(concatSmallChunk, mode, iterations, double(mb), false, false) * 1e3);
+    printf("\n%-24s", "concat (1MB, 1KB pieces)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(concatLargeChunk, mode, iterations, double(mb), false, false) * 1e3);
+    printf("\n%-24s", "find (%d+, 4KB)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(findChunk, mode, iterations, 1000.0 * digits.size(), false, false) * 1e3);
+    printf("\n%-24s", "gsub (%s+, 4KB)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(gsubChunk, mode, iterations, 1000.0 * spaceRuns, false, false) * 1e3);
+    printf("\n%-24s", "gsub (a*a*a*c, 32B)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(backtrackChunk, mode, iterations, 0, false, false) * 1e3);
+    printf("\n%-24s", "sub (32B of 1MB)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(subShortChunk, mode, iterations, 100000.0 * 32, false, false) * 1e3);
+    printf("\n%-24s", "sub (4KB of 1MB)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(subLongChunk, mode, iterations, 100000.0 * 4096, false, false) * 1e3);
+    printf("\n%-24s", "split (1MB, 100B lines)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(splitLinesChunk, mode, iterations, 10 * lineCount, false, false) * 1e3);
+    printf("\n%-24s", "utf8.len (1MB ASCII)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(utf8LenAsciiChunk, mode, iterations, 10 * utf8AsciiLength, false, false) * 1e3);
+    printf("\n%-24s", "utf8.len (1MB mixed)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(utf8LenMixedChunk, mode, iterations, 10 * utf8MixedLength, false, false) * 1e3);
+    printf("\n%-24s", "utf8.codepoints (1MB)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(utf8CodepointsChunk, mode, iterations, utf8MixedLength, false, false) * 1e3);
+    printf("\n%-24s", "format (%d: %s (%s))");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(formatPlainChunk, mode, iterations, formatPlainLength, false, false) * 1e3);
+    printf("\n%-24s", "format (%5d|%8.3f|%s)");
+    for (Mode mode : {Baseline, Verified, Fused})
+        printf(" %10.3fms", benchRun(formatWidthChunk, mode, iterations, formatWidthLength, false, false) * 1e3);
+
+    // plain string functions over 10 MB of text in total, processed in 1 KB, 1 MB and 10 MB strings
+    for (size_t size : {size_t(1) << 10, size_t(1) << 20, size_t(10) << 20})
+    {
+        int count = int((size_t(10) << 20) / size);
+        const char* unit = size < mb ? "KB" : "MB";
+        int units = int(size < mb ? size >> 10 : size >> 20);
+
+        // the needle starts with a frequent character and is only found at the end
+        std::string needle = "sit amet, consectetur";
+        std::string haystack = makeText(size - needle.size(), "Lorem ipsum dolor sit amet, ") + needle;
+        std::string csv = makeText(size, "lorem,ipsum,dolor,sit,amet,");
+        std::string text = makeText(size, "Lorem Ipsum Dolor Sit Amet ");
+
+        std::string findPlain = makePatternChunk(count, "find", haystack, needle, NULL);
+        std::string split = makeLengthChunk(count, "split", csv, ",");
+        std::string lower = makeLengthChunk(count, "lower", text, NULL);
+        std::string reverse = makeLengthChunk(count, "reverse", text, NULL);
+
+        double fields = 1;
+        for (char ch : csv)
+            fields += ch == ',';
+
+        char name[32];
+        snprintf(name, sizeof(name), "find plain (%d%s)", units, unit);
+        printf("\n%-24s", name);
+        for (Mode mode : {Baseline, Verified, Fused})
+            printf(" %10.3fms", benchRun(findPlain, mode, iterations, double(count) * size, false, false) * 1e3);
+        snprintf(name, sizeof(name), "split (%d%s)", units, unit);
+        printf("\n%-24s", name);
+        for (Mode mode : {Baseline, Verified, Fused})
+            printf(" %10.3fms", benchRun(split, mode, iterations, count * fields, false, false) * 1e3);
+        snprintf(name, sizeof(name), "lower (%d%s)", units, unit);
+        printf("\n%-24s", name);
+        for (Mode mode : {Baseline, Verified, Fused})
+            printf(" %10.3fms", benchRun(lower, mode, iterations, double(count) * size, false, false) * 1e3);
+        snprintf(name, sizeof(name), "reverse (%d%s)", units, unit);
+        printf("\n%-24s", name);
+        for (Mode mode : {Baseline, Verified, Fused})
+            printf(" %10.3fms", benchRun(reverse, mode, iterations, double(count) * size, false, false) * 1e3);
+    }
+    printf("\n");
+
+    return 0;
+}
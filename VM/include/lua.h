@@ -109,6 +109,26 @@ typedef unsigned lua_Unsigned;
 ** state manipulation
 */
 LUA_API lua_State* lua_newstate(lua_Alloc f, void* ud);
+
+/*
+** page allocator size classes
+** allocations of up to 1024 bytes are served from pages that hold blocks of a single size; each allocation takes the smallest size class
+** that fits it, so sizes just above a class waste the difference. the default classes are the multiples of 8 up to 64, of 16 up to 256,
+** of 32 up to 512 and of 64 up to 1024, in 16 KB pages (32 KB pages for classes above 512 bytes); lua_getsizehistogram can be used to
+** find the sizes a workload allocates. lua_newstateex returns NULL when the classes are invalid; NULL selects the default classes
+*/
+struct lua_SizeClasses
+{
+    const int* sizes; // block sizes in ascending order, multiples of 8 up to 1024; allocations above the largest class get dedicated blocks
+    int count;        // number of sizes, up to LUA_SIZECLASSES
+
+    int smallpagesize; // size in bytes of the pages for classes up to largeclass, 0 selects the default
+    int largepagesize; // size in bytes of the pages for classes above largeclass, 0 selects the default
+    int largeclass;    // largest class that uses small pages, 0 selects the default (512); each page has to fit at least one block
+};
+typedef struct lua_SizeClasses lua_SizeClasses;
+
+LUA_API lua_State* lua_newstateex(lua_Alloc f, void* ud, const lua_SizeClasses* classes);
 LUA_API void lua_close(lua_State* L);
 LUA_API lua_State* lua_newthread(lua_State* L);
 LUA_API lua_State* lua_mainthread(lua_State* L);
@@ -153,6 +173,7 @@ LUA_API unsigned lua_tounsignedx(lua_State* L, int idx, int* isnum);
 LUA_API const float* lua_tovector(lua_State* L, int idx);
 LUA_API int lua_toboolean(lua_State* L, int idx);
 LUA_API const char* lua_tolstring(lua_State* L, int idx, size_t* len);
+LUA_API const char* lua_tolstringview(lua_State* L, int idx, size_t* len); // result of a string is not necessarily 0-terminated
 LUA_API const char* lua_tostringatom(lua_State* L, int idx, int* atom);
 LUA_API const char* lua_tolstringatom(lua_State* L, int idx, size_t* len, int* atom);
 LUA_API const char* lua_namecallatom(lua_State* L, int* atom);
@@ -181,6 +202,7 @@ LUA_API void lua_pushvector(lua_State* L, float x, float y, float z, float w);
 LUA_API void lua_pushvector(lua_State* L, float x, float y, float z);
 #endif
 LUA_API void lua_pushlstring(lua_State* L, const char* s, size_t l);
+LUA_API void lua_pushsubstring(lua_State* L, int idx, size_t offset, size_t len); // long substrings share the contents of the string
 LUA_API void lua_pushstring(lua_State* L, const char* s);
 LUA_API const char* lua_pushvfstring(lua_State* L, const char* fmt, va_list argp);
 LUA_API LUA_PRINTF_ATTR(2, 3) const char* lua_pushfstringL(lua_State* L, const char* fmt, ...);
@@ -227,6 +249,20 @@ LUA_API int lua_setfenv(lua_State* L, int idx);
 ** `load' and `call' functions (load and run Luau bytecode)
 */
 LUA_API int luau_load(lua_State* L, const char* chunkname, const char* data, size_t size, int env);
+// like luau_load, but nested functions are only deserialized when first used and debug info when first requested
+// data has to stay valid until release(ud, data, size) is called, which happens once no function needs it anymore, or when loading fails
+LUA_API int luau_loadmapped(
+    lua_State* L,
+    const char* chunkname,
+    const char* data,
+    size_t size,
+    int env,
+    void (*release)(void* ud, const char* data, size_t size),
+    void* ud
+);
+LUA_API void luau_setverify(lua_State* L, int enabled); // verify jump targets, registers and constants of loaded bytecode
+LUA_API void luau_setfusion(lua_State* L, int enabled); // fuse common instruction pairs of loaded bytecode; ignored with native codegen
+LUA_API void luau_setloadcache(lua_State* L, int capacity); // reuse functions of up to 'capacity' recently loaded chunks; 0 disables
 LUA_API void lua_call(lua_State* L, int nargs, int nresults);
 LUA_API int lua_pcall(lua_State* L, int nargs, int nresults, int errfunc);
 
@@ -292,10 +328,69 @@ enum lua_GCOp
     LUA_GCSETGOAL,
     LUA_GCSETSTEPMUL,
     LUA_GCSETSTEPSIZE,
+
+    /*
+    ** switch between generational and incremental (default) collection; both return the previous mode (LUA_GCGEN or LUA_GCINC)
+    **
+    ** in generational mode, objects that survive a cycle are not marked again by the following minor cycles, which only traverse
+    ** objects allocated since the last one and old objects that were modified; old objects that become unreachable are collected
+    ** by a major cycle that runs once the heap grows past G (goal) relative to its size after the previous major cycle.
+    ** for LUA_GCGEN, data sets the heap growth in percentages that starts a minor cycle (20% by default); 0 keeps the current value
+    */
+    LUA_GCGEN,
+    LUA_GCINC,
+
+    /*
+    ** frame budget pacing, for hosts that run scripts in a frame loop
+    **
+    ** LUA_GCSETFRAMEBUDGET limits the total time GC assists take within a frame to data microseconds (0 disables) and returns the old value;
+    ** LUA_GCFRAME starts the next frame and spends up to data microseconds of idle time on GC work, the same way lua_gcidle does.
+    ** assists that don't fit into the budget of a frame, based on the measured GC throughput, are postponed until the next LUA_GCFRAME,
+    ** so the host has to call it every frame; an atomic step that takes longer than the whole budget runs at the start of a frame
+    */
+    LUA_GCSETFRAMEBUDGET,
+    LUA_GCFRAME,
+
+    /*
+    ** parallel marking for full collections (LUA_GCCOLLECT and collections forced by memory limits)
+    **
+    ** the mark phase of a full collection is split between data threads, including the thread running the state; 0 or 1 disables.
+    ** returns the old value. helper threads are started by each full collection and finish before it returns; incremental steps
+    ** are not affected
+    */
+    LUA_GCSETMARKTHREADS,
+
+    /*
+    ** heap defragmentation for full collections started by the host between calls (LUA_GCCOLLECT)
+    **
+    ** pages of the collectable heap where less than data percent of the blocks are in use are evacuated by moving their tables and
+    ** functions into other pages, which allows the pages to be freed; 0 (default) disables. returns the old value.
+    ** moved objects get new addresses, so lua_topointer results and default tostring output for tables and functions can change
+    */
+    LUA_GCSETDEFRAG,
 };
 
 LUA_API int lua_gc(lua_State* L, int what, int data);
 
+/*
+** idle-time collection
+** performs GC work for up to the given number of microseconds, finishing the current cycle (or starting the next one if it's due);
+** the work that was done ahead of time makes the next assists happen later. returns the remaining GC debt in KB, which is the
+** amount of allocation that assists are behind on
+*/
+LUA_API int lua_gcidle(lua_State* L, int microseconds);
+
+/*
+** background sweeping
+** when enabled, notify is called at the end of each mark phase, after which other threads can call lua_gcsweepbackground to sweep
+** pages of the heap in parallel with the execution; GC steps of the thread running the state pick up the results and sweep the
+** pages that were left over, so the sweep never waits for helper threads for longer than it takes to sweep a page
+** notify is called from the thread running the state during a GC step and must not call into the state; NULL disables
+** lua_gcsweepbackground returns the number of pages it swept; it must not be running while the state is closed
+*/
+LUA_API void lua_gcsetbackgroundsweep(lua_State* L, void* ud, void (*notify)(void* ud));
+LUA_API int lua_gcsweepbackground(lua_State* L);
+
 /*
 ** memory statistics
 ** all allocated bytes are attributed to the memory category of the running thread (0..LUA_MEMORY_CATEGORIES-1)
@@ -304,6 +399,71 @@ LUA_API int lua_gc(lua_State* L, int what, int data);
 LUA_API void lua_setmemcat(lua_State* L, int category);
 LUA_API size_t lua_totalbytes(lua_State* L, int category);
 
+/*
+** allocation size histogram
+** while enabled, every allocation is counted by its memory category and size: bucket i counts sizes in (8 * i, 8 * i + 8] for sizes up
+** to 1024 bytes, and the last bucket counts larger allocations. enabling resets the counts; the histogram takes LUA_MEMORY_CATEGORIES *
+** LUA_SIZEBUCKETS * 8 bytes of the heap. lua_getsizehistogram copies LUA_SIZEBUCKETS counts of a category and returns 0 if recording
+** is disabled
+*/
+#define LUA_SIZEBUCKETS 129
+
+LUA_API void lua_setsizehistogram(lua_State* L, int enabled);
+LUA_API int lua_getsizehistogram(lua_State* L, int category, uint64_t* counts);
+
+/*
+** memory limits
+** an allocation that would take the total heap size (category < 0) or the size of a memory category over its limit fails with LUA_ERRMEM
+** when the usage gets close to a limit, a full collection is performed at the next GC step to make room before allocations start failing
+** SIZE_MAX (default) disables the limit; lua_setmemorylimit returns the previous limit
+*/
+LUA_API size_t lua_setmemorylimit(lua_State* L, int category, size_t limit);
+LUA_API size_t lua_getmemorylimit(lua_State* L, int category);
+
+/*
+** execution metrics
+** counters are maintained per state by the thread that runs it and published at every GC step (or via lua_publishmetrics)
+** lua_getmetrics can be called from any thread and returns the last published copy without stopping execution
+*/
+struct lua_Metrics
+{
+    double starttime;   // lua_clock() at the last lua_resetmetrics
+    double publishtime; // lua_clock() when this copy was published
+
+    uint64_t allocations;    // number of blocks allocated or reallocated
+    uint64_t frees;          // number of blocks freed
+    uint64_t allocatedbytes; // total number of bytes requested by allocations
+
+    size_t totalbytes; // heap size when this copy was published
+    size_t peakbytes;  // largest heap size observed at a GC step
+
+    uint64_t gcsteps;         // number of GC steps, both assists and explicit steps
+    uint64_t gccycles;        // number of completed GC cycles
+    uint64_t gcminorcycles;   // number of completed GC cycles that only marked young objects (see LUA_GCGEN)
+    uint64_t gcdeferredsteps; // number of GC assists postponed to the next frame since the frame budget ran out (see LUA_GCFRAME)
+    uint64_t gcdefragpages;   // number of pages freed by heap defragmentation (see LUA_GCSETDEFRAG)
+    uint64_t gcdefragbytes;   // total size of the pages freed by heap defragmentation
+    uint64_t gcdefragobjects; // number of objects moved by heap defragmentation
+
+    uint64_t loadcachehits;      // number of luau_load calls served from the load cache
+    uint64_t loadcachemisses;    // number of luau_load calls that had to deserialize the chunk while the cache is enabled
+    uint64_t loadcacheevictions; // number of chunks dropped from the load cache
+
+    uint64_t icachehits;   // field accesses on objects with metatables served by inline caches after the slot hint missed
+    uint64_t icachemisses; // field accesses on objects with metatables that missed both the slot hint and the inline cache
+
+    uint64_t profilersamples; // number of samples taken by the sampling profiler
+
+    uint32_t memerrors;      // number of allocations that failed with LUA_ERRMEM
+    uint32_t stackoverflows; // number of stack overflow errors
+    uint32_t timeouts;       // number of executions interrupted by a watchdog
+};
+typedef struct lua_Metrics lua_Metrics;
+
+LUA_API void lua_resetmetrics(lua_State* L);
+LUA_API void lua_publishmetrics(lua_State* L);
+LUA_API void lua_getmetrics(lua_State* L, lua_Metrics* metrics);
+
 /*
 ** miscellaneous functions
 */
@@ -419,6 +579,14 @@ typedef void (*lua_Coverage)(void* context, const char* function, int linedefine
 
 LUA_API void lua_getcoverage(lua_State* L, int funcindex, void* context, lua_Coverage callback);
 
+// Sampling profiler: lua_profilerrequest can be called from any thread, the sample is taken by the thread running the state at its next
+// interrupt safepoint and stored in a ring buffer of 'capacity' frames that overwrites the oldest samples; lua_profilerdump writes the
+// samples in folded stack format ("outer;inner count" lines), with current lines instead of function definition lines if 'lines' is set
+LUA_API void lua_profilerstart(lua_State* L, int capacity);
+LUA_API void lua_profilerstop(lua_State* L);
+LUA_API void lua_profilerrequest(lua_State* L);
+LUA_API void lua_profilerdump(lua_State* L, int lines, void* context, void (*write)(void* context, const char* data, size_t size));
+
 // Warning: this function is not thread-safe since it stores the result in a shared global array! Only use for debugging.
 LUA_API const char* lua_debugtrace(lua_State* L);
 
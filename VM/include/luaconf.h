@@ -32,6 +32,17 @@
 #endif
 #endif
 
+// String library functions have AVX2 variants that are selected at runtime, unless AVX2 support is guaranteed by compiler settings
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(__AVX2__)
+#if defined(_MSC_VER) && !defined(__clang__)
+#define LUAU_TARGET_AVX2
+#elif defined(__GNUC__) && defined(__has_attribute)
+#if __has_attribute(target)
+#define LUAU_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+#endif
+
 // Used on functions that have a printf-like interface to validate them statically
 #if defined(__GNUC__)
 #define LUA_PRINTF_ATTR(fmt, arg) __attribute__((format(printf, fmt, arg)))
@@ -121,11 +132,36 @@
 #define LUA_MINSTRTABSIZE 32
 #endif
 
+// minimum length of a concatenation result that shares append storage with its first operand instead of being interned
+#ifndef LUA_MINSTRVIEW
+#define LUA_MINSTRVIEW 512
+#endif
+
+// minimum length of a substring that shares the contents of the string it was taken from instead of being interned
+#ifndef LUA_MINSUBVIEW
+#define LUA_MINSUBVIEW 64
+#endif
+
 // maximum number of captures supported by pattern matching
 #ifndef LUA_MAXCAPTURES
 #define LUA_MAXCAPTURES 32
 #endif
 
+// number of compiled patterns cached by the string library
+#ifndef LUA_PATTERNCACHE
+#define LUA_PATTERNCACHE 32
+#endif
+
+// number of compiled format strings cached by the string library
+#ifndef LUA_FORMATCACHE
+#define LUA_FORMATCACHE 32
+#endif
+
+// number of receiver metatables remembered by the inline cache of a table access instruction
+#ifndef LUA_ICACHEWAYS
+#define LUA_ICACHEWAYS 4
+#endif
+
 // }==================================================================
 
 /*
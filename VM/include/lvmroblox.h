@@ -4,12 +4,13 @@
 
 #include "lua.h"
 
-// Structure to track VM execution metrics
+// Structure to track VM execution metrics; built from the per-state lua_Metrics snapshot
 struct RobloxVMMetrics {
     int64_t executionTimeMs;
     size_t memoryUsed;
-    int callDepth;
-    int instructionsExecuted;
+    size_t peakMemoryUsed;
+    uint64_t allocations;
+    uint64_t gcCycles;
     bool timedOut;
     bool memoryLimitExceeded;
     bool stackOverflow;
@@ -19,19 +20,19 @@ struct RobloxVMMetrics {
 void roblox_vm_error(lua_State* L, const char* error);
 
 // Check if execution has timed out
-bool roblox_vm_check_timeout();
+bool roblox_vm_check_timeout(lua_State* L);
 
 // Check if memory limit has been exceeded
 bool roblox_vm_check_memory(lua_State* L);
 
 // Check if call stack depth limit has been exceeded
-bool roblox_vm_check_stack_depth(int depth);
+bool roblox_vm_check_stack_depth(lua_State* L);
 
 // Initialize VM metrics for a new execution
-void roblox_vm_init_metrics();
+void roblox_vm_init_metrics(lua_State* L);
 
-// Get current VM metrics
-const RobloxVMMetrics& roblox_vm_get_metrics();
+// Get VM metrics of the state as of the last GC step or completed execution; safe to call from any thread
+RobloxVMMetrics roblox_vm_get_metrics(lua_State* L);
 
 // Enhanced VM execution with safety checks and metrics
 int roblox_vm_execute(lua_State* L, int nresults);
@@ -39,12 +40,35 @@ int roblox_vm_execute(lua_State* L, int nresults);
 // Enhanced memory allocator with limits and tracking
 void* roblox_vm_alloc(void* ud, void* ptr, size_t osize, size_t nsize);
 
+// Pooled memory allocator with thread-local caches and size-class slabs; can be passed to lua_newstate
+void* roblox_vm_pool_alloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+// Statistics of the pooled allocator, aggregated over all threads
+struct RobloxVMPoolStats {
+    size_t reservedBytes;      // bytes reserved from the OS for pooled size classes
+    int64_t pooledBytes;       // bytes in pooled blocks currently in use, rounded up to the size class
+    int64_t largeBytes;        // bytes currently allocated through the system allocator
+    uint64_t allocations;      // number of pooled allocations
+    uint64_t frees;            // number of frees, both pooled and large
+    uint64_t largeAllocations; // number of allocations too large for the pool
+    uint64_t refills;          // number of thread cache refills from the shared pool
+};
+
+// Get statistics of the pooled allocator; safe to call from any thread
+void roblox_vm_pool_getstats(RobloxVMPoolStats* stats);
+
 // Create a new Roblox-optimized Lua state
 lua_State* roblox_vm_newstate();
 
+// Close a Roblox-optimized Lua state; has to be used instead of lua_close once the watchdog, profiler or background sweeping was started
+void roblox_vm_close(lua_State* L);
+
 // Enhanced bytecode loader with security checks
 int roblox_vm_load(lua_State* L, const char* chunkname, const char* bytecode, size_t bytecode_size);
 
+// Load a bytecode file through mmap; nested functions and debug info are decoded on first use
+int roblox_vm_load_file(lua_State* L, const char* chunkname, const char* path);
+
 // Enhanced function to safely call a Lua function with timeout and memory checks
 int roblox_vm_pcall(lua_State* L, int nargs, int nresults);
 
@@ -66,5 +90,21 @@ void roblox_vm_create_sandbox(lua_State* L);
 // Enhanced function to detect and prevent infinite loops
 void roblox_vm_setup_loop_detection(lua_State* L);
 
+// Arm the interrupt-based execution watchdog; the script is interrupted with an error once timeoutMs elapses
+void roblox_vm_watchdog_arm(lua_State* L, int timeoutMs);
+
+// Disarm the execution watchdog
+void roblox_vm_watchdog_disarm(lua_State* L);
+
+// Start the sampling profiler; a timer thread requests samples at frequencyHz that are kept in a ring buffer of capacity frames
+void roblox_vm_profiler_start(lua_State* L, int frequencyHz, int capacity);
+
+// Stop the sampling profiler and write the samples to path (if not NULL) as folded stacks
+bool roblox_vm_profiler_stop(lua_State* L, const char* path, bool lines);
+
+// Sweep the heap on a helper thread after each mark phase; must be stopped before the state is closed unless roblox_vm_close is used
+void roblox_vm_background_sweep_start(lua_State* L);
+void roblox_vm_background_sweep_stop(lua_State* L);
+
 // Enhanced function to safely execute a script with all security measures
 int roblox_vm_execute_script(lua_State* L, const char* script, size_t scriptLen, const char* chunkname);
@@ -12,6 +12,7 @@
 #include "lvm.h"
 #include "lnumutils.h"
 #include "lbuffer.h"
+#include "lmem.h"
 
 #include <string.h>
 
@@ -120,6 +121,17 @@ static LUAU_FORCEINLINE TValue* index2addr(lua_State* L, int idx)
     }
 }
 
+// strings reach the host interned and terminated, so views are replaced with their flat copies first
+static LUAU_NOINLINE TString* flattenstring(lua_State* L, int idx, TValue* o)
+{
+    luaC_threadbarrier(L);
+    TString* ts = luaS_flatten(L, tsvalue(o));
+    setsvalue(L, o, ts);
+    if (idx < LUA_GLOBALSINDEX) // function upvalue?
+        luaC_barrier(L, curr_func(L), o);
+    return ts;
+}
+
 const TValue* luaA_toobject(lua_State* L, int idx)
 {
     StkId p = index2addr(L, idx);
@@ -435,6 +447,19 @@ const char* lua_tolstring(lua_State* L, int idx, size_t* len)
         luaC_checkGC(L);
         o = index2addr(L, idx); // previous call may reallocate the stack
     }
+    else if (tsvalue(o)->kind == STRING_VIEW)
+        flattenstring(L, idx, o);
+    if (len != NULL)
+        *len = tsvalue(o)->len;
+    return svalue(o);
+}
+
+const char* lua_tolstringview(lua_State* L, int idx, size_t* len)
+{
+    StkId o = index2addr(L, idx);
+    if (!ttisstring(o))
+        return lua_tolstring(L, idx, len);
+    // unlike lua_tolstring, substrings are read in place, so the contents aren't necessarily terminated
     if (len != NULL)
         *len = tsvalue(o)->len;
     return svalue(o);
@@ -446,6 +471,8 @@ const char* lua_tostringatom(lua_State* L, int idx, int* atom)
     if (!ttisstring(o))
         return NULL;
     TString* s = tsvalue(o);
+    if (s->kind == STRING_VIEW)
+        s = flattenstring(L, idx, o);
     if (atom)
     {
         updateatom(L, s);
@@ -466,6 +493,8 @@ const char* lua_tolstringatom(lua_State* L, int idx, size_t* len, int* atom)
     }
 
     TString* s = tsvalue(o);
+    if (s->kind == STRING_VIEW)
+        s = flattenstring(L, idx, o);
     if (len)
         *len = s->len;
     if (atom)
@@ -652,6 +681,16 @@ void lua_pushlstring(lua_State* L, const char* s, size_t len)
     api_incr_top(L);
 }
 
+void lua_pushsubstring(lua_State* L, int idx, size_t offset, size_t len)
+{
+    luaC_checkGC(L);
+    luaC_threadbarrier(L);
+    StkId o = index2addr(L, idx);
+    api_check(L, ttisstring(o) && offset + len <= tsvalue(o)->len);
+    setsvalue(L, L->top, luaS_sub(L, tsvalue(o), offset, len));
+    api_incr_top(L);
+}
+
 void lua_pushstring(lua_State* L, const char* s)
 {
     if (s == NULL)
@@ -1198,12 +1237,62 @@ int lua_gc(lua_State* L, int what, int data)
         g->gcstepsize = data << 10;
         break;
     }
+    case LUA_GCGEN:
+    case LUA_GCINC:
+    {
+        res = g->gcgen ? LUA_GCGEN : LUA_GCINC;
+        if (what == LUA_GCGEN && data > 0)
+            g->gcgenminormul = data;
+        luaC_setgenerational(L, what == LUA_GCGEN);
+        break;
+    }
+    case LUA_GCSETFRAMEBUDGET:
+    {
+        res = int(g->gcframe.budget * 1e6 + 0.5);
+        g->gcframe.budget = data * 1e-6;
+        break;
+    }
+    case LUA_GCFRAME:
+    {
+        luaC_startframe(L, data * 1e-6);
+        break;
+    }
+    case LUA_GCSETMARKTHREADS:
+    {
+        res = g->gcmarkthreads;
+        g->gcmarkthreads = data < 1 ? 1 : data;
+        break;
+    }
+    case LUA_GCSETDEFRAG:
+    {
+        res = g->gcdefrag;
+        g->gcdefrag = data < 0 ? 0 : data > 100 ? 100 : data;
+        break;
+    }
     default:
         res = -1; // invalid option
     }
     return res;
 }
 
+int lua_gcidle(lua_State* L, int microseconds)
+{
+    size_t debt = luaC_idle(L, microseconds * 1e-6);
+
+    // GC values are expressed in Kbytes: #bytes/2^10
+    return cast_int(debt >> 10);
+}
+
+void lua_gcsetbackgroundsweep(lua_State* L, void* ud, void (*notify)(void* ud))
+{
+    luaC_setbackgroundsweep(L, ud, notify);
+}
+
+int lua_gcsweepbackground(lua_State* L)
+{
+    return luaC_sweepbackground(L);
+}
+
 /*
 ** miscellaneous functions
 */
@@ -1349,7 +1438,7 @@ void* lua_newbuffer(lua_State* L, size_t sz)
     return b->data;
 }
 
-static const char* aux_upvalue(StkId fi, int n, TValue** val)
+static const char* aux_upvalue(lua_State* L, StkId fi, int n, TValue** val)
 {
     Closure* f;
     if (!ttisfunction(fi))
@@ -1369,6 +1458,8 @@ static const char* aux_upvalue(StkId fi, int n, TValue** val)
             return NULL;
         TValue* r = &f->l.uprefs[n - 1];
         *val = ttisupval(r) ? upvalue(r)->v : r;
+        if (p->lazydebuginfo)
+            luaV_loaddebuginfo(L, p);
         if (!(1 <= n && n <= p->sizeupvalues)) // don't have a name for this upvalue
             return "";
         return getstr(p->upvalues[n - 1]);
@@ -1379,7 +1470,7 @@ const char* lua_getupvalue(lua_State* L, int funcindex, int n)
 {
     luaC_threadbarrier(L);
     TValue* val;
-    const char* name = aux_upvalue(index2addr(L, funcindex), n, &val);
+    const char* name = aux_upvalue(L, index2addr(L, funcindex), n, &val);
     if (name)
     {
         setobj2s(L, L->top, val);
@@ -1393,7 +1484,7 @@ const char* lua_setupvalue(lua_State* L, int funcindex, int n)
     api_checknelems(L, 1);
     StkId fi = index2addr(L, funcindex);
     TValue* val;
-    const char* name = aux_upvalue(fi, n, &val);
+    const char* name = aux_upvalue(L, fi, n, &val);
     if (name)
     {
         L->top--;
@@ -1575,6 +1666,74 @@ size_t lua_totalbytes(lua_State* L, int category)
     return category < 0 ? L->global->totalbytes : L->global->memcatbytes[category];
 }
 
+void lua_setsizehistogram(lua_State* L, int enabled)
+{
+    global_State* g = L->global;
+    size_t count = LUA_MEMORY_CATEGORIES * LUA_SIZEBUCKETS;
+
+    if (enabled)
+    {
+        // the allocation of the histogram itself isn't counted
+        if (!g->sizehistogram)
+            g->sizehistogram = luaM_newarray(L, count, uint64_t, 0);
+
+        memset(g->sizehistogram, 0, count * sizeof(uint64_t));
+    }
+    else if (g->sizehistogram)
+    {
+        luaM_freearray(L, g->sizehistogram, count, uint64_t, 0);
+        g->sizehistogram = NULL;
+    }
+}
+
+int lua_getsizehistogram(lua_State* L, int category, uint64_t* counts)
+{
+    api_check(L, unsigned(category) < LUA_MEMORY_CATEGORIES);
+    global_State* g = L->global;
+
+    if (!g->sizehistogram)
+        return 0;
+
+    memcpy(counts, g->sizehistogram + category * LUA_SIZEBUCKETS, LUA_SIZEBUCKETS * sizeof(uint64_t));
+    return 1;
+}
+
+size_t lua_setmemorylimit(lua_State* L, int category, size_t limit)
+{
+    api_check(L, category < LUA_MEMORY_CATEGORIES);
+    global_State* g = L->global;
+    size_t* slot = category < 0 ? &g->memlimit : &g->memcatlimit[category];
+    size_t res = *slot;
+    *slot = limit;
+    luaM_updatebudget(g);
+    return res;
+}
+
+size_t lua_getmemorylimit(lua_State* L, int category)
+{
+    api_check(L, category < LUA_MEMORY_CATEGORIES);
+    return category < 0 ? L->global->memlimit : L->global->memcatlimit[category];
+}
+
+void lua_resetmetrics(lua_State* L)
+{
+    global_State* g = L->global;
+    g->metrics = lua_Metrics();
+    g->metrics.starttime = lua_clock();
+    g->metrics.peakbytes = g->totalbytes;
+    luaE_publishmetrics(g);
+}
+
+void lua_publishmetrics(lua_State* L)
+{
+    luaE_publishmetrics(L->global);
+}
+
+void lua_getmetrics(lua_State* L, lua_Metrics* metrics)
+{
+    luaE_snapshotmetrics(L->global, metrics);
+}
+
 lua_Alloc lua_getallocf(lua_State* L, void** ud)
 {
     lua_Alloc f = L->global->frealloc;
@@ -444,7 +444,7 @@ void luaL_addvalue(luaL_Strbuf* B)
     lua_State* L = B->L;
 
     size_t vl;
-    if (const char* s = lua_tolstring(L, -1, &vl))
+    if (const char* s = lua_tolstringview(L, -1, &vl))
     {
         if (size_t(B->end - B->p) < vl)
             extendstrbuf(B, vl - (B->end - B->p), -2);
@@ -487,7 +487,7 @@ void luaL_addvalueany(luaL_Strbuf* B, int idx)
     case LUA_TSTRING:
     {
         size_t len;
-        const char* s = lua_tolstring(L, idx, &len);
+        const char* s = lua_tolstringview(L, idx, &len);
         luaL_addlstring(B, s, len);
         break;
     }
@@ -909,7 +909,7 @@ static int luauF_sub(lua_State* L, StkId res, TValue* arg0, int nresults, StkId
 
         if (i >= 1 && j >= i && unsigned(j - 1) < unsigned(ts->len))
         {
-            setsvalue(L, res, luaS_newlstr(L, getstr(ts) + (i - 1), j - i + 1));
+            setsvalue(L, res, luaS_sub(L, ts, i - 1, j - i + 1));
             return 1;
         }
     }
@@ -1272,7 +1272,7 @@ static int luauF_tonumber(lua_State* L, StkId res, TValue* arg0, int nresults, S
             setnvalue(res, nvalue(arg0));
             return 1;
         }
-        else if (ttisstring(arg0) && luaO_str2d(svalue(arg0), &num))
+        else if (ttisstring(arg0) && luaS_str2d(tsvalue(arg0), &num))
         {
             setnvalue(res, num);
             return 1;
@@ -4,3 +4,51 @@
 
 // This is a forwarding header for Luau bytecode definition
 #include "Luau/Bytecode.h"
+
+// VM-internal superinstructions; the load-time fusion pass (see luau_setfusion) writes them over the opcode of the first instruction of a
+// common pair and keeps all operands, so instruction offsets, line info and jump targets are the same as in the original bytecode
+enum LuauFusedOpcode
+{
+    LOP_FUSED_GETIMPORT_CALL = LOP__COUNT,
+    LOP_FUSED_GETTABLEKS_NAMECALL,
+    LOP_FUSED_LOADN_FORNPREP,
+
+    LOP_FUSED__COUNT
+};
+
+static_assert(LOP_FUSED__COUNT <= 256, "fused opcodes have to fit into the opcode byte");
+
+// number of instruction words, including AUX, for a bytecode opcode
+inline int getOpLength(uint8_t op)
+{
+    switch (op)
+    {
+    case LOP_GETGLOBAL:
+    case LOP_SETGLOBAL:
+    case LOP_GETIMPORT:
+    case LOP_GETTABLEKS:
+    case LOP_SETTABLEKS:
+    case LOP_NAMECALL:
+    case LOP_JUMPIFEQ:
+    case LOP_JUMPIFLE:
+    case LOP_JUMPIFLT:
+    case LOP_JUMPIFNOTEQ:
+    case LOP_JUMPIFNOTLE:
+    case LOP_JUMPIFNOTLT:
+    case LOP_NEWTABLE:
+    case LOP_SETLIST:
+    case LOP_FORGLOOP:
+    case LOP_LOADKX:
+    case LOP_FASTCALL2:
+    case LOP_FASTCALL2K:
+    case LOP_FASTCALL3:
+    case LOP_JUMPXEQKNIL:
+    case LOP_JUMPXEQKB:
+    case LOP_JUMPXEQKN:
+    case LOP_JUMPXEQKS:
+        return 2;
+
+    default:
+        return 1;
+    }
+}
@@ -8,6 +8,7 @@
 #include "lgc.h"
 #include "ldo.h"
 #include "lbytecode.h"
+#include "lvm.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -21,7 +22,13 @@ static int currentpc(lua_State* L, CallInfo* ci)
 
 static int currentline(lua_State* L, CallInfo* ci)
 {
-    return luaG_getline(ci_func(ci)->l.p, currentpc(L, ci));
+    Proto* p = ci_func(ci)->l.p;
+
+    // line info of mapped chunks is decoded when it's first needed
+    if (p->lazylineinfo)
+        luaV_loadlineinfo(L, p);
+
+    return luaG_getline(p, currentpc(L, ci));
 }
 
 static Proto* getluaproto(CallInfo* ci)
@@ -72,6 +79,9 @@ const char* lua_getlocal(lua_State* L, int level, int n)
         return NULL;
 
     Proto* fp = getluaproto(ci);
+    if (fp && fp->lazydebuginfo)
+        luaV_loaddebuginfo(L, fp);
+
     const LocVar* var = fp ? luaF_getlocal(fp, n, currentpc(L, ci)) : NULL;
     if (var)
     {
@@ -93,6 +103,9 @@ const char* lua_setlocal(lua_State* L, int level, int n)
         return NULL;
 
     Proto* fp = getluaproto(ci);
+    if (fp && fp->lazydebuginfo)
+        luaV_loaddebuginfo(L, fp);
+
     const LocVar* var = fp ? luaF_getlocal(fp, n, currentpc(L, ci)) : NULL;
     if (var)
         setobj2s(L, ci->base + var->reg, L->top - 1);
@@ -287,8 +300,10 @@ l_noret luaG_indexerror(lua_State* L, const TValue* p1, const TValue* p2)
     const char* t2 = luaT_objtypename(L, p2);
     const TString* key = ttisstring(p2) ? tsvalue(p2) : 0;
 
-    if (key && key->len <= 64) // limit length to make sure we don't generate very long error messages for very long keys
-        luaG_runerror(L, "attempt to index %s with '%s'", t1, getstr(key));
+    // limit length to make sure we don't generate very long error messages for very long keys
+    // the key can be a view that isn't terminated, so its length is passed along
+    if (key && key->len <= 64)
+        luaG_runerror(L, "attempt to index %s with '%.*s'", t1, int(key->len), getstr(key));
     else
         luaG_runerror(L, "attempt to index %s with %s", t1, t2);
 }
@@ -297,7 +312,7 @@ l_noret luaG_methoderror(lua_State* L, const TValue* p1, const TString* p2)
 {
     const char* t1 = luaT_objtypename(L, p1);
 
-    luaG_runerror(L, "attempt to call missing method '%s' of %s", getstr(p2), t1);
+    luaG_runerror(L, "attempt to call missing method '%.*s' of %s", int(p2->len), getstr(p2), t1);
 }
 
 l_noret luaG_readonlyerror(lua_State* L)
@@ -497,12 +512,26 @@ static int getnextline(Proto* p, int line)
     return closest;
 }
 
+// functions of mapped chunks that haven't run yet are materialized so that breakpoints and coverage cover all of them
+static void loadlazyprotos(lua_State* L, Proto* p, LuaTable* env)
+{
+    if (p->lazyoffset)
+        luaV_materialize(L, p, env);
+
+    if (p->lazylineinfo)
+        luaV_loadlineinfo(L, p);
+
+    for (int i = 0; i < p->sizep; ++i)
+        loadlazyprotos(L, p->p[i], env);
+}
+
 int lua_breakpoint(lua_State* L, int funcindex, int line, int enabled)
 {
     const TValue* func = luaA_toobject(L, funcindex);
     api_check(L, ttisfunction(func) && !clvalue(func)->isC);
 
     Proto* p = clvalue(func)->l.p;
+    loadlazyprotos(L, p, clvalue(func)->env);
 
     // set the breakpoint to the next closest line with valid instructions
     int target = getnextline(p, line);
@@ -545,6 +574,7 @@ void lua_getcoverage(lua_State* L, int funcindex, void* context, lua_Coverage ca
     api_check(L, ttisfunction(func) && !clvalue(func)->isC);
 
     Proto* p = clvalue(func)->l.p;
+    loadlazyprotos(L, p, clvalue(func)->env);
 
     size_t size = getmaxline(p) + 1;
     if (size == 0)
@@ -613,3 +643,238 @@ const char* lua_debugtrace(lua_State* L)
 
     return buf;
 }
+
+static void profilerpush(Profiler* p, GCObject* function, int pc)
+{
+    ProfilerFrame& f = p->frames[p->head++ % unsigned(p->capacity)];
+    f.function = function;
+    f.pc = pc;
+}
+
+// runs on the thread that executes L and can't allocate: interrupts are also raised from GC steps and allocation failures
+static void profilersample(lua_State* L, Profiler* p, bool gc)
+{
+    int limit = p->capacity - 2 < PROFILER_MAXDEPTH ? p->capacity - 2 : PROFILER_MAXDEPTH;
+    int depth = 0;
+
+    if (gc)
+    {
+        profilerpush(p, NULL, PROFILER_GC);
+        depth++;
+    }
+
+    for (CallInfo* ci = L->ci; ci > L->base_ci; ci--)
+    {
+        if (depth == limit)
+        {
+            profilerpush(p, NULL, PROFILER_TRUNCATED);
+            depth++;
+            break;
+        }
+
+        Closure* cl = clvalue(ci->func);
+
+        if (cl->isC)
+            profilerpush(p, obj2gco(cl), 0);
+        else
+            profilerpush(p, obj2gco(cl->l.p), currentpc(L, ci));
+
+        depth++;
+    }
+
+    profilerpush(p, NULL, depth);
+
+    L->global->metrics.profilersamples++;
+}
+
+void luaG_interrupt(lua_State* L, int gc)
+{
+    global_State* g = L->global;
+
+    uint32_t requests = g->interruptrequests.load(std::memory_order_relaxed);
+
+    if (LUAU_UNLIKELY(requests & INTERRUPT_PROFILER))
+    {
+        g->interruptrequests.fetch_and(~uint32_t(INTERRUPT_PROFILER), std::memory_order_acquire);
+
+        // the profiler may have been stopped after the sample was requested
+        if (g->profiler)
+            profilersample(L, g->profiler, gc >= 0);
+    }
+
+    // the host callback may be set from another thread
+    if (void (*interrupt)(lua_State*, int) = __atomic_load_n(&g->cb.interrupt, __ATOMIC_RELAXED))
+        interrupt(L, gc);
+
+    // errors can only be raised from VM safepoints, GC steps report gc >= 0 and leave the request for the next one
+    if (LUAU_UNLIKELY(requests & INTERRUPT_TIMEOUT) && gc < 0)
+    {
+        g->interruptrequests.fetch_and(~uint32_t(INTERRUPT_TIMEOUT), std::memory_order_relaxed);
+
+        // the deadline could have been moved or cleared after the request was raised
+        double deadline = g->deadline.load(std::memory_order_relaxed);
+
+        if (deadline != 0 && lua_clock() >= deadline)
+        {
+            g->deadline.store(0, std::memory_order_relaxed);
+            g->metrics.timeouts++;
+            luaG_runerror(L, "script execution timed out");
+        }
+    }
+}
+
+void lua_profilerstart(lua_State* L, int capacity)
+{
+    api_check(L, capacity > 2);
+
+    lua_profilerstop(L);
+
+    global_State* g = L->global;
+
+    ProfilerFrame* frames = luaM_newarray(L, capacity, ProfilerFrame, 0);
+
+    Profiler* p = cast_to(Profiler*, luaM_new_(L, sizeof(Profiler), 0));
+    p->frames = frames;
+    p->capacity = capacity;
+    p->head = 0;
+
+    g->profiler = p;
+}
+
+void luaG_freeprofiler(lua_State* L)
+{
+    global_State* g = L->global;
+    Profiler* p = g->profiler;
+
+    if (!p)
+        return;
+
+    // requests only touch the flag word, so a sample that is requested from now on is dropped by luaG_interrupt
+    g->profiler = NULL;
+    g->interruptrequests.fetch_and(~uint32_t(INTERRUPT_PROFILER), std::memory_order_relaxed);
+
+    luaM_freearray(L, p->frames, p->capacity, ProfilerFrame, 0);
+    luaM_free_(L, p, sizeof(Profiler), 0);
+}
+
+void lua_profilerstop(lua_State* L)
+{
+    luaG_freeprofiler(L);
+}
+
+void lua_profilerrequest(lua_State* L)
+{
+    // this is the only profiler function that may run on another thread, so it doesn't access the Profiler
+    L->global->interruptrequests.fetch_or(INTERRUPT_PROFILER, std::memory_order_release);
+}
+
+static void appendframe(char*& buf, size_t& size, size_t& capacity, lua_State* L, const char* data, bool separator)
+{
+    size_t len = strlen(data);
+
+    if (size + len + 2 > capacity)
+    {
+        size_t newcapacity = (size + len + 2) * 2;
+        luaM_reallocarray(L, buf, capacity, newcapacity, char, 0);
+        capacity = newcapacity;
+    }
+
+    // ';' separates frames in folded stacks so it can't appear in frame names
+    if (separator)
+        buf[size++] = ';';
+
+    for (size_t i = 0; i < len; ++i)
+        buf[size++] = data[i] == ';' ? ':' : data[i];
+}
+
+static void getframename(lua_State* L, const ProfilerFrame& f, int lines, char* name, size_t size)
+{
+    if (!f.function)
+    {
+        snprintf(name, size, "%s", f.pc == PROFILER_GC ? "[gc]" : "[truncated]");
+    }
+    else if (f.function->gch.tt == LUA_TFUNCTION)
+    {
+        Closure* cl = gco2cl(f.function);
+        snprintf(name, size, "%s [C]", cl->c.debugname ? cl->c.debugname : "<C function>");
+    }
+    else
+    {
+        Proto* p = gco2p(f.function);
+
+        if (lines && p->lazylineinfo)
+            luaV_loadlineinfo(L, p);
+
+        char buf[LUA_IDSIZE];
+        const char* source = luaO_chunkid(buf, sizeof(buf), getstr(p->source), p->source->len);
+
+        const char* fname = p->debugname ? getstr(p->debugname) : p->linedefined == 0 ? "<main>" : "<anonymous>";
+        snprintf(name, size, "%s %s:%d", fname, source, lines ? luaG_getline(p, f.pc) : p->linedefined);
+    }
+}
+
+void lua_profilerdump(lua_State* L, int lines, void* context, void (*write)(void* context, const char* data, size_t size))
+{
+    Profiler* p = L->global->profiler;
+    if (!p)
+        return;
+
+    // identical stacks are merged through a table that maps each stack to the number of its samples
+    lua_createtable(L, 0, 0);
+
+    char* buf = NULL;
+    size_t capacity = 0;
+
+    uint64_t oldest = p->head > uint64_t(p->capacity) ? p->head - p->capacity : 0;
+    uint64_t end = p->head;
+
+    // samples are read from the newest one since only the end record tells where a sample starts
+    while (end > oldest)
+    {
+        int depth = p->frames[(end - 1) % unsigned(p->capacity)].pc;
+
+        if (end - 1 - oldest < uint64_t(depth))
+            break;
+
+        uint64_t start = end - 1 - depth;
+        size_t size = 0;
+
+        for (uint64_t i = end - 1; i > start; --i)
+        {
+            char name[LUA_IDSIZE + 64];
+            getframename(L, p->frames[(i - 1) % unsigned(p->capacity)], lines, name, sizeof(name));
+
+            appendframe(buf, size, capacity, L, name, size != 0);
+        }
+
+        lua_pushlstring(L, buf ? buf : "", size);
+        lua_pushvalue(L, -1);
+        lua_rawget(L, -3);
+        lua_Number count = lua_tonumber(L, -1);
+        lua_pop(L, 1);
+        lua_pushnumber(L, count + 1);
+        lua_rawset(L, -3);
+
+        end = start;
+    }
+
+    if (buf)
+        luaM_freearray(L, buf, capacity, char, 0);
+
+    lua_pushnil(L);
+    while (lua_next(L, -2))
+    {
+        size_t len = 0;
+        const char* stack = lua_tolstring(L, -2, &len);
+
+        char count[32];
+        snprintf(count, sizeof(count), " %d\n", int(lua_tonumber(L, -1)));
+
+        write(context, stack, len);
+        write(context, count, strlen(count));
+
+        lua_pop(L, 1);
+    }
+
+    lua_pop(L, 1);
+}
@@ -30,5 +30,9 @@ LUAI_FUNC bool luaG_onbreak(lua_State* L);
 
 LUAI_FUNC int luaG_getline(Proto* p, int pc);
 
+LUAI_FUNC void luaG_freeprofiler(lua_State* L);
+
+LUAI_FUNC void luaG_interrupt(lua_State* L, int gc);
+
 LUAI_FUNC int luaG_isnative(lua_State* L, int level);
 LUAI_FUNC int luaG_hasnative(lua_State* L, int level);
@@ -233,7 +233,10 @@ CallInfo* luaD_growCI(lua_State* L)
     luaD_reallocCI(L, L->size_ci >= LUAI_MAXCALLS ? hardlimit : request < LUAI_MAXCALLS ? request : LUAI_MAXCALLS);
 
     if (L->size_ci > LUAI_MAXCALLS)
+    {
+        L->global->metrics.stackoverflows++;
         luaG_runerror(L, "stack overflow");
+    }
 
     return ++L->ci;
 }
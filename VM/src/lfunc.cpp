@@ -5,6 +5,7 @@
 #include "lstate.h"
 #include "lmem.h"
 #include "lgc.h"
+#include "lvm.h"
 
 Proto* luaF_newproto(lua_State* L)
 {
@@ -41,6 +42,14 @@ Proto* luaF_newproto(lua_State* L)
 
     f->gclist = NULL;
 
+    f->lazychunk = NULL;
+    f->lazyoffset = 0;
+    f->lazylineinfo = 0;
+    f->lazydebuginfo = 0;
+
+    f->icache = NULL;
+    f->icindex = NULL;
+
     f->sizecode = 0;
     f->sizep = 0;
     f->sizelocvars = 0;
@@ -51,6 +60,7 @@ Proto* luaF_newproto(lua_State* L)
     f->linedefined = 0;
     f->bytecodeid = 0;
     f->sizetypeinfo = 0;
+    f->sizeicache = 0;
 
     return f;
 }
@@ -177,6 +187,14 @@ void luaF_freeproto(lua_State* L, Proto* f, lua_Page* page)
     if (f->typeinfo)
         luaM_freearray(L, f->typeinfo, f->sizetypeinfo, uint8_t, f->memcat);
 
+    if (f->lazychunk)
+        luaV_releasechunk(L, f->lazychunk);
+
+    if (f->icache)
+        luaM_freearray(L, f->icache, f->sizeicache, InlineCache, f->memcat);
+    if (f->icindex)
+        luaM_freearray(L, f->icindex, f->sizecode, uint16_t, f->memcat);
+
     luaM_freegco(L, f, sizeof(Proto), f->memcat, page);
 }
 
@@ -11,9 +11,16 @@
 #include "lmem.h"
 #include "ludata.h"
 #include "lbuffer.h"
+#include "lvm.h"
+#include "ldebug.h"
 
 #include <string.h>
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 /*
  * Luau uses an incremental non-generational non-moving mark&sweep garbage collector.
  *
@@ -81,6 +88,11 @@
  * emptying out the `gray` list the second time, we finish the mark stage and do final marking of `grayagain` during atomic phase.
  * GC works correctly without this second-phase mark (called GCSpropagateagain), but it reduces the time spent during atomic phase.
  *
+ * Traversing a table with a large array part could take longer than a whole incremental step, so such tables are painted black
+ * after their hash part is traversed and the array is traversed in chunks by the following steps (see `graytable`). Writes to the
+ * array go through the regular backward barrier, so if the table is modified in the meantime, it is queued for another traversal
+ * and the rest of the chunks are skipped. Operations that move elements within the array without a barrier use luaC_arraybarrier.
+ *
  * Sweeping is also incremental, but instead of working at a granularity of an object, it works at a granularity of a page: all GC
  * objects are allocated in special pages (see lmem.cpp for details), and sweeper traverses all objects in one page in one incremental
  * step, freeing objects that aren't reachable (old white), and recoloring all other objects with the new white to prepare them for next
@@ -88,6 +100,24 @@
  * however, some barriers will still trigger (because some reachable objects are still black as sweeping didn't get to them yet), and
  * some barriers will proactively mark black objects as white to avoid extra barriers from triggering excessively.
  *
+ * Optionally, sweeping can be offloaded to helper threads (see lua_gcsetbackgroundsweep). At the end of atomic phase all pages are
+ * put into a sweep queue and detached from the allocator, so new objects go to new pages. Helper threads claim queued pages from the
+ * end of the queue and sweep them without touching any global state: live objects are recolored, and dead objects that don't own any
+ * other memory (closures, upvalues and buffers) are returned to the page free list. Dead objects of other types need to run code that
+ * isn't thread safe, so a page that has them is marked as dirty. The thread running the state walks the queue from the front in its
+ * sweep steps: pages that were swept by a helper are returned to the allocator after applying their accounting (and dirty pages are
+ * swept again to free the remaining objects), and pages that no helper got to are swept as usual. While the queue exists, barriers
+ * don't touch object marks, so the only writes to an object header from both threads are recoloring a live object to the same value.
+ *
+ * Optionally, the collector can run in generational mode (see LUA_GCGEN), using sticky mark bits: the sweep that follows a cycle keeps
+ * the marks of surviving objects instead of making them white, so they are "old" and the next cycle (a minor one) only has to mark
+ * objects that were allocated since, which are white. Barriers keep the tri-color invariant between cycles as well, so an old object
+ * that gets a reference to a young one is either queued on a gray list (which is not reset by a minor cycle and acts as a remembered
+ * set) or makes the young object gray right away. Threads with open upvalues and weak tables are kept gray, so they are rescanned
+ * and cleared by every cycle. Minor sweeps only visit pages that had objects allocated out of them since the previous sweep. Once the
+ * heap grows past the goal relative to its size after the last major cycle, the collector sweeps all pages once more to make every
+ * object white, and the cycle after that is a regular (major) one. Background sweeping is only used for cycles that don't keep marks.
+ *
  * Most references that GC deals with are strong, and as such they fit neatly into the incremental marking scheme. Some, however, are
  * weak - notably, tables can be marked as having weak keys/values (using __mode metafield). During incremental marking, we don't know
  * for certain if a given object is alive - if it's marked as black, it definitely was reachable during marking, but if it's marked as
@@ -100,7 +130,9 @@
  * Strings are semantically black (they are initially white, and when the mark stage reaches a string, it changes its color and never
  * touches the object again), but they are technically marked as gray - the black bit is never set on a string object. This behavior
  * is inherited from Lua 5.1 GC, but doesn't have a clear rationale - effectively, strings are marked as gray but are never part of
- * a gray list.
+ * a gray list. A view (see STRING_VIEW) marks the string that holds its contents, unless it only covers a small part of a long
+ * string: then it's recorded instead, and at the end of the atomic phase the views whose base still wasn't marked get copies of
+ * their contents, which lets the base be freed. Views on thread stacks always mark their base, as C functions may be reading it.
  *
  * Threads are hard to deal with because for them to fit into the white-gray-black scheme, writes to thread stacks need to have barriers
  * that turn the thread from black (already scanned) to gray - but this is very expensive because stack writes are very common. To
@@ -119,11 +151,26 @@
 
 #define GC_SWEEPPAGESTEPCOST 16
 
+// number of array elements of a large table that are traversed at a time
+#define GC_ARRAYCHUNK 256
+
+// a view that covers at most 1/GC_VIEWPINRATIO of a string of at least GC_VIEWPINSIZE bytes doesn't mark it; if nothing else does,
+// the view gets a copy of its contents at the end of the mark phase and the string is freed
+#define GC_VIEWPINSIZE 4096
+#define GC_VIEWPINRATIO 8
+
+#define canpinview(ts) ((ts)->base->len >= GC_VIEWPINSIZE && (ts)->len <= (ts)->base->len / GC_VIEWPINRATIO)
+
+// states of a page in the background sweep queue
+#define SWEEP_QUEUED 0  // not claimed yet
+#define SWEEP_HELPER 1  // being swept by a helper thread
+#define SWEEP_DONE 2    // swept by a helper thread, waiting to be returned to the allocator
+#define SWEEP_MUTATOR 3 // claimed by the thread running the state
+
 #define GC_INTERRUPT(state) \
     { \
-        void (*interrupt)(lua_State*, int) = g->cb.interrupt; \
-        if (LUAU_UNLIKELY(!!interrupt)) \
-            interrupt(L, state); \
+        if (LUAU_UNLIKELY(hasinterrupt(g))) \
+            luaG_interrupt(L, state); \
     }
 
 #define maskmarks cast_byte(~(bitmask(BLACKBIT) | WHITEBITS))
@@ -232,6 +279,27 @@ static void removeentry(LuaNode* n)
         setttype(gkey(n), LUA_TDEADKEY); // dead key; remove it
 }
 
+static bool pinview(global_State* g, TString* ts)
+{
+    if (!iswhite(obj2gco(ts->base)) || !canpinview(ts))
+        return false;
+
+    if (g->pinviewcount == g->pinviewcapacity)
+    {
+        // marking can't fail, so if the list can't grow the view marks its base as usual
+        int capacity = g->pinviewcapacity ? g->pinviewcapacity * 2 : 64;
+        void* views = (*g->frealloc)(g->ud, g->pinviews, g->pinviewcapacity * sizeof(TString*), capacity * sizeof(TString*));
+        if (!views)
+            return false;
+
+        g->pinviews = (TString**)views;
+        g->pinviewcapacity = capacity;
+    }
+
+    g->pinviews[g->pinviewcount++] = ts;
+    return true;
+}
+
 static void reallymarkobject(global_State* g, GCObject* o)
 {
     LUAU_ASSERT(iswhite(o) && !isdead(g, o));
@@ -240,6 +308,9 @@ static void reallymarkobject(global_State* g, GCObject* o)
     {
     case LUA_TSTRING:
     {
+        TString* ts = gco2ts(o);
+        if (ts->kind == STRING_VIEW && !pinview(g, ts))
+            markobject(g, ts->base);
         return;
     }
     case LUA_TUSERDATA:
@@ -292,16 +363,22 @@ static void reallymarkobject(global_State* g, GCObject* o)
     }
 }
 
-static const char* gettablemode(global_State* g, LuaTable* h)
+static const TString* gettablemode(global_State* g, LuaTable* h)
 {
     const TValue* mode = gfasttm(g, h->metatable, TM_MODE);
 
     if (mode && ttisstring(mode))
-        return svalue(mode);
+        return tsvalue(mode);
 
     return NULL;
 }
 
+// mode can be a view, which isn't terminated
+static bool hasmode(const TString* mode, char m)
+{
+    return memchr(getstr(mode), m, mode->len) != NULL;
+}
+
 static int traversetable(global_State* g, LuaTable* h)
 {
     int i;
@@ -311,10 +388,10 @@ static int traversetable(global_State* g, LuaTable* h)
         markobject(g, cast_to(LuaTable*, h->metatable));
 
     // is there a weak mode?
-    if (const char* modev = gettablemode(g, h))
+    if (const TString* modev = gettablemode(g, h))
     {
-        weakkey = (strchr(modev, 'k') != NULL);
-        weakvalue = (strchr(modev, 'v') != NULL);
+        weakkey = hasmode(modev, 'k');
+        weakvalue = hasmode(modev, 'v');
         if (weakkey || weakvalue)
         {                         // is really weak?
             h->gclist = g->weak;  // must be cleared after GC, ...
@@ -326,9 +403,19 @@ static int traversetable(global_State* g, LuaTable* h)
         return 1;
     if (!weakvalue)
     {
-        i = h->sizearray;
-        while (i--)
-            markvalue(g, &h->array[i]);
+        // large arrays of strong tables are traversed in chunks by the next steps, see propagatearray
+        if (h->sizearray > GC_ARRAYCHUNK && !weakkey)
+        {
+            LUAU_ASSERT(!g->graytable);
+            g->graytable = h;
+            g->graytablepos = 0;
+        }
+        else
+        {
+            i = h->sizearray;
+            while (i--)
+                markvalue(g, &h->array[i]);
+        }
     }
     i = sizenode(h);
     while (i--)
@@ -404,7 +491,12 @@ static void traversestack(global_State* g, lua_State* l)
     if (l->namecall)
         stringmark(l->namecall);
     for (StkId o = l->stack; o < l->top; o++)
+    {
+        // C functions can hold pointers into the bases of views on the stack (see lua_tolstringview), so these are always kept
+        if (ttisstring(o) && tsvalue(o)->kind == STRING_VIEW)
+            markobject(g, tsvalue(o)->base);
         markvalue(g, o);
+    }
     for (UpVal* uv = l->openupval; uv; uv = uv->u.open.threadnext)
     {
         LUAU_ASSERT(upisopen(uv));
@@ -446,12 +538,45 @@ static void shrinkstack(lua_State* L)
     condhardstacktests(luaD_reallocstack(L, s_used, 0));
 }
 
+/*
+** traverse the next chunk of the array part of a table that is already black.
+** writes to the table turn it gray and queue it for another traversal, in which
+** case the rest of the array doesn't need to be traversed now.
+*/
+static size_t propagatearray(global_State* g)
+{
+    LuaTable* h = g->graytable;
+
+    if (!isblack(obj2gco(h)))
+    {
+        g->graytable = NULL;
+        return 0;
+    }
+
+    int begin = g->graytablepos;
+    int end = h->sizearray - begin > GC_ARRAYCHUNK ? begin + GC_ARRAYCHUNK : h->sizearray;
+
+    for (int i = begin; i < end; i++)
+        markvalue(g, &h->array[i]);
+
+    if (end == h->sizearray)
+        g->graytable = NULL;
+    else
+        g->graytablepos = end;
+
+    return sizeof(TValue) * (end - begin);
+}
+
 /*
 ** traverse one gray object, turning it to black.
 ** Returns `quantity' traversed.
 */
 static size_t propagatemark(global_State* g)
 {
+    // finish the array of a large table before moving on to other objects
+    if (g->graytable)
+        return propagatearray(g);
+
     GCObject* o = g->gray;
     LUAU_ASSERT(isgray(o));
     gray2black(o);
@@ -463,7 +588,8 @@ static size_t propagatemark(global_State* g)
         g->gray = h->gclist;
         if (traversetable(g, h)) // table is weak?
             black2gray(o);       // keep it gray
-        return sizeof(LuaTable) + sizeof(TValue) * h->sizearray + sizeof(LuaNode) * sizenode(h);
+        // array part traversed in chunks is accounted for by propagatearray
+        return sizeof(LuaTable) + (g->graytable == h ? 0 : sizeof(TValue) * h->sizearray) + sizeof(LuaNode) * sizenode(h);
     }
     case LUA_TFUNCTION:
     {
@@ -477,7 +603,8 @@ static size_t propagatemark(global_State* g)
         lua_State* th = gco2th(o);
         g->gray = th->gclist;
 
-        bool active = th->isactive || th == th->global->mainthread;
+        // in generational mode, threads with open upvalues are rescanned by every cycle since minor cycles rely on that to find live upvalues
+        bool active = th->isactive || th == th->global->mainthread || (th->global->gcgen && th->openupval);
 
         traversestack(g, th);
 
@@ -519,7 +646,7 @@ static size_t propagatemark(global_State* g)
 static size_t propagateall(global_State* g)
 {
     size_t work = 0;
-    while (g->gray)
+    while (g->gray || g->graytable)
     {
         work += propagatemark(g);
     }
@@ -527,203 +654,832 @@ static size_t propagateall(global_State* g)
 }
 
 /*
-** The next function tells whether a key or value can be cleared from
-** a weak table. Non-collectable objects are never removed from weak
-** tables. Strings behave as `values', so are never removed too. for
-** other objects: if really collected, cannot keep them.
+** Parallel marking for full collections, see LUA_GCSETMARKTHREADS.
+**
+** Worker threads take gray objects from their own stacks and traverse them. References are marked by clearing the white bits of
+** an object atomically, so every object is claimed and traversed by exactly one worker. Large tables are split into slices of
+** array elements and hash nodes that are traversed as separate items. Once the stack of a worker grows large enough, it moves the
+** older half to a shared stack that workers which run out of work steal from. Workers don't touch any state shared with other
+** workers except object colors: weak tables and threads that need to be traversed again are collected by each worker and linked
+** into the gray lists after all workers finish, and so are tables that have dead keys to remove, since a worker could be looking
+** up __mode in the same table, and views that don't mark their base (see pinview).
 */
-static int isobjcleared(GCObject* o)
-{
-    if (o->gch.tt == LUA_TSTRING)
-    {
-        stringmark(&o->ts); // strings are `values', so are never weak
-        return 0;
-    }
 
-    return iswhite(o);
-}
+// number of table slots that one parallel mark item traverses at most
+#define GC_MARKSLICE 1024
+// number of items on the stack of a worker at which it shares half of them
+#define GC_MARKSHARE 64
 
-#define iscleared(o) (iscollectable(o) && isobjcleared(gcvalue(o)))
+struct MarkItem
+{
+    GCObject* o;
+    // slice of a large table, array elements first and hash nodes after them; empty for items that traverse the whole object
+    int begin;
+    int end;
+};
 
-/*
-** clear collected entries from weaktables
-*/
-static size_t cleartable(lua_State* L, GCObject* l)
+struct MarkWorker
 {
+    std::vector<MarkItem> stack;
+
+    std::mutex lock;
+    std::vector<MarkItem> shared; // protected by lock
+    std::atomic<int> sharedcount{0};
+
+    GCObject* weak = NULL;           // weak tables, linked using gclist
+    GCObject* grayagain = NULL;      // active threads, linked using gclist
+    std::vector<MarkItem> deadkeys;  // table slices with empty nodes
+    std::vector<TString*> pinviews;  // views that didn't mark their base, see pinview
     size_t work = 0;
-    while (l)
-    {
-        LuaTable* h = gco2h(l);
-        work += sizeof(LuaTable) + sizeof(TValue) * h->sizearray + sizeof(LuaNode) * sizenode(h);
+};
 
-        int i = h->sizearray;
-        while (i--)
-        {
-            TValue* o = &h->array[i];
-            if (iscleared(o))   // value was collected?
-                setnilvalue(o); // remove value
-        }
-        i = sizenode(h);
-        int activevalues = 0;
-        while (i--)
-        {
-            LuaNode* n = gnode(h, i);
+struct ParallelMark
+{
+    global_State* g;
+    std::vector<MarkWorker> workers;
 
-            // non-empty entry?
-            if (!ttisnil(gval(n)))
-            {
-                // can we clear key or value?
-                if (iscleared(gkey(n)) || iscleared(gval(n)))
-                {
-                    setnilvalue(gval(n)); // remove value ...
-                    removeentry(n);       // remove entry from table
-                }
-                else
-                {
-                    activevalues++;
-                }
-            }
-        }
+    std::atomic<int> running{1}; // workers that were started, including the thread running the state
+    std::atomic<int> idle{0};    // workers that ran out of work
+};
 
-        if (const char* modev = gettablemode(L->global, h))
-        {
-            // are we allowed to shrink this weak table?
-            if (strchr(modev, 's'))
-            {
-                // shrink at 37.5% occupancy
-                if (activevalues < sizenode(h) * 3 / 8)
-                    luaH_resizehash(L, h, activevalues);
-            }
-        }
+static_assert(sizeof(std::atomic<uint8_t>) == sizeof(uint8_t), "object colors are updated in place");
 
-        l = h->gclist;
-    }
-    return work;
+static std::atomic<uint8_t>& markbits(GCObject* o)
+{
+    return *reinterpret_cast<std::atomic<uint8_t>*>(&o->gch.marked);
 }
 
-static void freeobj(lua_State* L, GCObject* o, lua_Page* page)
+// turns a white object gray; fails if another worker got there first
+static bool claimobject(GCObject* o)
 {
-    switch (o->gch.tt)
+    std::atomic<uint8_t>& marked = markbits(o);
+    uint8_t m = marked.load(std::memory_order_relaxed);
+
+    while (m & WHITEBITS)
     {
-    case LUA_TPROTO:
-        luaF_freeproto(L, gco2p(o), page);
-        break;
-    case LUA_TFUNCTION:
-        luaF_freeclosure(L, gco2cl(o), page);
-        break;
-    case LUA_TUPVAL:
-        luaF_freeupval(L, gco2uv(o), page);
-        break;
-    case LUA_TTABLE:
-        luaH_free(L, gco2h(o), page);
-        break;
-    case LUA_TTHREAD:
-        LUAU_ASSERT(gco2th(o) != L && gco2th(o) != L->global->mainthread);
-        luaE_freethread(L, gco2th(o), page);
-        break;
-    case LUA_TSTRING:
-        luaS_free(L, gco2ts(o), page);
-        break;
-    case LUA_TUSERDATA:
-        luaU_freeudata(L, gco2u(o), page);
-        break;
-    case LUA_TBUFFER:
-        luaB_freebuffer(L, gco2buf(o), page);
-        break;
-    default:
-        LUAU_ASSERT(0);
+        if (marked.compare_exchange_weak(m, cast_byte(m & ~WHITEBITS), std::memory_order_relaxed))
+            return true;
     }
+
+    return false;
 }
 
-static void shrinkbuffers(lua_State* L)
+static void blackenobject(GCObject* o)
 {
-    global_State* g = L->global;
-    // check size of string hash
-    if (g->strt.nuse < cast_to(uint32_t, g->strt.size / 4) && g->strt.size > LUA_MINSTRTABSIZE * 2)
-        luaS_resize(L, g->strt.size / 2); // table is too big
+    markbits(o).fetch_or(bitmask(BLACKBIT), std::memory_order_relaxed);
 }
 
-static void shrinkbuffersfull(lua_State* L)
+static void pushitem(MarkWorker& w, GCObject* o, int begin, int end)
 {
-    global_State* g = L->global;
-    // check size of string hash
-    int hashsize = g->strt.size;
-    while (g->strt.nuse < cast_to(uint32_t, hashsize / 4) && hashsize > LUA_MINSTRTABSIZE * 2)
-        hashsize /= 2;
-    if (hashsize != g->strt.size)
-        luaS_resize(L, hashsize); // table is too big
+    w.stack.push_back({o, begin, end});
+
+    // other workers may be waiting for work
+    if (w.stack.size() >= GC_MARKSHARE && w.sharedcount.load(std::memory_order_relaxed) == 0)
+    {
+        size_t half = w.stack.size() / 2;
+
+        std::lock_guard<std::mutex> guard(w.lock);
+        w.shared.insert(w.shared.end(), w.stack.begin(), w.stack.begin() + half);
+        w.stack.erase(w.stack.begin(), w.stack.begin() + half);
+        w.sharedcount.store(int(w.shared.size()), std::memory_order_relaxed);
+    }
 }
 
-static bool deletegco(void* context, lua_Page* page, GCObject* gco)
+// same as pinview, but the views are kept by the worker until marking is done; the base may still be marked by another worker
+static bool ppinview(MarkWorker& w, TString* ts)
 {
-    lua_State* L = (lua_State*)context;
-    freeobj(L, gco, page);
+    if (!(markbits(obj2gco(ts->base)).load(std::memory_order_relaxed) & WHITEBITS) || !canpinview(ts))
+        return false;
+
+    w.pinviews.push_back(ts);
     return true;
 }
 
-void luaC_freeall(lua_State* L)
+static void pmarkobject(MarkWorker& w, GCObject* o)
 {
-    global_State* g = L->global;
+    if (!claimobject(o))
+        return;
 
-    LUAU_ASSERT(L == g->mainthread);
+    switch (o->gch.tt)
+    {
+    case LUA_TSTRING:
+    {
+        TString* ts = gco2ts(o);
+        if (ts->kind == STRING_VIEW && !ppinview(w, ts))
+            pmarkobject(w, obj2gco(ts->base));
+        return;
+    }
+    case LUA_TUSERDATA:
+    {
+        LuaTable* mt = gco2u(o)->metatable;
+        blackenobject(o); // udata are never gray
+        if (mt)
+            pmarkobject(w, obj2gco(mt));
+        return;
+    }
+    case LUA_TUPVAL:
+    {
+        UpVal* uv = gco2uv(o);
+        if (iscollectable(uv->v))
+            pmarkobject(w, gcvalue(uv->v));
+        if (!upisopen(uv))   // closed?
+            blackenobject(o); // open upvalues are never black
+        return;
+    }
+    case LUA_TBUFFER:
+    {
+        blackenobject(o); // buffers are never gray
+        return;
+    }
+    case LUA_TFUNCTION:
+    case LUA_TTABLE:
+    case LUA_TTHREAD:
+    case LUA_TPROTO:
+    {
+        pushitem(w, o, 0, 0);
+        return;
+    }
+    default:
+        LUAU_ASSERT(0);
+    }
+}
 
-    luaM_visitgco(L, L, deletegco);
+#define pmarkvalue(w, o) \
+    { \
+        checkconsistency(o); \
+        if (iscollectable(o)) \
+            pmarkobject(w, gcvalue(o)); \
+    }
 
-    for (int i = 0; i < g->strt.size; i++) // free all string lists
-        LUAU_ASSERT(g->strt.hash[i] == NULL);
+static void ptraverseslice(MarkWorker& w, LuaTable* h, int begin, int end, bool weakkey, bool weakvalue)
+{
+    bool deadkeys = false;
 
-    LUAU_ASSERT(L->global->strt.nuse == 0);
-}
+    for (int i = begin; i < end && i < h->sizearray; i++)
+    {
+        if (!weakvalue)
+            pmarkvalue(w, &h->array[i]);
+    }
 
-static void markmt(global_State* g)
-{
-    int i;
-    for (i = 0; i < LUA_T_COUNT; i++)
-        if (g->mt[i])
-            markobject(g, g->mt[i]);
-}
+    for (int i = begin > h->sizearray ? begin : h->sizearray; i < end; i++)
+    {
+        LuaNode* n = gnode(h, i - h->sizearray);
+        LUAU_ASSERT(ttype(gkey(n)) != LUA_TDEADKEY || ttisnil(gval(n)));
+        if (ttisnil(gval(n)))
+            deadkeys |= iscollectable(gkey(n));
+        else
+        {
+            LUAU_ASSERT(!ttisnil(gkey(n)));
+            if (!weakkey)
+                pmarkvalue(w, gkey(n));
+            if (!weakvalue)
+                pmarkvalue(w, gval(n));
+        }
+    }
 
-// mark root set
-static void markroot(lua_State* L)
-{
-    global_State* g = L->global;
-    g->gray = NULL;
-    g->grayagain = NULL;
-    g->weak = NULL;
-    markobject(g, g->mainthread);
-    // make global table be traversed before main stack
-    markobject(g, g->mainthread->gt);
-    markvalue(g, registry(L));
-    markmt(g);
-    g->gcstate = GCSpropagate;
+    if (deadkeys)
+        w.deadkeys.push_back({obj2gco(h), begin, end});
+
+    w.work += sizeof(TValue) * (end - begin);
 }
 
-static size_t remarkupvals(global_State* g)
+static void ptraversetable(global_State* g, MarkWorker& w, LuaTable* h)
 {
-    size_t work = 0;
+    bool weakkey = false;
+    bool weakvalue = false;
 
-    for (UpVal* uv = g->uvhead.u.open.next; uv != &g->uvhead; uv = uv->u.open.next)
+    if (LuaTable* mt = h->metatable)
     {
-        work += sizeof(UpVal);
+        pmarkobject(w, obj2gco(mt));
 
-        LUAU_ASSERT(upisopen(uv));
-        LUAU_ASSERT(uv->u.open.next->u.open.prev == uv && uv->u.open.prev->u.open.next == uv);
-        LUAU_ASSERT(!isblack(obj2gco(uv))); // open upvalues are never black
+        // same as gettablemode, but without updating the tag method cache of the metatable
+        const TValue* mode = (mt->tmcache & (1u << TM_MODE)) ? NULL : luaH_getstr(mt, g->tmname[TM_MODE]);
 
-        if (isgray(obj2gco(uv)))
-            markvalue(g, uv->v);
+        if (mode && ttisstring(mode))
+        {
+            weakkey = hasmode(tsvalue(mode), 'k');
+            weakvalue = hasmode(tsvalue(mode), 'v');
+        }
     }
 
-    return work;
-}
-
-static size_t clearupvals(lua_State* L)
-{
-    global_State* g = L->global;
+    int slots = h->sizearray + sizenode(h);
 
-    size_t work = 0;
+    w.work += sizeof(LuaTable);
 
-    for (UpVal* uv = g->uvhead.u.open.next; uv != &g->uvhead;)
+    if (weakkey || weakvalue)
+    {
+        h->gclist = w.weak; // keep it gray and clear it after GC
+        w.weak = obj2gco(h);
+
+        if (!(weakkey && weakvalue))
+            ptraverseslice(w, h, 0, slots, weakkey, weakvalue);
+    }
+    else
+    {
+        blackenobject(obj2gco(h));
+
+        if (slots > GC_MARKSLICE)
+            pushitem(w, obj2gco(h), 0, slots);
+        else
+            ptraverseslice(w, h, 0, slots, false, false);
+    }
+}
+
+static void ptraverseproto(MarkWorker& w, Proto* f)
+{
+    blackenobject(obj2gco(f));
+
+    if (f->source)
+        pmarkobject(w, obj2gco(f->source));
+    if (f->debugname)
+        pmarkobject(w, obj2gco(f->debugname));
+    for (int i = 0; i < f->sizek; i++)
+        pmarkvalue(w, &f->k[i]);
+    for (int i = 0; i < f->sizeupvalues; i++)
+    {
+        if (f->upvalues[i])
+            pmarkobject(w, obj2gco(f->upvalues[i]));
+    }
+    for (int i = 0; i < f->sizep; i++)
+    {
+        if (f->p[i])
+            pmarkobject(w, obj2gco(f->p[i]));
+    }
+    for (int i = 0; i < f->sizelocvars; i++)
+    {
+        if (f->locvars[i].varname)
+            pmarkobject(w, obj2gco(f->locvars[i].varname));
+    }
+
+    w.work += sizeof(Proto) + sizeof(TValue) * f->sizek + sizeof(Proto*) * f->sizep;
+}
+
+static void ptraverseclosure(MarkWorker& w, Closure* cl)
+{
+    blackenobject(obj2gco(cl));
+
+    pmarkobject(w, obj2gco(cl->env));
+    if (cl->isC)
+    {
+        for (int i = 0; i < cl->nupvalues; i++)
+            pmarkvalue(w, &cl->c.upvals[i]);
+    }
+    else
+    {
+        LUAU_ASSERT(cl->nupvalues == cl->l.p->nups);
+        pmarkobject(w, obj2gco(cl->l.p));
+        for (int i = 0; i < cl->nupvalues; i++)
+            pmarkvalue(w, &cl->l.uprefs[i]);
+    }
+
+    w.work += cl->isC ? sizeCclosure(cl->nupvalues) : sizeLclosure(cl->nupvalues);
+}
+
+static void ptraversethread(MarkWorker& w, lua_State* th)
+{
+    // same as in propagatemark; the stack isn't shrunk since that would allocate memory
+    bool active = th->isactive || th == th->global->mainthread || (th->global->gcgen && th->openupval);
+
+    pmarkobject(w, obj2gco(th->gt));
+    if (th->namecall)
+        pmarkobject(w, obj2gco(th->namecall));
+    for (StkId o = th->stack; o < th->top; o++)
+    {
+        // same as in traversestack
+        if (ttisstring(o) && tsvalue(o)->kind == STRING_VIEW)
+            pmarkobject(w, obj2gco(tsvalue(o)->base));
+        pmarkvalue(w, o);
+    }
+    for (UpVal* uv = th->openupval; uv; uv = uv->u.open.threadnext)
+    {
+        LUAU_ASSERT(upisopen(uv));
+        uv->markedopen = 1;
+        pmarkobject(w, obj2gco(uv));
+    }
+
+    if (active)
+    {
+        th->gclist = w.grayagain;
+        w.grayagain = obj2gco(th);
+    }
+    else
+    {
+        blackenobject(obj2gco(th));
+        clearstack(th);
+    }
+
+    w.work += sizeof(lua_State) + sizeof(TValue) * th->stacksize + sizeof(CallInfo) * th->size_ci;
+}
+
+static void ptraverse(global_State* g, MarkWorker& w, MarkItem item)
+{
+    GCObject* o = item.o;
+
+    if (item.begin != item.end)
+    {
+        // split large slices in half, so that other workers can take over the rest
+        while (item.end - item.begin > GC_MARKSLICE)
+        {
+            int mid = item.begin + (item.end - item.begin) / 2;
+            pushitem(w, o, mid, item.end);
+            item.end = mid;
+        }
+
+        ptraverseslice(w, gco2h(o), item.begin, item.end, false, false);
+        return;
+    }
+
+    switch (o->gch.tt)
+    {
+    case LUA_TTABLE:
+        ptraversetable(g, w, gco2h(o));
+        break;
+    case LUA_TFUNCTION:
+        ptraverseclosure(w, gco2cl(o));
+        break;
+    case LUA_TTHREAD:
+        ptraversethread(w, gco2th(o));
+        break;
+    case LUA_TPROTO:
+        ptraverseproto(w, gco2p(o));
+        break;
+    default:
+        LUAU_ASSERT(0);
+    }
+}
+
+// moves shared items of a worker to the stack of another one; a worker takes all of its own items back
+static bool stealwork(MarkWorker& from, MarkWorker& to)
+{
+    if (from.sharedcount.load(std::memory_order_relaxed) == 0)
+        return false;
+
+    std::lock_guard<std::mutex> guard(from.lock);
+
+    size_t count = from.shared.size();
+    size_t take = &from == &to ? count : (count + 1) / 2;
+
+    if (take == 0)
+        return false;
+
+    to.stack.insert(to.stack.end(), from.shared.end() - take, from.shared.end());
+    from.shared.resize(count - take);
+    from.sharedcount.store(int(from.shared.size()), std::memory_order_relaxed);
+    return true;
+}
+
+static bool findwork(ParallelMark& pm, int self)
+{
+    int count = int(pm.workers.size());
+
+    for (int i = 0; i < count; i++)
+    {
+        if (stealwork(pm.workers[(self + i) % count], pm.workers[self]))
+            return true;
+    }
+
+    return false;
+}
+
+static bool hasshared(ParallelMark& pm)
+{
+    for (MarkWorker& w : pm.workers)
+    {
+        if (w.sharedcount.load(std::memory_order_relaxed) != 0)
+            return true;
+    }
+
+    return false;
+}
+
+static void markworker(ParallelMark* pm, int self)
+{
+    MarkWorker& w = pm->workers[self];
+
+    for (;;)
+    {
+        while (!w.stack.empty())
+        {
+            MarkItem item = w.stack.back();
+            w.stack.pop_back();
+            ptraverse(pm->g, w, item);
+        }
+
+        if (findwork(*pm, self))
+            continue;
+
+        // a worker only goes idle without any shared items, so once all workers are idle, marking is done
+        pm->idle.fetch_add(1);
+
+        for (;;)
+        {
+            if (pm->idle.load() == pm->running.load())
+                return;
+
+            if (hasshared(*pm))
+            {
+                pm->idle.fetch_sub(1);
+
+                if (findwork(*pm, self))
+                    break;
+
+                pm->idle.fetch_add(1);
+            }
+
+            std::this_thread::yield();
+        }
+    }
+}
+
+static GCObject* nextgray(GCObject* o)
+{
+    switch (o->gch.tt)
+    {
+    case LUA_TTABLE:
+        return gco2h(o)->gclist;
+    case LUA_TFUNCTION:
+        return gco2cl(o)->gclist;
+    case LUA_TTHREAD:
+        return gco2th(o)->gclist;
+    case LUA_TPROTO:
+        return gco2p(o)->gclist;
+    default:
+        LUAU_ASSERT(0);
+        return NULL;
+    }
+}
+
+// traverses the gray list with the given number of threads; leaves the same state behind as the propagate stage would
+static size_t propagateparallel(global_State* g, int threads)
+{
+    LUAU_ASSERT(g->gcstate == GCSpropagate && !g->gcminor && !g->graytable);
+
+    ParallelMark pm;
+    pm.g = g;
+    pm.workers = std::vector<MarkWorker>(threads);
+
+    // roots are taken by the thread running the state, other workers steal them as marking progresses
+    for (GCObject* o = g->gray; o; o = nextgray(o))
+        pm.workers[0].stack.push_back({o, 0, 0});
+
+    g->gray = NULL;
+
+    std::vector<std::thread> helpers;
+
+    for (int i = 1; i < threads; i++)
+    {
+        pm.running.fetch_add(1);
+
+        try
+        {
+            helpers.emplace_back(markworker, &pm, i);
+        }
+        catch (std::exception&)
+        {
+            // marking works with any number of threads
+            pm.running.fetch_sub(1);
+            break;
+        }
+    }
+
+    markworker(&pm, 0);
+
+    for (std::thread& t : helpers)
+        t.join();
+
+    size_t work = 0;
+
+    for (MarkWorker& w : pm.workers)
+    {
+        LUAU_ASSERT(w.stack.empty() && w.shared.empty());
+
+        for (GCObject* o = w.weak; o;)
+        {
+            LuaTable* h = gco2h(o);
+            o = h->gclist;
+
+            h->gclist = g->weak;
+            g->weak = obj2gco(h);
+        }
+
+        for (GCObject* o = w.grayagain; o;)
+        {
+            lua_State* th = gco2th(o);
+            o = th->gclist;
+
+            th->gclist = g->grayagain;
+            g->grayagain = obj2gco(th);
+        }
+
+        for (MarkItem& item : w.deadkeys)
+        {
+            LuaTable* h = gco2h(item.o);
+
+            for (int i = item.begin > h->sizearray ? item.begin : h->sizearray; i < item.end; i++)
+            {
+                LuaNode* n = gnode(h, i - h->sizearray);
+                if (ttisnil(gval(n)))
+                    removeentry(n);
+            }
+        }
+
+        // bases that were marked by another worker after the view was kept are skipped here
+        for (TString* ts : w.pinviews)
+        {
+            if (!pinview(g, ts))
+                markobject(g, ts->base);
+        }
+
+        work += w.work;
+    }
+
+    return work;
+}
+
+/*
+** The next function tells whether a key or value can be cleared from
+** a weak table. Non-collectable objects are never removed from weak
+** tables. Strings behave as `values', so are never removed too. for
+** other objects: if really collected, cannot keep them.
+*/
+static int isobjcleared(GCObject* o)
+{
+    if (o->gch.tt == LUA_TSTRING)
+    {
+        stringmark(&o->ts); // strings are `values', so are never weak
+        if (o->ts.kind == STRING_VIEW)
+            stringmark(o->ts.base);
+        return 0;
+    }
+
+    return iswhite(o);
+}
+
+#define iscleared(o) (iscollectable(o) && isobjcleared(gcvalue(o)))
+
+/*
+** clear collected entries from weaktables
+*/
+static size_t cleartable(lua_State* L, GCObject* l)
+{
+    size_t work = 0;
+    while (l)
+    {
+        LuaTable* h = gco2h(l);
+        work += sizeof(LuaTable) + sizeof(TValue) * h->sizearray + sizeof(LuaNode) * sizenode(h);
+
+        int i = h->sizearray;
+        while (i--)
+        {
+            TValue* o = &h->array[i];
+            if (iscleared(o))   // value was collected?
+                setnilvalue(o); // remove value
+        }
+        i = sizenode(h);
+        int activevalues = 0;
+        while (i--)
+        {
+            LuaNode* n = gnode(h, i);
+
+            // non-empty entry?
+            if (!ttisnil(gval(n)))
+            {
+                // can we clear key or value?
+                if (iscleared(gkey(n)) || iscleared(gval(n)))
+                {
+                    setnilvalue(gval(n)); // remove value ...
+                    removeentry(n);       // remove entry from table
+                }
+                else
+                {
+                    activevalues++;
+                }
+            }
+        }
+
+        if (const TString* modev = gettablemode(L->global, h))
+        {
+            // are we allowed to shrink this weak table?
+            if (hasmode(modev, 's'))
+            {
+                // shrink at 37.5% occupancy
+                if (activevalues < sizenode(h) * 3 / 8)
+                    luaH_resizehash(L, h, activevalues);
+            }
+        }
+
+        l = h->gclist;
+    }
+    return work;
+}
+
+static void freeobj(lua_State* L, GCObject* o, lua_Page* page)
+{
+    switch (o->gch.tt)
+    {
+    case LUA_TPROTO:
+        luaF_freeproto(L, gco2p(o), page);
+        break;
+    case LUA_TFUNCTION:
+        luaF_freeclosure(L, gco2cl(o), page);
+        break;
+    case LUA_TUPVAL:
+        luaF_freeupval(L, gco2uv(o), page);
+        break;
+    case LUA_TTABLE:
+        luaH_free(L, gco2h(o), page);
+        break;
+    case LUA_TTHREAD:
+        LUAU_ASSERT(gco2th(o) != L && gco2th(o) != L->global->mainthread);
+        luaE_freethread(L, gco2th(o), page);
+        break;
+    case LUA_TSTRING:
+        luaS_free(L, gco2ts(o), page);
+        break;
+    case LUA_TUSERDATA:
+        luaU_freeudata(L, gco2u(o), page);
+        break;
+    case LUA_TBUFFER:
+        luaB_freebuffer(L, gco2buf(o), page);
+        break;
+    default:
+        LUAU_ASSERT(0);
+    }
+}
+
+static void shrinkbuffers(lua_State* L)
+{
+    global_State* g = L->global;
+    // check size of string hash
+    if (g->strt.nuse < cast_to(uint32_t, g->strt.size / 4) && g->strt.size > LUA_MINSTRTABSIZE * 2)
+        luaS_resize(L, g->strt.size / 2); // table is too big
+}
+
+static void shrinkbuffersfull(lua_State* L)
+{
+    global_State* g = L->global;
+    // check size of string hash
+    int hashsize = g->strt.size;
+    while (g->strt.nuse < cast_to(uint32_t, hashsize / 4) && hashsize > LUA_MINSTRTABSIZE * 2)
+        hashsize /= 2;
+    if (hashsize != g->strt.size)
+        luaS_resize(L, hashsize); // table is too big
+}
+
+static bool deletegco(void* context, lua_Page* page, GCObject* gco)
+{
+    lua_State* L = (lua_State*)context;
+    freeobj(L, gco, page);
+    return true;
+}
+
+void luaC_freeall(lua_State* L)
+{
+    global_State* g = L->global;
+
+    LUAU_ASSERT(L == g->mainthread);
+
+    // pages in the background sweep queue have to be returned to the allocator before they can be freed
+    if (g->bgsweep.pages)
+        luaC_finishsweep(L);
+
+    luaM_visitgco(L, L, deletegco);
+
+    for (int i = 0; i < g->strt.size; i++) // free all string lists
+        LUAU_ASSERT(g->strt.hash[i] == NULL);
+    for (int i = g->strt.rehashpos; i < g->strt.oldsize; i++)
+        LUAU_ASSERT(g->strt.old[i] == NULL);
+
+    LUAU_ASSERT(L->global->strt.nuse == 0);
+}
+
+static void markmt(global_State* g)
+{
+    int i;
+    for (i = 0; i < LUA_T_COUNT; i++)
+        if (g->mt[i])
+            markobject(g, g->mt[i]);
+}
+
+static void markloadcache(global_State* g)
+{
+    for (int i = 0; i < g->loadcachesize; i++)
+    {
+        markobject(g, g->loadcache[i].main);
+        markobject(g, g->loadcache[i].env);
+    }
+}
+
+static void markprofiler(global_State* g)
+{
+    Profiler* p = g->profiler;
+    if (!p)
+        return;
+
+    // functions of the samples in the ring buffer are kept alive until the profiler is stopped or the samples are overwritten
+    int count = p->head < uint64_t(p->capacity) ? int(p->head) : p->capacity;
+
+    for (int i = 0; i < count; i++)
+    {
+        GCObject* o = p->frames[i].function;
+
+        if (o && iswhite(o))
+            reallymarkobject(g, o);
+    }
+}
+
+// mark root set
+static void markroot(lua_State* L)
+{
+    global_State* g = L->global;
+    // when the objects that survived the last cycle are still marked, gray lists hold old objects that need to be traversed again
+    g->gcminor = g->gcaged;
+    if (!g->gcminor)
+    {
+        g->gray = NULL;
+        g->grayagain = NULL;
+    }
+    g->weak = NULL;
+    g->pinviewcount = 0;
+    markobject(g, g->mainthread);
+    // make global table be traversed before main stack
+    markobject(g, g->mainthread->gt);
+    markvalue(g, registry(L));
+    markmt(g);
+    // chunks that weren't loaded during the last cycle are dropped here, the rest stay alive until the next one
+    luaV_trimloadcache(L);
+    markloadcache(g);
+    markprofiler(g);
+    g->gcstate = GCSpropagate;
+}
+
+static void unshareviews(lua_State* L, void* ud)
+{
+    global_State* g = L->global;
+    size_t* work = (size_t*)ud;
+
+    // the list is consumed from the end, so the views that are left when an allocation fails haven't been unshared yet
+    while (g->pinviewcount)
+    {
+        TString* ts = g->pinviews[g->pinviewcount - 1];
+
+        if (iswhite(obj2gco(ts->base)))
+        {
+            luaS_unshare(L, ts);
+            stringmark(ts->base);
+            *work += sizestring(ts->len);
+        }
+
+        g->pinviewcount--;
+    }
+}
+
+static size_t unsharepinviews(lua_State* L)
+{
+    global_State* g = L->global;
+    size_t work = 0;
+
+    // the atomic phase can't be interrupted by an error, so if a copy can't be allocated, the remaining views keep their bases
+    StkId top = L->top;
+    if (luaD_rawrunprotected(L, unshareviews, &work) != 0)
+    {
+        L->top = top;
+
+        for (int i = 0; i < g->pinviewcount; i++)
+            stringmark(g->pinviews[i]->base);
+
+        g->pinviewcount = 0;
+    }
+
+    return work;
+}
+
+static size_t remarkupvals(global_State* g)
+{
+    size_t work = 0;
+
+    for (UpVal* uv = g->uvhead.u.open.next; uv != &g->uvhead; uv = uv->u.open.next)
+    {
+        work += sizeof(UpVal);
+
+        LUAU_ASSERT(upisopen(uv));
+        LUAU_ASSERT(uv->u.open.next->u.open.prev == uv && uv->u.open.prev->u.open.next == uv);
+        LUAU_ASSERT(!isblack(obj2gco(uv))); // open upvalues are never black
+
+        if (isgray(obj2gco(uv)))
+            markvalue(g, uv->v);
+    }
+
+    return work;
+}
+
+static size_t clearupvals(lua_State* L)
+{
+    global_State* g = L->global;
+
+    size_t work = 0;
+
+    for (UpVal* uv = g->uvhead.u.open.next; uv != &g->uvhead;)
     {
         work += sizeof(UpVal);
 
@@ -748,7 +1504,64 @@ static size_t clearupvals(lua_State* L)
         }
     }
 
-    return work;
+    return work;
+}
+
+static void queuesweep(lua_State* L)
+{
+    global_State* g = L->global;
+    BackgroundSweep* bg = &g->bgsweep;
+    LUAU_ASSERT(!bg->pages && g->sweepgcopage == g->allgcopages);
+
+    int count = 0;
+    for (lua_Page* page = g->allgcopages; page; page = luaM_getnextpage(page))
+        count++;
+
+    // the queue is allocated outside of the GC heap since atomic can't fail; without it, the sweep simply stays on this thread
+    SweepPage* pages = count ? (SweepPage*)(*g->frealloc)(g->ud, NULL, 0, count * sizeof(SweepPage)) : NULL;
+    if (!pages)
+        return;
+
+    int i = 0;
+    for (lua_Page* page = g->allgcopages; page; page = luaM_getnextpage(page))
+    {
+        luaM_detachgcopage(g, page);
+
+        SweepPage& sp = pages[i++];
+        sp.page = page;
+        sp.state = SWEEP_QUEUED;
+        sp.memcat = 0;
+        sp.dirty = false;
+        sp.frees = 0;
+        sp.freedbytes = 0;
+    }
+
+    bg->count = count;
+    bg->cursor = 0;
+    bg->next = count;
+    __atomic_store_n(&bg->pages, pages, __ATOMIC_SEQ_CST);
+
+    g->sweepgcopage = NULL;
+
+    bg->notify(bg->ud);
+}
+
+static void releasesweep(global_State* g)
+{
+    BackgroundSweep* bg = &g->bgsweep;
+    SweepPage* pages = bg->pages;
+    LUAU_ASSERT(pages && bg->cursor == bg->count);
+
+    __atomic_store_n(&bg->pages, (SweepPage*)NULL, __ATOMIC_SEQ_CST);
+
+    // helper threads that picked up the queue before it was released may still be looking for pages to claim
+    while (__atomic_load_n(&bg->active, __ATOMIC_SEQ_CST) != 0)
+        std::this_thread::yield();
+
+    (*g->frealloc)(g->ud, pages, bg->count * sizeof(SweepPage), 0);
+
+    bg->count = 0;
+    bg->cursor = 0;
 }
 
 static size_t atomic(lua_State* L)
@@ -777,6 +1590,8 @@ static size_t atomic(lua_State* L)
     LUAU_ASSERT(!iswhite(obj2gco(g->mainthread)));
     markobject(g, L); // mark running thread
     markmt(g);        // mark basic metatables (again)
+    markloadcache(g); // mark chunks cached during this cycle
+    markprofiler(g);  // mark functions sampled during this cycle
     work += propagateall(g);
 
 #ifdef LUAI_GCMETRICS
@@ -794,6 +1609,20 @@ static size_t atomic(lua_State* L)
 
     // remove collected objects from weak tables
     work += cleartable(L, g->weak);
+
+    // in generational mode, weak tables survive as gray and need to be cleared by the next cycle again
+    if (g->gcgen)
+    {
+        for (GCObject* o = g->weak; o;)
+        {
+            LuaTable* h = gco2h(o);
+            o = h->gclist;
+
+            h->gclist = g->grayagain;
+            g->grayagain = obj2gco(h);
+        }
+    }
+
     g->weak = NULL;
 
 #ifdef LUAI_GCMETRICS
@@ -803,15 +1632,24 @@ static size_t atomic(lua_State* L)
     // close orphaned live upvalues of dead threads and clear dead upvalues
     work += clearupvals(L);
 
+    // views that were the only reason to keep a long string alive get their own copies, so that the string can be freed
+    work += unsharepinviews(L);
+
 #ifdef LUAI_GCMETRICS
     g->gcmetrics.currcycle.atomictimeupval += recordGcDeltaTime(currts);
 #endif
 
+    // in generational mode, the sweep keeps the marks of surviving objects
+    g->gcaged = g->gcgen;
+
     // flip current white
     g->currentwhite = cast_byte(otherwhite(g));
     g->sweepgcopage = g->allgcopages;
     g->gcstate = GCSsweep;
 
+    if (g->bgsweep.notify && !g->gcaged)
+        queuesweep(L);
+
     return work;
 }
 
@@ -828,10 +1666,16 @@ static int sweepgcopage(lua_State* L, lua_Page* page)
 
     global_State* g = L->global;
 
+    // objects that weren't allocated since the last sweep were marked in an earlier cycle, so a minor cycle doesn't need to visit them
+    if (g->gcminor && g->gcaged && !luaM_getpageyoung(page))
+        return 1;
+
     int deadmask = otherwhite(g);
     LUAU_ASSERT(testbit(deadmask, FIXEDBIT)); // make sure we never sweep fixed objects
 
     int newwhite = luaC_white(g);
+    bool aging = g->gcaged;
+    bool young = false;
 
     for (char* pos = start; pos != end; pos += blockSize)
     {
@@ -845,8 +1689,12 @@ static int sweepgcopage(lua_State* L, lua_Page* page)
         if ((gco->gch.marked ^ WHITEBITS) & deadmask)
         {
             LUAU_ASSERT(!isdead(g, gco));
-            // make it white (for next cycle)
-            gco->gch.marked = cast_byte((gco->gch.marked & maskmarks) | newwhite);
+
+            // in generational mode, objects keep their marks; the ones that are still white were allocated during the sweep
+            if (aging)
+                young |= iswhite(gco);
+            else // make it white (for next cycle)
+                gco->gch.marked = cast_byte((gco->gch.marked & maskmarks) | newwhite);
         }
         else
         {
@@ -859,9 +1707,166 @@ static int sweepgcopage(lua_State* L, lua_Page* page)
         }
     }
 
+    luaM_setpageyoung(page, young);
+
     return int(end - start) / blockSize;
 }
 
+// size of a dead object that can be freed without running code on the thread that runs the state, or 0 if it can't be
+static size_t sweepsize(GCObject* o)
+{
+    switch (o->gch.tt)
+    {
+    case LUA_TFUNCTION:
+    {
+        Closure* cl = gco2cl(o);
+        return cl->isC ? sizeCclosure(cl->nupvalues) : sizeLclosure(cl->nupvalues);
+    }
+    case LUA_TUPVAL:
+        return sizeof(UpVal);
+    case LUA_TBUFFER:
+        return sizebuffer(gco2buf(o)->len);
+    default:
+        return 0;
+    }
+}
+
+// a version of sweepgcopage that runs on helper threads; the page is owned by the caller, so it can be modified, but global state can't
+static void sweepgcopagebackground(SweepPage& sp, int deadmask, uint8_t newwhite)
+{
+    char* start;
+    char* end;
+    int busyBlocks;
+    int blockSize;
+    luaM_getpagewalkinfo(sp.page, &start, &end, &busyBlocks, &blockSize);
+
+    LUAU_ASSERT(busyBlocks > 0);
+
+    for (char* pos = start; pos != end; pos += blockSize)
+    {
+        GCObject* gco = (GCObject*)pos;
+
+        // skip memory blocks that are already freed
+        if (gco->gch.tt == LUA_TNIL)
+            continue;
+
+        uint8_t marked = __atomic_load_n(&gco->gch.marked, __ATOMIC_RELAXED);
+
+        // is the object alive?
+        if ((marked ^ WHITEBITS) & deadmask)
+        {
+            // make it white (for next cycle); the thread running the state may only change the marks of this object to the same value
+            __atomic_store_n(&gco->gch.marked, cast_byte((marked & maskmarks) | newwhite), __ATOMIC_RELAXED);
+        }
+        else if (size_t size = sweepsize(gco); size && (sp.frees == 0 || gco->gch.memcat == sp.memcat))
+        {
+            // accounting is per page, so objects from a different memory category are left to the thread running the state
+            sp.memcat = gco->gch.memcat;
+            sp.frees++;
+            sp.freedbytes += size;
+
+            luaM_sweepgco(sp.page, gco);
+
+            // if the last block was removed, the page will be freed when it's returned to the allocator
+            if (--busyBlocks == 0)
+                break;
+        }
+        else
+        {
+            sp.dirty = true;
+        }
+    }
+}
+
+// sweep step over the queue built by queuesweep; returns the amount of work done
+static size_t sweepqueue(lua_State* L, size_t limit)
+{
+    global_State* g = L->global;
+    BackgroundSweep* bg = &g->bgsweep;
+    size_t cost = 0;
+
+    while (bg->cursor < bg->count && cost < limit)
+    {
+        SweepPage& sp = bg->pages[bg->cursor];
+
+        uint8_t state = SWEEP_QUEUED;
+        if (__atomic_compare_exchange_n(&sp.state, &state, SWEEP_MUTATOR, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+        {
+            // no helper thread got to this page; return it to the allocator first since sweeping may free blocks
+            luaM_attachgcopage(L, sp.page, 0, 0, 0);
+
+            cost += sweepgcopage(L, sp.page) * GC_SWEEPPAGESTEPCOST;
+        }
+        else
+        {
+            // a helper thread is sweeping the page; this is bounded by the time it takes to sweep one page
+            while (state == SWEEP_HELPER)
+            {
+                std::this_thread::yield();
+                state = __atomic_load_n(&sp.state, __ATOMIC_ACQUIRE);
+            }
+
+            LUAU_ASSERT(state == SWEEP_DONE);
+
+            bool alive = luaM_attachgcopage(L, sp.page, sp.freedbytes, sp.memcat, sp.frees);
+
+            // live objects were already recolored, so this only frees the objects that the helper thread couldn't
+            if (sp.dirty)
+            {
+                LUAU_ASSERT(alive);
+                cost += sweepgcopage(L, sp.page) * GC_SWEEPPAGESTEPCOST;
+            }
+            else
+            {
+                cost += GC_SWEEPPAGESTEPCOST;
+            }
+        }
+
+        bg->cursor++;
+    }
+
+    if (bg->cursor == bg->count)
+        releasesweep(g);
+
+    return cost;
+}
+
+// abandons the mark phase of the current cycle and starts a sweep that makes all objects white
+static void abortmark(global_State* g)
+{
+    LUAU_ASSERT(keepinvariant(g));
+
+    // reset sweep marks to sweep all elements (returning them to white)
+    g->sweepgcopage = g->allgcopages;
+    // reset other collector lists
+    g->gray = NULL;
+    g->grayagain = NULL;
+    g->weak = NULL;
+    g->graytable = NULL;
+    g->gcstate = GCSsweep;
+    g->gcaged = false;
+
+    // clear markedopen bits for all open upvalues; these would be stuck from the half-finished mark
+    for (UpVal* uv = g->uvhead.u.open.next; uv != &g->uvhead; uv = uv->u.open.next)
+    {
+        LUAU_ASSERT(upisopen(uv));
+        uv->markedopen = 0;
+    }
+}
+
+// starts a sweep that makes objects that survived the previous cycles white again, so that the next cycle marks the whole heap
+static void resetmarks(global_State* g)
+{
+    LUAU_ASSERT(g->gcaged && !g->sweepgcopage && !g->bgsweep.pages);
+    LUAU_ASSERT(g->gcstate == GCSpause || g->gcstate == GCSsweep);
+
+    g->gcaged = false;
+    g->gray = NULL;
+    g->grayagain = NULL;
+    g->sweepgcopage = g->allgcopages;
+    g->gcstate = GCSsweep;
+}
+
 static size_t gcstep(lua_State* L, size_t limit)
 {
     size_t cost = 0;
@@ -876,12 +1881,12 @@ static size_t gcstep(lua_State* L, size_t limit)
     }
     case GCSpropagate:
     {
-        while (g->gray && cost < limit)
+        while ((g->gray || g->graytable) && cost < limit)
         {
             cost += propagatemark(g);
         }
 
-        if (!g->gray)
+        if (!g->gray && !g->graytable)
         {
 #ifdef LUAI_GCMETRICS
             g->gcmetrics.currcycle.propagatework = g->gcmetrics.currcycle.explicitwork + g->gcmetrics.currcycle.assistwork;
@@ -897,12 +1902,12 @@ static size_t gcstep(lua_State* L, size_t limit)
     }
     case GCSpropagateagain:
     {
-        while (g->gray && cost < limit)
+        while ((g->gray || g->graytable) && cost < limit)
         {
             cost += propagatemark(g);
         }
 
-        if (!g->gray) // no more `gray' objects
+        if (!g->gray && !g->graytable) // no more `gray' objects
         {
 #ifdef LUAI_GCMETRICS
             g->gcmetrics.currcycle.propagateagainwork =
@@ -930,6 +1935,9 @@ static size_t gcstep(lua_State* L, size_t limit)
     }
     case GCSsweep:
     {
+        if (g->bgsweep.pages)
+            cost = sweepqueue(L, limit);
+
         while (g->sweepgcopage && cost < limit)
         {
             lua_Page* next = luaM_getnextpage(g->sweepgcopage); // page sweep might destroy the page
@@ -941,11 +1949,28 @@ static size_t gcstep(lua_State* L, size_t limit)
         }
 
         // nothing more to sweep?
-        if (g->sweepgcopage == NULL)
+        if (g->sweepgcopage == NULL && g->bgsweep.pages == NULL)
         {
             // don't forget to visit main thread, it's the only object not allocated in GCO pages
             LUAU_ASSERT(!isdead(g, obj2gco(g->mainthread)));
-            makewhite(g, obj2gco(g->mainthread)); // make it white (for next cycle)
+
+            if (g->gcaged)
+            {
+                // heap size after a major cycle is the baseline for deciding when the next one is needed
+                if (!g->gcminor)
+                    g->gcmajorbase = g->totalbytes;
+
+                // old objects that became unreachable can only be collected by a major cycle, which needs all objects to be white
+                if (!g->gcgen || g->totalbytes > (g->gcmajorbase / 100) * g->gcgoal)
+                {
+                    resetmarks(g);
+                    break;
+                }
+            }
+            else
+            {
+                makewhite(g, obj2gco(g->mainthread)); // make it white (for next cycle)
+            }
 
             shrinkbuffers(L);
 
@@ -1013,14 +2038,77 @@ static size_t getheaptrigger(global_State* g, size_t heapgoal)
     return heaptrigger < int64_t(g->totalbytes) ? g->totalbytes : (heaptrigger > int64_t(heapgoal) ? heapgoal : size_t(heaptrigger));
 }
 
+// limits the work of an assist to what fits into the rest of the frame budget, based on the rate of previous steps; 0 if nothing fits
+static size_t getframelimit(global_State* g, size_t limit)
+{
+    double remaining = g->gcframe.budget - g->gcframe.time;
+
+    if (remaining <= 0)
+        return 0;
+
+    // atomic step can't be split, so it waits for a frame that has enough time left (when it doesn't fit into any, it runs first)
+    if (g->gcstate == GCSatomic && g->gcframe.atomictime > remaining && g->gcframe.time > 0)
+        return 0;
+
+    if (g->gcframe.workrate > 0 && remaining * g->gcframe.workrate < double(limit))
+        return size_t(remaining * g->gcframe.workrate) + 1;
+
+    return limit;
+}
+
+static void recordframestep(global_State* g, int startgcstate, double seconds, bool assist, size_t work)
+{
+    if (assist)
+        g->gcframe.time += seconds;
+
+    if (startgcstate == GCSatomic)
+        g->gcframe.atomictime = seconds;
+    else if (work > 0 && seconds > 0)
+        g->gcframe.workrate = g->gcframe.workrate > 0 ? g->gcframe.workrate * 0.75 + (work / seconds) * 0.25 : work / seconds;
+}
+
 size_t luaC_step(lua_State* L, bool assist)
 {
     global_State* g = L->global;
 
-    int lim = g->gcstepsize * g->gcstepmul / 100; // how much to work
+    // a memory limit is close; GC steps run at safe points, so this is where the full collection requested by the allocator can happen
+    if (LUAU_UNLIKELY(g->gcemergency))
+    {
+        g->gcemergency = false;
+
+        GC_INTERRUPT(0);
+
+        luaC_fullgc(L);
+
+        GC_INTERRUPT(GCSpause);
+
+        return 0;
+    }
+
+    size_t lim = g->gcstepsize * g->gcstepmul / 100; // how much to work
     LUAU_ASSERT(g->totalbytes >= g->GCthreshold);
     size_t debt = g->totalbytes - g->GCthreshold;
 
+    // with a frame budget, assists that don't fit into the current frame are left for the next one
+    if (assist && g->gcframe.budget > 0)
+    {
+        lim = getframelimit(g, lim);
+
+        if (lim == 0)
+        {
+            if (!g->gcframe.deferred)
+            {
+                g->gcframe.deferred = true;
+                g->gcframe.threshold = g->GCthreshold;
+            }
+
+            g->metrics.gcdeferredsteps++;
+
+            g->GCthreshold = g->totalbytes + g->gcstepsize;
+            return 0;
+        }
+    }
+
     GC_INTERRUPT(0);
 
     // at the start of the new cycle
@@ -1031,17 +2119,31 @@ size_t luaC_step(lua_State* L, bool assist)
     if (g->gcstate == GCSpause)
         startGcCycleMetrics(g);
 
-    double lasttimestamp = lua_clock();
+    bool timed = true;
+#else
+    bool timed = g->gcframe.budget > 0;
 #endif
 
+    double lasttimestamp = timed ? lua_clock() : 0;
+
     int lastgcstate = g->gcstate;
 
     size_t work = gcstep(L, lim);
 
+    double steptime = timed ? lua_clock() - lasttimestamp : 0;
+
 #ifdef LUAI_GCMETRICS
-    recordGcStateStep(g, lastgcstate, lua_clock() - lasttimestamp, assist, work);
+    recordGcStateStep(g, lastgcstate, steptime, assist, work);
 #endif
 
+    if (g->gcframe.budget > 0)
+        recordframestep(g, lastgcstate, steptime, assist, work);
+
+    g->metrics.gcsteps++;
+
+    if (g->totalbytes > g->metrics.peakbytes)
+        g->metrics.peakbytes = g->totalbytes;
+
     size_t actualstepsize = work * 100 / g->gcstepmul;
 
     // at the end of the last cycle
@@ -1049,7 +2151,8 @@ size_t luaC_step(lua_State* L, bool assist)
     {
         // at the end of a collection cycle, set goal based on gcgoal setting
         size_t heapgoal = (g->totalbytes / 100) * g->gcgoal;
-        size_t heaptrigger = getheaptrigger(g, heapgoal);
+        // minor cycles only mark objects allocated since the last cycle, so they can start after a small amount of growth
+        size_t heaptrigger = g->gcaged ? g->totalbytes + (g->totalbytes / 100) * g->gcgenminormul : getheaptrigger(g, heapgoal);
 
         g->GCthreshold = heaptrigger;
 
@@ -1057,6 +2160,13 @@ size_t luaC_step(lua_State* L, bool assist)
         g->gcstats.endtimestamp = lua_clock();
         g->gcstats.endtotalsizebytes = g->totalbytes;
 
+        g->metrics.gccycles++;
+
+        if (g->gcminor)
+            g->metrics.gcminorcycles++;
+
+        luaM_updatebudget(g);
+
 #ifdef LUAI_GCMETRICS
         finishGcCycleMetrics(g);
 #endif
@@ -1070,6 +2180,8 @@ size_t luaC_step(lua_State* L, bool assist)
             g->GCthreshold -= debt;
     }
 
+    luaE_publishmetrics(g);
+
     GC_INTERRUPT(lastgcstate);
 
     return actualstepsize;
@@ -1079,21 +2191,16 @@ void luaC_fullgc(lua_State* L)
 {
     global_State* g = L->global;
 
+    if (g->totalbytes > g->metrics.peakbytes)
+        g->metrics.peakbytes = g->totalbytes;
+
 #ifdef LUAI_GCMETRICS
     if (g->gcstate == GCSpause)
         startGcCycleMetrics(g);
 #endif
 
     if (keepinvariant(g))
-    {
-        // reset sweep marks to sweep all elements (returning them to white)
-        g->sweepgcopage = g->allgcopages;
-        // reset other collector lists
-        g->gray = NULL;
-        g->grayagain = NULL;
-        g->weak = NULL;
-        g->gcstate = GCSsweep;
-    }
+        abortmark(g);
     LUAU_ASSERT(g->gcstate == GCSpause || g->gcstate == GCSsweep);
     // finish any pending sweep phase
     while (g->gcstate != GCSpause)
@@ -1102,11 +2209,13 @@ void luaC_fullgc(lua_State* L)
         gcstep(L, SIZE_MAX);
     }
 
-    // clear markedopen bits for all open upvalues; these might be stuck from half-finished mark prior to full gc
-    for (UpVal* uv = g->uvhead.u.open.next; uv != &g->uvhead; uv = uv->u.open.next)
+    // in generational mode, objects that survived the last cycle have to be made white before the heap can be marked again
+    if (g->gcaged)
     {
-        LUAU_ASSERT(upisopen(uv));
-        uv->markedopen = 0;
+        resetmarks(g);
+
+        while (g->gcstate != GCSpause)
+            gcstep(L, SIZE_MAX);
     }
 
 #ifdef LUAI_GCMETRICS
@@ -1116,12 +2225,16 @@ void luaC_fullgc(lua_State* L)
 
     // run a full collection cycle
     markroot(L);
+    if (g->gcmarkthreads > 1)
+        propagateparallel(g, g->gcmarkthreads);
     while (g->gcstate != GCSpause)
     {
         gcstep(L, SIZE_MAX);
     }
     // reclaim as much buffer memory as possible (shrinkbuffers() called during sweep is incremental)
     shrinkbuffersfull(L);
+    // return pages that only hold a few objects, see lgcdefrag.cpp
+    luaC_defrag(L);
 
     size_t heapgoalsizebytes = (g->totalbytes / 100) * g->gcgoal;
 
@@ -1136,20 +2249,183 @@ void luaC_fullgc(lua_State* L)
     if (g->GCthreshold < g->totalbytes)
         g->GCthreshold = g->totalbytes;
 
+    // in generational mode, the next cycle is a minor one
+    if (g->gcaged)
+        g->GCthreshold = g->totalbytes + (g->totalbytes / 100) * g->gcgenminormul;
+
     g->gcstats.heapgoalsizebytes = heapgoalsizebytes;
 
+    g->metrics.gccycles++;
+    luaE_publishmetrics(g);
+
+    g->gcemergency = false;
+    g->gcframe.deferred = false;
+    luaM_updatebudget(g);
+
 #ifdef LUAI_GCMETRICS
     finishGcCycleMetrics(g);
 #endif
 }
 
+// free all objects that the last completed mark found to be dead; unlike a GC step, this is safe to call at any allocation
+void luaC_finishsweep(lua_State* L)
+{
+    global_State* g = L->global;
+
+    if (g->gcstate != GCSsweep)
+        return;
+
+    if (g->bgsweep.pages)
+        sweepqueue(L, SIZE_MAX);
+
+    while (g->sweepgcopage)
+    {
+        lua_Page* next = luaM_getnextpage(g->sweepgcopage); // page sweep might destroy the page
+
+        sweepgcopage(L, g->sweepgcopage);
+
+        g->sweepgcopage = next;
+    }
+
+    // the transition to GCSpause is left to the next step since it may need to allocate
+}
+
+// makes assists that were postponed because the frame budget ran out due again, unless the collector was stopped since
+static void resumedeferred(global_State* g)
+{
+    if (g->gcframe.deferred && g->GCthreshold != SIZE_MAX)
+        g->GCthreshold = g->gcframe.threshold < g->totalbytes ? g->gcframe.threshold : g->totalbytes;
+
+    g->gcframe.deferred = false;
+}
+
+size_t luaC_idle(lua_State* L, double seconds)
+{
+    global_State* g = L->global;
+
+    resumedeferred(g);
+
+    double start = lua_clock();
+
+    // work that is due is paid off first; after that, the cycle in progress keeps going, but a new one is only started when it's due
+    while (g->GCthreshold != SIZE_MAX && (g->GCthreshold <= g->totalbytes || g->gcstate != GCSpause))
+    {
+        double now = lua_clock();
+        double remaining = seconds - (now - start);
+
+        if (remaining <= 0 || (g->gcstate == GCSatomic && g->gcframe.atomictime > remaining))
+            break;
+
+        // work done ahead of time moves the threshold of the next assist forward by the amount of allocation it accounts for
+        size_t credit = g->GCthreshold > g->totalbytes ? g->GCthreshold - g->totalbytes : 0;
+        g->GCthreshold -= credit;
+
+        int laststate = g->gcstate;
+
+        luaC_step(L, false);
+
+        if (laststate == GCSatomic)
+            g->gcframe.atomictime = lua_clock() - now;
+
+        if (g->gcstate != GCSpause)
+            g->GCthreshold += credit;
+    }
+
+    return g->GCthreshold < g->totalbytes ? g->totalbytes - g->GCthreshold : 0;
+}
+
+void luaC_startframe(lua_State* L, double idle)
+{
+    global_State* g = L->global;
+
+    // assists that were postponed by the previous frame are due now
+    resumedeferred(g);
+
+    g->gcframe.time = 0;
+
+    // idle time is spent on work that would otherwise be done by assists during the frame
+    if (idle > 0)
+        luaC_idle(L, idle);
+}
+
+void luaC_setgenerational(lua_State* L, bool enabled)
+{
+    global_State* g = L->global;
+
+    // objects that the current mark has already traversed don't follow the rules of generational mode, so the mark starts over
+    if (enabled && !g->gcgen && keepinvariant(g))
+        abortmark(g);
+
+    // otherwise, cycles that are in progress pick up the change when they finish, but the marks that survivors kept have to be reset
+    if (!enabled && g->gcaged && g->gcstate == GCSpause)
+        resetmarks(g);
+
+    g->gcgen = enabled;
+}
+
+void luaC_setbackgroundsweep(lua_State* L, void* ud, void (*notify)(void* ud))
+{
+    global_State* g = L->global;
+
+    // the queue of the current cycle, if any, is finished on this thread so that helpers of the previous setting are done with it
+    if (g->bgsweep.pages)
+        luaC_finishsweep(L);
+
+    g->bgsweep.ud = ud;
+    g->bgsweep.notify = notify;
+}
+
+// called by helper threads; sweeps queued pages until none are left and returns the number of pages swept
+int luaC_sweepbackground(lua_State* L)
+{
+    global_State* g = L->global;
+    BackgroundSweep* bg = &g->bgsweep;
+
+    __atomic_add_fetch(&bg->active, 1, __ATOMIC_SEQ_CST);
+
+    int swept = 0;
+
+    // the queue can't be released while this thread is counted as active
+    if (SweepPage* pages = __atomic_load_n(&bg->pages, __ATOMIC_SEQ_CST))
+    {
+        // current white only changes in atomic, which can't run before the queue is released
+        int deadmask = otherwhite(g);
+        uint8_t newwhite = luaC_white(g);
+
+        while (__atomic_load_n(&bg->next, __ATOMIC_RELAXED) > 0)
+        {
+            int i = __atomic_sub_fetch(&bg->next, 1, __ATOMIC_RELAXED);
+            if (i < 0)
+                break;
+
+            SweepPage& sp = pages[i];
+
+            uint8_t state = SWEEP_QUEUED;
+            if (__atomic_compare_exchange_n(&sp.state, &state, SWEEP_HELPER, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            {
+                sweepgcopagebackground(sp, deadmask, newwhite);
+                swept++;
+
+                __atomic_store_n(&sp.state, SWEEP_DONE, __ATOMIC_RELEASE);
+            }
+        }
+    }
+
+    __atomic_sub_fetch(&bg->active, 1, __ATOMIC_SEQ_CST);
+
+    return swept;
+}
+
 void luaC_barrierf(lua_State* L, GCObject* o, GCObject* v)
 {
     global_State* g = L->global;
+    // helper threads may be recoloring the object; it'll be white by the end of the sweep either way
+    if (g->bgsweep.pages)
+        return;
     LUAU_ASSERT(isblack(o) && iswhite(v) && !isdead(g, v) && !isdead(g, o));
-    LUAU_ASSERT(g->gcstate != GCSpause);
-    // must keep invariant?
-    if (keepinvariant(g))
+    LUAU_ASSERT(g->gcstate != GCSpause || g->gcaged);
+    // must keep invariant? (generational mode keeps it between cycles)
+    if (keepinvariant(g) || g->gcaged)
         reallymarkobject(g, v); // restore invariant
     else                        // don't mind
         makewhite(g, o);        // mark as white just to avoid other barriers
@@ -1160,6 +2436,9 @@ void luaC_barriertable(lua_State* L, LuaTable* t, GCObject* v)
     global_State* g = L->global;
     GCObject* o = obj2gco(t);
 
+    if (g->bgsweep.pages)
+        return;
+
     // in the second propagation stage, table assignment barrier works as a forward barrier
     if (g->gcstate == GCSpropagateagain)
     {
@@ -1169,7 +2448,7 @@ void luaC_barriertable(lua_State* L, LuaTable* t, GCObject* v)
     }
 
     LUAU_ASSERT(isblack(o) && !isdead(g, o));
-    LUAU_ASSERT(g->gcstate != GCSpause);
+    LUAU_ASSERT(g->gcstate != GCSpause || g->gcaged);
     black2gray(o); // make table gray (again)
     t->gclist = g->grayagain;
     g->grayagain = o;
@@ -1178,8 +2457,11 @@ void luaC_barriertable(lua_State* L, LuaTable* t, GCObject* v)
 void luaC_barrierback(lua_State* L, GCObject* o, GCObject** gclist)
 {
     global_State* g = L->global;
+    if (g->bgsweep.pages)
+        return;
+
     LUAU_ASSERT(isblack(o) && !isdead(g, o));
-    LUAU_ASSERT(g->gcstate != GCSpause);
+    LUAU_ASSERT(g->gcstate != GCSpause || g->gcaged);
 
     black2gray(o); // make object gray (again)
     *gclist = g->grayagain;
@@ -1193,9 +2475,12 @@ void luaC_upvalclosed(lua_State* L, UpVal* uv)
 
     LUAU_ASSERT(!upisopen(uv)); // upvalue was closed but needs GC state fixup
 
+    if (g->bgsweep.pages)
+        return;
+
     if (isgray(o))
     {
-        if (keepinvariant(g))
+        if (keepinvariant(g) || g->gcaged)
         {
             gray2black(o); // closed upvalues need barrier
             luaC_barrier(L, uv, uv->v);
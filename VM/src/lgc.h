@@ -9,9 +9,10 @@
 /*
 ** Default settings for GC tunables (settable via lua_gc)
 */
-#define LUAI_GCGOAL 200    // 200% (allow heap to double compared to live heap size)
-#define LUAI_GCSTEPMUL 200 // GC runs 'twice the speed' of memory allocation
-#define LUAI_GCSTEPSIZE 1  // GC runs every KB of memory allocation
+#define LUAI_GCGOAL 200       // 200% (allow heap to double compared to live heap size)
+#define LUAI_GCSTEPMUL 200    // GC runs 'twice the speed' of memory allocation
+#define LUAI_GCSTEPSIZE 1     // GC runs every KB of memory allocation
+#define LUAI_GCGENMINORMUL 20 // in generational mode, minor cycle starts after heap grows by 20% since the last one
 
 /*
 ** Possible states of the Garbage Collector
@@ -106,6 +107,13 @@
             luaC_barrierback(L, obj2gco(t), &t->gclist); \
     }
 
+// array elements that move within a table bypass table barriers, which is only valid if the table has been traversed in full
+#define luaC_arraybarrier(L, t) \
+    { \
+        if (L->global->graytable == (t) && isblack(obj2gco(t))) \
+            luaC_barrierback(L, obj2gco(t), &(t)->gclist); \
+    }
+
 #define luaC_objbarrier(L, p, o) \
     { \
         if (isblack(obj2gco(p)) && iswhite(obj2gco(o))) \
@@ -128,6 +136,13 @@
 LUAI_FUNC void luaC_freeall(lua_State* L);
 LUAI_FUNC size_t luaC_step(lua_State* L, bool assist);
 LUAI_FUNC void luaC_fullgc(lua_State* L);
+LUAI_FUNC void luaC_finishsweep(lua_State* L);
+LUAI_FUNC void luaC_defrag(lua_State* L);
+LUAI_FUNC size_t luaC_idle(lua_State* L, double seconds);
+LUAI_FUNC void luaC_startframe(lua_State* L, double idle);
+LUAI_FUNC void luaC_setgenerational(lua_State* L, bool enabled);
+LUAI_FUNC void luaC_setbackgroundsweep(lua_State* L, void* ud, void (*notify)(void* ud));
+LUAI_FUNC int luaC_sweepbackground(lua_State* L);
 LUAI_FUNC void luaC_initobj(lua_State* L, GCObject* o, uint8_t tt);
 LUAI_FUNC void luaC_upvalclosed(lua_State* L, UpVal* uv);
 LUAI_FUNC void luaC_barrierf(lua_State* L, GCObject* o, GCObject* v);
@@ -135,6 +150,7 @@ LUAI_FUNC void luaC_barriertable(lua_State* L, LuaTable* t, GCObject* v);
 LUAI_FUNC void luaC_barrierback(lua_State* L, GCObject* o, GCObject** gclist);
 LUAI_FUNC void luaC_validate(lua_State* L);
 LUAI_FUNC void luaC_dump(lua_State* L, void* file, const char* (*categoryName)(lua_State* L, uint8_t memcat));
+LUAI_FUNC void luaC_snapshot(lua_State* L, void* file, const char* (*categoryName)(lua_State* L, uint8_t memcat));
 LUAI_FUNC void luaC_enumheap(
     lua_State* L,
     void* context,
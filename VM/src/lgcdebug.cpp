@@ -11,6 +11,8 @@
 #include "ludata.h"
 #include "lbuffer.h"
 
+#include <vector>
+
 #include <string.h>
 #include <stdio.h>
 
@@ -18,9 +20,9 @@ static void validateobjref(global_State* g, GCObject* f, GCObject* t)
 {
     LUAU_ASSERT(!isdead(g, t));
 
-    if (keepinvariant(g))
+    if (keepinvariant(g) || g->gcaged)
     {
-        // basic incremental invariant: black can't point to white
+        // basic incremental invariant: black can't point to white (generational mode keeps it between cycles)
         LUAU_ASSERT(!(isblack(f) && iswhite(t)));
     }
 }
@@ -43,7 +45,10 @@ static void validatetable(global_State* g, LuaTable* h)
     if (h->metatable)
         validateobjref(g, obj2gco(h), obj2gco(h->metatable));
 
-    for (int i = 0; i < h->sizearray; ++i)
+    // array elements of a table that is being traversed in chunks may still be white
+    int sizearray = g->graytable == h ? g->graytablepos : h->sizearray;
+
+    for (int i = 0; i < sizearray; ++i)
         validateref(g, obj2gco(h), &h->array[i]);
 
     for (int i = 0; i < sizenode; ++i)
@@ -148,6 +153,8 @@ static void validateobj(global_State* g, GCObject* o)
     switch (o->gch.tt)
     {
     case LUA_TSTRING:
+        if (gco2ts(o)->kind == STRING_VIEW)
+            validateobjref(g, o, obj2gco(gco2ts(o)->base));
         break;
 
     case LUA_TTABLE:
@@ -226,6 +233,10 @@ void luaC_validate(lua_State* L)
 {
     global_State* g = L->global;
 
+    // pages in the background sweep queue may be owned by helper threads
+    if (g->bgsweep.pages)
+        luaC_finishsweep(L);
+
     LUAU_ASSERT(!isdead(g, obj2gco(g->mainthread)));
     checkliveness(g, &g->registry);
 
@@ -285,9 +296,17 @@ static void dumpstringdata(FILE* f, const char* data, size_t len)
 
 static void dumpstring(FILE* f, TString* ts)
 {
-    fprintf(f, "{\"type\":\"string\",\"cat\":%d,\"size\":%d,\"data\":\"", ts->memcat, int(sizestring(ts->len)));
-    dumpstringdata(f, ts->data, ts->len);
-    fprintf(f, "\"}");
+    fprintf(f, "{\"type\":\"string\",\"cat\":%d,\"size\":%d,\"data\":\"", ts->memcat, int(sizestringobj(ts)));
+    dumpstringdata(f, getstr(ts), ts->kind == STRING_STORAGE ? ts->used : ts->len);
+    fprintf(f, "\"");
+
+    if (ts->kind == STRING_VIEW)
+    {
+        fprintf(f, ",\"base\":");
+        dumpref(f, obj2gco(ts->base));
+    }
+
+    fprintf(f, "}");
 }
 
 static void dumptable(FILE* f, LuaTable* h)
@@ -583,6 +602,9 @@ void luaC_dump(lua_State* L, void* file, const char* (*categoryName)(lua_State*
     global_State* g = L->global;
     FILE* f = static_cast<FILE*>(file);
 
+    if (g->bgsweep.pages)
+        luaC_finishsweep(L);
+
     fprintf(f, "{\"objects\":{\n");
 
     dumpgco(f, NULL, obj2gco(g->mainthread));
@@ -651,7 +673,11 @@ static void enumedges(EnumContext* ctx, GCObject* from, TValue* data, size_t siz
 
 static void enumstring(EnumContext* ctx, TString* ts)
 {
-    enumnode(ctx, obj2gco(ts), ts->len, NULL);
+    // contents of a view are accounted for by its storage
+    enumnode(ctx, obj2gco(ts), ts->kind == STRING_VIEW ? 0 : ts->len, NULL);
+
+    if (ts->kind == STRING_VIEW)
+        enumedge(ctx, obj2gco(ts), obj2gco(ts->base), "base");
 }
 
 static void enumtable(EnumContext* ctx, LuaTable* h)
@@ -670,8 +696,8 @@ static void enumtable(EnumContext* ctx, LuaTable* h)
         {
             if (ttisstring(mode))
             {
-                weakkey = strchr(svalue(mode), 'k') != NULL;
-                weakvalue = strchr(svalue(mode), 'v') != NULL;
+                weakkey = memchr(svalue(mode), 'k', tsvalue(mode)->len) != NULL;
+                weakvalue = memchr(svalue(mode), 'v', tsvalue(mode)->len) != NULL;
             }
         }
 
@@ -762,7 +788,7 @@ static void enumudata(EnumContext* ctx, Udata* u)
             {
                 const LuaNode& n = h->node[i];
 
-                if (ttisstring(&n.key) && ttisstring(&n.val) && strcmp(svalue(&n.key), "__type") == 0)
+                if (ttisstring(&n.key) && ttisstring(&n.val) && tsvalue(&n.val)->kind != STRING_VIEW && strcmp(svalue(&n.key), "__type") == 0)
                 {
                     name = svalue(&n.val);
                     break;
@@ -898,6 +924,9 @@ void luaC_enumheap(
 {
     global_State* g = L->global;
 
+    if (g->bgsweep.pages)
+        luaC_finishsweep(L);
+
     EnumContext ctx;
     ctx.L = L;
     ctx.context = context;
@@ -908,3 +937,227 @@ void luaC_enumheap(
 
     luaM_visitgco(L, &ctx, enumgco);
 }
+
+/*
+ * Heap snapshots
+ *
+ * luaC_snapshot writes the graph produced by luaC_enumheap in a compact binary format that tools can diff (see
+ * VM/tools/heapdiff.cpp). Integers are LEB128 varints, signed ones are zigzag encoded first; addresses are stored as deltas
+ * since neighbouring objects share a page and most edges start at the node written just before them.
+ *
+ *   header  "LHS" 1, totalbytes
+ *   'S'     len, bytes                           defines the next name; names are numbered from 1, 0 means no name
+ *   'N'     address - last node, tt, memcat, size, name
+ *   'E'     from - last node, to - from, name
+ *   'R'     address - last node, name            root of the graph (main thread and registry)
+ *   'C'     memcat, bytes, name                  memory category with its total size
+ *   'Z'                                          end of the snapshot
+ */
+
+#define SNAPSHOT_BUFFER 65536
+
+struct SnapshotName
+{
+    uint64_t hash;
+    size_t offset; // in SnapshotWriter::names, 0 for an empty slot
+    size_t len;
+    uint32_t id;
+};
+
+struct SnapshotWriter
+{
+    FILE* f;
+
+    uint8_t buffer[SNAPSHOT_BUFFER];
+    size_t pos;
+
+    uintptr_t lastnode;
+
+    // names that were written, in an open addressing table that grows at 50% load
+    std::vector<SnapshotName> slots;
+    std::vector<char> names;
+    uint32_t nameCount;
+};
+
+static void snapflush(SnapshotWriter* w)
+{
+    fwrite(w->buffer, 1, w->pos, w->f);
+    w->pos = 0;
+}
+
+static void snapbyte(SnapshotWriter* w, uint8_t value)
+{
+    if (w->pos == SNAPSHOT_BUFFER)
+        snapflush(w);
+
+    w->buffer[w->pos++] = value;
+}
+
+static void snapvarint(SnapshotWriter* w, uint64_t value)
+{
+    // varints take at most 10 bytes
+    if (w->pos > SNAPSHOT_BUFFER - 10)
+        snapflush(w);
+
+    while (value >= 0x80)
+    {
+        w->buffer[w->pos++] = uint8_t(value | 0x80);
+        value >>= 7;
+    }
+
+    w->buffer[w->pos++] = uint8_t(value);
+}
+
+static void snapdelta(SnapshotWriter* w, uintptr_t value, uintptr_t base)
+{
+    int64_t delta = int64_t(value - base);
+    snapvarint(w, (uint64_t(delta) << 1) ^ uint64_t(delta >> 63));
+}
+
+static void snapbytes(SnapshotWriter* w, const char* data, size_t len)
+{
+    snapvarint(w, len);
+
+    for (size_t i = 0; i < len; ++i)
+        snapbyte(w, uint8_t(data[i]));
+}
+
+static void snapgrownames(SnapshotWriter* w)
+{
+    std::vector<SnapshotName> slots(w->slots.empty() ? 1024 : w->slots.size() * 2);
+    size_t mask = slots.size() - 1;
+
+    for (const SnapshotName& name : w->slots)
+    {
+        if (name.offset == 0)
+            continue;
+
+        size_t i = name.hash & mask;
+        while (slots[i].offset != 0)
+            i = (i + 1) & mask;
+
+        slots[i] = name;
+    }
+
+    w->slots.swap(slots);
+}
+
+static uint32_t snapname(SnapshotWriter* w, const char* name)
+{
+    if (!name)
+        return 0;
+
+    // FNV-1a; names are short, most of them are field names and closure descriptions
+    uint64_t hash = 14695981039346656037ull;
+    size_t len = 0;
+
+    for (; name[len]; ++len)
+        hash = (hash ^ uint8_t(name[len])) * 1099511628211ull;
+
+    size_t mask = w->slots.size() - 1;
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        SnapshotName& slot = w->slots[i];
+
+        if (slot.offset == 0)
+        {
+            slot.hash = hash;
+            slot.offset = w->names.size();
+            slot.len = len;
+            slot.id = ++w->nameCount;
+
+            w->names.insert(w->names.end(), name, name + len);
+
+            snapbyte(w, 'S');
+            snapbytes(w, name, len);
+
+            uint32_t id = slot.id;
+
+            if (w->nameCount * 2 > w->slots.size())
+                snapgrownames(w);
+
+            return id;
+        }
+
+        if (slot.hash == hash && slot.len == len && memcmp(&w->names[slot.offset], name, len) == 0)
+            return slot.id;
+    }
+}
+
+static void snapnode(void* context, void* ptr, uint8_t tt, uint8_t memcat, size_t size, const char* name)
+{
+    SnapshotWriter* w = (SnapshotWriter*)context;
+    uint32_t id = snapname(w, name);
+
+    snapbyte(w, 'N');
+    snapdelta(w, uintptr_t(ptr), w->lastnode);
+    snapbyte(w, tt);
+    snapbyte(w, memcat);
+    snapvarint(w, size);
+    snapvarint(w, id);
+
+    w->lastnode = uintptr_t(ptr);
+}
+
+static void snapedge(void* context, void* from, void* to, const char* name)
+{
+    SnapshotWriter* w = (SnapshotWriter*)context;
+    uint32_t id = snapname(w, name);
+
+    snapbyte(w, 'E');
+    snapdelta(w, uintptr_t(from), w->lastnode);
+    snapdelta(w, uintptr_t(to), uintptr_t(from));
+    snapvarint(w, id);
+}
+
+static void snaproot(SnapshotWriter* w, GCObject* o, const char* name)
+{
+    uint32_t id = snapname(w, name);
+
+    snapbyte(w, 'R');
+    snapdelta(w, uintptr_t(enumtopointer(o)), w->lastnode);
+    snapvarint(w, id);
+}
+
+void luaC_snapshot(lua_State* L, void* file, const char* (*categoryName)(lua_State* L, uint8_t memcat))
+{
+    global_State* g = L->global;
+
+    SnapshotWriter* w = new SnapshotWriter();
+    w->f = static_cast<FILE*>(file);
+    w->pos = 0;
+    w->lastnode = 0;
+    w->names.push_back(0); // offset 0 marks empty slots
+    w->nameCount = 0;
+    snapgrownames(w);
+
+    snapbyte(w, 'L');
+    snapbyte(w, 'H');
+    snapbyte(w, 'S');
+    snapbyte(w, 1);
+    snapvarint(w, g->totalbytes);
+
+    luaC_enumheap(L, w, snapnode, snapedge);
+
+    snaproot(w, obj2gco(g->mainthread), "mainthread");
+    snaproot(w, gcvalue(&g->registry), "registry");
+
+    for (int i = 0; i < LUA_MEMORY_CATEGORIES; i++)
+    {
+        if (size_t bytes = g->memcatbytes[i])
+        {
+            uint32_t id = snapname(w, categoryName ? categoryName(L, uint8_t(i)) : NULL);
+
+            snapbyte(w, 'C');
+            snapbyte(w, uint8_t(i));
+            snapvarint(w, bytes);
+            snapvarint(w, id);
+        }
+    }
+
+    snapbyte(w, 'Z');
+    snapflush(w);
+
+    delete w;
+}
@@ -0,0 +1,479 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "lgc.h"
+
+#include "lfunc.h"
+#include "lmem.h"
+#include "lobject.h"
+#include "lstate.h"
+#include "ltable.h"
+#include "ludata.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <string.h>
+
+/*
+ * Heap defragmentation
+ *
+ * A collection can leave GCO pages that only hold a few live objects each. The allocator reuses their free blocks, but a page
+ * is only returned once all of its objects die, so a heap that shrank after a peak keeps most of its pages. When enabled with
+ * LUA_GCSETDEFRAG, luaC_fullgc ends with a pass that evacuates sparse pages: their objects are copied into free blocks of other
+ * pages of the same size class, all references to them are rewritten, and the pages that become empty are freed.
+ *
+ * Only tables and functions are moved. Addresses of other objects escape to the host (userdata and buffer contents, string
+ * data, threads) or are linked from structures that the pass doesn't rewrite (string table, open upvalue lists, prototypes
+ * referenced by native code and the profiler), so a page that holds any of them is left in place. Table keys are hashed by
+ * address, which pins the page of every object used as a key, including keys of removed entries since next() compares them.
+ *
+ * The interpreter and library functions keep raw pointers to objects in locals, so nothing is moved while any thread is in
+ * the middle of a call (suspended coroutines resume from their stack); this leaves out collections started by scripts, such
+ * as collectgarbage and emergency collections in GC assists, and the pass only runs for collections that the host starts
+ * between calls.
+ *
+ * The pass doesn't allocate or throw while references are inconsistent:
+ * - pages of each size class are picked from the sparsest one while the free blocks of the remaining pages can hold their
+ *   objects, so moving never creates pages; picked pages are detached from the free list so that nothing is moved into them
+ * - each object is copied into a new block and the old block becomes a forwarding record (FORWARDED type, new address)
+ * - references in all objects and roots are forwarded, after which the old blocks are freed along with their pages
+ */
+
+// type of the old block of an object that was moved, see Forward
+#define FORWARDED (LUA_TDEADKEY + 1)
+
+struct Forward
+{
+    CommonHeader;
+    GCObject* to;
+};
+
+struct DefragPage
+{
+    lua_Page* page;
+    char* start; // address range of the page, including the header
+    char* end;
+    int blocks;
+    int busy;
+    int blockSize;
+    bool pinned; // page has objects that can't move
+};
+
+struct DefragState
+{
+    lua_State* L;
+
+    std::vector<DefragPage> pages; // sparse pages, sorted by address
+    std::vector<DefragPage> moved; // pages that are evacuated, sorted by address
+
+    bool running; // a thread is in the middle of a call, see incall
+
+    size_t bytes[LUA_MEMORY_CATEGORIES]; // size of the objects that are moved, by memory category
+    int objects;
+};
+
+static DefragPage* findpage(std::vector<DefragPage>& pages, const void* p)
+{
+    auto it = std::upper_bound(pages.begin(), pages.end(), (const char*)p,
+        [](const char* p, const DefragPage& page)
+        {
+            return p < page.start;
+        });
+
+    if (it == pages.begin())
+        return NULL;
+
+    DefragPage* page = &*(it - 1);
+    return (const char*)p < page->end ? page : NULL;
+}
+
+static bool movable(GCObject* o)
+{
+    return (o->gch.tt == LUA_TTABLE || o->gch.tt == LUA_TFUNCTION) && !isfixed(o);
+}
+
+static size_t objsize(GCObject* o)
+{
+    if (o->gch.tt == LUA_TTABLE)
+        return sizeof(LuaTable);
+
+    Closure* cl = gco2cl(o);
+    return cl->isC ? sizeCclosure(cl->nupvalues) : sizeLclosure(cl->nupvalues);
+}
+
+// functions that are being called can keep raw pointers to objects in locals, such as the closure of a running Luau function
+static bool incall(lua_State* th)
+{
+    return th->isactive || (th->status == LUA_OK && th->ci != th->base_ci);
+}
+
+static void pin(DefragState* s, const void* p)
+{
+    if (DefragPage* page = findpage(s->pages, p))
+        page->pinned = true;
+}
+
+static bool pinvisitor(void* context, lua_Page* page, GCObject* gco)
+{
+    DefragState* s = (DefragState*)context;
+
+    if (gco->gch.tt == LUA_TTHREAD && incall(gco2th(gco)))
+        s->running = true;
+
+    if (!movable(gco))
+        pin(s, gco);
+
+    if (gco->gch.tt == LUA_TTABLE)
+    {
+        LuaTable* h = gco2h(gco);
+
+        // dead keys are not dereferenced, they only need to keep the address of the object they refer to
+        for (int i = 0; i < sizenode(h); i++)
+        {
+            LuaNode* n = gnode(h, i);
+
+            if (iscollectable(gkey(n)))
+                pin(s, gkey(n)->value.gc);
+        }
+    }
+
+    return false;
+}
+
+static bool sizevisitor(void* context, lua_Page* page, GCObject* gco)
+{
+    DefragState* s = (DefragState*)context;
+
+    s->bytes[gco->gch.memcat] += objsize(gco);
+    s->objects++;
+
+    return false;
+}
+
+static bool movevisitor(void* context, lua_Page* page, GCObject* gco)
+{
+    DefragState* s = (DefragState*)context;
+    size_t size = objsize(gco);
+
+    GCObject* to = luaM_newgco_(s->L, size, gco->gch.memcat);
+    memcpy(to, gco, size);
+
+    Forward* f = (Forward*)gco;
+    f->tt = FORWARDED;
+    f->to = to;
+
+    return false;
+}
+
+static bool freevisitor(void* context, lua_Page* page, GCObject* gco)
+{
+    DefragState* s = (DefragState*)context;
+    LUAU_ASSERT(gco->gch.tt == FORWARDED);
+
+    luaM_freegco_(s->L, gco, objsize(((Forward*)gco)->to), gco->gch.memcat, page);
+    return true;
+}
+
+static GCObject* forward(GCObject* o)
+{
+    return o->gch.tt == FORWARDED ? ((Forward*)o)->to : o;
+}
+
+static void forwardvalue(TValue* o)
+{
+    if (iscollectable(o))
+        o->value.gc = forward(o->value.gc);
+}
+
+static void forwardtable(LuaTable** h)
+{
+    if (*h)
+        *h = gco2h(forward(obj2gco(*h)));
+}
+
+// forwards a pointer that might refer to an object that was already freed, such as an inline cache hint
+static void forwardhint(DefragState* s, LuaTable** h)
+{
+    if (*h && findpage(s->moved, *h) && obj2gco(*h)->gch.tt == FORWARDED)
+        *h = gco2h(((Forward*)*h)->to);
+}
+
+static GCObject** gclistof(GCObject* o)
+{
+    switch (o->gch.tt)
+    {
+    case LUA_TTABLE:
+        return &gco2h(o)->gclist;
+    case LUA_TFUNCTION:
+        return &gco2cl(o)->gclist;
+    case LUA_TTHREAD:
+        return &gco2th(o)->gclist;
+    case LUA_TPROTO:
+        return &gco2p(o)->gclist;
+    default:
+        LUAU_ASSERT(!"unexpected object in a gray list");
+        return NULL;
+    }
+}
+
+static void forwardlist(GCObject** list)
+{
+    for (GCObject** p = list; *p; p = gclistof(*p))
+        *p = forward(*p);
+}
+
+static void forwardthread(lua_State* th)
+{
+    forwardtable(&th->gt);
+
+    // the stack above top was cleared by the collection; open upvalues refer to these slots
+    for (StkId o = th->stack; o < th->top; o++)
+        forwardvalue(o);
+}
+
+static bool forwardvisitor(void* context, lua_Page* page, GCObject* gco)
+{
+    DefragState* s = (DefragState*)context;
+
+    switch (gco->gch.tt)
+    {
+    case LUA_TTABLE:
+    {
+        LuaTable* h = gco2h(gco);
+        forwardtable(&h->metatable);
+
+        for (int i = 0; i < h->sizearray; i++)
+            forwardvalue(&h->array[i]);
+
+        // keys are pinned, so only the values need to be forwarded
+        for (int i = 0; i < sizenode(h); i++)
+            forwardvalue(gval(gnode(h, i)));
+        break;
+    }
+    case LUA_TFUNCTION:
+    {
+        Closure* cl = gco2cl(gco);
+        forwardtable(&cl->env);
+
+        if (cl->isC)
+        {
+            for (int i = 0; i < cl->nupvalues; i++)
+                forwardvalue(&cl->c.upvals[i]);
+        }
+        else
+        {
+            for (int i = 0; i < cl->nupvalues; i++)
+                forwardvalue(&cl->l.uprefs[i]);
+        }
+        break;
+    }
+    case LUA_TUSERDATA:
+        forwardtable(&gco2u(gco)->metatable);
+        break;
+    case LUA_TTHREAD:
+        forwardthread(gco2th(gco));
+        break;
+    case LUA_TUPVAL:
+    {
+        UpVal* uv = gco2uv(gco);
+
+        // open upvalues refer to stack slots which are forwarded with their thread
+        if (!upisopen(uv))
+            forwardvalue(&uv->u.value);
+        break;
+    }
+    case LUA_TPROTO:
+    {
+        Proto* p = gco2p(gco);
+
+        for (int i = 0; i < p->sizek; i++)
+            forwardvalue(&p->k[i]);
+
+        for (int i = 0; i < p->sizeicache; i++)
+            for (int j = 0; j < p->icache[i].size; j++)
+                forwardhint(s, &p->icache[i].metatable[j]);
+        break;
+    }
+    case FORWARDED:
+        break;
+    }
+
+    return false;
+}
+
+static void forwardroots(DefragState* s)
+{
+    global_State* g = s->L->global;
+
+    forwardvalue(&g->registry);
+    forwardvalue(&g->pseudotemp);
+
+    // the main thread isn't allocated in GCO pages, so it isn't visited with the other threads
+    forwardthread(g->mainthread);
+
+    for (int i = 0; i < LUA_T_COUNT; i++)
+        forwardtable(&g->mt[i]);
+
+    for (int i = 0; i < LUA_UTAG_LIMIT; i++)
+        forwardtable(&g->udatamt[i]);
+
+    for (int i = 0; i < g->loadcachesize; i++)
+        forwardtable(&g->loadcache[i].env);
+
+    if (Profiler* p = g->profiler)
+    {
+        int count = p->head < uint64_t(p->capacity) ? int(p->head) : p->capacity;
+
+        for (int i = 0; i < count; i++)
+            if (p->frames[i].function)
+                p->frames[i].function = forward(p->frames[i].function);
+    }
+
+    // objects that survive a generational cycle keep their places in these lists
+    forwardlist(&g->gray);
+    forwardlist(&g->grayagain);
+    forwardlist(&g->weak);
+}
+
+// picks the pages to evacuate, see the comment at the top
+static void choosepages(DefragState* s, std::vector<int>& freeblocks)
+{
+    std::vector<DefragPage*> order;
+    for (DefragPage& page : s->pages)
+        if (!page.pinned)
+            order.push_back(&page);
+
+    std::sort(order.begin(), order.end(),
+        [](const DefragPage* l, const DefragPage* r)
+        {
+            return l->blockSize != r->blockSize ? l->blockSize < r->blockSize : l->busy < r->busy;
+        });
+
+    int blockSize = 0;
+    int moving = 0;
+
+    for (DefragPage* page : order)
+    {
+        if (page->blockSize != blockSize)
+        {
+            blockSize = page->blockSize;
+            moving = 0;
+        }
+
+        // once a page doesn't fit, denser pages of this size class won't either
+        int free = page->blocks - page->busy;
+
+        if (moving + page->busy <= freeblocks[blockSize] - free)
+        {
+            freeblocks[blockSize] -= free;
+            moving += page->busy;
+
+            s->moved.push_back(*page);
+        }
+        else
+        {
+            freeblocks[blockSize] = 0;
+        }
+    }
+
+    std::sort(s->moved.begin(), s->moved.end(),
+        [](const DefragPage& l, const DefragPage& r)
+        {
+            return l.start < r.start;
+        });
+}
+
+void luaC_defrag(lua_State* L)
+{
+    global_State* g = L->global;
+    LUAU_ASSERT(g->gcstate == GCSpause && !g->graytable);
+
+    if (g->gcdefrag == 0 || g->bgsweep.pages)
+        return;
+
+    // the main thread isn't allocated in GCO pages, the others are checked by pinvisitor
+    if (incall(g->mainthread))
+        return;
+
+    DefragState s = {};
+    s.L = L;
+
+    // free blocks of each size class, by block size
+    std::vector<int> freeblocks;
+
+    for (lua_Page* curr = g->allgcopages; curr; curr = luaM_getnextpage(curr))
+    {
+        int pageBlocks, busyBlocks, blockSize, pageSize;
+        luaM_getpageinfo(curr, &pageBlocks, &busyBlocks, &blockSize, &pageSize);
+
+        // pages of large objects only have one block
+        if (pageBlocks == 1)
+            continue;
+
+        if (size_t(blockSize) >= freeblocks.size())
+            freeblocks.resize(blockSize + 1);
+
+        freeblocks[blockSize] += pageBlocks - busyBlocks;
+
+        if (busyBlocks * 100 < pageBlocks * g->gcdefrag)
+            s.pages.push_back({curr, (char*)curr, (char*)curr + pageSize, pageBlocks, busyBlocks, blockSize, false});
+    }
+
+    if (s.pages.empty())
+        return;
+
+    std::sort(s.pages.begin(), s.pages.end(),
+        [](const DefragPage& l, const DefragPage& r)
+        {
+            return l.start < r.start;
+        });
+
+    luaM_visitgco(L, &s, pinvisitor);
+
+    if (s.running)
+        return;
+
+    choosepages(&s, freeblocks);
+
+    if (s.moved.empty())
+        return;
+
+    for (DefragPage& page : s.moved)
+        luaM_visitpage(page.page, &s, sizevisitor);
+
+    // new copies are allocated before the old blocks are freed, which can't fail or schedule another collection
+    size_t total = 0;
+
+    for (int i = 0; i < LUA_MEMORY_CATEGORIES; i++)
+    {
+        if (s.bytes[i] && g->memcatbytes[i] + s.bytes[i] > g->memcattrigger[i])
+            return;
+
+        total += s.bytes[i];
+    }
+
+    if (g->totalbytes + total > g->memtrigger)
+        return;
+
+    for (DefragPage& page : s.moved)
+        luaM_detachgcopage(g, page.page);
+
+    for (DefragPage& page : s.moved)
+        luaM_visitpage(page.page, &s, movevisitor);
+
+    luaM_visitgco(L, &s, forwardvisitor);
+    forwardroots(&s);
+
+    size_t pagebytes = 0;
+
+    for (DefragPage& page : s.moved)
+    {
+        pagebytes += page.end - page.start;
+
+        // the last free releases the page
+        luaM_visitpage(page.page, &s, freevisitor);
+    }
+
+    g->metrics.gcdefragpages += s.moved.size();
+    g->metrics.gcdefragbytes += pagebytes;
+    g->metrics.gcdefragobjects += s.objects;
+}
@@ -5,6 +5,7 @@
 #include "lstate.h"
 #include "ldo.h"
 #include "ldebug.h"
+#include "lgc.h"
 
 #include <string.h>
 
@@ -69,17 +70,37 @@
  *
  * In both cases, we pick the page by computing the size class from the block size which rounds the block
  * size up to reduce the chance that we'll allocate pages that have very few allocated blocks. The size
- * class strategy is determined by SizeClassConfig constructor.
+ * class strategy is determined by SizeClassConfig constructor; hosts can replace it with their own classes and page
+ * sizes for each state (see lua_newstateex), which is shared by all threads of the state via global_State::sizeclasses.
+ * To help with picking the classes, allocation sizes can be recorded per memory category (see lua_setsizehistogram).
  *
  * Note that when the last block in a page is freed, we immediately free the page with frealloc - the
  * memory manager doesn't currently attempt to keep unused memory around. This can result in excessive
  * allocation traffic and can be mitigated by adding a page cache in the future.
  *
+ * Allocations are also checked against optional memory limits for the total heap size and for each memory category
+ * (global_State::memlimit/memcatlimit). To keep the check cheap, the fast path only compares the new size against a
+ * trigger value; crossing it leads to luaM_checkbudget which decides what to do. Triggers are placed below the limits,
+ * and crossing one schedules a full collection for the next GC step, which always runs at a point where every live object
+ * is reachable. Allocations themselves can't run a full collection since the objects that are under construction at that
+ * point are not anchored yet; when an allocation would exceed a limit, the only work that is done is to finish the
+ * pending sweep (objects it frees were proven dead before the allocation started), after which the allocation fails
+ * with LUA_ERRMEM.
+ *
  * For both GCO and non-GCO pages, the per-page block allocation combines bump pointer style allocation
  * (lua_Page::freeNext) and per-page free list (lua_Page::freeList). We use the bump allocator to allocate
  * the contents of the page, and the free list for further reuse; this allows shorter page setup times
  * which results in less variance between allocation cost, as well as tighter sweep bounds for newly
  * allocated pages.
+ *
+ * When background sweeping is enabled (see lgc.cpp), the pages that exist at the end of the mark phase are handed over to
+ * helper threads. luaM_detachgcopage takes a page out of its size class free list so that the thread running the state
+ * never allocates from it, luaM_sweepgco frees blocks of a detached page without touching any global state, and
+ * luaM_attachgcopage applies the accounting for those blocks and returns the page to the allocator. Until then, new
+ * objects are allocated from new pages.
+ *
+ * GCO pages also track whether any object was allocated out of them since the generational collector last swept them
+ * (lua_Page::young); minor collections only need to sweep those pages, since every other object survived a collection.
  */
 
 #ifndef __has_feature
@@ -152,10 +173,13 @@ struct SizeClassConfig
     int8_t classForSize[kMaxSmallSize + 1];
     int classCount = 0;
 
+    int smallPageSize = int(kSmallPageSize);
+    int largePageSize = int(kLargePageSize);
+    int largePageThreshold = int(kLargePageThreshold);
+
     SizeClassConfig()
     {
         memset(sizeOfClass, 0, sizeof(sizeOfClass));
-        memset(classForSize, -1, sizeof(classForSize));
 
         // we use a progressive size class scheme:
         // - all size classes are aligned by 8b to satisfy pointer alignment requirements
@@ -178,11 +202,35 @@ struct SizeClassConfig
 
         LUAU_ASSERT(size_t(classCount) <= kSizeClasses);
 
+        fillLookup();
+    }
+
+    SizeClassConfig(const lua_SizeClasses* classes)
+    {
+        memset(sizeOfClass, 0, sizeof(sizeOfClass));
+
+        for (int klass = 0; klass < classes->count; ++klass)
+            sizeOfClass[classCount++] = classes->sizes[klass];
+
+        if (classes->smallpagesize)
+            smallPageSize = classes->smallpagesize;
+        if (classes->largepagesize)
+            largePageSize = classes->largepagesize;
+        if (classes->largeclass)
+            largePageThreshold = classes->largeclass;
+
+        fillLookup();
+    }
+
+    void fillLookup()
+    {
+        memset(classForSize, -1, sizeof(classForSize));
+
         // fill the lookup table for all classes
         for (int klass = 0; klass < classCount; ++klass)
             classForSize[sizeOfClass[klass]] = int8_t(klass);
 
-        // fill the gaps in lookup table
+        // fill the gaps in lookup table; sizes above the largest class stay unpaged
         for (int size = kMaxSmallSize - 1; size >= 0; --size)
             if (classForSize[size] < 0)
                 classForSize[size] = classForSize[size + 1];
@@ -192,7 +240,7 @@ struct SizeClassConfig
 const SizeClassConfig kSizeClassConfig;
 
 // size class for a block of size sz; returns -1 for size=0 because empty allocations take no space
-#define sizeclass(sz) (size_t((sz) - 1) < kMaxSmallSizeUsed ? kSizeClassConfig.classForSize[sz] : -1)
+#define sizeclass(g, sz) (size_t((sz) - 1) < kMaxSmallSizeUsed ? (g)->sizeclasses->classForSize[sz] : -1)
 
 // metadata for a block is stored in the first pointer of the block
 #define metadata(block) (*(void**)(block))
@@ -221,6 +269,8 @@ struct lua_Page
     int freeNext;   // next free block offset in this page, in bytes; when negative, freeList is used instead
     int busyBlocks; // number of blocks allocated out of this page
 
+    bool young; // page had objects allocated since the last generational sweep (see lgc.cpp)
+
     union
     {
         char data[1];
@@ -234,6 +284,130 @@ l_noret luaM_toobig(lua_State* L)
     luaG_runerror(L, "memory allocation error: block too big");
 }
 
+l_noret luaM_outofmemory(lua_State* L)
+{
+    L->global->metrics.memerrors++;
+    luaD_throw(L, LUA_ERRMEM);
+}
+
+// fraction of the limit at which a full collection is scheduled
+#define budgetsoftlimit(limit) ((limit) - (limit) / 8)
+
+#define overbudget(g, nsize, memcat) ((g)->totalbytes + (nsize) > (g)->memtrigger || (g)->memcatbytes[memcat] + (nsize) > (g)->memcattrigger[memcat])
+
+static bool overlimit(global_State* g, size_t nsize, uint8_t memcat)
+{
+    return g->totalbytes + nsize > g->memlimit || g->memcatbytes[memcat] + nsize > g->memcatlimit[memcat];
+}
+
+static size_t budgettrigger(size_t limit, size_t used)
+{
+    if (limit == SIZE_MAX)
+        return SIZE_MAX;
+
+    // once the usage is past the soft limit, trigger only at the hard limit so that scheduled collections don't repeat
+    size_t soft = budgetsoftlimit(limit);
+    return used < soft ? soft : limit;
+}
+
+void luaM_updatebudget(global_State* g)
+{
+    g->memtrigger = budgettrigger(g->memlimit, g->totalbytes);
+
+    for (int i = 0; i < LUA_MEMORY_CATEGORIES; i++)
+        g->memcattrigger[i] = budgettrigger(g->memcatlimit[i], g->memcatbytes[i]);
+}
+
+static bool validsizeclasses(const lua_SizeClasses* classes)
+{
+    if (!classes->sizes || classes->count < 1 || size_t(classes->count) > kSizeClasses)
+        return false;
+
+    for (int klass = 0; klass < classes->count; ++klass)
+    {
+        int size = classes->sizes[klass];
+        int prev = klass > 0 ? classes->sizes[klass - 1] : 0;
+
+        // blocks need pointer alignment, see kBlockHeader
+        if (size <= prev || size % 8 != 0 || size_t(size) > kMaxSmallSizeUsed)
+            return false;
+    }
+
+    if (classes->largeclass < 0 || size_t(classes->largeclass) > kMaxSmallSize)
+        return false;
+
+    int threshold = classes->largeclass ? classes->largeclass : int(kLargePageThreshold);
+    int smallPageSize = classes->smallpagesize ? classes->smallpagesize : int(kSmallPageSize);
+    int largePageSize = classes->largepagesize ? classes->largepagesize : int(kLargePageSize);
+
+    // every page has to fit at least one block of the classes that use it
+    for (int klass = 0; klass < classes->count; ++klass)
+    {
+        int size = classes->sizes[klass];
+        int pageSize = size > threshold ? largePageSize : smallPageSize;
+
+        if (pageSize < 0 || size_t(pageSize) < offsetof(lua_Page, data) + size + kBlockHeader)
+            return false;
+    }
+
+    return true;
+}
+
+const SizeClassConfig* luaM_newsizeclasses(lua_Alloc f, void* ud, const lua_SizeClasses* classes)
+{
+    if (!classes)
+        return &kSizeClassConfig;
+
+    if (!validsizeclasses(classes))
+        return NULL;
+
+    SizeClassConfig* config = (SizeClassConfig*)(*f)(ud, NULL, 0, sizeof(SizeClassConfig));
+    if (!config)
+        return NULL;
+
+    SizeClassConfig custom(classes);
+    memcpy(config, &custom, sizeof(SizeClassConfig));
+    return config;
+}
+
+void luaM_freesizeclasses(lua_Alloc f, void* ud, const SizeClassConfig* config)
+{
+    if (config != &kSizeClassConfig)
+        (*f)(ud, (void*)config, sizeof(SizeClassConfig), 0);
+}
+
+static void recordsize(global_State* g, size_t nsize, uint8_t memcat)
+{
+    size_t bucket = nsize <= kMaxSmallSize ? (nsize - 1) / 8 : LUA_SIZEBUCKETS - 1;
+    g->sizehistogram[memcat * LUA_SIZEBUCKETS + bucket]++;
+}
+
+// this is part of a cold path in all allocation functions
+LUAU_NOINLINE static void checkbudget(lua_State* L, size_t nsize, uint8_t memcat)
+{
+    global_State* g = L->global;
+
+    bool over = overlimit(g, nsize, memcat);
+
+    if (over)
+    {
+        luaC_finishsweep(L);
+
+        over = overlimit(g, nsize, memcat);
+    }
+
+    // close to or over the limit: request a full collection from the next GC step, unless the collector was stopped
+    if (g->GCthreshold != SIZE_MAX)
+    {
+        g->gcemergency = true;
+        g->GCthreshold = 0;
+    }
+
+    // the collection can't run inside the allocator, so an allocation that doesn't fit fails and a retry after the next safepoint may succeed
+    if (over)
+        luaM_outofmemory(L);
+}
+
 static lua_Page* newpage(lua_State* L, lua_Page** pageset, int pageSize, int blockSize, int blockCount)
 {
     global_State* g = L->global;
@@ -242,7 +416,7 @@ static lua_Page* newpage(lua_State* L, lua_Page** pageset, int pageSize, int blo
 
     lua_Page* page = (lua_Page*)(*g->frealloc)(g->ud, NULL, 0, pageSize);
     if (!page)
-        luaD_throw(L, LUA_ERRMEM);
+        luaM_outofmemory(L);
 
     ASAN_POISON_MEMORY_REGION(page->data, blockSize * blockCount);
 
@@ -262,6 +436,7 @@ static lua_Page* newpage(lua_State* L, lua_Page** pageset, int pageSize, int blo
     page->freeList = NULL;
     page->freeNext = (blockCount - 1) * blockSize;
     page->busyBlocks = 0;
+    page->young = false;
 
     if (pageset)
     {
@@ -279,8 +454,9 @@ static lua_Page* newpage(lua_State* L, lua_Page** pageset, int pageSize, int blo
 // if it is inlined, then the compiler may determine those functions are "too big" to be profitably inlined, which results in reduced performance
 LUAU_NOINLINE static lua_Page* newclasspage(lua_State* L, lua_Page** freepageset, lua_Page** pageset, uint8_t sizeClass, bool storeMetadata)
 {
-    int sizeOfClass = kSizeClassConfig.sizeOfClass[sizeClass];
-    int pageSize = sizeOfClass > int(kLargePageThreshold) ? kLargePageSize : kSmallPageSize;
+    const SizeClassConfig* config = L->global->sizeclasses;
+    int sizeOfClass = config->sizeOfClass[sizeClass];
+    int pageSize = sizeOfClass > config->largePageThreshold ? config->largePageSize : config->smallPageSize;
     int blockSize = sizeOfClass + (storeMetadata ? kBlockHeader : 0);
     int blockCount = (pageSize - offsetof(lua_Page, data)) / blockSize;
 
@@ -338,7 +514,7 @@ static void* newblock(lua_State* L, int sizeClass)
 
     LUAU_ASSERT(!page->prev);
     LUAU_ASSERT(page->freeList || page->freeNext >= 0);
-    LUAU_ASSERT(size_t(page->blockSize) == kSizeClassConfig.sizeOfClass[sizeClass] + kBlockHeader);
+    LUAU_ASSERT(size_t(page->blockSize) == g->sizeclasses->sizeOfClass[sizeClass] + kBlockHeader);
 
     void* block;
 
@@ -386,7 +562,7 @@ static void* newgcoblock(lua_State* L, int sizeClass)
 
     LUAU_ASSERT(!page->prev);
     LUAU_ASSERT(page->freeList || page->freeNext >= 0);
-    LUAU_ASSERT(page->blockSize == kSizeClassConfig.sizeOfClass[sizeClass]);
+    LUAU_ASSERT(page->blockSize == g->sizeclasses->sizeOfClass[sizeClass]);
 
     void* block;
 
@@ -408,6 +584,8 @@ static void* newgcoblock(lua_State* L, int sizeClass)
         page->busyBlocks++;
     }
 
+    page->young = true;
+
     // if we allocate the last block out of a page, we need to remove it from free list
     if (!page->freeList && page->freeNext < 0)
     {
@@ -430,7 +608,7 @@ static void freeblock(lua_State* L, int sizeClass, void* block)
 
     lua_Page* page = (lua_Page*)metadata(block);
     LUAU_ASSERT(page && page->busyBlocks > 0);
-    LUAU_ASSERT(size_t(page->blockSize) == kSizeClassConfig.sizeOfClass[sizeClass] + kBlockHeader);
+    LUAU_ASSERT(size_t(page->blockSize) == g->sizeclasses->sizeOfClass[sizeClass] + kBlockHeader);
     LUAU_ASSERT(block >= page->data && block < (char*)page + page->pageSize);
 
     // if the page wasn't in the page free list, it should be now since it got a block!
@@ -461,7 +639,7 @@ static void freeblock(lua_State* L, int sizeClass, void* block)
 static void freegcoblock(lua_State* L, int sizeClass, void* block, lua_Page* page)
 {
     LUAU_ASSERT(page && page->busyBlocks > 0);
-    LUAU_ASSERT(page->blockSize == kSizeClassConfig.sizeOfClass[sizeClass]);
+    LUAU_ASSERT(page->blockSize == L->global->sizeclasses->sizeOfClass[sizeClass]);
     LUAU_ASSERT(block >= page->data && block < (char*)page + page->pageSize);
 
     global_State* g = L->global;
@@ -495,15 +673,24 @@ void* luaM_new_(lua_State* L, size_t nsize, uint8_t memcat)
 {
     global_State* g = L->global;
 
-    int nclass = sizeclass(nsize);
+    if (LUAU_UNLIKELY(overbudget(g, nsize, memcat)))
+        checkbudget(L, nsize, memcat);
+
+    int nclass = sizeclass(g, nsize);
 
     void* block = nclass >= 0 ? newblock(L, nclass) : (*g->frealloc)(g->ud, NULL, 0, nsize);
     if (block == NULL && nsize > 0)
-        luaD_throw(L, LUA_ERRMEM);
+        luaM_outofmemory(L);
 
     g->totalbytes += nsize;
     g->memcatbytes[memcat] += nsize;
 
+    g->metrics.allocations++;
+    g->metrics.allocatedbytes += nsize;
+
+    if (LUAU_UNLIKELY(!!g->sizehistogram) && nsize > 0)
+        recordsize(g, nsize, memcat);
+
     if (LUAU_UNLIKELY(!!g->cb.onallocate))
     {
         g->cb.onallocate(L, 0, nsize);
@@ -519,7 +706,10 @@ GCObject* luaM_newgco_(lua_State* L, size_t nsize, uint8_t memcat)
 
     global_State* g = L->global;
 
-    int nclass = sizeclass(nsize);
+    if (LUAU_UNLIKELY(overbudget(g, nsize, memcat)))
+        checkbudget(L, nsize, memcat);
+
+    int nclass = sizeclass(g, nsize);
 
     void* block = NULL;
 
@@ -536,14 +726,21 @@ GCObject* luaM_newgco_(lua_State* L, size_t nsize, uint8_t memcat)
 
         page->freeNext -= page->blockSize;
         page->busyBlocks++;
+        page->young = true;
     }
 
     if (block == NULL && nsize > 0)
-        luaD_throw(L, LUA_ERRMEM);
+        luaM_outofmemory(L);
 
     g->totalbytes += nsize;
     g->memcatbytes[memcat] += nsize;
 
+    g->metrics.allocations++;
+    g->metrics.allocatedbytes += nsize;
+
+    if (LUAU_UNLIKELY(!!g->sizehistogram) && nsize > 0)
+        recordsize(g, nsize, memcat);
+
     if (LUAU_UNLIKELY(!!g->cb.onallocate))
     {
         g->cb.onallocate(L, 0, nsize);
@@ -557,7 +754,7 @@ void luaM_free_(lua_State* L, void* block, size_t osize, uint8_t memcat)
     global_State* g = L->global;
     LUAU_ASSERT((osize == 0) == (block == NULL));
 
-    int oclass = sizeclass(osize);
+    int oclass = sizeclass(g, osize);
 
     if (oclass >= 0)
         freeblock(L, oclass, block);
@@ -566,6 +763,8 @@ void luaM_free_(lua_State* L, void* block, size_t osize, uint8_t memcat)
 
     g->totalbytes -= osize;
     g->memcatbytes[memcat] -= osize;
+
+    g->metrics.frees++;
 }
 
 void luaM_freegco_(lua_State* L, GCObject* block, size_t osize, uint8_t memcat, lua_Page* page)
@@ -573,7 +772,7 @@ void luaM_freegco_(lua_State* L, GCObject* block, size_t osize, uint8_t memcat,
     global_State* g = L->global;
     LUAU_ASSERT((osize == 0) == (block == NULL));
 
-    int oclass = sizeclass(osize);
+    int oclass = sizeclass(g, osize);
 
     if (oclass >= 0)
     {
@@ -592,6 +791,8 @@ void luaM_freegco_(lua_State* L, GCObject* block, size_t osize, uint8_t memcat,
 
     g->totalbytes -= osize;
     g->memcatbytes[memcat] -= osize;
+
+    g->metrics.frees++;
 }
 
 void* luaM_realloc_(lua_State* L, void* block, size_t osize, size_t nsize, uint8_t memcat)
@@ -599,8 +800,11 @@ void* luaM_realloc_(lua_State* L, void* block, size_t osize, size_t nsize, uint8
     global_State* g = L->global;
     LUAU_ASSERT((osize == 0) == (block == NULL));
 
-    int nclass = sizeclass(nsize);
-    int oclass = sizeclass(osize);
+    if (nsize > osize && LUAU_UNLIKELY(overbudget(g, nsize - osize, memcat)))
+        checkbudget(L, nsize - osize, memcat);
+
+    int nclass = sizeclass(g, nsize);
+    int oclass = sizeclass(g, osize);
     void* result;
 
     // if either block needs to be allocated using a block allocator, we can't use realloc directly
@@ -608,7 +812,7 @@ void* luaM_realloc_(lua_State* L, void* block, size_t osize, size_t nsize, uint8
     {
         result = nclass >= 0 ? newblock(L, nclass) : (*g->frealloc)(g->ud, NULL, 0, nsize);
         if (result == NULL && nsize > 0)
-            luaD_throw(L, LUA_ERRMEM);
+            luaM_outofmemory(L);
 
         if (osize > 0 && nsize > 0)
             memcpy(result, block, osize < nsize ? osize : nsize);
@@ -622,13 +826,26 @@ void* luaM_realloc_(lua_State* L, void* block, size_t osize, size_t nsize, uint8
     {
         result = (*g->frealloc)(g->ud, block, osize, nsize);
         if (result == NULL && nsize > 0)
-            luaD_throw(L, LUA_ERRMEM);
+            luaM_outofmemory(L);
     }
 
     LUAU_ASSERT((nsize == 0) == (result == NULL));
     g->totalbytes = (g->totalbytes - osize) + nsize;
     g->memcatbytes[memcat] += nsize - osize;
 
+    if (nsize > 0)
+    {
+        g->metrics.allocations++;
+        g->metrics.allocatedbytes += nsize;
+
+        if (LUAU_UNLIKELY(!!g->sizehistogram))
+            recordsize(g, nsize, memcat);
+    }
+    else
+    {
+        g->metrics.frees++;
+    }
+
     if (LUAU_UNLIKELY(!!g->cb.onallocate))
     {
         g->cb.onallocate(L, osize, nsize);
@@ -664,6 +881,82 @@ lua_Page* luaM_getnextpage(lua_Page* page)
     return page->listnext;
 }
 
+bool luaM_getpageyoung(lua_Page* page)
+{
+    return page->young;
+}
+
+void luaM_setpageyoung(lua_Page* page, bool young)
+{
+    page->young = young;
+}
+
+void luaM_detachgcopage(global_State* g, lua_Page* page)
+{
+    // pages are in the free list of their size class iff they have free blocks; pages of large objects never do
+    if (page->freeList || page->freeNext >= 0)
+    {
+        int sizeClass = sizeclass(g, page->blockSize);
+        LUAU_ASSERT(sizeClass >= 0 && page->blockSize == g->sizeclasses->sizeOfClass[sizeClass]);
+
+        if (page->next)
+            page->next->prev = page->prev;
+
+        if (page->prev)
+            page->prev->next = page->next;
+        else if (g->freegcopages[sizeClass] == page)
+            g->freegcopages[sizeClass] = page->next;
+
+        page->prev = NULL;
+        page->next = NULL;
+    }
+}
+
+void luaM_sweepgco(lua_Page* page, GCObject* block)
+{
+    LUAU_ASSERT(page->busyBlocks > 0);
+    LUAU_ASSERT((char*)block >= page->data && (char*)block < (char*)page + page->pageSize);
+
+    block->gch.tt = LUA_TNIL;
+
+    freegcolink(block) = page->freeList;
+    page->freeList = block;
+
+    ASAN_POISON_MEMORY_REGION((char*)block + sizeof(GCheader), page->blockSize - sizeof(GCheader));
+
+    page->busyBlocks--;
+}
+
+bool luaM_attachgcopage(lua_State* L, lua_Page* page, size_t freedbytes, uint8_t memcat, int frees)
+{
+    global_State* g = L->global;
+    LUAU_ASSERT(!page->prev && !page->next);
+
+    g->totalbytes -= freedbytes;
+    g->memcatbytes[memcat] -= freedbytes;
+
+    g->metrics.frees += frees;
+
+    if (page->busyBlocks == 0)
+    {
+        freepage(L, &g->allgcopages, page);
+        return false;
+    }
+
+    if (page->freeList || page->freeNext >= 0)
+    {
+        int sizeClass = sizeclass(g, page->blockSize);
+        LUAU_ASSERT(sizeClass >= 0);
+
+        page->next = g->freegcopages[sizeClass];
+        if (page->next)
+            page->next->prev = page;
+        g->freegcopages[sizeClass] = page;
+    }
+
+    return true;
+}
+
 void luaM_visitpage(lua_Page* page, void* context, bool (*visitor)(void* context, lua_Page* page, GCObject* gco))
 {
     char* start;
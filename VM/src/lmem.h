@@ -5,6 +5,7 @@
 #include "lua.h"
 
 struct lua_Page;
+struct SizeClassConfig;
 union GCObject;
 
 #define luaM_newgco(L, t, size, memcat) cast_to(t*, luaM_newgco_(L, size, memcat))
@@ -24,10 +25,21 @@ LUAI_FUNC void luaM_freegco_(lua_State* L, GCObject* block, size_t osize, uint8_
 LUAI_FUNC void* luaM_realloc_(lua_State* L, void* block, size_t osize, size_t nsize, uint8_t memcat);
 
 LUAI_FUNC l_noret luaM_toobig(lua_State* L);
+LUAI_FUNC l_noret luaM_outofmemory(lua_State* L);
+LUAI_FUNC void luaM_updatebudget(struct global_State* g);
+
+LUAI_FUNC const SizeClassConfig* luaM_newsizeclasses(lua_Alloc f, void* ud, const lua_SizeClasses* classes);
+LUAI_FUNC void luaM_freesizeclasses(lua_Alloc f, void* ud, const SizeClassConfig* config);
 
 LUAI_FUNC void luaM_getpagewalkinfo(lua_Page* page, char** start, char** end, int* busyBlocks, int* blockSize);
 LUAI_FUNC void luaM_getpageinfo(lua_Page* page, int* pageBlocks, int* busyBlocks, int* blockSize, int* pageSize);
 LUAI_FUNC lua_Page* luaM_getnextpage(lua_Page* page);
+LUAI_FUNC bool luaM_getpageyoung(lua_Page* page);
+LUAI_FUNC void luaM_setpageyoung(lua_Page* page, bool young);
+
+LUAI_FUNC void luaM_detachgcopage(struct global_State* g, lua_Page* page);
+LUAI_FUNC void luaM_sweepgco(lua_Page* page, GCObject* block);
+LUAI_FUNC bool luaM_attachgcopage(lua_State* L, lua_Page* page, size_t freedbytes, uint8_t memcat, int frees);
 
 LUAI_FUNC void luaM_visitpage(lua_Page* page, void* context, bool (*visitor)(void* context, lua_Page* page, GCObject* gco));
 LUAI_FUNC void luaM_visitgco(lua_State* L, void* context, bool (*visitor)(void* context, lua_Page* page, GCObject* gco));
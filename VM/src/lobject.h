@@ -237,22 +237,45 @@ typedef TValue* StkId; // index to stack elements
 typedef struct TString
 {
     CommonHeader;
-    // 1 byte padding
+
+    uint8_t kind; // STRING_FLAT, STRING_VIEW or STRING_STORAGE
 
     int16_t atom;
 
     // 2 byte padding
 
-    TString* next; // next string in the hash table bucket
+    union
+    {
+        TString* next; // next string in the hash table bucket
+        TString* base; // STRING_VIEW: flat or storage string that holds the contents
+    };
 
-    unsigned int hash;
-    unsigned int len;
+    union
+    {
+        unsigned int hash;
+        unsigned int offset; // STRING_VIEW: position of the contents in the base
+        unsigned int used;   // STRING_STORAGE: number of bytes in use, followed by a terminating 0
+    };
+
+    unsigned int len; // STRING_STORAGE: capacity
 
     char data[1]; // string data is allocated right after the header
 } TString;
 
+/*
+** Kinds of strings
+** Strings created from concatenation results that are at least LUA_MINSTRVIEW bytes long are views into storage strings
+** with spare capacity, so that the next concatenation that extends the view can append to the storage in place. Views are
+** not interned and their contents are not followed by a terminating 0 once something was appended after them; storage
+** strings are only referenced by views and never reach the stack. Substrings that are at least LUA_MINSUBVIEW bytes long
+** are views into the flat or storage string they were taken from; the collector copies the ones that would be the only
+** reason to keep a much longer string alive.
+*/
+#define STRING_FLAT 0
+#define STRING_VIEW 1
+#define STRING_STORAGE 2
 
-#define getstr(ts) (ts)->data
+#define getstr(ts) ((ts)->kind == STRING_VIEW ? (ts)->base->data + (ts)->offset : (ts)->data)
 #define svalue(o) getstr(tsvalue(o))
 
 typedef struct Udata
@@ -285,6 +308,19 @@ typedef struct Buffer
     };
 } Buffer;
 
+/*
+** Polymorphic inline cache of a GETTABLEKS/SETTABLEKS/NAMECALL instruction
+** receivers are told apart by their metatable; entries are hints that are validated against the key stored in the slot on every use,
+** so a rehash that moves the key simply invalidates the entry, and the metatable pointers are never dereferenced
+*/
+typedef struct InlineCache
+{
+    struct LuaTable* metatable[LUA_ICACHEWAYS]; // metatable of the receiver, NULL for tables without one
+    int slot[LUA_ICACHEWAYS];                   // node of the key in the receiver, or ~node in the __index table of the metatable
+    uint8_t size;                               // number of entries in use
+    uint8_t next;                               // entry that is replaced when the cache is full
+} InlineCache;
+
 /*
 ** Function Prototypes
 */
@@ -325,6 +361,14 @@ typedef struct Proto
 
     GCObject* gclist;
 
+    struct LazyChunk* lazychunk; // bytecode of luau_loadmapped that parts of this function are still decoded from
+    uint32_t lazyoffset;         // offset of code and constants while the function isn't materialized; 0 afterwards
+    uint32_t lazylineinfo;       // offset of line info that wasn't decoded yet, or 0
+    uint32_t lazydebuginfo;      // offset of local and upvalue names that weren't decoded yet, or 0
+
+    InlineCache* icache; // caches of table access instructions, allocated when the first one is needed (see luaV_getinlinecache)
+    uint16_t* icindex;   // for each instruction, 1-based index of its cache in icache or 0
+
 
     int sizecode;
     int sizep;
@@ -336,6 +380,7 @@ typedef struct Proto
     int linedefined;
     int bytecodeid;
     int sizetypeinfo;
+    int sizeicache;
 } Proto;
 // clang-format on
 
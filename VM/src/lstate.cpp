@@ -9,6 +9,9 @@
 #include "lgc.h"
 #include "ldo.h"
 #include "ldebug.h"
+#include "lvm.h"
+
+#include <string.h>
 
 /*
 ** Main thread combines a thread state and the global state
@@ -86,9 +89,17 @@ static void close_state(lua_State* L)
 {
     global_State* g = L->global;
     luaF_close(L, L->stack); // close all upvalues for this thread
+    luaV_clearloadcache(L);  // the cache references objects that are about to be freed
+    luaG_freeprofiler(L);    // so do samples of the profiler
     luaC_freeall(L);         // collect all objects
     LUAU_ASSERT(g->strt.nuse == 0);
     luaM_freearray(L, L->global->strt.hash, L->global->strt.size, TString*, 0);
+    if (g->strt.next)
+        luaM_freearray(L, g->strt.next, g->strt.nextsize, TString*, 0);
+    if (g->strt.old)
+        luaM_freearray(L, g->strt.old, g->strt.oldsize, TString*, 0);
+    if (g->sizehistogram)
+        luaM_freearray(L, g->sizehistogram, LUA_MEMORY_CATEGORIES * LUA_SIZEBUCKETS, uint64_t, 0);
     freestack(L, L);
     for (int i = 0; i < LUA_SIZECLASSES; i++)
     {
@@ -104,7 +115,15 @@ static void close_state(lua_State* L)
     if (L->global->ecb.close)
         L->global->ecb.close(L);
 
-    (*g->frealloc)(g->ud, L, sizeof(LG), 0);
+    lua_Alloc frealloc = g->frealloc;
+    void* ud = g->ud;
+    const SizeClassConfig* sizeclasses = g->sizeclasses;
+
+    if (g->pinviews)
+        frealloc(ud, g->pinviews, g->pinviewcapacity * sizeof(TString*), 0);
+
+    frealloc(ud, L, sizeof(LG), 0);
+    luaM_freesizeclasses(frealloc, ud, sizeclasses);
 }
 
 lua_State* luaE_newthread(lua_State* L)
@@ -159,14 +178,61 @@ int lua_isthreadreset(lua_State* L)
     return L->ci == L->base_ci && L->base == L->top && L->status == LUA_OK;
 }
 
+/*
+** metrics are published using a sequence lock: the owning thread is the only writer, so it never waits, and readers
+** retry until they observe the same even sequence number before and after copying the data
+*/
+void luaE_publishmetrics(global_State* g)
+{
+    g->metrics.totalbytes = g->totalbytes;
+    g->metrics.publishtime = lua_clock();
+
+    uint32_t seq = g->metricsseq.load(std::memory_order_relaxed);
+
+    g->metricsseq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(&g->publishedmetrics, &g->metrics, sizeof(lua_Metrics));
+
+    g->metricsseq.store(seq + 2, std::memory_order_release);
+}
+
+void luaE_snapshotmetrics(global_State* g, lua_Metrics* metrics)
+{
+    for (;;)
+    {
+        uint32_t seq = g->metricsseq.load(std::memory_order_acquire);
+
+        if (seq & 1)
+            continue;
+
+        memcpy(metrics, &g->publishedmetrics, sizeof(lua_Metrics));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (g->metricsseq.load(std::memory_order_relaxed) == seq)
+            break;
+    }
+}
+
 lua_State* lua_newstate(lua_Alloc f, void* ud)
+{
+    return lua_newstateex(f, ud, NULL);
+}
+
+lua_State* lua_newstateex(lua_Alloc f, void* ud, const lua_SizeClasses* classes)
 {
     int i;
     lua_State* L;
     global_State* g;
+    const SizeClassConfig* sizeclasses = luaM_newsizeclasses(f, ud, classes);
+    if (sizeclasses == NULL)
+        return NULL;
     void* l = (*f)(ud, NULL, 0, sizeof(LG));
     if (l == NULL)
+    {
+        luaM_freesizeclasses(f, ud, sizeclasses);
         return NULL;
+    }
     L = (lua_State*)l;
     g = &((LG*)L)->g;
     L->tt = LUA_TTHREAD;
@@ -189,16 +255,35 @@ lua_State* lua_newstate(lua_Alloc f, void* ud)
     g->strt.size = 0;
     g->strt.nuse = 0;
     g->strt.hash = NULL;
+    g->strt.next = NULL;
+    g->strt.nextsize = 0;
+    g->strt.old = NULL;
+    g->strt.oldsize = 0;
+    g->strt.rehashpos = 0;
     setnilvalue(&g->pseudotemp);
     setnilvalue(registry(L));
     g->gcstate = GCSpause;
     g->gray = NULL;
     g->grayagain = NULL;
     g->weak = NULL;
+    g->graytable = NULL;
+    g->graytablepos = 0;
+    g->pinviews = NULL;
+    g->pinviewcount = 0;
+    g->pinviewcapacity = 0;
     g->totalbytes = sizeof(LG);
     g->gcgoal = LUAI_GCGOAL;
     g->gcstepmul = LUAI_GCSTEPMUL;
     g->gcstepsize = LUAI_GCSTEPSIZE << 10;
+    g->gcgen = false;
+    g->gcaged = false;
+    g->gcminor = false;
+    g->gcgenminormul = LUAI_GCGENMINORMUL;
+    g->gcmajorbase = 0;
+    g->gcmarkthreads = 1;
+    g->gcdefrag = 0;
+    g->sizeclasses = sizeclasses;
+    g->sizehistogram = NULL;
     for (i = 0; i < LUA_SIZECLASSES; i++)
     {
         g->freepages[i] = NULL;
@@ -207,6 +292,7 @@ lua_State* lua_newstate(lua_Alloc f, void* ud)
     g->allpages = NULL;
     g->allgcopages = NULL;
     g->sweepgcopage = NULL;
+    g->bgsweep = BackgroundSweep();
     for (i = 0; i < LUA_T_COUNT; i++)
         g->mt[i] = NULL;
     for (i = 0; i < LUA_UTAG_LIMIT; i++)
@@ -217,20 +303,45 @@ lua_State* lua_newstate(lua_Alloc f, void* ud)
     for (i = 0; i < LUA_LUTAG_LIMIT; i++)
         g->lightuserdataname[i] = NULL;
     for (i = 0; i < LUA_MEMORY_CATEGORIES; i++)
+    {
         g->memcatbytes[i] = 0;
+        g->memcatlimit[i] = SIZE_MAX;
+        g->memcattrigger[i] = SIZE_MAX;
+    }
 
     g->memcatbytes[0] = sizeof(LG);
+    g->memlimit = SIZE_MAX;
+    g->memtrigger = SIZE_MAX;
+    g->gcemergency = false;
 
     g->cb = lua_Callbacks();
 
     g->ecb = lua_ExecutionCallbacks();
 
+    g->verifyload = false;
+    g->fuseload = false;
+
+    g->loadcache = NULL;
+    g->loadcachesize = 0;
+    g->loadcachecapacity = 0;
+    g->loadcacheclock = 0;
+    g->loadcacheepoch = 0;
+    g->profiler = NULL;
+    g->interruptrequests.store(0, std::memory_order_relaxed);
+    g->deadline.store(0, std::memory_order_relaxed);
+
     g->gcstats = GCStats();
+    g->gcframe = GCFrame();
 
 #ifdef LUAI_GCMETRICS
     g->gcmetrics = GCMetrics();
 #endif
 
+    g->metrics = lua_Metrics();
+    g->metrics.starttime = lua_clock();
+    g->publishedmetrics = g->metrics;
+    g->metricsseq.store(0, std::memory_order_relaxed);
+
     if (luaD_rawrunprotected(L, f_luaopen, NULL) != 0)
     {
         // memory allocation error: free partial state
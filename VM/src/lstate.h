@@ -5,6 +5,8 @@
 #include "lobject.h"
 #include "ltm.h"
 
+#include <atomic>
+
 // registry
 #define registry(L) (&L->global->registry)
 
@@ -22,6 +24,13 @@ typedef struct stringtable
     TString** hash;
     uint32_t nuse; // number of elements
     int size;
+
+    // incremental growth: 'next' is cleared while 'hash' is in use, then it replaces 'hash' and the buckets of 'old' are moved over
+    TString** next;
+    int nextsize;
+    TString** old;
+    int oldsize;
+    int rehashpos; // next bucket to clear in 'next' or to move from 'old'
 } stringtable;
 // clang-format on
 
@@ -92,6 +101,19 @@ struct GCStats
     double endtimestamp = 0;
 };
 
+// state of the frame budget pacer, see LUA_GCSETFRAMEBUDGET
+struct GCFrame
+{
+    double budget = 0; // time GC assists can take in one frame, in seconds; 0 when pacing only depends on allocations
+    double time = 0;   // time taken by GC assists since the start of the frame
+
+    double workrate = 0;   // GC work units per second, measured by recent steps
+    double atomictime = 0; // duration of the last atomic step
+
+    bool deferred = false; // budget of this frame ran out, so assists are postponed until the next frame
+    size_t threshold = 0;  // GCthreshold at the point where assists were postponed
+};
+
 #ifdef LUAI_GCMETRICS
 struct GCCycleMetrics
 {
@@ -159,6 +181,72 @@ struct lua_ExecutionCallbacks
     uint8_t (*gettypemapping)(lua_State* L, const char* str, size_t len); // called to get the userdata type index
 };
 
+// Entry of the ring buffer of the sampling profiler; a sample is stored as its frames, innermost first, followed by an end record
+struct ProfilerFrame
+{
+    GCObject* function; // Proto of a Luau frame or Closure of a C function; NULL for pseudo-frames and end records
+    int pc;             // pc of a Luau frame, PROFILER_GC/PROFILER_TRUNCATED for pseudo-frames, number of frames for end records
+};
+
+#define PROFILER_GC -1        // innermost pseudo-frame of samples taken during a GC step
+#define PROFILER_TRUNCATED -2 // outermost pseudo-frame of samples that didn't fit into PROFILER_MAXDEPTH frames
+#define PROFILER_MAXDEPTH 256
+
+// Sampling profiler, see lua_profilerstart
+struct Profiler
+{
+    ProfilerFrame* frames;
+    int capacity;
+    uint64_t head; // number of entries written since the profiler was started
+};
+
+// Requests that other threads raise in global_State::interruptrequests; luaG_interrupt handles them at the next safepoint
+#define INTERRUPT_PROFILER (1 << 0) // take a sample, see lua_profilerrequest
+#define INTERRUPT_TIMEOUT (1 << 1)  // global_State::deadline may have passed
+
+// checked inline at every safepoint, luaG_interrupt is only called when there is a request or a host interrupt callback
+#define hasinterrupt(g) (!!(g)->cb.interrupt | ((g)->interruptrequests.load(std::memory_order_relaxed) != 0))
+
+// Page of the sweep queue that is built at the end of the mark phase when background sweeping is enabled
+struct SweepPage
+{
+    struct lua_Page* page;
+    uint8_t state;     // SWEEP_* from lgc.cpp; accessed atomically
+    uint8_t memcat;    // memory category of the objects freed by the helper thread
+    bool dirty;        // page has dead objects that the helper thread couldn't free
+    int frees;         // number of objects freed by the helper thread
+    size_t freedbytes; // total size of objects freed by the helper thread
+};
+
+// Background sweeping, see lua_gcsetbackgroundsweep
+struct BackgroundSweep
+{
+    void* ud;
+    void (*notify)(void* ud); // called when a new sweep queue is ready; NULL when background sweeping is disabled
+
+    SweepPage* pages; // sweep queue of the current cycle, NULL if there is none; accessed atomically
+    int count;
+    int cursor; // next page to be handed back to the allocator by the thread running the state
+    int next;   // helper threads claim pages below this index, from the end of the queue; accessed atomically
+    int active; // number of helper threads inside luaC_sweepbackground; accessed atomically
+};
+
+// A chunk kept by luau_load for reuse; identical bytecode loaded into the same environment gets a new closure over the same main function
+struct LoadCacheEntry
+{
+    unsigned int hash; // luaS_hash of the bytecode
+    char* data;        // copy of the bytecode
+    size_t size;
+
+    TString* source;
+    struct LuaTable* env; // imports and closure constants are bound to the environment the chunk was loaded in
+    bool verify;          // the chunk was verified and fused when it was loaded; entries are only reused with the same settings
+    bool fuse;
+    Proto* main;
+
+    uint64_t lastuse; // loadcacheclock when the entry was last loaded
+};
+
 /*
 ** `global state', shared by all threads of this state
 */
@@ -179,6 +267,11 @@ typedef struct global_State
     GCObject* gray;      // list of gray objects
     GCObject* grayagain; // list of objects to be traversed atomically
     GCObject* weak;     // list of weak tables (to be cleared)
+    struct LuaTable* graytable; // black table with an array part that is still being traversed, see propagatemark
+    int graytablepos;           // next array element of 'graytable' to traverse
+    TString** pinviews;         // marked views that didn't mark their long base, see atomic; allocated outside of the GC heap
+    int pinviewcount;
+    int pinviewcapacity;
 
 
     size_t GCthreshold;                       // when totalbytes > GCthreshold, run GC step
@@ -187,14 +280,31 @@ typedef struct global_State
     int gcstepmul;                            // see LUAI_GCSTEPMUL
     int gcstepsize;                          // see LUAI_GCSTEPSIZE
 
+    bool gcgen;         // generational mode is enabled, see LUA_GCGEN
+    bool gcaged;        // objects that survived the last cycle are still marked
+    bool gcminor;       // current cycle only marks objects allocated since the last one
+    int gcgenminormul;  // see LUAI_GCGENMINORMUL
+    size_t gcmajorbase; // heap size after the last major cycle in generational mode
+    int gcmarkthreads;  // number of threads that mark the heap in a full collection, see LUA_GCSETMARKTHREADS
+    int gcdefrag;       // occupancy in percent below which full collections evacuate pages, see LUA_GCSETDEFRAG
+
+    const struct SizeClassConfig* sizeclasses; // size classes of the page allocator, see lua_newstateex
+    uint64_t* sizehistogram;                   // allocation counts by memory category and size, see lua_setsizehistogram
     struct lua_Page* freepages[LUA_SIZECLASSES]; // free page linked list for each size class for non-collectable objects
     struct lua_Page* freegcopages[LUA_SIZECLASSES]; // free page linked list for each size class for collectable objects
     struct lua_Page* allpages; // page linked list with all pages for all non-collectable object classes (available with LUAU_ASSERTENABLED)
     struct lua_Page* allgcopages; // page linked list with all pages for all collectable object classes
     struct lua_Page* sweepgcopage; // position of the sweep in `allgcopages'
+    BackgroundSweep bgsweep;       // pages swept by helper threads, see luaC_sweepbackground
 
     size_t memcatbytes[LUA_MEMORY_CATEGORIES]; // total amount of memory used by each memory category
 
+    size_t memlimit;                              // allocations can't take totalbytes over this limit, see lua_setmemorylimit
+    size_t memtrigger;                            // allocations that take totalbytes over this value check the budget
+    size_t memcatlimit[LUA_MEMORY_CATEGORIES];    // per memory category version of 'memlimit'
+    size_t memcattrigger[LUA_MEMORY_CATEGORIES];  // per memory category version of 'memtrigger'
+    bool gcemergency;                             // a memory limit is close, next GC step has to perform a full collection
+
 
     struct lua_State* mainthread;
     UpVal uvhead;                                    // head of double-linked list of all open upvalues
@@ -216,16 +326,35 @@ typedef struct global_State
 
     lua_ExecutionCallbacks ecb;
 
+    bool verifyload; // luau_load verifies bytecode of every function and rejects chunks that fail, see luau_setverify
+    bool fuseload;   // luau_load rewrites common instruction pairs into superinstructions, see luau_setfusion
+
+    LoadCacheEntry* loadcache; // chunks that luau_load can reuse, see luau_setloadcache
+    int loadcachesize;
+    int loadcachecapacity;
+    uint64_t loadcacheclock; // incremented on every cached load, orders entries for LRU eviction
+    uint64_t loadcacheepoch; // loadcacheclock at the start of the current GC cycle
+
+    Profiler* profiler; // sampling profiler, see lua_profilerstart
+
+    std::atomic<uint32_t> interruptrequests; // INTERRUPT_* bits, the only state that other threads may write
+    std::atomic<double> deadline;            // lua_clock time at which the running script is interrupted with an error, 0 if none
+
     void (*udatagc[LUA_UTAG_LIMIT])(lua_State*, void*); // for each userdata tag, a gc callback to be called immediately before freeing memory
     LuaTable* udatamt[LUA_UTAG_LIMIT]; // metatables for tagged userdata
 
     TString* lightuserdataname[LUA_LUTAG_LIMIT]; // names for tagged lightuserdata
 
     GCStats gcstats;
+    GCFrame gcframe;
 
 #ifdef LUAI_GCMETRICS
     GCMetrics gcmetrics;
 #endif
+
+    lua_Metrics metrics;                // execution metrics, only accessed by the thread running the state
+    lua_Metrics publishedmetrics;       // copy of 'metrics' that can be read from other threads, guarded by 'metricsseq'
+    std::atomic<uint32_t> metricsseq;   // sequence lock for 'publishedmetrics'; odd while a copy is being published
 } global_State;
 // clang-format on
 
@@ -307,3 +436,5 @@ union GCObject
 
 LUAI_FUNC lua_State* luaE_newthread(lua_State* L);
 LUAI_FUNC void luaE_freethread(lua_State* L, lua_State* L1, struct lua_Page* page);
+LUAI_FUNC void luaE_publishmetrics(global_State* g);
+LUAI_FUNC void luaE_snapshotmetrics(global_State* g, lua_Metrics* metrics);
@@ -7,8 +7,133 @@
 
 #include <string.h>
 
+// Strings of at least this size are hashed in 32-byte blocks by a multiply-accumulate hash (XXH3 style) that maps to 128-bit vectors
+// Shorter strings use the hash that BytecodeBuilder replicates, so compile-time slot predictions for constants still match
+#define HASH_BLOCK_MIN 256
+
+// Accumulators are scrambled after this many blocks so that early input keeps affecting the result
+#define HASH_SCRAMBLE_BLOCKS 16
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HASH_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define HASH_NEON 1
+#include <arm_neon.h>
+#endif
+
+static const uint64_t kHashKey[4] = {0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull};
+static const uint64_t kHashScramble[4] = {0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull, 0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull};
+static const uint32_t kHashPrime = 2654435761u;
+
+// The vector paths compute exactly the same values as the scalar one
+static unsigned int hashblocks(const char* str, size_t len)
+{
+    uint64_t acc[4] = {kHashPrime, 0x9e3779b185ebca87ull, 0xc2b2ae3d27d4eb4full, 0x165667b19e3779f9ull};
+    size_t blocks = len / 32;
+
+#if HASH_SSE2
+    __m128i acc0 = _mm_loadu_si128((const __m128i*)&acc[0]);
+    __m128i acc1 = _mm_loadu_si128((const __m128i*)&acc[2]);
+    __m128i key0 = _mm_loadu_si128((const __m128i*)&kHashKey[0]);
+    __m128i key1 = _mm_loadu_si128((const __m128i*)&kHashKey[2]);
+    __m128i prime = _mm_set1_epi32(int(kHashPrime));
+
+    for (size_t i = 0; i < blocks; ++i, str += 32)
+    {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)str);
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(str + 16));
+
+        // acc[j] += lo32(v[j] ^ key[j]) * hi32(v[j] ^ key[j]), acc[j ^ 1] += v[j]
+        __m128i k0 = _mm_xor_si128(v0, key0);
+        __m128i k1 = _mm_xor_si128(v1, key1);
+        acc0 = _mm_add_epi64(acc0, _mm_add_epi64(_mm_mul_epu32(k0, _mm_srli_epi64(k0, 32)), _mm_shuffle_epi32(v0, _MM_SHUFFLE(1, 0, 3, 2))));
+        acc1 = _mm_add_epi64(acc1, _mm_add_epi64(_mm_mul_epu32(k1, _mm_srli_epi64(k1, 32)), _mm_shuffle_epi32(v1, _MM_SHUFFLE(1, 0, 3, 2))));
+
+        if (i % HASH_SCRAMBLE_BLOCKS == HASH_SCRAMBLE_BLOCKS - 1)
+        {
+            // acc = (acc ^ (acc >> 47) ^ scramble) * prime, with the 64x32 multiply composed from two 32x32->64 ones
+            __m128i x0 = _mm_xor_si128(_mm_xor_si128(acc0, _mm_srli_epi64(acc0, 47)), _mm_loadu_si128((const __m128i*)&kHashScramble[0]));
+            __m128i x1 = _mm_xor_si128(_mm_xor_si128(acc1, _mm_srli_epi64(acc1, 47)), _mm_loadu_si128((const __m128i*)&kHashScramble[2]));
+            acc0 = _mm_add_epi64(_mm_mul_epu32(x0, prime), _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(x0, 32), prime), 32));
+            acc1 = _mm_add_epi64(_mm_mul_epu32(x1, prime), _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(x1, 32), prime), 32));
+        }
+    }
+
+    _mm_storeu_si128((__m128i*)&acc[0], acc0);
+    _mm_storeu_si128((__m128i*)&acc[2], acc1);
+#elif HASH_NEON
+    uint64x2_t acc0 = vld1q_u64(&acc[0]);
+    uint64x2_t acc1 = vld1q_u64(&acc[2]);
+    uint64x2_t key0 = vld1q_u64(&kHashKey[0]);
+    uint64x2_t key1 = vld1q_u64(&kHashKey[2]);
+    uint32x2_t prime = vdup_n_u32(kHashPrime);
+
+    for (size_t i = 0; i < blocks; ++i, str += 32)
+    {
+        uint64x2_t v0 = vreinterpretq_u64_u8(vld1q_u8((const uint8_t*)str));
+        uint64x2_t v1 = vreinterpretq_u64_u8(vld1q_u8((const uint8_t*)str + 16));
+
+        uint64x2_t k0 = veorq_u64(v0, key0);
+        uint64x2_t k1 = veorq_u64(v1, key1);
+        acc0 = vaddq_u64(acc0, vaddq_u64(vmull_u32(vmovn_u64(k0), vshrn_n_u64(k0, 32)), vextq_u64(v0, v0, 1)));
+        acc1 = vaddq_u64(acc1, vaddq_u64(vmull_u32(vmovn_u64(k1), vshrn_n_u64(k1, 32)), vextq_u64(v1, v1, 1)));
+
+        if (i % HASH_SCRAMBLE_BLOCKS == HASH_SCRAMBLE_BLOCKS - 1)
+        {
+            uint64x2_t x0 = veorq_u64(veorq_u64(acc0, vshrq_n_u64(acc0, 47)), vld1q_u64(&kHashScramble[0]));
+            uint64x2_t x1 = veorq_u64(veorq_u64(acc1, vshrq_n_u64(acc1, 47)), vld1q_u64(&kHashScramble[2]));
+            acc0 = vaddq_u64(vmull_u32(vmovn_u64(x0), prime), vshlq_n_u64(vmull_u32(vshrn_n_u64(x0, 32), prime), 32));
+            acc1 = vaddq_u64(vmull_u32(vmovn_u64(x1), prime), vshlq_n_u64(vmull_u32(vshrn_n_u64(x1, 32), prime), 32));
+        }
+    }
+
+    vst1q_u64(&acc[0], acc0);
+    vst1q_u64(&acc[2], acc1);
+#else
+    for (size_t i = 0; i < blocks; ++i, str += 32)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            uint64_t v;
+            memcpy(&v, str + j * 8, 8);
+
+            uint64_t k = v ^ kHashKey[j];
+            acc[j] += (k & 0xffffffff) * (k >> 32);
+            acc[j ^ 1] += v;
+        }
+
+        if (i % HASH_SCRAMBLE_BLOCKS == HASH_SCRAMBLE_BLOCKS - 1)
+        {
+            for (int j = 0; j < 4; ++j)
+                acc[j] = (acc[j] ^ (acc[j] >> 47) ^ kHashScramble[j]) * kHashPrime;
+        }
+    }
+#endif
+
+    uint64_t h = uint64_t(len) * 0x9e3779b185ebca87ull;
+
+    for (int j = 0; j < 4; ++j)
+        h = (h ^ acc[j]) * 0xc2b2ae3d27d4eb4full;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+
+    unsigned int result = unsigned(h ^ (h >> 32));
+
+    // the tail of less than 32 bytes is mixed in with the Lua 5.1 hash
+    for (size_t i = len % 32; i > 0; --i)
+        result ^= (result << 5) + (result >> 2) + (uint8_t)str[i - 1];
+
+    return result;
+}
+
 unsigned int luaS_hash(const char* str, size_t len)
 {
+    if (len >= HASH_BLOCK_MIN)
+        return hashblocks(str, len);
+
     // Note that this hashing algorithm is replicated in BytecodeBuilder.cpp, BytecodeBuilder::getStringHash
     unsigned int a = 0, b = 0;
     unsigned int h = unsigned(len);
@@ -42,16 +167,11 @@ unsigned int luaS_hash(const char* str, size_t len)
     return h;
 }
 
-void luaS_resize(lua_State* L, int newsize)
+static void rehash(TString** oldhash, int oldsize, TString** newhash, int newsize)
 {
-    TString** newhash = luaM_newarray(L, newsize, TString*, 0);
-    stringtable* tb = &L->global->strt;
-    for (int i = 0; i < newsize; i++)
-        newhash[i] = NULL;
-    // rehash
-    for (int i = 0; i < tb->size; i++)
+    for (int i = 0; i < oldsize; i++)
     {
-        TString* p = tb->hash[i];
+        TString* p = oldhash[i];
         while (p)
         {                            // for each node in the list
             TString* next = p->next; // save next
@@ -63,11 +183,111 @@ void luaS_resize(lua_State* L, int newsize)
             p = next;
         }
     }
+}
+
+// Number of buckets cleared in the new table and moved from the old table for every new string
+// Growth to 2*size buckets starts at size strings and takes size/128 + size/8 new strings, well before the table is crowded again
+#define GROW_CLEAR_STEP 256
+#define GROW_MOVE_STEP 8
+
+static void growstep(lua_State* L, int clearstep, int movestep)
+{
+    stringtable* tb = &L->global->strt;
+
+    if (tb->next)
+    {
+        int end = tb->nextsize - tb->rehashpos > clearstep ? tb->rehashpos + clearstep : tb->nextsize;
+
+        for (int i = tb->rehashpos; i < end; i++)
+            tb->next[i] = NULL;
+
+        tb->rehashpos = end;
+
+        if (end == tb->nextsize)
+        {
+            // new strings go into the new table from now on; lookups check the old table until its buckets are moved
+            tb->old = tb->hash;
+            tb->oldsize = tb->size;
+            tb->hash = tb->next;
+            tb->size = tb->nextsize;
+            tb->next = NULL;
+            tb->nextsize = 0;
+            tb->rehashpos = 0;
+        }
+    }
+    else if (tb->old)
+    {
+        int end = tb->oldsize - tb->rehashpos > movestep ? tb->rehashpos + movestep : tb->oldsize;
+
+        rehash(tb->old + tb->rehashpos, end - tb->rehashpos, tb->hash, tb->size);
+
+        tb->rehashpos = end;
+
+        if (end == tb->oldsize)
+        {
+            luaM_freearray(L, tb->old, tb->oldsize, TString*, 0);
+            tb->old = NULL;
+            tb->oldsize = 0;
+            tb->rehashpos = 0;
+        }
+    }
+}
+
+static void growtable(lua_State* L)
+{
+    stringtable* tb = &L->global->strt;
+
+    if (tb->next || tb->old)
+        growstep(L, GROW_CLEAR_STEP, GROW_MOVE_STEP);
+    else if (tb->nuse > cast_to(uint32_t, tb->size) && tb->size <= INT_MAX / 2)
+    {
+        // too crowded; the new table is cleared in steps so that first touch of its pages is spread out as well
+        tb->next = luaM_newarray(L, tb->size * 2, TString*, 0);
+        tb->nextsize = tb->size * 2;
+        tb->rehashpos = 0;
+    }
+}
+
+void luaS_resize(lua_State* L, int newsize)
+{
+    stringtable* tb = &L->global->strt;
+
+    // finish incremental growth so that all strings are in one table
+    while (tb->next || tb->old)
+        growstep(L, INT_MAX, INT_MAX);
+
+    TString** newhash = luaM_newarray(L, newsize, TString*, 0);
+    for (int i = 0; i < newsize; i++)
+        newhash[i] = NULL;
+    rehash(tb->hash, tb->size, newhash, newsize);
     luaM_freearray(L, tb->hash, tb->size, TString*, 0);
     tb->size = newsize;
     tb->hash = newhash;
 }
 
+static TString* findstr(lua_State* L, const char* str, size_t l, unsigned int h)
+{
+    stringtable* tb = &L->global->strt;
+
+    for (TString* el = tb->hash[lmod(h, tb->size)]; el != NULL; el = el->next)
+    {
+        if (el->len == l && (memcmp(str, getstr(el), l) == 0))
+            return el;
+    }
+
+    // buckets before rehashpos have already been moved to the new table
+    if (tb->old && lmod(h, tb->oldsize) >= tb->rehashpos)
+    {
+        for (TString* el = tb->old[lmod(h, tb->oldsize)]; el != NULL; el = el->next)
+        {
+            if (el->len == l && (memcmp(str, getstr(el), l) == 0))
+                return el;
+        }
+    }
+
+    return NULL;
+}
+
 static TString* newlstr(lua_State* L, const char* str, size_t l, unsigned int h)
 {
     if (l > MAXSSIZE)
@@ -75,6 +295,7 @@ static TString* newlstr(lua_State* L, const char* str, size_t l, unsigned int h)
 
     TString* ts = luaM_newgco(L, TString, sizestring(l), L->activememcat);
     luaC_init(L, ts, LUA_TSTRING);
+    ts->kind = STRING_FLAT;
     ts->atom = ATOM_UNDEF;
     ts->hash = h;
     ts->len = unsigned(l);
@@ -88,8 +309,7 @@ static TString* newlstr(lua_State* L, const char* str, size_t l, unsigned int h)
     tb->hash[h] = ts;
 
     tb->nuse++;
-    if (tb->nuse > cast_to(uint32_t, tb->size) && tb->size <= INT_MAX / 2)
-        luaS_resize(L, tb->size * 2); // too crowded
+    growtable(L);
 
     return ts;
 }
@@ -101,6 +321,7 @@ TString* luaS_bufstart(lua_State* L, size_t size)
 
     TString* ts = luaM_newgco(L, TString, sizestring(size), L->activememcat);
     luaC_init(L, ts, LUA_TSTRING);
+    ts->kind = STRING_FLAT;
     ts->atom = ATOM_UNDEF;
     ts->hash = 0; // computed in luaS_buffinish
     ts->len = unsigned(size);
@@ -117,16 +338,13 @@ TString* luaS_buffinish(lua_State* L, TString* ts)
     int bucket = lmod(h, tb->size);
 
     // search if we already have this string in the hash table
-    for (TString* el = tb->hash[bucket]; el != NULL; el = el->next)
+    if (TString* el = findstr(L, ts->data, ts->len, h))
     {
-        if (el->len == ts->len && memcmp(el->data, ts->data, ts->len) == 0)
-        {
-            // string may be dead
-            if (isdead(L->global, obj2gco(el)))
-                changewhite(obj2gco(el));
+        // string may be dead
+        if (isdead(L->global, obj2gco(el)))
+            changewhite(obj2gco(el));
 
-            return el;
-        }
+        return el;
     }
 
     LUAU_ASSERT(ts->next == NULL);
@@ -138,8 +356,7 @@ TString* luaS_buffinish(lua_State* L, TString* ts)
     tb->hash[bucket] = ts;
 
     tb->nuse++;
-    if (tb->nuse > cast_to(uint32_t, tb->size) && tb->size <= INT_MAX / 2)
-        luaS_resize(L, tb->size * 2); // too crowded
+    growtable(L);
 
     return ts;
 }
@@ -147,19 +364,133 @@ TString* luaS_buffinish(lua_State* L, TString* ts)
 TString* luaS_newlstr(lua_State* L, const char* str, size_t l)
 {
     unsigned int h = luaS_hash(str, l);
-    for (TString* el = L->global->strt.hash[lmod(h, L->global->strt.size)]; el != NULL; el = el->next)
+    if (TString* el = findstr(L, str, l, h))
     {
-        if (el->len == l && (memcmp(str, getstr(el), l) == 0))
-        {
-            // string may be dead
-            if (isdead(L->global, obj2gco(el)))
-                changewhite(obj2gco(el));
-            return el;
-        }
+        // string may be dead
+        if (isdead(L->global, obj2gco(el)))
+            changewhite(obj2gco(el));
+        return el;
     }
     return newlstr(L, str, l, h); // not found
 }
 
+TString* luaS_reserve(lua_State* L, TString* prefix, size_t len)
+{
+    LUAU_ASSERT(prefix->len <= len);
+
+    // a view that ends where the storage contents end can be extended in place if there is enough room left
+    if (prefix->kind == STRING_VIEW && prefix->base->kind == STRING_STORAGE)
+    {
+        TString* storage = prefix->base;
+
+        if (prefix->offset + prefix->len == storage->used && storage->len - storage->used >= len - prefix->len)
+            return storage;
+    }
+
+    // extending a view again is likely, so spare capacity is only reserved once that happened
+    size_t capacity = prefix->kind == STRING_VIEW && len <= MAXSSIZE / 2 ? len * 2 : len;
+
+    TString* storage = luaS_bufstart(L, capacity);
+    storage->kind = STRING_STORAGE;
+    storage->used = prefix->len;
+
+    memcpy(storage->data, getstr(prefix), prefix->len);
+    storage->data[storage->used] = '\0';
+
+    return storage;
+}
+
+static TString* newview(lua_State* L, TString* base, size_t offset, size_t len)
+{
+    TString* ts = luaM_newgco(L, TString, sizestring(0), L->activememcat);
+    luaC_init(L, ts, LUA_TSTRING);
+    ts->kind = STRING_VIEW;
+    ts->atom = ATOM_UNDEF;
+    ts->base = base;
+    ts->offset = unsigned(offset);
+    ts->len = unsigned(len);
+
+    return ts;
+}
+
+TString* luaS_newview(lua_State* L, TString* storage, size_t offset, size_t len)
+{
+    LUAU_ASSERT(storage->kind == STRING_STORAGE && offset + len <= storage->len);
+
+    storage->used = unsigned(offset + len);
+    storage->data[storage->used] = '\0';
+
+    return newview(L, storage, offset, len);
+}
+
+TString* luaS_sub(lua_State* L, TString* ts, size_t offset, size_t len)
+{
+    LUAU_ASSERT(offset + len <= ts->len);
+
+    if (len == ts->len)
+        return ts;
+
+    if (len < LUA_MINSUBVIEW)
+        return luaS_newlstr(L, getstr(ts) + offset, len);
+
+    // views always refer to the string that holds the contents, so that a substring of a substring doesn't keep the middle one alive
+    if (ts->kind == STRING_VIEW)
+    {
+        offset += ts->offset;
+        ts = ts->base;
+    }
+
+    return newview(L, ts, offset, len);
+}
+
+void luaS_unshare(lua_State* L, TString* ts)
+{
+    LUAU_ASSERT(ts->kind == STRING_VIEW);
+
+    TString* storage = luaM_newgco(L, TString, sizestring(ts->len), ts->memcat);
+    luaC_init(L, storage, LUA_TSTRING);
+    storage->memcat = ts->memcat;
+    storage->kind = STRING_STORAGE;
+    storage->atom = ATOM_UNDEF;
+    storage->next = NULL;
+    storage->used = ts->len;
+    storage->len = ts->len;
+
+    memcpy(storage->data, getstr(ts), ts->len);
+    storage->data[storage->used] = '\0';
+
+    ts->base = storage;
+    ts->offset = 0;
+}
+
+TString* luaS_flatten(lua_State* L, TString* ts)
+{
+    if (ts->kind != STRING_VIEW)
+        return ts;
+
+    return luaS_newlstr(L, getstr(ts), ts->len);
+}
+
+int luaS_eqview(const TString* a, const TString* b)
+{
+    return a->len == b->len && memcmp(getstr(a), getstr(b), a->len) == 0;
+}
+
+int luaS_str2d(TString* ts, double* result)
+{
+    if (ts->kind != STRING_VIEW)
+        return luaO_str2d(ts->data, result);
+
+    // contents of a view can be followed by the contents appended after it, so it is terminated for the duration of the call
+    char* end = ts->base->data + ts->offset + ts->len;
+    char saved = *end;
+    *end = '\0';
+    int res = luaO_str2d(ts->base->data + ts->offset, result);
+    *end = saved;
+
+    return res;
+}
+
 static bool unlinkstr(lua_State* L, TString* ts)
 {
     global_State* g = L->global;
@@ -179,11 +510,38 @@ static bool unlinkstr(lua_State* L, TString* ts)
         }
     }
 
+    // the string may still be in the old table during incremental growth; buckets before rehashpos have been moved, but they
+    // still point to the strings that were in them
+    if (g->strt.old && lmod(ts->hash, g->strt.oldsize) >= g->strt.rehashpos)
+    {
+        p = &g->strt.old[lmod(ts->hash, g->strt.oldsize)];
+
+        while (TString* curr = *p)
+        {
+            if (curr == ts)
+            {
+                *p = curr->next;
+                return true;
+            }
+            else
+            {
+                p = &curr->next;
+            }
+        }
+    }
+
     return false;
 }
 
 void luaS_free(lua_State* L, TString* ts, lua_Page* page)
 {
+    if (ts->kind != STRING_FLAT)
+    {
+        // views and storage strings are not interned; a storage string is only freed along with or after its last view
+        luaM_freegco(L, ts, sizestringobj(ts), ts->memcat, page);
+        return;
+    }
+
     if (unlinkstr(L, ts))
         L->global->strt.nuse--;
     else
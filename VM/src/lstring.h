@@ -13,6 +13,12 @@
 
 #define sizestring(len) (offsetof(TString, data) + len + 1)
 
+// views only hold the header, their contents live in the storage string
+#define sizestringobj(ts) ((ts)->kind == STRING_VIEW ? sizestring(0) : sizestring((ts)->len))
+
+// interned strings are equal only if they are the same object, views have to compare contents
+#define luaS_eqstr(a, b) ((a) == (b) || (((a)->kind == STRING_VIEW || (b)->kind == STRING_VIEW) && luaS_eqview(a, b)))
+
 #define luaS_new(L, s) (luaS_newlstr(L, s, strlen(s)))
 #define luaS_newliteral(L, s) (luaS_newlstr(L, "" s, (sizeof(s) / sizeof(char)) - 1))
 
@@ -27,3 +33,11 @@ LUAI_FUNC void luaS_free(lua_State* L, TString* ts, struct lua_Page* page);
 
 LUAI_FUNC TString* luaS_bufstart(lua_State* L, size_t size);
 LUAI_FUNC TString* luaS_buffinish(lua_State* L, TString* ts);
+
+LUAI_FUNC TString* luaS_reserve(lua_State* L, TString* prefix, size_t len);
+LUAI_FUNC TString* luaS_newview(lua_State* L, TString* storage, size_t offset, size_t len);
+LUAI_FUNC TString* luaS_sub(lua_State* L, TString* ts, size_t offset, size_t len);
+LUAI_FUNC void luaS_unshare(lua_State* L, TString* ts);
+LUAI_FUNC TString* luaS_flatten(lua_State* L, TString* ts);
+LUAI_FUNC int luaS_eqview(const TString* a, const TString* b);
+LUAI_FUNC int luaS_str2d(TString* ts, double* result);
@@ -3,6 +3,8 @@
 #include "lualib.h"
 
 #include "lstring.h"
+#include "ldebug.h"
+#include "lnumutils.h"
 
 #include <ctype.h>
 #include <string.h>
@@ -13,10 +15,378 @@ LUAU_DYNAMIC_FASTFLAGVARIABLE(LuauStringFormatFixC, false)
 // macro to `unsign' a character
 #define uchar(c) ((unsigned char)(c))
 
+/*
+** {======================================================
+** VECTORIZED KERNELS
+** =======================================================
+*/
+
+// Plain substring search, case mapping and reversal have SSE2 variants on x64, with AVX2 ones selected at startup when the CPU
+// supports them, and NEON variants on ARM64; all of them produce the same results as the scalar code
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STR_SSE2 1
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64)
+#define STR_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if STR_SSE2 && defined(__AVX2__)
+#define STR_AVX2 1
+#define STR_TARGET_AVX2
+#elif STR_SSE2 && defined(LUAU_TARGET_AVX2)
+#define STR_AVX2 1
+#define STR_TARGET_AVX2 LUAU_TARGET_AVX2
+#endif
+
+#if STR_AVX2
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#elif STR_AVX2
+#include <cpuid.h>
+#endif
+
+struct StringKernels
+{
+    const char* (*find)(const char* s, size_t ls, const char* p, size_t lp); // requires 0 < lp <= ls
+    void (*lower)(char* dst, const char* src, size_t l);
+    void (*upper)(char* dst, const char* src, size_t l);
+    void (*reverse)(char* dst, const char* src, size_t l);
+};
+
+static const char* findscalar(const char* s1, size_t l1, const char* s2, size_t l2)
+{
+    const char* init; // to search for a `*s2' inside `s1'
+    l2--;             // 1st char will be checked by `memchr'
+    l1 = l1 - l2;     // `s2' cannot be found after that
+    while (l1 > 0 && (init = (const char*)memchr(s1, *s2, l1)) != NULL)
+    {
+        init++; // 1st char is already checked
+        if (memcmp(init, s2 + 1, l2) == 0)
+            return init - 1;
+        else
+        { // correct `l1' and `s1' to try again
+            l1 -= init - s1;
+            s1 = init;
+        }
+    }
+    return NULL; // not found
+}
+
+template<bool Upper>
+static void casemapscalar(char* dst, const char* src, size_t l)
+{
+    for (size_t i = 0; i < l; i++)
+        dst[i] = char(Upper ? toupper(uchar(src[i])) : tolower(uchar(src[i])));
+}
+
+static void reversescalar(char* dst, const char* src, size_t l)
+{
+    for (size_t i = 0; i < l; i++)
+        dst[i] = src[l - 1 - i];
+}
+
+// Substring search compares the first and the last byte of the needle at a block of positions at once, and only verifies
+// the candidates that match both with memcmp
+// Case mapping handles ASCII letters in vector registers; blocks with bytes above 0x7f are left to the C library, which knows
+// the current locale
+#if STR_SSE2
+static int countrz(uint32_t n)
+{
+#ifdef _MSC_VER
+    unsigned long rl;
+    _BitScanForward(&rl, n);
+    return int(rl);
+#else
+    return __builtin_ctz(n);
+#endif
+}
+
+static const char* findsse2(const char* s, size_t ls, const char* p, size_t lp)
+{
+    const __m128i first = _mm_set1_epi8(p[0]);
+    const __m128i last = _mm_set1_epi8(p[lp - 1]);
+    size_t i = 0;
+
+    for (; i + lp - 1 + 16 <= ls; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(s + i + lp - 1));
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+
+        for (; mask; mask &= mask - 1)
+        {
+            size_t k = i + countrz(mask);
+            if (memcmp(s + k + 1, p + 1, lp - 1) == 0)
+                return s + k;
+        }
+    }
+
+    return findscalar(s + i, ls - i, p, lp);
+}
+
+template<bool Upper>
+static void casemapsse2(char* dst, const char* src, size_t l)
+{
+    // signed comparisons exclude bytes above 0x7f
+    const __m128i lo = _mm_set1_epi8(Upper ? 'a' - 1 : 'A' - 1);
+    const __m128i hi = _mm_set1_epi8(Upper ? 'z' + 1 : 'Z' + 1);
+    const __m128i bit = _mm_set1_epi8(0x20);
+    size_t i = 0;
+
+    for (; i + 16 <= l; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+
+        if (_mm_movemask_epi8(v))
+        {
+            casemapscalar<Upper>(dst + i, src + i, 16);
+            continue;
+        }
+
+        __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(v, _mm_and_si128(letters, bit)));
+    }
+
+    casemapscalar<Upper>(dst + i, src + i, l - i);
+}
+
+static void reversesse2(char* dst, const char* src, size_t l)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= l; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + l - i - 16));
+
+        // SSE2 has no byte shuffle: swap bytes in 16-bit words, then reverse the words
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        v = _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+
+    reversescalar(dst + i, src, l - i);
+}
+
+static const StringKernels kernelssse2 = {findsse2, casemapsse2<false>, casemapsse2<true>, reversesse2};
+#endif
+
+#if STR_AVX2
+STR_TARGET_AVX2 static const char* findavx2(const char* s, size_t ls, const char* p, size_t lp)
+{
+    const __m256i first = _mm256_set1_epi8(p[0]);
+    const __m256i last = _mm256_set1_epi8(p[lp - 1]);
+    size_t i = 0;
+
+    for (; i + lp - 1 + 32 <= ls; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(s + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(s + i + lp - 1));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+
+        for (; mask; mask &= mask - 1)
+        {
+            size_t k = i + countrz(mask);
+            if (memcmp(s + k + 1, p + 1, lp - 1) == 0)
+                return s + k;
+        }
+    }
+
+    return findsse2(s + i, ls - i, p, lp);
+}
+
+template<bool Upper>
+STR_TARGET_AVX2 static void casemapavx2(char* dst, const char* src, size_t l)
+{
+    const __m256i lo = _mm256_set1_epi8(Upper ? 'a' - 1 : 'A' - 1);
+    const __m256i hi = _mm256_set1_epi8(Upper ? 'z' + 1 : 'Z' + 1);
+    const __m256i bit = _mm256_set1_epi8(0x20);
+    size_t i = 0;
+
+    for (; i + 32 <= l; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+
+        if (_mm256_movemask_epi8(v))
+        {
+            casemapscalar<Upper>(dst + i, src + i, 32);
+            continue;
+        }
+
+        __m256i letters = _mm256_and_si256(_mm256_cmpgt_epi8(v, lo), _mm256_cmpgt_epi8(hi, v));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(v, _mm256_and_si256(letters, bit)));
+    }
+
+    casemapsse2<Upper>(dst + i, src + i, l - i);
+}
+
+STR_TARGET_AVX2 static void reverseavx2(char* dst, const char* src, size_t l)
+{
+    const __m256i mask = _mm256_setr_epi8(
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+    );
+    size_t i = 0;
+
+    for (; i + 32 <= l; i += 32)
+    {
+        // reverse the bytes of each 128-bit lane, then swap the lanes
+        __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + l - i - 32)), mask);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute2x128_si256(v, v, 1));
+    }
+
+    reversesse2(dst + i, src, l - i);
+}
+
+static const StringKernels kernelsavx2 = {findavx2, casemapavx2<false>, casemapavx2<true>, reverseavx2};
+
+static bool luau_hasavx2()
+{
+#ifdef __AVX2__
+    return true;
+#else
+    int cpuinfo[4] = {};
+#ifdef _MSC_VER
+    __cpuid(cpuinfo, 1);
+#else
+    __cpuid(1, cpuinfo[0], cpuinfo[1], cpuinfo[2], cpuinfo[3]);
+#endif
+
+    // The OS has to save YMM registers: OSXSAVE is ECX bit 27 and XCR0 has to enable SSE and AVX state
+    if ((cpuinfo[2] & (1 << 27)) == 0)
+        return false;
+
+#ifdef _MSC_VER
+    uint64_t xcr0 = _xgetbv(0);
+#else
+    uint32_t xcr0lo, xcr0hi;
+    __asm__("xgetbv" : "=a"(xcr0lo), "=d"(xcr0hi) : "c"(0));
+    uint64_t xcr0 = xcr0lo | (uint64_t(xcr0hi) << 32);
+#endif
+
+    if ((xcr0 & 6) != 6)
+        return false;
+
+#ifdef _MSC_VER
+    __cpuidex(cpuinfo, 7, 0);
+#else
+    __cpuid_count(7, 0, cpuinfo[0], cpuinfo[1], cpuinfo[2], cpuinfo[3]);
+#endif
+
+    // https://en.wikipedia.org/wiki/CPUID#EAX=7,_ECX=0:_Extended_Features
+    return (cpuinfo[1] & (1 << 5)) != 0;
+#endif
+}
+#endif
+
+#if STR_NEON
+static int countrz(uint64_t n)
+{
+#ifdef _MSC_VER
+    unsigned long rl;
+    _BitScanForward64(&rl, n);
+    return int(rl);
+#else
+    return __builtin_ctzll(n);
+#endif
+}
+
+static const char* findneon(const char* s, size_t ls, const char* p, size_t lp)
+{
+    const uint8x16_t first = vdupq_n_u8(uchar(p[0]));
+    const uint8x16_t last = vdupq_n_u8(uchar(p[lp - 1]));
+    size_t i = 0;
+
+    for (; i + lp - 1 + 16 <= ls; i += 16)
+    {
+        uint8x16_t a = vld1q_u8((const uint8_t*)s + i);
+        uint8x16_t b = vld1q_u8((const uint8_t*)s + i + lp - 1);
+        uint8x16_t eq = vandq_u8(vceqq_u8(a, first), vceqq_u8(b, last));
+
+        // NEON has no movemask: narrowing shift leaves 4 bits for every byte
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+
+        for (; mask; mask &= ~(uint64_t(15) << (countrz(mask) & ~3)))
+        {
+            size_t k = i + countrz(mask) / 4;
+            if (memcmp(s + k + 1, p + 1, lp - 1) == 0)
+                return s + k;
+        }
+    }
+
+    return findscalar(s + i, ls - i, p, lp);
+}
+
+template<bool Upper>
+static void casemapneon(char* dst, const char* src, size_t l)
+{
+    const uint8x16_t lo = vdupq_n_u8(Upper ? 'a' : 'A');
+    const uint8x16_t hi = vdupq_n_u8(Upper ? 'z' : 'Z');
+    const uint8x16_t bit = vdupq_n_u8(0x20);
+    size_t i = 0;
+
+    for (; i + 16 <= l; i += 16)
+    {
+        uint8x16_t v = vld1q_u8((const uint8_t*)src + i);
+
+        if (vmaxvq_u8(v) > 0x7f)
+        {
+            casemapscalar<Upper>(dst + i, src + i, 16);
+            continue;
+        }
+
+        uint8x16_t letters = vandq_u8(vcgeq_u8(v, lo), vcleq_u8(v, hi));
+        vst1q_u8((uint8_t*)dst + i, veorq_u8(v, vandq_u8(letters, bit)));
+    }
+
+    casemapscalar<Upper>(dst + i, src + i, l - i);
+}
+
+static void reverseneon(char* dst, const char* src, size_t l)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= l; i += 16)
+    {
+        uint8x16_t v = vrev64q_u8(vld1q_u8((const uint8_t*)src + l - i - 16));
+        vst1q_u8((uint8_t*)dst + i, vextq_u8(v, v, 8));
+    }
+
+    reversescalar(dst + i, src, l - i);
+}
+#endif
+
+static const StringKernels stringkernels =
+#if STR_AVX2
+    luau_hasavx2() ? kernelsavx2 : kernelssse2;
+#elif STR_SSE2
+    kernelssse2;
+#elif STR_NEON
+    {findneon, casemapneon<false>, casemapneon<true>, reverseneon};
+#else
+    {findscalar, casemapscalar<false>, casemapscalar<true>, reversescalar};
+#endif
+
+// }======================================================
+
+// like luaL_checklstring, but substrings are read in place instead of being interned, so the contents aren't necessarily terminated
+static const char* checkstringview(lua_State* L, int arg, size_t* len)
+{
+    const char* s = lua_tolstringview(L, arg, len);
+    if (!s)
+        luaL_typeerror(L, arg, "string");
+    return s;
+}
+
 static int str_len(lua_State* L)
 {
     size_t l;
-    luaL_checklstring(L, 1, &l);
+    checkstringview(L, 1, &l);
     lua_pushinteger(L, (int)l);
     return 1;
 }
@@ -32,7 +402,7 @@ static int posrelat(int pos, size_t len)
 static int str_sub(lua_State* L)
 {
     size_t l;
-    const char* s = luaL_checklstring(L, 1, &l);
+    checkstringview(L, 1, &l);
     int start = posrelat(luaL_checkinteger(L, 2), l);
     int end = posrelat(luaL_optinteger(L, 3, -1), l);
     if (start < 1)
@@ -40,7 +410,7 @@ static int str_sub(lua_State* L)
     if (end > (int)l)
         end = (int)l;
     if (start <= end)
-        lua_pushlstring(L, s + start - 1, end - start + 1);
+        lua_pushsubstring(L, 1, start - 1, end - start + 1);
     else
         lua_pushliteral(L, "");
     return 1;
@@ -49,23 +419,21 @@ static int str_sub(lua_State* L)
 static int str_reverse(lua_State* L)
 {
     size_t l;
-    const char* s = luaL_checklstring(L, 1, &l);
+    const char* s = checkstringview(L, 1, &l);
     luaL_Strbuf b;
     char* ptr = luaL_buffinitsize(L, &b, l);
-    while (l--)
-        *ptr++ = s[l];
-    luaL_pushresultsize(&b, ptr - b.p);
+    stringkernels.reverse(ptr, s, l);
+    luaL_pushresultsize(&b, l);
     return 1;
 }
 
 static int str_lower(lua_State* L)
 {
     size_t l;
-    const char* s = luaL_checklstring(L, 1, &l);
+    const char* s = checkstringview(L, 1, &l);
     luaL_Strbuf b;
     char* ptr = luaL_buffinitsize(L, &b, l);
-    for (size_t i = 0; i < l; i++)
-        *ptr++ = tolower(uchar(s[i]));
+    stringkernels.lower(ptr, s, l);
     luaL_pushresultsize(&b, l);
     return 1;
 }
@@ -73,11 +441,10 @@ static int str_lower(lua_State* L)
 static int str_upper(lua_State* L)
 {
     size_t l;
-    const char* s = luaL_checklstring(L, 1, &l);
+    const char* s = checkstringview(L, 1, &l);
     luaL_Strbuf b;
     char* ptr = luaL_buffinitsize(L, &b, l);
-    for (size_t i = 0; i < l; i++)
-        *ptr++ = toupper(uchar(s[i]));
+    stringkernels.upper(ptr, s, l);
     luaL_pushresultsize(&b, l);
     return 1;
 }
@@ -85,7 +452,7 @@ static int str_upper(lua_State* L)
 static int str_rep(lua_State* L)
 {
     size_t l;
-    const char* s = luaL_checklstring(L, 1, &l);
+    const char* s = checkstringview(L, 1, &l);
     int n = luaL_checkinteger(L, 2);
 
     if (n <= 0)
@@ -130,7 +497,7 @@ static int str_rep(lua_State* L)
 static int str_byte(lua_State* L)
 {
     size_t l;
-    const char* s = luaL_checklstring(L, 1, &l);
+    const char* s = checkstringview(L, 1, &l);
     int posi = posrelat(luaL_optinteger(L, 2, 1), l);
     int pose = posrelat(luaL_optinteger(L, 3, posi), l);
     int n, i;
@@ -176,12 +543,92 @@ static int str_char(lua_State* L)
 #define CAP_UNFINISHED (-1)
 #define CAP_POSITION (-2)
 
+#define L_ESC '%'
+#define SPECIALS "^$*+?.([%-"
+
+// patterns are compiled into a sequence of operations, with every single character class expanded into a set
+enum PatternOpKind
+{
+    PAT_CHAR,     // single character class with an optional '*', '+', '-' or '?' suffix
+    PAT_OPEN,     // '('
+    PAT_POSITION, // '()'
+    PAT_CLOSE,    // ')'
+    PAT_END,      // '$' at the end of the pattern
+    PAT_BALANCE,  // '%bxy'
+    PAT_FRONTIER, // '%f[set]'
+    PAT_BACKREF,  // '%0'-'%9'
+    PAT_ERROR,    // malformed rest of the pattern, reported once the matcher reaches it
+};
+
+struct PatternOp
+{
+    uint8_t kind;
+    char rep;        // suffix of PAT_CHAR, 0 when there is none
+    char arg[2];     // delimiters of PAT_BALANCE, capture index of PAT_BACKREF, message of PAT_ERROR
+    uint32_t set[8]; // characters of PAT_CHAR and PAT_FRONTIER
+};
+
+#define insetpat(set, c) (((set)[(c) >> 5] >> ((c)&31)) & 1)
+
+static const char* const patternerrors[] = {
+    "malformed pattern (ends with '%')",
+    "malformed pattern (missing ']')",
+    "malformed pattern (missing arguments to '%b')",
+    "missing '[' after '%f' in pattern",
+};
+
+// patterns made of single character classes and an optional final '$' are matched by lazily built automata
+#define PATTERN_DFAITEMS 63  // maximum number of items, with each '+' counted twice
+#define PATTERN_DFASTATES 64 // number of cached states in each direction; all of them are discarded when it runs out
+
+#define DFA_MATCH 1    // a match ends before the next character
+#define DFA_EOFMATCH 2 // a match ends here if this is the end of the string
+#define DFA_STARTS 4   // matches can still start at the next character
+#define DFA_DEAD 8     // no further matches are possible
+
+struct PatternItem
+{
+    uint8_t op;
+    char rep; // 0, '*', '-' or '?'; 'x+' is expanded into 'x' followed by 'x*'
+};
+
+struct PatternDfa
+{
+    int16_t* next;     // nclasses transitions for each state, -1 when it has not been built yet
+    uint8_t* threads;  // nitems + 1 item positions for each state, in the order of preference
+    uint8_t* nthreads; // number of item positions for each state
+    uint8_t* flags;    // DFA_* flags for each state
+    int count;
+    int start[2]; // initial state for unanchored and anchored searches, -1 when it has not been built yet
+};
+
+struct Pattern
+{
+    uint64_t lastuse; // cache clock at the last lookup of the pattern
+    bool anchor;      // pattern starts with '^'
+    bool dfa;         // pattern is matched by the automata
+    bool endanchor;   // pattern ends with '$'
+
+    int nops;
+    int nitems;
+    int nclasses;
+
+    PatternOp* ops;
+    PatternItem* items;
+
+    PatternDfa forward; // finds the end of the match that the backtracking matcher would find first
+    PatternDfa reverse; // finds the start of that match from its end
+
+    uint8_t classmap[256]; // characters that belong to the same sets share a class
+    uint8_t classrep[256]; // first character of each class
+};
+
 typedef struct MatchState
 {
-    int matchdepth;       // control for recursive depth (to avoid C stack overflow)
-    const char* src_init; // init of source string
-    const char* src_end;  // end ('\0') of source string
-    const char* p_end;    // end ('\0') of pattern
+    int matchdepth;          // control for recursive depth (to avoid C stack overflow)
+    const char* src_init;    // init of source string
+    const char* src_end;     // end ('\0') of source string
+    const PatternOp* op_end; // end of compiled pattern
     lua_State* L;
     int level; // total number of captures (finished or unfinished)
     struct
@@ -192,10 +639,7 @@ typedef struct MatchState
 } MatchState;
 
 // recursive function
-static const char* match(MatchState* ms, const char* s, const char* p);
-
-#define L_ESC '%'
-#define SPECIALS "^$*+?.([%-"
+static const char* match(MatchState* ms, const char* s, const PatternOp* op);
 
 static int check_capture(MatchState* ms, int l)
 {
@@ -214,14 +658,15 @@ static int capture_to_close(MatchState* ms)
     luaL_error(ms->L, "invalid pattern capture");
 }
 
-static const char* classend(MatchState* ms, const char* p)
+// returns the end of the single character class at p, or NULL if it is malformed
+static const char* classend(const char* p, const char* p_end)
 {
     switch (*p++)
     {
     case L_ESC:
     {
-        if (p == ms->p_end)
-            luaL_error(ms->L, "malformed pattern (ends with '%%')");
+        if (p == p_end)
+            return NULL;
         return p + 1;
     }
     case '[':
@@ -230,9 +675,9 @@ static const char* classend(MatchState* ms, const char* p)
             p++;
         do
         { // look for a `]'
-            if (p == ms->p_end)
-                luaL_error(ms->L, "malformed pattern (missing ']')");
-            if (*(p++) == L_ESC && p < ms->p_end)
+            if (p == p_end)
+                return NULL;
+            if (*(p++) == L_ESC && p < p_end)
                 p++; // skip escapes (e.g. `%]')
         } while (*p != ']');
         return p + 1;
@@ -316,37 +761,545 @@ static int matchbracketclass(int c, const char* p, const char* ec)
     return !sig;
 }
 
-static int singlematch(MatchState* ms, const char* s, const char* p, const char* ep)
+// expands the single character class between p and ep into a set
+static void compileset(uint32_t* set, const char* p, const char* ep)
 {
-    if (s >= ms->src_end)
-        return 0;
-    else
+    memset(set, 0, 8 * sizeof(uint32_t));
+
+    for (int c = 0; c < 256; c++)
     {
-        int c = uchar(*s);
+        int res;
         switch (*p)
         {
         case '.':
-            return 1; // matches any char
+            res = 1; // matches any char
+            break;
         case L_ESC:
-            return match_class(c, uchar(*(p + 1)));
+            res = match_class(c, uchar(*(p + 1)));
+            break;
         case '[':
-            return matchbracketclass(c, p, ep - 1);
+            res = matchbracketclass(c, p, ep - 1);
+            break;
         default:
-            return (uchar(*p) == c);
+            res = (uchar(*p) == c);
         }
+
+        if (res)
+            set[c >> 5] |= 1u << (c & 31);
     }
 }
 
-static const char* matchbalance(MatchState* ms, const char* s, const char* p)
+struct PatternInfo
 {
-    if (p >= ms->p_end - 1)
-        luaL_error(ms->L, "malformed pattern (missing arguments to '%%b')");
-    if (*s != *p)
+    int nops;
+    int nitems;
+    bool simple;        // pattern only has single character classes and a final '$'
+    uint64_t sigs[256]; // sets of the first 64 ops that each character belongs to
+};
+
+// translates the pattern into ops; the first pass only collects info, the second one stores the ops
+static void compilepattern(const char* p, const char* p_end, PatternOp* ops, PatternInfo* info)
+{
+    int n = 0;
+
+    if (info)
+    {
+        info->nitems = 0;
+        info->simple = true;
+        memset(info->sigs, 0, sizeof(info->sigs));
+    }
+
+    while (p < p_end)
+    {
+        PatternOp op = {};
+        int error = -1;
+
+        switch (*p)
+        {
+        case '(':
+        {
+            if (*(p + 1) == ')') // position capture?
+            {
+                op.kind = PAT_POSITION;
+                p += 2;
+            }
+            else
+            {
+                op.kind = PAT_OPEN;
+                p++;
+            }
+            break;
+        }
+        case ')':
+        {
+            op.kind = PAT_CLOSE;
+            p++;
+            break;
+        }
+        case '$':
+        {
+            if ((p + 1) != p_end) // is the `$' the last char in pattern?
+                goto dflt;        // no; go to default
+            op.kind = PAT_END;
+            p++;
+            break;
+        }
+        case L_ESC:
+        {
+            switch (*(p + 1))
+            {
+            case 'b':
+            {
+                if (p + 2 >= p_end - 1)
+                {
+                    error = 2;
+                    break;
+                }
+                op.kind = PAT_BALANCE;
+                op.arg[0] = p[2];
+                op.arg[1] = p[3];
+                p += 4;
+                break;
+            }
+            case 'f':
+            {
+                p += 2;
+                if (*p != '[')
+                {
+                    error = 3;
+                    break;
+                }
+                const char* ep = classend(p, p_end);
+                if (!ep)
+                {
+                    error = 1;
+                    break;
+                }
+                op.kind = PAT_FRONTIER;
+                compileset(op.set, p, ep);
+                p = ep;
+                break;
+            }
+            case '0':
+            case '1':
+            case '2':
+            case '3':
+            case '4':
+            case '5':
+            case '6':
+            case '7':
+            case '8':
+            case '9':
+            {
+                op.kind = PAT_BACKREF;
+                op.arg[0] = p[1];
+                p += 2;
+                break;
+            }
+            default:
+                goto dflt;
+            }
+            break;
+        }
+        default:
+        dflt:
+        {
+            const char* ep = classend(p, p_end);
+            if (!ep)
+            {
+                error = (*p == L_ESC) ? 0 : 1;
+                break;
+            }
+            op.kind = PAT_CHAR;
+            compileset(op.set, p, ep);
+            if (ep < p_end && (*ep == '*' || *ep == '+' || *ep == '-' || *ep == '?'))
+                op.rep = *ep++;
+            p = ep;
+            break;
+        }
+        }
+
+        if (error >= 0)
+        {
+            op.kind = PAT_ERROR;
+            op.arg[0] = char(error);
+            p = p_end;
+        }
+
+        if (info)
+        {
+            if (op.kind == PAT_CHAR)
+            {
+                if (n < 64)
+                    for (int c = 0; c < 256; c++)
+                        if (insetpat(op.set, c))
+                            info->sigs[c] |= 1ull << n;
+
+                info->nitems += (op.rep == '+') ? 2 : 1;
+            }
+            else if (op.kind != PAT_END)
+                info->simple = false;
+        }
+
+        if (ops)
+            ops[n] = op;
+        n++;
+    }
+
+    if (info)
+        info->nops = n;
+}
+
+static Pattern* newpattern(lua_State* L, const char* p, size_t lp, bool anchor)
+{
+    anchor = anchor && *p == '^';
+    if (anchor)
+    {
+        p++;
+        lp--; // skip anchor character
+    }
+
+    PatternInfo info;
+    compilepattern(p, p + lp, NULL, &info);
+
+    bool dfa = info.simple && info.nitems <= PATTERN_DFAITEMS;
+
+    // characters that belong to the same sets can't be told apart by the automata
+    uint8_t classmap[256];
+    uint8_t classrep[256];
+    int nclasses = 0;
+
+    if (dfa)
+    {
+        for (int c = 0; c < 256; c++)
+        {
+            int k = 0;
+            while (k < nclasses && info.sigs[classrep[k]] != info.sigs[c])
+                k++;
+
+            if (k == nclasses)
+                classrep[nclasses++] = uint8_t(c);
+
+            classmap[c] = uint8_t(k);
+        }
+    }
+
+    size_t dfasize = PATTERN_DFASTATES * (nclasses * sizeof(int16_t) + (info.nitems + 1) + 2);
+    size_t size = sizeof(Pattern) + info.nops * sizeof(PatternOp) + (dfa ? info.nitems * sizeof(PatternItem) + 2 * dfasize : 0);
+
+    Pattern* pat = (Pattern*)lua_newuserdata(L, size);
+    char* data = (char*)(pat + 1);
+
+    pat->lastuse = 0;
+    pat->anchor = anchor;
+    pat->dfa = dfa;
+    pat->endanchor = false;
+    pat->nops = info.nops;
+    pat->nitems = dfa ? info.nitems : 0;
+    pat->nclasses = nclasses;
+
+    pat->ops = (PatternOp*)data;
+    data += info.nops * sizeof(PatternOp);
+
+    compilepattern(p, p + lp, pat->ops, NULL);
+
+    if (dfa)
+    {
+        PatternDfa* dfas[] = {&pat->forward, &pat->reverse};
+
+        for (PatternDfa* d : dfas)
+        {
+            d->next = (int16_t*)data;
+            data += PATTERN_DFASTATES * nclasses * sizeof(int16_t);
+        }
+
+        pat->items = (PatternItem*)data;
+        data += info.nitems * sizeof(PatternItem);
+
+        for (PatternDfa* d : dfas)
+        {
+            d->threads = (uint8_t*)data;
+            data += PATTERN_DFASTATES * (info.nitems + 1);
+            d->nthreads = (uint8_t*)data;
+            data += PATTERN_DFASTATES;
+            d->flags = (uint8_t*)data;
+            data += PATTERN_DFASTATES;
+
+            d->count = 0;
+            d->start[0] = d->start[1] = -1;
+        }
+
+        int nitems = 0;
+
+        for (int i = 0; i < pat->nops; i++)
+        {
+            const PatternOp* op = &pat->ops[i];
+
+            if (op->kind == PAT_END)
+            {
+                pat->endanchor = true;
+                continue;
+            }
+
+            pat->items[nitems].op = uint8_t(i);
+            pat->items[nitems].rep = (op->rep == '+') ? 0 : op->rep;
+            nitems++;
+
+            if (op->rep == '+')
+            {
+                pat->items[nitems].op = uint8_t(i);
+                pat->items[nitems].rep = '*';
+                nitems++;
+            }
+        }
+
+        LUAU_ASSERT(nitems == pat->nitems);
+
+        memcpy(pat->classmap, classmap, sizeof(classmap));
+        memcpy(pat->classrep, classrep, nclasses);
+    }
+    else
+    {
+        pat->items = NULL;
+    }
+
+    LUAU_ASSERT(data == (char*)(pat + 1) + size - sizeof(Pattern));
+    return pat;
+}
+
+// set of item positions reached after a character; in leftmost mode the positions that the backtracking matcher would only
+// try after a match are dropped
+struct DfaThreads
+{
+    uint8_t pc[PATTERN_DFAITEMS + 1];
+    int count;
+    uint64_t visited;
+    bool cut;
+};
+
+// adds the item position and everything reachable from it without consuming a character, in the order of preference
+static void dfafollow(const Pattern* pat, DfaThreads* t, int pc, bool forward, bool leftmost)
+{
+    if (t->cut || (t->visited & (1ull << pc)))
+        return;
+
+    t->visited |= 1ull << pc;
+
+    if (pc == pat->nitems)
+    {
+        t->pc[t->count++] = uint8_t(pc);
+        t->cut = leftmost;
+        return;
+    }
+
+    char rep = pat->items[forward ? pc : pat->nitems - 1 - pc].rep;
+
+    if (rep == '-')
+    {
+        // the shortest expansion is tried first
+        dfafollow(pat, t, pc + 1, forward, leftmost);
+
+        if (!t->cut)
+            t->pc[t->count++] = uint8_t(pc);
+    }
+    else
+    {
+        t->pc[t->count++] = uint8_t(pc);
+
+        if (rep == '*' || rep == '?')
+            dfafollow(pat, t, pc + 1, forward, leftmost);
+    }
+}
+
+static int dfastate(Pattern* pat, PatternDfa* dfa, const uint8_t* threads, int count, int flags)
+{
+    int stride = pat->nitems + 1;
+
+    for (int i = 0; i < dfa->count; i++)
+        if (dfa->flags[i] == flags && dfa->nthreads[i] == count && memcmp(dfa->threads + i * stride, threads, count) == 0)
+            return i;
+
+    if (dfa->count == PATTERN_DFASTATES)
+    {
+        // the states that are still needed will be rebuilt on demand
+        dfa->count = 0;
+        dfa->start[0] = dfa->start[1] = -1;
+    }
+
+    int i = dfa->count++;
+
+    memcpy(dfa->threads + i * stride, threads, count);
+    dfa->nthreads[i] = uint8_t(count);
+    dfa->flags[i] = uint8_t(flags);
+
+    for (int k = 0; k < pat->nclasses; k++)
+        dfa->next[i * pat->nclasses + k] = -1;
+
+    return i;
+}
+
+static int dfaadd(Pattern* pat, PatternDfa* dfa, DfaThreads* t, bool forward, bool starts)
+{
+    bool accepts = (t->visited >> pat->nitems) & 1;
+    bool consumes = false;
+    int flags = 0;
+
+    for (int i = 0; i < t->count; i++)
+        consumes |= t->pc[i] < pat->nitems;
+
+    if (accepts)
+        flags |= (forward && pat->endanchor) ? DFA_EOFMATCH : DFA_MATCH;
+
+    if (starts && !t->cut)
+        flags |= DFA_STARTS;
+
+    if (!consumes && !(flags & DFA_STARTS))
+        flags |= DFA_DEAD;
+
+    // the reverse automaton only looks for the longest match, so the order of item positions doesn't matter
+    if (!forward)
+    {
+        for (int i = 1; i < t->count; i++)
+            for (int j = i; j > 0 && t->pc[j - 1] > t->pc[j]; j--)
+            {
+                uint8_t pc = t->pc[j];
+                t->pc[j] = t->pc[j - 1];
+                t->pc[j - 1] = pc;
+            }
+    }
+
+    return dfastate(pat, dfa, t->pc, t->count, flags);
+}
+
+static int dfastart(Pattern* pat, PatternDfa* dfa, bool forward, bool anchored)
+{
+    if (dfa->start[anchored] < 0)
+    {
+        DfaThreads t;
+        t.count = 0;
+        t.visited = 0;
+        t.cut = false;
+
+        dfafollow(pat, &t, 0, forward, forward && !pat->endanchor);
+
+        int state = dfaadd(pat, dfa, &t, forward, forward && !anchored);
+        dfa->start[anchored] = state;
+    }
+
+    return dfa->start[anchored];
+}
+
+static int dfanext(Pattern* pat, PatternDfa* dfa, bool forward, int state, int cls)
+{
+    int next = dfa->next[state * pat->nclasses + cls];
+    if (next >= 0)
+        return next;
+
+    int c = pat->classrep[cls];
+    int flags = dfa->flags[state];
+    bool leftmost = forward && !pat->endanchor;
+    const uint8_t* threads = dfa->threads + state * (pat->nitems + 1);
+
+    DfaThreads t;
+    t.count = 0;
+    t.visited = 0;
+    t.cut = false;
+
+    for (int i = 0; i < dfa->nthreads[state]; i++)
+    {
+        int pc = threads[i];
+        if (pc == pat->nitems)
+            continue;
+
+        const PatternItem* item = &pat->items[forward ? pc : pat->nitems - 1 - pc];
+
+        if (insetpat(pat->ops[item->op].set, c))
+            dfafollow(pat, &t, (item->rep == '*' || item->rep == '-') ? pc : pc + 1, forward, leftmost);
+    }
+
+    // a match starting at the next character is the least preferred one
+    if (flags & DFA_STARTS)
+        dfafollow(pat, &t, 0, forward, leftmost);
+
+    int count = dfa->count;
+    next = dfaadd(pat, dfa, &t, forward, (flags & DFA_STARTS) != 0);
+
+    // the transition can only be recorded if the states weren't discarded
+    if (dfa->count >= count)
+        dfa->next[state * pat->nclasses + cls] = int16_t(next);
+
+    return next;
+}
+
+static void matchinterrupt(lua_State* L)
+{
+    if (LUAU_UNLIKELY(hasinterrupt(L->global)))
+    {
+        // this interrupt is not yieldable
+        L->nCcalls++;
+        luaG_interrupt(L, -1);
+        L->nCcalls--;
+    }
+}
+
+// finds the first match at or after init, returning its end or NULL; the backtracking matcher would find the same match
+static const char* dfasearch(lua_State* L, Pattern* pat, const char* init, const char* end, const char** start)
+{
+    matchinterrupt(L);
+
+    PatternDfa* dfa = &pat->forward;
+    int state = dfastart(pat, dfa, true, pat->anchor);
+    const char* s = init;
+    const char* e = (dfa->flags[state] & DFA_MATCH) ? s : NULL;
+
+    while (s < end && !(dfa->flags[state] & DFA_DEAD))
+    {
+        state = dfanext(pat, dfa, true, state, pat->classmap[uchar(*s++)]);
+
+        if (dfa->flags[state] & DFA_MATCH)
+            e = s;
+    }
+
+    if (s == end && (dfa->flags[state] & DFA_EOFMATCH))
+        e = end;
+
+    if (!e || pat->anchor)
+    {
+        *start = init;
+        return e;
+    }
+
+    // the match starts at the earliest position that the reversed pattern reaches from its end
+    dfa = &pat->reverse;
+    state = dfastart(pat, dfa, false, false);
+    s = e;
+    *start = (dfa->flags[state] & DFA_MATCH) ? s : NULL;
+
+    while (s > init && !(dfa->flags[state] & DFA_DEAD))
+    {
+        state = dfanext(pat, dfa, false, state, pat->classmap[uchar(*--s)]);
+
+        if (dfa->flags[state] & DFA_MATCH)
+            *start = s;
+    }
+
+    LUAU_ASSERT(*start);
+    return e;
+}
+
+static int singlematch(MatchState* ms, const char* s, const PatternOp* op)
+{
+    return s < ms->src_end && insetpat(op->set, uchar(*s));
+}
+
+static const char* matchbalance(MatchState* ms, const char* s, const PatternOp* op)
+{
+    if (*s != op->arg[0])
         return NULL;
     else
     {
-        int b = *p;
-        int e = *(p + 1);
+        int b = op->arg[0];
+        int e = op->arg[1];
         int cont = 1;
         while (++s < ms->src_end)
         {
@@ -362,15 +1315,15 @@ static const char* matchbalance(MatchState* ms, const char* s, const char* p)
     return NULL; // string ends out of balance
 }
 
-static const char* max_expand(MatchState* ms, const char* s, const char* p, const char* ep)
+static const char* max_expand(MatchState* ms, const char* s, const PatternOp* op)
 {
     ptrdiff_t i = 0; // counts maximum expand for item
-    while (singlematch(ms, s + i, p, ep))
+    while (singlematch(ms, s + i, op))
         i++;
     // keeps trying to match with the maximum repetitions
     while (i >= 0)
     {
-        const char* res = match(ms, (s + i), ep + 1);
+        const char* res = match(ms, (s + i), op + 1);
         if (res)
             return res;
         i--; // else didn't match; reduce 1 repetition to try again
@@ -378,21 +1331,21 @@ static const char* max_expand(MatchState* ms, const char* s, const char* p, cons
     return NULL;
 }
 
-static const char* min_expand(MatchState* ms, const char* s, const char* p, const char* ep)
+static const char* min_expand(MatchState* ms, const char* s, const PatternOp* op)
 {
     for (;;)
     {
-        const char* res = match(ms, s, ep + 1);
+        const char* res = match(ms, s, op + 1);
         if (res != NULL)
             return res;
-        else if (singlematch(ms, s, p, ep))
+        else if (singlematch(ms, s, op))
             s++; // try with one more repetition
         else
             return NULL;
     }
 }
 
-static const char* start_capture(MatchState* ms, const char* s, const char* p, int what)
+static const char* start_capture(MatchState* ms, const char* s, const PatternOp* op, int what)
 {
     const char* res;
     int level = ms->level;
@@ -401,17 +1354,17 @@ static const char* start_capture(MatchState* ms, const char* s, const char* p, i
     ms->capture[level].init = s;
     ms->capture[level].len = what;
     ms->level = level + 1;
-    if ((res = match(ms, s, p)) == NULL) // match failed?
-        ms->level--;                     // undo capture
+    if ((res = match(ms, s, op)) == NULL) // match failed?
+        ms->level--;                      // undo capture
     return res;
 }
 
-static const char* end_capture(MatchState* ms, const char* s, const char* p)
+static const char* end_capture(MatchState* ms, const char* s, const PatternOp* op)
 {
     int l = capture_to_close(ms);
     const char* res;
     ms->capture[l].len = s - ms->capture[l].init; // close capture
-    if ((res = match(ms, s, p)) == NULL)          // match failed?
+    if ((res = match(ms, s, op)) == NULL)         // match failed?
         ms->capture[l].len = CAP_UNFINISHED;      // undo capture
     return res;
 }
@@ -427,130 +1380,96 @@ static const char* match_capture(MatchState* ms, const char* s, int l)
         return NULL;
 }
 
-static const char* match(MatchState* ms, const char* s, const char* p)
+static const char* match(MatchState* ms, const char* s, const PatternOp* op)
 {
     if (ms->matchdepth-- == 0)
         luaL_error(ms->L, "pattern too complex");
 
-    lua_State* L = ms->L;
-    void (*interrupt)(lua_State*, int) = L->global->cb.interrupt;
-
-    if (LUAU_UNLIKELY(!!interrupt))
-    {
-        // this interrupt is not yieldable
-        L->nCcalls++;
-        interrupt(L, -1);
-        L->nCcalls--;
-    }
+    matchinterrupt(ms->L);
 
 init: // using goto's to optimize tail recursion
-    if (p != ms->p_end)
+    if (op != ms->op_end)
     { // end of pattern?
-        switch (*p)
+        switch (op->kind)
         {
-        case '(':
-        {                        // start capture
-            if (*(p + 1) == ')') // position capture?
-                s = start_capture(ms, s, p + 2, CAP_POSITION);
-            else
-                s = start_capture(ms, s, p + 1, CAP_UNFINISHED);
+        case PAT_OPEN:
+        { // start capture
+            s = start_capture(ms, s, op + 1, CAP_UNFINISHED);
             break;
         }
-        case ')':
-        { // end capture
-            s = end_capture(ms, s, p + 1);
+        case PAT_POSITION:
+        { // position capture
+            s = start_capture(ms, s, op + 1, CAP_POSITION);
             break;
         }
-        case '$':
-        {
-            if ((p + 1) != ms->p_end)          // is the `$' the last char in pattern?
-                goto dflt;                     // no; go to default
-            s = (s == ms->src_end) ? s : NULL; // check end of string
+        case PAT_CLOSE:
+        { // end capture
+            s = end_capture(ms, s, op + 1);
             break;
         }
-        case L_ESC:
-        { // escaped sequences not in the format class[*+?-]?
-            switch (*(p + 1))
-            {
-            case 'b':
-            { // balanced string?
-                s = matchbalance(ms, s, p + 2);
-                if (s != NULL)
-                {
-                    p += 4;
-                    goto init; // return match(ms, s, p + 4);
-                }              // else fail (s == NULL)
-                break;
-            }
-            case 'f':
-            { // frontier?
-                const char* ep;
-                char previous;
-                p += 2;
-                if (*p != '[')
-                    luaL_error(ms->L, "missing '[' after '%%f' in pattern");
-                ep = classend(ms, p); // points to what is next
-                previous = (s == ms->src_init) ? '\0' : *(s - 1);
-                if (!matchbracketclass(uchar(previous), p, ep - 1) && matchbracketclass(uchar(*s), p, ep - 1))
-                {
-                    p = ep;
-                    goto init; // return match(ms, s, ep);
-                }
-                s = NULL; // match failed
-                break;
-            }
-            case '0':
-            case '1':
-            case '2':
-            case '3':
-            case '4':
-            case '5':
-            case '6':
-            case '7':
-            case '8':
-            case '9':
-            { // capture results (%0-%9)?
-                s = match_capture(ms, s, uchar(*(p + 1)));
-                if (s != NULL)
-                {
-                    p += 2;
-                    goto init; // return match(ms, s, p + 2)
-                }
-                break;
+        case PAT_END:
+        {
+            s = (s == ms->src_end) ? s : NULL; // check end of string
+            break;
+        }
+        case PAT_BALANCE:
+        { // balanced string?
+            s = matchbalance(ms, s, op);
+            if (s != NULL)
+            {
+                op++;
+                goto init; // return match(ms, s, op + 1);
+            }              // else fail (s == NULL)
+            break;
+        }
+        case PAT_FRONTIER:
+        { // frontier?
+            char previous = (s == ms->src_init) ? '\0' : *(s - 1);
+            char current = (s == ms->src_end) ? '\0' : *s;
+            if (!insetpat(op->set, uchar(previous)) && insetpat(op->set, uchar(current)))
+            {
+                op++;
+                goto init; // return match(ms, s, op + 1);
             }
-            default:
-                goto dflt;
+            s = NULL; // match failed
+            break;
+        }
+        case PAT_BACKREF:
+        { // capture results (%0-%9)?
+            s = match_capture(ms, s, uchar(op->arg[0]));
+            if (s != NULL)
+            {
+                op++;
+                goto init; // return match(ms, s, op + 1)
             }
             break;
         }
-        default:
-        dflt:
-        {                                     // pattern class plus optional suffix
-            const char* ep = classend(ms, p); // points to optional suffix
+        case PAT_CHAR:
+        { // pattern class plus optional suffix
             // does not match at least once?
-            if (!singlematch(ms, s, p, ep))
+            if (!singlematch(ms, s, op))
             {
-                if (*ep == '*' || *ep == '?' || *ep == '-')
+                if (op->rep == '*' || op->rep == '?' || op->rep == '-')
                 { // accept empty?
-                    p = ep + 1;
-                    goto init; // return match(ms, s, ep + 1);
+                    op++;
+                    goto init; // return match(ms, s, op + 1);
                 }
                 else          // '+' or no suffix
                     s = NULL; // fail
             }
             else
             { // matched once
-                switch (*ep)
+                switch (op->rep)
                 { // handle optional suffix
                 case '?':
                 { // optional
                     const char* res;
-                    if ((res = match(ms, s + 1, ep + 1)) != NULL)
+                    if ((res = match(ms, s + 1, op + 1)) != NULL)
                         s = res;
                     else
                     {
-                        p = ep + 1;
-                        goto init; // else return match(ms, s, ep + 1);
+                        op++;
+                        goto init; // else return match(ms, s, op + 1);
                     }
                     break;
                 }
@@ -558,19 +1477,23 @@ init: // using goto's to optimize tail recursion
                     s++;              // 1 match already done
                     LUAU_FALLTHROUGH; // go through
                 case '*': // 0 or more repetitions
-                    s = max_expand(ms, s, p, ep);
+                    s = max_expand(ms, s, op);
                     break;
                 case '-': // 0 or more repetitions (minimum)
-                    s = min_expand(ms, s, p, ep);
+                    s = min_expand(ms, s, op);
                     break;
                 default: // no suffix
                     s++;
-                    p = ep;
-                    goto init; // return match(ms, s + 1, ep);
+                    op++;
+                    goto init; // return match(ms, s + 1, op + 1);
                 }
             }
             break;
         }
+        case PAT_ERROR:
+        {
+            luaL_error(ms->L, "%s", patternerrors[uchar(op->arg[0])]);
+        }
         }
     }
     ms->matchdepth++;
@@ -584,23 +1507,7 @@ static const char* lmemfind(const char* s1, size_t l1, const char* s2, size_t l2
     else if (l2 > l1)
         return NULL; // avoids a negative `l1'
     else
-    {
-        const char* init; // to search for a `*s2' inside `s1'
-        l2--;             // 1st char will be checked by `memchr'
-        l1 = l1 - l2;     // `s2' cannot be found after that
-        while (l1 > 0 && (init = (const char*)memchr(s1, *s2, l1)) != NULL)
-        {
-            init++; // 1st char is already checked
-            if (memcmp(init, s2 + 1, l2) == 0)
-                return init - 1;
-            else
-            { // correct `l1' and `s1' to try again
-                l1 -= init - s1;
-                s1 = init;
-            }
-        }
-        return NULL; // not found
-    }
+        return stringkernels.find(s1, l1, s2, l2);
 }
 
 static void push_onecapture(MatchState* ms, int i, const char* s, const char* e)
@@ -647,13 +1554,76 @@ static int nospecials(const char* p, size_t l)
     return 1; // no special chars found
 }
 
-static void prepstate(MatchState* ms, lua_State* L, const char* s, size_t ls, const char* p, size_t lp)
+// compiled patterns and format strings are cached in tables shared by the functions that use them; once a cache is full,
+// the least recently used program is evicted
+#define MAXCACHEDPATTERN 1024 // longer patterns are compiled on every call
+
+struct ProgramCache
+{
+    int size;
+    uint64_t clock;
+};
+
+template<typename T>
+static void evictprogram(lua_State* L, ProgramCache* cache)
+{
+    uint64_t oldest = ~0ull;
+    lua_pushnil(L); // key of the least recently used program
+    lua_pushnil(L);
+    while (lua_next(L, lua_upvalueindex(1)))
+    {
+        T* prog = (T*)lua_touserdata(L, -1);
+        if (prog->lastuse < oldest)
+        {
+            oldest = prog->lastuse;
+            lua_pushvalue(L, -2);
+            lua_replace(L, -4);
+        }
+        lua_pop(L, 1);
+    }
+    lua_pushnil(L);
+    lua_rawset(L, lua_upvalueindex(1));
+    cache->size--;
+}
+
+// pushes the compiled form of the pattern at stack index 2, which keeps it alive while it's used
+static Pattern* getpattern(lua_State* L, const char* p, size_t lp)
+{
+    if (LUA_PATTERNCACHE <= 0 || lp > MAXCACHEDPATTERN)
+        return newpattern(L, p, lp, true);
+
+    ProgramCache* cache = (ProgramCache*)lua_touserdata(L, lua_upvalueindex(2));
+
+    lua_pushvalue(L, 2);
+    lua_rawget(L, lua_upvalueindex(1));
+    Pattern* pat = (Pattern*)lua_touserdata(L, -1);
+
+    if (!pat)
+    {
+        lua_pop(L, 1);
+
+        if (cache->size >= LUA_PATTERNCACHE)
+            evictprogram<Pattern>(L, cache);
+
+        pat = newpattern(L, p, lp, true);
+
+        lua_pushvalue(L, 2);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, lua_upvalueindex(1));
+        cache->size++;
+    }
+
+    pat->lastuse = ++cache->clock;
+    return pat;
+}
+
+static void prepstate(MatchState* ms, lua_State* L, const char* s, size_t ls, const Pattern* pat)
 {
     ms->L = L;
     ms->matchdepth = LUAI_MAXCCALLS;
     ms->src_init = s;
     ms->src_end = s + ls;
-    ms->p_end = p + lp;
+    ms->op_end = pat->ops + pat->nops;
 }
 
 static void reprepstate(MatchState* ms)
@@ -665,7 +1635,7 @@ static void reprepstate(MatchState* ms)
 static int str_find_aux(lua_State* L, int find)
 {
     size_t ls, lp;
-    const char* s = luaL_checklstring(L, 1, &ls);
+    const char* s = checkstringview(L, 1, &ls);
     const char* p = luaL_checklstring(L, 2, &lp);
     int init = posrelat(luaL_optinteger(L, 3, 1), ls);
     if (init < 1)
@@ -691,29 +1661,34 @@ static int str_find_aux(lua_State* L, int find)
     {
         MatchState ms;
         const char* s1 = s + init - 1;
-        int anchor = (*p == '^');
-        if (anchor)
+        const char* res = NULL;
+        Pattern* pat = getpattern(L, p, lp);
+        prepstate(&ms, L, s, ls, pat);
+        if (pat->dfa)
         {
-            p++;
-            lp--; // skip anchor character
+            reprepstate(&ms);
+            res = dfasearch(L, pat, s1, ms.src_end, &s1);
         }
-        prepstate(&ms, L, s, ls, p, lp);
-        do
+        else
         {
-            const char* res;
-            reprepstate(&ms);
-            if ((res = match(&ms, s1, p)) != NULL)
+            do
             {
-                if (find)
-                {
-                    lua_pushinteger(L, (int)(s1 - s + 1)); // start
-                    lua_pushinteger(L, (int)(res - s));    // end
-                    return push_captures(&ms, NULL, 0) + 2;
-                }
-                else
-                    return push_captures(&ms, s1, res);
+                reprepstate(&ms);
+                if ((res = match(&ms, s1, pat->ops)) != NULL)
+                    break;
+            } while (s1++ < ms.src_end && !pat->anchor);
+        }
+        if (res)
+        {
+            if (find)
+            {
+                lua_pushinteger(L, (int)(s1 - s + 1)); // start
+                lua_pushinteger(L, (int)(res - s));    // end
+                return push_captures(&ms, NULL, 0) + 2;
             }
-        } while (s1++ < ms.src_end && !anchor);
+            else
+                return push_captures(&ms, s1, res);
+        }
     }
     lua_pushnil(L); // not found
     return 1;
@@ -732,33 +1707,52 @@ static int str_match(lua_State* L)
 static int gmatch_aux(lua_State* L)
 {
     MatchState ms;
-    size_t ls, lp;
-    const char* s = lua_tolstring(L, lua_upvalueindex(1), &ls);
-    const char* p = lua_tolstring(L, lua_upvalueindex(2), &lp);
-    const char* src;
-    prepstate(&ms, L, s, ls, p, lp);
-    for (src = s + (size_t)lua_tointeger(L, lua_upvalueindex(3)); src <= ms.src_end; src++)
+    size_t ls;
+    lua_pushvalue(L, lua_upvalueindex(1)); // the subject is read in place, which is only safe while it's on the stack
+    const char* s = lua_tolstringview(L, -1, &ls);
+    Pattern* pat = (Pattern*)lua_touserdata(L, lua_upvalueindex(2));
+    const char* src = s + (size_t)lua_tointeger(L, lua_upvalueindex(3));
+    const char* e = NULL;
+    prepstate(&ms, L, s, ls, pat);
+    if (pat->dfa)
     {
-        const char* e;
         reprepstate(&ms);
-        if ((e = match(&ms, src, p)) != NULL)
+        if (src <= ms.src_end)
+            e = dfasearch(L, pat, src, ms.src_end, &src);
+    }
+    else
+    {
+        for (; src <= ms.src_end; src++)
         {
-            int newstart = (int)(e - s);
-            if (e == src)
-                newstart++; // empty match? go at least one position
-            lua_pushinteger(L, newstart);
-            lua_replace(L, lua_upvalueindex(3));
-            return push_captures(&ms, src, e);
+            reprepstate(&ms);
+            if ((e = match(&ms, src, pat->ops)) != NULL)
+                break;
         }
     }
+    if (e)
+    {
+        int newstart = (int)(e - s);
+        if (e == src)
+            newstart++; // empty match? go at least one position
+        lua_pushinteger(L, newstart);
+        lua_replace(L, lua_upvalueindex(3));
+        return push_captures(&ms, src, e);
+    }
     return 0; // not found
 }
 
 static int gmatch(lua_State* L)
 {
-    luaL_checkstring(L, 1);
-    luaL_checkstring(L, 2);
+    size_t lp;
+    checkstringview(L, 1, NULL);
+    const char* p = luaL_checklstring(L, 2, &lp);
     lua_settop(L, 2);
+    // a leading '^' has no special meaning in gmatch, so such patterns are not shared with other functions
+    if (*p == '^')
+        newpattern(L, p, lp, false);
+    else
+        getpattern(L, p, lp);
+    lua_remove(L, 2);
     lua_pushinteger(L, 0);
     lua_pushcclosure(L, gmatch_aux, NULL, 3);
     return 1;
@@ -833,27 +1827,32 @@ static void add_value(MatchState* ms, luaL_Strbuf* b, const char* s, const char*
 static int str_gsub(lua_State* L)
 {
     size_t srcl, lp;
-    const char* src = luaL_checklstring(L, 1, &srcl);
+    const char* src = checkstringview(L, 1, &srcl);
     const char* p = luaL_checklstring(L, 2, &lp);
     int tr = lua_type(L, 3);
     int max_s = luaL_optinteger(L, 4, (int)srcl + 1);
-    int anchor = (*p == '^');
     int n = 0;
     MatchState ms;
     luaL_Strbuf b;
     luaL_argexpected(L, tr == LUA_TNUMBER || tr == LUA_TSTRING || tr == LUA_TFUNCTION || tr == LUA_TTABLE, 3, "string/function/table");
+    Pattern* pat = getpattern(L, p, lp);
     luaL_buffinit(L, &b);
-    if (anchor)
-    {
-        p++;
-        lp--; // skip anchor character
-    }
-    prepstate(&ms, L, src, srcl, p, lp);
+    prepstate(&ms, L, src, srcl, pat);
     while (n < max_s)
     {
         const char* e;
         reprepstate(&ms);
-        e = match(&ms, src, p);
+        if (pat->dfa)
+        {
+            // skip to the next match, keeping the text before it
+            const char* start;
+            if ((e = dfasearch(L, pat, src, ms.src_end, &start)) == NULL)
+                break;
+            luaL_addlstring(&b, src, start - src);
+            src = start;
+        }
+        else
+            e = match(&ms, src, pat->ops);
         if (e)
         {
             n++;
@@ -865,7 +1864,7 @@ static int str_gsub(lua_State* L)
             luaL_addchar(&b, *src++);
         else
             break;
-        if (anchor)
+        if (pat->anchor)
             break;
     }
     luaL_addlstring(&b, src, ms.src_end - src);
@@ -924,19 +1923,65 @@ static void addquoted(lua_State* L, luaL_Strbuf* b, int arg)
     luaL_addchar(b, '"');
 }
 
-static const char* scanformat(lua_State* L, const char* strfrmt, char* form, size_t* size)
+// format strings are compiled into a list of items: runs of text copied as is, and conversions with their specifications
+// already parsed, which lets the common conversions skip snprintf
+#define MAXCACHEDFORMAT 1024 // longer format strings are compiled on every call
+
+enum FormatKind
+{
+    FORMAT_TEXT, // part of the format string
+    FORMAT_ANY,  // '%*', formats any value like tostring
+    FORMAT_ITEM, // conversion of an argument
+};
+
+struct FormatItem
+{
+    uint8_t kind;
+    char conversion; // conversion character, invalid ones are reported when the item is reached
+    bool plain;      // no flags, width or precision
+    bool precision;
+    bool fastint; // integer conversion with only '-' and '0' flags and a width, which is formatted without snprintf
+    bool left;    // '-' flag
+    bool zero;    // '0' flag
+    uint8_t width;
+
+    size_t start; // position and length of the text in the format string
+    size_t length;
+
+    const char* error; // invalid specification, reported when the item is reached
+
+    char form[MAX_FORMAT]; // snprintf specification, with a 'll' length modifier for integer conversions
+};
+
+struct FormatProgram
+{
+    uint64_t lastuse; // cache clock at the last lookup of the format string
+    int nitems;
+    FormatItem* items;
+};
+
+static const char* scanformat(const char* strfrmt, FormatItem* item)
 {
     const char* p = strfrmt;
     while (*p != '\0' && strchr(FLAGS, *p) != NULL)
+    {
+        item->left |= *p == '-';
+        item->zero |= *p == '0';
         p++; // skip flags
+    }
     if ((size_t)(p - strfrmt) >= sizeof(FLAGS))
-        luaL_error(L, "invalid format (repeated flags)");
+    {
+        item->error = "invalid format (repeated flags)";
+        return p;
+    }
+    const char* flags_end = p;
     if (isdigit(uchar(*p)))
-        p++; // skip width
+        item->width = uint8_t(*p++ - '0'); // skip width
     if (isdigit(uchar(*p)))
-        p++; // (2 digits at most)
+        item->width = uint8_t(item->width * 10 + (*p++ - '0')); // (2 digits at most)
     if (*p == '.')
     {
+        item->precision = true;
         p++;
         if (isdigit(uchar(*p)))
             p++; // skip precision
@@ -944,12 +1989,18 @@ static const char* scanformat(lua_State* L, const char* strfrmt, char* form, siz
             p++; // (2 digits at most)
     }
     if (isdigit(uchar(*p)))
-        luaL_error(L, "invalid format (width or precision too long)");
-    *(form++) = '%';
-    *size = p - strfrmt + 1;
-    strncpy(form, strfrmt, *size);
-    form += *size;
-    *form = '\0';
+    {
+        item->error = "invalid format (width or precision too long)";
+        return p;
+    }
+    size_t size = p - strfrmt + 1;
+    item->form[0] = '%';
+    strncpy(item->form + 1, strfrmt, size);
+    item->form[size + 1] = '\0';
+    item->conversion = *p;
+    item->plain = p == strfrmt;
+    // the flags other than '-' and '0' and the precision change the integer conversions in ways left to snprintf
+    item->fastint = (*p == 'd' || *p == 'i') && !item->precision && strspn(strfrmt, "-0") == size_t(flags_end - strfrmt);
     return p;
 }
 
@@ -965,114 +2016,282 @@ static void addInt64Format(char form[MAX_FORMAT], char formatIndicator, size_t f
     form[formatItemSize + 3] = 0;
 }
 
-static int str_format(lua_State* L)
+static FormatItem* addformatitem(FormatProgram* prog, int kind)
+{
+    FormatItem* item = &prog->items[prog->nitems++];
+    memset(item, 0, sizeof(FormatItem));
+    item->kind = uint8_t(kind);
+    return item;
+}
+
+static FormatProgram* newformat(lua_State* L, const char* strfrmt, size_t sfl)
 {
-    int top = lua_gettop(L);
-    int arg = 1;
-    size_t sfl;
-    const char* strfrmt = luaL_checklstring(L, arg, &sfl);
     const char* strfrmt_end = strfrmt + sfl;
-    luaL_Strbuf b;
-    luaL_buffinit(L, &b);
+
+    // each specification adds at most one conversion and one run of text
+    int nesc = 0;
+    for (const char* p = strfrmt; (p = (const char*)memchr(p, L_ESC, strfrmt_end - p)) != NULL; p++)
+        nesc++;
+
+    FormatProgram* prog = (FormatProgram*)lua_newuserdata(L, sizeof(FormatProgram) + (2 * nesc + 1) * sizeof(FormatItem));
+    prog->lastuse = 0;
+    prog->nitems = 0;
+    prog->items = (FormatItem*)(prog + 1);
+
+    const char* begin = strfrmt;
+    const char* text = strfrmt;
     while (strfrmt < strfrmt_end)
     {
         if (*strfrmt != L_ESC)
-            luaL_addchar(&b, *strfrmt++);
-        else if (*++strfrmt == L_ESC)
-            luaL_addchar(&b, *strfrmt++); // %%
-        else if (*strfrmt == '*')
         {
             strfrmt++;
-            if (++arg > top)
-                luaL_error(L, "missing argument #%d", arg);
+            continue;
+        }
 
-            luaL_addvalueany(&b, arg);
+        const char* spec = strfrmt + 1;
+        // %% keeps the first '%' as a part of the text before it
+        const char* text_end = (*spec == L_ESC) ? spec : strfrmt;
+        if (text_end > text)
+        {
+            FormatItem* item = addformatitem(prog, FORMAT_TEXT);
+            item->start = text - begin;
+            item->length = text_end - text;
+        }
+
+        if (*spec == L_ESC)
+        {
+            strfrmt = text = spec + 1;
+        }
+        else if (*spec == '*')
+        {
+            addformatitem(prog, FORMAT_ANY);
+            strfrmt = text = spec + 1;
         }
         else
-        {                          // format item
-            char form[MAX_FORMAT]; // to store the format (`%...')
-            char buff[MAX_ITEM];   // to store the formatted item
-            if (++arg > top)
-                luaL_error(L, "missing argument #%d", arg);
-            size_t formatItemSize = 0;
-            strfrmt = scanformat(L, strfrmt, form, &formatItemSize);
-            char formatIndicator = *strfrmt++;
-            switch (formatIndicator)
-            {
-            case 'c':
+        {
+            FormatItem* item = addformatitem(prog, FORMAT_ITEM);
+            const char* p = scanformat(spec, item);
+            if (item->error)
+                return prog; // nothing past an invalid specification is formatted
+
+            switch (item->conversion)
             {
-                if (DFFlag::LuauStringFormatFixC)
-                {
-                    int count = snprintf(buff, sizeof(buff), form, (int)luaL_checknumber(L, arg));
-                    luaL_addlstring(&b, buff, count);
-                    continue; // skip the 'luaL_addlstring' at the end
-                }
-                else
-                {
-                    snprintf(buff, sizeof(buff), form, (int)luaL_checknumber(L, arg));
-                    break;
-                }
-            }
             case 'd':
             case 'i':
-            {
-                addInt64Format(form, formatIndicator, formatItemSize);
-                snprintf(buff, sizeof(buff), form, (long long)luaL_checknumber(L, arg));
-                break;
-            }
             case 'o':
             case 'u':
             case 'x':
             case 'X':
-            {
-                double argValue = luaL_checknumber(L, arg);
-                addInt64Format(form, formatIndicator, formatItemSize);
-                unsigned long long v = (argValue < 0) ? (unsigned long long)(long long)argValue : (unsigned long long)argValue;
-                snprintf(buff, sizeof(buff), form, v);
+                addInt64Format(item->form, item->conversion, p - spec + 1);
                 break;
             }
-            case 'e':
-            case 'E':
-            case 'f':
-            case 'g':
-            case 'G':
+            strfrmt = text = p + 1;
+        }
+    }
+    if (strfrmt_end > text)
+    {
+        FormatItem* item = addformatitem(prog, FORMAT_TEXT);
+        item->start = text - begin;
+        item->length = strfrmt_end - text;
+    }
+    return prog;
+}
+
+// pushes the compiled form of the format string at stack index 1, which keeps it alive while it's used
+static FormatProgram* getformat(lua_State* L, const char* strfrmt, size_t sfl)
+{
+    if (LUA_FORMATCACHE <= 0 || sfl > MAXCACHEDFORMAT)
+        return newformat(L, strfrmt, sfl);
+
+    ProgramCache* cache = (ProgramCache*)lua_touserdata(L, lua_upvalueindex(2));
+
+    lua_pushvalue(L, 1);
+    lua_rawget(L, lua_upvalueindex(1));
+    FormatProgram* prog = (FormatProgram*)lua_touserdata(L, -1);
+
+    if (!prog)
+    {
+        lua_pop(L, 1);
+
+        if (cache->size >= LUA_FORMATCACHE)
+            evictprogram<FormatProgram>(L, cache);
+
+        prog = newformat(L, strfrmt, sfl);
+
+        lua_pushvalue(L, 1);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, lua_upvalueindex(1));
+        cache->size++;
+    }
+
+    prog->lastuse = ++cache->clock;
+    return prog;
+}
+
+// same output as snprintf with the "%lld" conversion, padded with spaces or zeros according to the '-' and '0' flags
+static void addinteger(luaL_Strbuf* b, const FormatItem* item, long long v)
+{
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    char* p = end;
+    unsigned long long u = v < 0 ? 0ull - (unsigned long long)v : (unsigned long long)v;
+    do
+    {
+        *--p = char('0' + u % 10);
+        u /= 10;
+    } while (u);
+
+    size_t len = (end - p) + (v < 0);
+    size_t pad = item->width > len ? item->width - len : 0;
+    char* out = luaL_prepbuffsize(b, len + pad);
+
+    if (!item->left && !item->zero)
+    {
+        memset(out, ' ', pad);
+        out += pad;
+    }
+    if (v < 0)
+        *out++ = '-';
+    if (!item->left && item->zero)
+    {
+        memset(out, '0', pad);
+        out += pad;
+    }
+    memcpy(out, p, end - p);
+    out += end - p;
+    if (item->left)
+    {
+        memset(out, ' ', pad);
+        out += pad;
+    }
+    b->p = out;
+}
+
+static int str_format(lua_State* L)
+{
+    int top = lua_gettop(L);
+    int arg = 1;
+    size_t sfl;
+    const char* strfrmt = luaL_checklstring(L, arg, &sfl);
+    FormatProgram* prog = getformat(L, strfrmt, sfl);
+    luaL_Strbuf b;
+    luaL_buffinit(L, &b);
+    for (int i = 0; i < prog->nitems; i++)
+    {
+        const FormatItem* item = &prog->items[i];
+
+        if (item->kind == FORMAT_TEXT)
+        {
+            luaL_addlstring(&b, strfrmt + item->start, item->length);
+            continue;
+        }
+
+        if (++arg > top)
+            luaL_error(L, "missing argument #%d", arg);
+
+        if (item->kind == FORMAT_ANY)
+        {
+            luaL_addvalueany(&b, arg);
+            continue;
+        }
+
+        if (item->error)
+            luaL_error(L, "%s", item->error);
+
+        const char* form = item->form;
+        char* buff = NULL; // the formatted item, when it's written by snprintf
+        switch (item->conversion)
+        {
+        case 'c':
+        {
+            buff = luaL_prepbuffsize(&b, MAX_ITEM);
+            if (DFFlag::LuauStringFormatFixC)
             {
-                snprintf(buff, sizeof(buff), form, (double)luaL_checknumber(L, arg));
-                break;
+                int count = snprintf(buff, MAX_ITEM, form, (int)luaL_checknumber(L, arg));
+                b.p += count;
+                continue; // skip the 'strlen' at the end
             }
-            case 'q':
+            else
             {
-                addquoted(L, &b, arg);
-                continue; // skip the 'luaL_addlstring' at the end
+                snprintf(buff, MAX_ITEM, form, (int)luaL_checknumber(L, arg));
+                break;
             }
-            case 's':
+        }
+        case 'd':
+        case 'i':
+        {
+            if (item->fastint)
             {
-                size_t l;
-                const char* s = luaL_checklstring(L, arg, &l);
-                // no precision and string is too long to be formatted, or no format necessary to begin with
-                if (form[2] == '\0' || (!strchr(form, '.') && l >= 100))
-                {
-                    luaL_addlstring(&b, s, l);
-                    continue; // skip the `luaL_addlstring' at the end
-                }
-                else
-                {
-                    snprintf(buff, sizeof(buff), form, s);
-                    break;
-                }
+                addinteger(&b, item, (long long)luaL_checknumber(L, arg));
+                continue;
             }
-            case '*':
+            buff = luaL_prepbuffsize(&b, MAX_ITEM);
+            snprintf(buff, MAX_ITEM, form, (long long)luaL_checknumber(L, arg));
+            break;
+        }
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+        {
+            double argValue = luaL_checknumber(L, arg);
+            unsigned long long v = (argValue < 0) ? (unsigned long long)(long long)argValue : (unsigned long long)argValue;
+            buff = luaL_prepbuffsize(&b, MAX_ITEM);
+            snprintf(buff, MAX_ITEM, form, v);
+            break;
+        }
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'g':
+        case 'G':
+        {
+            double argValue = luaL_checknumber(L, arg);
+            buff = luaL_prepbuffsize(&b, MAX_ITEM);
+            snprintf(buff, MAX_ITEM, form, argValue);
+            break;
+        }
+        case 'q':
+        {
+            addquoted(L, &b, arg);
+            continue;
+        }
+        case 's':
+        {
+            // numbers are written without going through the string they would be converted to
+            if (item->plain && lua_type(L, arg) == LUA_TNUMBER)
             {
-                // %* is parsed above, so if we got here we must have %...*
-                luaL_error(L, "'%%*' does not take a form");
+                char* s = luaL_prepbuffsize(&b, LUAI_MAXNUM2STR);
+                b.p = luai_num2str(s, lua_tonumber(L, arg));
+                continue;
             }
-            default:
-            { // also treat cases `pnLlh'
-                luaL_error(L, "invalid option '%%%c' to 'format'", *(strfrmt - 1));
+            size_t l;
+            const char* s = checkstringview(L, arg, &l);
+            // no precision and string is too long to be formatted, or no format necessary to begin with
+            if (item->plain || (!item->precision && l >= 100))
+            {
+                luaL_addlstring(&b, s, l);
+                continue;
             }
+            else
+            {
+                s = lua_tostring(L, arg); // snprintf needs the string to be terminated
+                buff = luaL_prepbuffsize(&b, MAX_ITEM);
+                snprintf(buff, MAX_ITEM, form, s);
+                break;
             }
-            luaL_addlstring(&b, buff, strlen(buff));
         }
+        case '*':
+        {
+            // %* is parsed above, so if we got here we must have %...*
+            luaL_error(L, "'%%*' does not take a form");
+        }
+        default:
+        { // also treat cases `pnLlh'
+            luaL_error(L, "invalid option '%%%c' to 'format'", item->conversion);
+        }
+        }
+        b.p += strlen(buff);
     }
     luaL_pushresult(&b);
     return 1;
@@ -1081,7 +2300,7 @@ static int str_format(lua_State* L)
 static int str_split(lua_State* L)
 {
     size_t haystackLen;
-    const char* haystack = luaL_checklstring(L, 1, &haystackLen);
+    const char* haystack = checkstringview(L, 1, &haystackLen);
     size_t needleLen;
     const char* needle = luaL_optlstring(L, 2, ",", &needleLen);
 
@@ -1093,33 +2312,33 @@ static int str_split(lua_State* L)
     lua_createtable(L, 0, 0);
 
     if (needleLen == 0)
-        begin++;
-
-    // Don't iterate the last needleLen - 1 bytes of the string - they are
-    // impossible to be splits and would let us memcmp past the end of the
-    // buffer.
-    for (const char* iter = begin; iter <= end - needleLen; iter++)
     {
-        // Use of memcmp here instead of strncmp is so that we allow embedded
-        // nulls to be used in either of the haystack or the needle strings.
-        // Most Lua string APIs allow embedded nulls, and this should be no
-        // exception.
-        if (memcmp(iter, needle, needleLen) == 0)
+        // every position is a split, so every character ends up on its own
+        for (const char* iter = begin + 1; iter <= end; iter++)
         {
             lua_pushinteger(L, ++numMatches);
             lua_pushlstring(L, spanStart, iter - spanStart);
             lua_settable(L, -3);
 
-            spanStart = iter + needleLen;
-            if (needleLen > 0)
-                iter += needleLen - 1;
+            spanStart = iter;
         }
     }
-
-    if (needleLen > 0)
+    else
     {
+        // lmemfind compares with memcmp, so embedded nulls are allowed in either of the haystack or the needle strings, like
+        // in most Lua string APIs
+        const char* iter;
+        while ((iter = lmemfind(spanStart, end - spanStart, needle, needleLen)) != NULL)
+        {
+            lua_pushinteger(L, ++numMatches);
+            lua_pushsubstring(L, 1, spanStart - begin, iter - spanStart);
+            lua_settable(L, -3);
+
+            spanStart = iter + needleLen;
+        }
+
         lua_pushinteger(L, ++numMatches);
-        lua_pushlstring(L, spanStart, end - spanStart);
+        lua_pushsubstring(L, 1, spanStart - begin, end - spanStart);
         lua_settable(L, -3);
     }
 
@@ -1647,13 +2866,8 @@ static int str_unpack(lua_State* L)
 static const luaL_Reg strlib[] = {
     {"byte", str_byte},
     {"char", str_char},
-    {"find", str_find},
-    {"format", str_format},
-    {"gmatch", gmatch},
-    {"gsub", str_gsub},
     {"len", str_len},
     {"lower", str_lower},
-    {"match", str_match},
     {"rep", str_rep},
     {"reverse", str_reverse},
     {"sub", str_sub},
@@ -1677,12 +2891,47 @@ static void createmetatable(lua_State* L)
     lua_pop(L, 1);                  // pop metatable
 }
 
+// pattern matching functions share the cache of compiled patterns through their upvalues
+static const luaL_Reg patternlib[] = {
+    {"find", str_find},
+    {"gmatch", gmatch},
+    {"gsub", str_gsub},
+    {"match", str_match},
+    {NULL, NULL},
+};
+
+// string.format caches its compiled format strings the same way
+static const luaL_Reg formatlib[] = {
+    {"format", str_format},
+    {NULL, NULL},
+};
+
+static void createcachedlib(lua_State* L, const luaL_Reg* lib)
+{
+    lua_newtable(L); // compiled programs, keyed by source string
+    ProgramCache* cache = (ProgramCache*)lua_newuserdata(L, sizeof(ProgramCache));
+    cache->size = 0;
+    cache->clock = 0;
+
+    for (const luaL_Reg* l = lib; l->name; l++)
+    {
+        lua_pushvalue(L, -2);
+        lua_pushvalue(L, -2);
+        lua_pushcclosure(L, l->func, l->name, 2);
+        lua_setfield(L, -4, l->name);
+    }
+
+    lua_pop(L, 2);
+}
+
 /*
 ** Open string library
 */
 int luaopen_string(lua_State* L)
 {
     luaL_register(L, LUA_STRLIBNAME, strlib);
+    createcachedlib(L, patternlib);
+    createcachedlib(L, formatlib);
     createmetatable(L);
 
     return 1;
@@ -26,6 +26,7 @@
 #include "ltable.h"
 
 #include "lstate.h"
+#include "lstring.h"
 #include "ldebug.h"
 #include "lgc.h"
 #include "lmem.h"
@@ -139,6 +140,8 @@ static LuaNode* mainposition(const LuaTable* t, const TValue* key)
     case LUA_TVECTOR:
         return hashvec(t, vvalue(key));
     case LUA_TSTRING:
+        if (LUAU_UNLIKELY(tsvalue(key)->kind == STRING_VIEW))
+            return hashpow2(t, luaS_hash(getstr(tsvalue(key)), tsvalue(key)->len));
         return hashstr(t, tsvalue(key));
     case LUA_TBOOLEAN:
         return hashboolean(t, bvalue(key));
@@ -388,6 +391,7 @@ static void resize(lua_State* L, LuaTable* t, int nasize, int nhsize)
     LuaNode* nnew = t->node;
     if (nasize < oldasize)
     { // array part must shrink?
+        luaC_arraybarrier(L, t); // elements of the vanishing slice move to the hash part
         t->sizearray = nasize;
         // re-insert elements from vanishing slice
         for (int i = nasize; i < oldasize; i++)
@@ -543,6 +547,14 @@ static LuaNode* getfreepos(LuaTable* t)
 */
 static TValue* newkey(lua_State* L, LuaTable* t, const TValue* key)
 {
+    // keys are compared by address, so views have to be interned first
+    TValue flat;
+    if (ttisstring(key) && tsvalue(key)->kind == STRING_VIEW)
+    {
+        setsvalue(L, &flat, luaS_flatten(L, tsvalue(key)));
+        key = &flat;
+    }
+
     // enforce boundary invariant
     if (ttisnumber(key) && nvalue(key) == t->sizearray + 1)
     {
@@ -651,7 +663,9 @@ const TValue* luaH_get(LuaTable* t, const TValue* key)
     case LUA_TNIL:
         return luaO_nilobject;
     case LUA_TSTRING:
-        return luaH_getstr(t, tsvalue(key));
+        if (LUAU_LIKELY(tsvalue(key)->kind != STRING_VIEW))
+            return luaH_getstr(t, tsvalue(key));
+        goto generic;
     case LUA_TNUMBER:
     {
         int k;
@@ -662,6 +676,7 @@ const TValue* luaH_get(LuaTable* t, const TValue* key)
         LUAU_FALLTHROUGH;                         // else go through
     }
     default:
+    generic:
     {
         LuaNode* n = mainposition(t, key);
         for (;;)
@@ -490,6 +490,9 @@ static int tsort(lua_State* L)
     }
     lua_settop(L, 2); // make sure there are two arguments
 
+    // swaps don't use barriers, so the GC must not be in the middle of traversing the array
+    luaC_arraybarrier(L, t);
+
     if (n > 0)
         sort_rec(L, t, 0, n - 1, n, pred);
     return 0;
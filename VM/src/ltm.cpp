@@ -160,5 +160,11 @@ const TString* luaT_objtypenamestr(lua_State* L, const TValue* o)
 
 const char* luaT_objtypename(lua_State* L, const TValue* o)
 {
-    return getstr(luaT_objtypenamestr(L, o));
+    const TString* name = luaT_objtypenamestr(L, o);
+
+    // __type can be a view that isn't terminated
+    if (name->kind == STRING_VIEW)
+        name = luaS_flatten(L, cast_to(TString*, name));
+
+    return getstr(name);
 }
@@ -4,6 +4,37 @@
 
 #include "lcommon.h"
 
+#include <string.h>
+
+// Validation and counting of characters work on blocks of 16 bytes: on x64 an SSE2 loop skips ASCII text, and CPUs with
+// SSE4.1 (and ARM64 with NEON) validate any text with the byte shuffle lookups of Keiser and Lemire, "Validating UTF-8 In
+// Less Than One Instruction Per Byte"; characters that the blocks leave out are handled by utf8_decode
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTF8_SSE2 1
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64)
+#define UTF8_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if UTF8_SSE2 && (defined(__SSE4_1__) || defined(__AVX__))
+#define UTF8_SSE41 1
+#define UTF8_TARGET_SSE41
+#elif UTF8_SSE2 && defined(LUAU_TARGET_SSE41)
+#define UTF8_SSE41 1
+#define UTF8_TARGET_SSE41 LUAU_TARGET_SSE41
+#endif
+
+#if UTF8_SSE41
+#include <smmintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(LUAU_TARGET_SSE41)
+#include <cpuid.h>
+#endif
+#endif
+
 #define MAXUNICODE 0x10FFFF
 
 #define iscont(p) ((*(p) & 0xC0) == 0x80)
@@ -22,8 +53,9 @@ static int u_posrelat(int pos, size_t len)
 
 /*
 ** Decode one UTF-8 sequence, returning NULL if byte sequence is invalid.
+** The string ends at 'e', which doesn't have to be terminated.
 */
-static const char* utf8_decode(const char* o, int* val)
+static const char* utf8_decode(const char* o, const char* e, int* val)
 {
     static const unsigned int limits[] = {0xFF, 0x7F, 0x7FF, 0xFFFF};
     const unsigned char* s = (const unsigned char*)o;
@@ -35,12 +67,12 @@ static const char* utf8_decode(const char* o, int* val)
     {
         int count = 0; // to count number of continuation bytes
         while (c & 0x40)
-        {                                   // still have continuation bytes?
-            int cc = s[++count];            // read next byte
-            if ((cc & 0xC0) != 0x80)        // not a continuation byte?
-                return NULL;                // invalid byte sequence
-            res = (res << 6) | (cc & 0x3F); // add lower 6 bits from cont. byte
-            c <<= 1;                        // to test next bit
+        {                                            // still have continuation bytes?
+            int cc = o + ++count < e ? s[count] : 0; // read next byte; the end reads as '\0'
+            if ((cc & 0xC0) != 0x80)                 // not a continuation byte?
+                return NULL;                         // invalid byte sequence
+            res = (res << 6) | (cc & 0x3F);          // add lower 6 bits from cont. byte
+            c <<= 1;                                 // to test next bit
         }
         res |= ((c & 0x7F) << (count * 5)); // add first byte
         if (count > 3 || res > MAXUNICODE || res <= limits[count])
@@ -54,6 +86,317 @@ static const char* utf8_decode(const char* o, int* val)
     return (const char*)s + 1; // +1 to include first byte
 }
 
+// decodes a character from a range that has been validated
+static const char* utf8_decodevalid(const char* o, int* val)
+{
+    const unsigned char* s = (const unsigned char*)o;
+    unsigned int c = s[0];
+    if (c < 0x80)
+    {
+        *val = c;
+        return o + 1;
+    }
+    else if (c < 0xE0)
+    {
+        *val = ((c & 0x1F) << 6) | (s[1] & 0x3F);
+        return o + 2;
+    }
+    else if (c < 0xF0)
+    {
+        *val = ((c & 0x0F) << 12) | ((s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+        return o + 3;
+    }
+    else
+    {
+        *val = ((c & 0x07) << 18) | ((s[1] & 0x3F) << 12) | ((s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+        return o + 4;
+    }
+}
+
+/*
+** Block scanners consume valid characters from the start of [s, e) that end before e, add their number to *n and return
+** the end of the consumed characters; they may stop early, leaving the rest to utf8_decode, which reports the errors.
+*/
+#if !UTF8_SSE2 && !UTF8_NEON
+static const char* scanscalar(const char* s, const char* e, int* n)
+{
+    const char* p = s;
+    for (; p + 8 <= e; p += 8)
+    {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        if (w & 0x8080808080808080ull)
+            break;
+    }
+    *n += int(p - s);
+    return p;
+}
+#endif
+
+#if UTF8_SSE41 || UTF8_NEON
+// flags of the errors that a pair of adjacent bytes can show, looked up by the high and the low nibble of the first byte
+// and by the high nibble of the second one; an error is found when all three lookups have its flag
+#define TOO_SHORT (1 << 0)      // 11______ 0_______, 11______ 11______
+#define TOO_LONG (1 << 1)       // 0_______ 10______
+#define OVERLONG_3 (1 << 2)     // 11100000 100_____
+#define TOO_LARGE (1 << 3)      // 11110100 1001____, 11110100 101_____, 11110101+ 1001____, 11110101+ 101_____
+#define SURROGATE (1 << 4)      // 11101101 101_____
+#define OVERLONG_2 (1 << 5)     // 1100000_ 10______
+#define TOO_LARGE_1000 (1 << 6) // 11110101+ 1000____
+#define OVERLONG_4 (1 << 6)     // 11110000 1000____
+#define TWO_CONTS (1 << 7)      // 10______ 10______
+#define CARRY (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+static const uint8_t kByte1High[16] = {
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, // ASCII
+    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,                                     // continuation
+    TOO_SHORT | OVERLONG_2,                                                         // 1100____
+    TOO_SHORT,                                                                      // 1101____
+    TOO_SHORT | OVERLONG_3 | SURROGATE,                                             // 1110____
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,                            // 1111____
+};
+
+static const uint8_t kByte1Low[16] = {
+    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,     // ____0000
+    CARRY | OVERLONG_2,                               // ____0001
+    CARRY,                                            // ____0010
+    CARRY,                                            // ____0011
+    CARRY | TOO_LARGE,                                // ____0100
+    CARRY | TOO_LARGE | TOO_LARGE_1000,               // ____0101
+    CARRY | TOO_LARGE | TOO_LARGE_1000,               // ____0110
+    CARRY | TOO_LARGE | TOO_LARGE_1000,               // ____0111
+    CARRY | TOO_LARGE | TOO_LARGE_1000,               // ____1000
+    CARRY | TOO_LARGE | TOO_LARGE_1000,               // ____1001
+    CARRY | TOO_LARGE | TOO_LARGE_1000,               // ____1010
+    CARRY | TOO_LARGE | TOO_LARGE_1000,               // ____1011
+    CARRY | TOO_LARGE | TOO_LARGE_1000,               // ____1100
+    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,   // ____1101
+    CARRY | TOO_LARGE | TOO_LARGE_1000,               // ____1110
+    CARRY | TOO_LARGE | TOO_LARGE_1000,               // ____1111
+};
+
+static const uint8_t kByte2High[16] = {
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, // ASCII
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,           // 1000____
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,                             // 1001____
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,                              // 1010____
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,                              // 1011____
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,                                             // lead byte
+};
+
+// a lead byte in one of the last bytes that its character doesn't fit in
+static const uint8_t kIncomplete[16] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1,
+};
+
+// the blocks before p are valid, except that their last character may be cut short
+static const char* backoff(const char* s, const char* p, int* n)
+{
+    for (int k = 1; k <= 3 && p - k >= s; k++)
+    {
+        unsigned int c = (unsigned char)p[-k];
+        if ((c & 0xC0) != 0x80)
+        {
+            int len = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+            if (len <= k)
+                break;
+            (*n)--;
+            return p - k;
+        }
+    }
+    return p;
+}
+#endif
+
+#if UTF8_SSE2
+static int popcount16(unsigned x)
+{
+    x = x - ((x >> 1) & 0x5555);
+    x = (x & 0x3333) + ((x >> 2) & 0x3333);
+    x = (x + (x >> 4)) & 0x0F0F;
+    return (x + (x >> 8)) & 0x1F;
+}
+
+static const char* scansse2(const char* s, const char* e, int* n)
+{
+    const char* p = s;
+    for (; p + 16 <= e; p += 16)
+        if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)p)))
+            break;
+    *n += int(p - s);
+    return p;
+}
+
+// number of bytes in a block that start a character
+static int countstarts(const char* p)
+{
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    return 16 - popcount16(_mm_movemask_epi8(_mm_cmplt_epi8(v, _mm_set1_epi8(-64))));
+}
+#elif UTF8_NEON
+static int countstarts(const char* p)
+{
+    int8x16_t v = vld1q_s8((const int8_t*)p);
+    return 16 - vaddvq_u8(vshrq_n_u8(vcltq_s8(v, vdupq_n_s8(-64)), 7));
+}
+#else
+static int countstarts(const char* p)
+{
+    int n = 0;
+    for (int i = 0; i < 16; i++)
+        n += (p[i] & 0xC0) != 0x80;
+    return n;
+}
+#endif
+
+#if UTF8_SSE41
+UTF8_TARGET_SSE41 static const char* scansse41(const char* s, const char* e, int* n)
+{
+    const __m128i byte1high = _mm_loadu_si128((const __m128i*)kByte1High);
+    const __m128i byte1low = _mm_loadu_si128((const __m128i*)kByte1Low);
+    const __m128i byte2high = _mm_loadu_si128((const __m128i*)kByte2High);
+    const __m128i incompletemax = _mm_loadu_si128((const __m128i*)kIncomplete);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i cont = _mm_set1_epi8(-64); // continuation bytes are below it as signed
+    __m128i prev = _mm_setzero_si128();
+    __m128i incomplete = _mm_setzero_si128();
+    const char* p = s;
+    int count = 0;
+
+    for (; p + 16 <= e; p += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+
+        if (_mm_movemask_epi8(v) == 0)
+        {
+            // ASCII is valid unless it follows a character that needs more bytes
+            if (!_mm_testz_si128(incomplete, incomplete))
+                break;
+            count += 16;
+            prev = v;
+            continue;
+        }
+
+        __m128i prev1 = _mm_alignr_epi8(v, prev, 15);
+        __m128i special = _mm_and_si128(
+            _mm_and_si128(
+                _mm_shuffle_epi8(byte1high, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                _mm_shuffle_epi8(byte1low, _mm_and_si128(prev1, nibble))
+            ),
+            _mm_shuffle_epi8(byte2high, _mm_and_si128(_mm_srli_epi16(v, 4), nibble))
+        );
+
+        // third and fourth bytes of a character have to be continuations, and are the only continuations that follow one
+        __m128i must23 = _mm_or_si128(
+            _mm_subs_epu8(_mm_alignr_epi8(v, prev, 14), _mm_set1_epi8(char(0xE0 - 0x80))),
+            _mm_subs_epu8(_mm_alignr_epi8(v, prev, 13), _mm_set1_epi8(char(0xF0 - 0x80)))
+        );
+        __m128i error = _mm_xor_si128(_mm_and_si128(must23, _mm_set1_epi8(char(0x80))), special);
+
+        if (!_mm_testz_si128(error, error))
+            break;
+
+        count += 16 - popcount16(_mm_movemask_epi8(_mm_cmplt_epi8(v, cont)));
+        prev = v;
+        incomplete = _mm_subs_epu8(v, incompletemax);
+    }
+
+    p = backoff(s, p, &count);
+    *n += count;
+    return p;
+}
+
+static bool luau_hassse41()
+{
+#if defined(__SSE4_1__) || defined(__AVX__)
+    return true;
+#else
+    int cpuinfo[4] = {};
+#ifdef _MSC_VER
+    __cpuid(cpuinfo, 1);
+#else
+    __cpuid(1, cpuinfo[0], cpuinfo[1], cpuinfo[2], cpuinfo[3]);
+#endif
+
+    // PSHUFB and PALIGNR come from SSSE3 and PTEST from SSE4.1
+    // https://en.wikipedia.org/wiki/CPUID#EAX=1:_Processor_Info_and_Feature_Bits
+    return (cpuinfo[2] & (1 << 19)) != 0;
+#endif
+}
+#endif
+
+#if UTF8_NEON
+static const char* scanneon(const char* s, const char* e, int* n)
+{
+    const uint8x16_t byte1high = vld1q_u8(kByte1High);
+    const uint8x16_t byte1low = vld1q_u8(kByte1Low);
+    const uint8x16_t byte2high = vld1q_u8(kByte2High);
+    const uint8x16_t incompletemax = vld1q_u8(kIncomplete);
+    const uint8x16_t nibble = vdupq_n_u8(0x0F);
+    uint8x16_t prev = vdupq_n_u8(0);
+    uint8x16_t incomplete = vdupq_n_u8(0);
+    const char* p = s;
+    int count = 0;
+
+    for (; p + 16 <= e; p += 16)
+    {
+        uint8x16_t v = vld1q_u8((const uint8_t*)p);
+
+        if (vmaxvq_u8(v) < 0x80)
+        {
+            // ASCII is valid unless it follows a character that needs more bytes
+            if (vmaxvq_u8(incomplete) != 0)
+                break;
+            count += 16;
+            prev = v;
+            continue;
+        }
+
+        uint8x16_t prev1 = vextq_u8(prev, v, 15);
+        uint8x16_t special = vandq_u8(
+            vandq_u8(vqtbl1q_u8(byte1high, vshrq_n_u8(prev1, 4)), vqtbl1q_u8(byte1low, vandq_u8(prev1, nibble))),
+            vqtbl1q_u8(byte2high, vshrq_n_u8(v, 4))
+        );
+
+        // third and fourth bytes of a character have to be continuations, and are the only continuations that follow one
+        uint8x16_t must23 =
+            vorrq_u8(vqsubq_u8(vextq_u8(prev, v, 14), vdupq_n_u8(0xE0 - 0x80)), vqsubq_u8(vextq_u8(prev, v, 13), vdupq_n_u8(0xF0 - 0x80)));
+        uint8x16_t error = veorq_u8(vandq_u8(must23, vdupq_n_u8(0x80)), special);
+
+        if (vmaxvq_u8(error) != 0)
+            break;
+
+        count += 16 - vaddvq_u8(vshrq_n_u8(vcltq_s8(vreinterpretq_s8_u8(v), vdupq_n_s8(-64)), 7));
+        prev = v;
+        incomplete = vqsubq_u8(v, incompletemax);
+    }
+
+    p = backoff(s, p, &count);
+    *n += count;
+    return p;
+}
+#endif
+
+static const char* (*const utf8scan)(const char* s, const char* e, int* n) =
+#if UTF8_SSE41
+    luau_hassse41() ? scansse41 : scansse2;
+#elif UTF8_SSE2
+    scansse2;
+#elif UTF8_NEON
+    scanneon;
+#else
+    scanscalar;
+#endif
+
+// like luaL_checklstring, but substrings are read in place instead of being interned, so the contents aren't necessarily terminated
+static const char* checkstringview(lua_State* L, int arg, size_t* len)
+{
+    const char* s = lua_tolstringview(L, arg, len);
+    if (!s)
+        luaL_typeerror(L, arg, "string");
+    return s;
+}
+
 /*
 ** utf8len(s [, i [, j]]) --> number of characters that start in the
 ** range [i,j], or nil + current position if 's' is not well formed in
@@ -63,14 +406,18 @@ static int utflen(lua_State* L)
 {
     int n = 0;
     size_t len;
-    const char* s = luaL_checklstring(L, 1, &len);
+    const char* s = checkstringview(L, 1, &len);
     int posi = u_posrelat(luaL_optinteger(L, 2, 1), len);
     int posj = u_posrelat(luaL_optinteger(L, 3, -1), len);
     luaL_argcheck(L, 1 <= posi && --posi <= (int)len, 2, "initial position out of string");
     luaL_argcheck(L, --posj < (int)len, 3, "final position out of string");
     while (posi <= posj)
     {
-        const char* s1 = utf8_decode(s + posi, NULL);
+        // blocks of valid characters are counted at once
+        posi = (int)(utf8scan(s + posi, s + posj + 1, &n) - s);
+        if (posi > posj)
+            break;
+        const char* s1 = utf8_decode(s + posi, s + len, NULL);
         if (s1 == NULL)
         {                                 // conversion error?
             lua_pushnil(L);               // return nil ...
@@ -91,11 +438,12 @@ static int utflen(lua_State* L)
 static int codepoint(lua_State* L)
 {
     size_t len;
-    const char* s = luaL_checklstring(L, 1, &len);
+    const char* s = checkstringview(L, 1, &len);
     int posi = u_posrelat(luaL_optinteger(L, 2, 1), len);
     int pose = u_posrelat(luaL_optinteger(L, 3, posi), len);
     int n;
     const char* se;
+    const char* send = s + len;
     luaL_argcheck(L, posi >= 1, 2, "out of range");
     luaL_argcheck(L, pose <= (int)len, 3, "out of range");
     if (posi > pose)
@@ -106,10 +454,18 @@ static int codepoint(lua_State* L)
     luaL_checkstack(L, n, "string slice too long");
     n = 0;
     se = s + pose;
-    for (s += posi - 1; s < se;)
+    s += posi - 1;
+    // characters in the blocks that pass validation are decoded without checks
+    for (const char* sv = utf8scan(s, se, &n); s < sv;)
     {
         int code;
-        s = utf8_decode(s, &code);
+        s = utf8_decodevalid(s, &code);
+        lua_pushinteger(L, code);
+    }
+    while (s < se)
+    {
+        int code;
+        s = utf8_decode(s, send, &code);
         if (s == NULL)
             luaL_error(L, "invalid UTF-8 code");
         lua_pushinteger(L, code);
@@ -118,6 +474,75 @@ static int codepoint(lua_State* L)
     return n;
 }
 
+/*
+** codepoints(s, [i, [j, [dest, [offset]]]]) -> dest, n
+** decodes the characters that start in the range [i,j] into a new table,
+** into the table 'dest' from index 'offset' (1 by default), or into the
+** buffer 'dest' as 32-bit integers from byte 'offset' (0 by default)
+*/
+static int codepoints(lua_State* L)
+{
+    size_t len;
+    const char* s = checkstringview(L, 1, &len);
+    int posi = u_posrelat(luaL_optinteger(L, 2, 1), len);
+    int pose = u_posrelat(luaL_optinteger(L, 3, -1), len);
+    int tt = lua_type(L, 4);
+    luaL_argcheck(L, posi >= 1, 2, "out of range");
+    luaL_argcheck(L, pose <= (int)len, 3, "out of range");
+    luaL_argexpected(L, tt == LUA_TNONE || tt == LUA_TNIL || tt == LUA_TTABLE || tt == LUA_TBUFFER, 4, "table or buffer");
+    int n = 0;
+    const char* send = s + len;
+    s += posi - 1;
+    if (posi <= pose)
+    {
+        // validate the characters first to know their number
+        const char* se = s + (pose - posi) + 1;
+        for (const char* p = utf8scan(s, se, &n); p < se; n++)
+        {
+            p = utf8_decode(p, send, NULL);
+            if (p == NULL)
+                luaL_error(L, "invalid UTF-8 code");
+        }
+    }
+    if (tt == LUA_TBUFFER)
+    {
+        size_t size;
+        unsigned char* buff = (unsigned char*)lua_tobuffer(L, 4, &size);
+        int offset = luaL_optinteger(L, 5, 0);
+        if (offset < 0 || uint64_t(offset) + uint64_t(n) * 4 > size)
+            luaL_error(L, "buffer access out of bounds");
+        buff += offset;
+        for (int i = 0; i < n; i++, buff += 4)
+        {
+            int code;
+            s = utf8_decodevalid(s, &code);
+            buff[0] = (unsigned char)code;
+            buff[1] = (unsigned char)(code >> 8);
+            buff[2] = (unsigned char)(code >> 16);
+            buff[3] = 0;
+        }
+        lua_pushvalue(L, 4);
+    }
+    else
+    {
+        int offset = luaL_optinteger(L, 5, 1);
+        luaL_argcheck(L, n == 0 || offset <= INT_MAX - (n - 1), 5, "out of range");
+        if (tt == LUA_TTABLE)
+            lua_pushvalue(L, 4);
+        else
+            lua_createtable(L, n, 0);
+        for (int i = 0; i < n; i++)
+        {
+            int code;
+            s = utf8_decodevalid(s, &code);
+            lua_pushinteger(L, code);
+            lua_rawseti(L, -2, offset + i);
+        }
+    }
+    lua_pushinteger(L, n);
+    return 2;
+}
+
 // from Lua 5.3 lobject.h
 #define UTF8BUFFSZ 8
 
@@ -191,7 +616,7 @@ static int utfchar(lua_State* L)
 static int byteoffset(lua_State* L)
 {
     size_t len;
-    const char* s = luaL_checklstring(L, 1, &len);
+    const char* s = checkstringview(L, 1, &len);
     int n = luaL_checkinteger(L, 2);
     int posi = (n >= 0) ? 1 : (int)len + 1;
     posi = u_posrelat(luaL_optinteger(L, 3, posi), len);
@@ -199,15 +624,24 @@ static int byteoffset(lua_State* L)
     if (n == 0)
     {
         // find beginning of current byte sequence
-        while (posi > 0 && iscont(s + posi))
+        while (posi > 0 && posi < (int)len && iscont(s + posi))
             posi--;
     }
     else
     {
-        if (iscont(s + posi))
+        if (posi < (int)len && iscont(s + posi))
             luaL_error(L, "initial position is a continuation byte");
         if (n < 0)
         {
+            // skip blocks with fewer character starts than there are characters to move back
+            while (n < -16 && posi > 16)
+            {
+                int starts = countstarts(s + posi - 16);
+                if (n + starts >= 0)
+                    break;
+                posi -= 16;
+                n += starts;
+            }
             while (n < 0 && posi > 0)
             { // move back
                 do
@@ -220,12 +654,26 @@ static int byteoffset(lua_State* L)
         else
         {
             n--; // do not move for 1st character
+            // skip blocks with fewer character starts than there are characters to move forward
+            if (n > 16)
+            {
+                int posb = posi + 1;
+                while (n > 16 && posb + 16 <= (int)len)
+                {
+                    int starts = countstarts(s + posb);
+                    if (starts >= n)
+                        break;
+                    posb += 16;
+                    n -= starts;
+                }
+                posi = posb - 1;
+            }
             while (n > 0 && posi < (int)len)
             {
                 do
                 { // find beginning of next character
                     posi++;
-                } while (iscont(s + posi)); // (cannot pass final '\0')
+                } while (posi < (int)len && iscont(s + posi));
                 n--;
             }
         }
@@ -240,14 +688,14 @@ static int byteoffset(lua_State* L)
 static int iter_aux(lua_State* L)
 {
     size_t len;
-    const char* s = luaL_checklstring(L, 1, &len);
+    const char* s = checkstringview(L, 1, &len);
     int n = lua_tointeger(L, 2) - 1;
     if (n < 0) // first iteration?
         n = 0; // start from here
     else if (n < (int)len)
     {
         n++; // skip current byte
-        while (iscont(s + n))
+        while (n < (int)len && iscont(s + n))
             n++; // and its continuations
     }
     if (n >= (int)len)
@@ -255,8 +703,8 @@ static int iter_aux(lua_State* L)
     else
     {
         int code;
-        const char* next = utf8_decode(s + n, &code);
-        if (next == NULL || iscont(next))
+        const char* next = utf8_decode(s + n, s + len, &code);
+        if (next == NULL || (next < s + len && iscont(next)))
             luaL_error(L, "invalid UTF-8 code");
         lua_pushinteger(L, n + 1);
         lua_pushinteger(L, code);
@@ -266,7 +714,7 @@ static int iter_aux(lua_State* L)
 
 static int iter_codes(lua_State* L)
 {
-    luaL_checkstring(L, 1);
+    checkstringview(L, 1, NULL);
     lua_pushcfunction(L, iter_aux, NULL);
     lua_pushvalue(L, 1);
     lua_pushinteger(L, 0);
@@ -279,6 +727,7 @@ static int iter_codes(lua_State* L)
 static const luaL_Reg funcs[] = {
     {"offset", byteoffset},
     {"codepoint", codepoint},
+    {"codepoints", codepoints},
     {"char", utfchar},
     {"len", utflen},
     {"codes", iter_codes},
@@ -31,6 +31,17 @@ LUAI_FUNC void luaV_prepareFORN(lua_State* L, StkId plimit, StkId pstep, StkId p
 LUAI_FUNC void luaV_callTM(lua_State* L, int nparams, int res);
 LUAI_FUNC void luaV_tryfuncTM(lua_State* L, StkId func);
 
+LUAI_FUNC const TValue* luaV_icacheget(lua_State* L, Proto* p, const Instruction* pc, LuaTable* h, LuaTable* mt, TString* key);
+LUAI_FUNC void luaV_icachefill(lua_State* L, Proto* p, const Instruction* pc, LuaTable* mt, int slot);
+
+LUAI_FUNC const char* luaV_verifyproto(lua_State* L, Proto* p, int* errpc);
+LUAI_FUNC void luaV_trimloadcache(lua_State* L);
+LUAI_FUNC void luaV_clearloadcache(lua_State* L);
+LUAI_FUNC void luaV_materialize(lua_State* L, Proto* p, LuaTable* env);
+LUAI_FUNC void luaV_loadlineinfo(lua_State* L, Proto* p);
+LUAI_FUNC void luaV_loaddebuginfo(lua_State* L, Proto* p);
+LUAI_FUNC void luaV_releasechunk(lua_State* L, struct LazyChunk* chunk);
+
 LUAI_FUNC void luau_execute(lua_State* L);
 LUAI_FUNC int luau_precall(lua_State* L, struct lua_TValue* func, int nresults);
 LUAI_FUNC void luau_poscall(lua_State* L, StkId first);
@@ -68,10 +68,9 @@
 
 #define VM_INTERRUPT() \
     { \
-        void (*interrupt)(lua_State*, int) = L->global->cb.interrupt; \
-        if (LUAU_UNLIKELY(!!interrupt)) \
+        if (LUAU_UNLIKELY(hasinterrupt(L->global))) \
         { /* the interrupt hook is called right before we advance pc */ \
-            VM_PROTECT(L->ci->savedpc++; interrupt(L, -1)); \
+            VM_PROTECT(L->ci->savedpc++; luaG_interrupt(L, -1)); \
             if (L->status != 0) \
             { \
                 L->ci->savedpc--; \
@@ -102,7 +101,10 @@
         VM_DISPATCH_OP(LOP_CAPTURE), VM_DISPATCH_OP(LOP_SUBRK), VM_DISPATCH_OP(LOP_DIVRK), VM_DISPATCH_OP(LOP_FASTCALL1), \
         VM_DISPATCH_OP(LOP_FASTCALL2), VM_DISPATCH_OP(LOP_FASTCALL2K), VM_DISPATCH_OP(LOP_FORGPREP), VM_DISPATCH_OP(LOP_JUMPXEQKNIL), \
         VM_DISPATCH_OP(LOP_JUMPXEQKB), VM_DISPATCH_OP(LOP_JUMPXEQKN), VM_DISPATCH_OP(LOP_JUMPXEQKS), VM_DISPATCH_OP(LOP_IDIV), \
-        VM_DISPATCH_OP(LOP_IDIVK),
+        VM_DISPATCH_OP(LOP_IDIVK), VM_DISPATCH_OP(LOP_FUSED_GETIMPORT_CALL), VM_DISPATCH_OP(LOP_FUSED_GETTABLEKS_NAMECALL), \
+        VM_DISPATCH_OP(LOP_FUSED_LOADN_FORNPREP),
+
+static_assert(LOP_FUSED_GETIMPORT_CALL == LOP_IDIVK + 1, "fused opcodes have to follow bytecode opcodes in the dispatch table");
 
 #if defined(__GNUC__) || defined(__clang__)
 #define VM_USE_CGOTO 1
@@ -130,6 +132,19 @@
     goto dispatchContinue
 #endif
 
+// VM_FUSED_NEXT(op) ends the first half of a superinstruction by jumping straight to the handler of the second instruction
+// the opcode is checked since the second instruction may be patched by a breakpoint, and single-step mode has to stop at every instruction
+#if VM_USE_CGOTO
+#define VM_FUSED_NEXT(op) \
+    { \
+        if (SingleStep || LUAU_INSN_OP(*pc) != op) \
+            VM_NEXT(); \
+        goto CASE_##op; \
+    }
+#else
+#define VM_FUSED_NEXT(op) VM_NEXT()
+#endif
+
 // Does VM support native execution via ExecutionCallbacks? We mostly assume it does but keep the define to make it easy to quantify the cost.
 #define VM_HAS_NATIVE 1
 
@@ -159,6 +174,9 @@ LUAU_NOINLINE void luau_callhook(lua_State* L, lua_Hook hook, void* userdata)
 
     Closure* cl = clvalue(L->ci->func);
 
+    if (!cl->isC && cl->l.p->lazylineinfo)
+        luaV_loadlineinfo(L, cl->l.p);
+
     lua_Debug ar;
     ar.currentline = cl->isC ? -1 : luaG_getline(cl->l.p, pcRel(L->ci->savedpc, cl->l.p));
     ar.userdata = userdata;
@@ -191,6 +209,62 @@ inline bool luau_skipstep(uint8_t op)
     return op == LOP_PREPVARARGS || op == LOP_BREAK;
 }
 
+// looks the key up in the inline cache of the table access instruction at pc; h is the receiver, or NULL when it's a userdata
+static LUAU_FORCEINLINE TValue* luau_icachelookup(lua_State* L, Proto* p, const Instruction* pc, LuaTable* h, LuaTable* mt, TString* key)
+{
+    if (!p->icindex || p->icindex[pc - p->code] == 0)
+        return NULL;
+
+    const InlineCache* ic = &p->icache[p->icindex[pc - p->code] - 1];
+
+    for (int i = 0; i < ic->size; ++i)
+    {
+        if (ic->metatable[i] != mt)
+            continue;
+
+        LuaTable* t = h;
+        int slot = ic->slot[i];
+
+        if (slot < 0)
+        {
+            // the __index table is only consulted when the key is absent from the receiver
+            if (h)
+            {
+                for (LuaNode* n = &h->node[key->hash & (sizenode(h) - 1)];; n += gnext(n))
+                {
+                    if (ttisstring(gkey(n)) && tsvalue(gkey(n)) == key)
+                        return NULL;
+
+                    if (gnext(n) == 0)
+                        break;
+                }
+            }
+
+            const TValue* index = fasttm(L, mt, TM_INDEX);
+
+            if (!index || !ttistable(index))
+                return NULL;
+
+            t = hvalue(index);
+            slot = ~slot;
+        }
+        else if (!h)
+            return NULL;
+
+        LuaNode* n = &t->node[slot & (sizenode(t) - 1)];
+
+        if (ttisstring(gkey(n)) && tsvalue(gkey(n)) == key && !ttisnil(gval(n)))
+        {
+            L->global->metrics.icachehits++;
+            return gval(n);
+        }
+
+        return NULL;
+    }
+
+    return NULL;
+}
+
 template<bool SingleStep>
 static void luau_execute(lua_State* L)
 {
@@ -475,8 +549,22 @@ reentry:
                         setobj2s(L, ra, res);
                         VM_NEXT();
                     }
+                    else if (const TValue* res = luau_icachelookup(L, cl->l.p, pc - 2, h, h->metatable, tsvalue(kv)))
+                    {
+                        // fast-path: objects of several classes, value is in the slot the inline cache has for the metatable
+                        setobj2s(L, ra, res);
+                        VM_NEXT();
+                    }
                     else
                     {
+                        VM_PROTECT_PC(); // inline cache allocation may fail
+
+                        if (const TValue* res = luaV_icacheget(L, cl->l.p, pc - 2, h, h->metatable, tsvalue(kv)))
+                        {
+                            setobj2s(L, ra, res);
+                            VM_NEXT();
+                        }
+
                         // slow-path, may invoke Lua calls via __index metamethod
                         L->cachedslot = slot;
                         VM_PROTECT(luaV_gettable(L, rb, kv, ra));
@@ -580,12 +668,27 @@ reentry:
                     }
                     else if (fastnotm(h->metatable, TM_NEWINDEX) && !h->readonly)
                     {
+                        // fast-path: objects of several classes, field is in the slot the inline cache has for the metatable
+                        if (TValue* res = h->metatable ? luau_icachelookup(L, cl->l.p, pc - 2, h, h->metatable, tsvalue(kv)) : NULL)
+                        {
+                            setobj2t(L, res, ra);
+                            luaC_barriert(L, h, ra);
+                            VM_NEXT();
+                        }
+
                         VM_PROTECT_PC(); // set may fail
 
                         TValue* res = luaH_setstr(L, h, tsvalue(kv));
                         int cachedslot = gval2slot(h, res);
                         // save cachedslot to accelerate future lookups; patches currently executing instruction since pc-2 rolls back two pc++
                         VM_PATCH_C(pc - 2, cachedslot);
+
+                        if (h->metatable)
+                        {
+                            L->global->metrics.icachemisses++;
+                            luaV_icachefill(L, cl->l.p, pc - 2, h->metatable, cachedslot);
+                        }
+
                         setobj2t(L, res, ra);
                         luaC_barriert(L, h, ra);
                         VM_NEXT();
@@ -751,11 +854,16 @@ reentry:
             VM_CASE(LOP_NEWCLOSURE)
             {
                 Instruction insn = *pc++;
-                StkId ra = VM_REG(LUAU_INSN_A(insn));
 
                 Proto* pv = cl->l.p->p[LUAU_INSN_D(insn)];
                 LUAU_ASSERT(unsigned(LUAU_INSN_D(insn)) < unsigned(cl->l.p->sizep));
 
+                // functions of mapped chunks are deserialized on first use; this can resolve imports which may reallocate the stack
+                if (LUAU_UNLIKELY(pv->lazyoffset))
+                    VM_PROTECT(luaV_materialize(L, pv, cl->env));
+
+                StkId ra = VM_REG(LUAU_INSN_A(insn));
+
                 VM_PROTECT_PC(); // luaF_newLclosure may fail due to OOM
 
                 // note: we save closure to stack early in case the code below wants to capture it by value
@@ -826,18 +934,38 @@ reentry:
                         setobj2s(L, ra + 1, rb);
                         setobj2s(L, ra, gval(mtn));
                     }
+                    // fast-path: objects of several classes, method is in the slot the inline cache has for the metatable
+                    else if (const TValue* res = h->metatable ? luau_icachelookup(L, cl->l.p, pc - 2, h, h->metatable, tsvalue(kv)) : NULL)
+                    {
+                        // note: order of copies allows rb to alias ra+1 or ra
+                        setobj2s(L, ra + 1, rb);
+                        setobj2s(L, ra, res);
+                    }
                     else
                     {
-                        // slow-path: handles full table lookup
+                        VM_PROTECT_PC(); // inline cache allocation may fail
+
+                        const TValue* raw = h->metatable ? luaV_icacheget(L, cl->l.p, pc - 2, h, h->metatable, tsvalue(kv)) : NULL;
+
+                        // note: order of copies allows rb to alias ra+1 or ra
                         setobj2s(L, ra + 1, rb);
-                        L->cachedslot = LUAU_INSN_C(insn);
-                        VM_PROTECT(luaV_gettable(L, rb, kv, ra));
-                        // save cachedslot to accelerate future lookups; patches currently executing instruction since pc-2 rolls back two pc++
-                        VM_PATCH_C(pc - 2, L->cachedslot);
-                        // recompute ra since stack might have been reallocated
-                        ra = VM_REG(LUAU_INSN_A(insn));
-                        if (ttisnil(ra))
-                            luaG_methoderror(L, ra + 1, tsvalue(kv));
+
+                        if (raw)
+                        {
+                            setobj2s(L, ra, raw);
+                        }
+                        else
+                        {
+                            // slow-path: handles full table lookup
+                            L->cachedslot = LUAU_INSN_C(insn);
+                            VM_PROTECT(luaV_gettable(L, rb, kv, ra));
+                            // save cachedslot to accelerate future lookups; patches currently executing instruction since pc-2 rolls back two pc++
+                            VM_PATCH_C(pc - 2, L->cachedslot);
+                            // recompute ra since stack might have been reallocated
+                            ra = VM_REG(LUAU_INSN_A(insn));
+                            if (ttisnil(ra))
+                                luaG_methoderror(L, ra + 1, tsvalue(kv));
+                        }
                     }
                 }
                 else
@@ -867,18 +995,38 @@ reentry:
                             setobj2s(L, ra + 1, rb);
                             setobj2s(L, ra, gval(n));
                         }
+                        // fast-path: userdata of several classes, method is in the slot the inline cache has for the metatable
+                        else if (const TValue* res = luau_icachelookup(L, cl->l.p, pc - 2, NULL, mt, tsvalue(kv)))
+                        {
+                            // note: order of copies allows rb to alias ra+1 or ra
+                            setobj2s(L, ra + 1, rb);
+                            setobj2s(L, ra, res);
+                        }
                         else
                         {
-                            // slow-path: handles slot mismatch
+                            VM_PROTECT_PC(); // inline cache allocation may fail
+
+                            const TValue* raw = luaV_icacheget(L, cl->l.p, pc - 2, NULL, mt, tsvalue(kv));
+
+                            // note: order of copies allows rb to alias ra+1 or ra
                             setobj2s(L, ra + 1, rb);
-                            L->cachedslot = slot;
-                            VM_PROTECT(luaV_gettable(L, rb, kv, ra));
-                            // save cachedslot to accelerate future lookups; patches currently executing instruction since pc-2 rolls back two pc++
-                            VM_PATCH_C(pc - 2, L->cachedslot);
-                            // recompute ra since stack might have been reallocated
-                            ra = VM_REG(LUAU_INSN_A(insn));
-                            if (ttisnil(ra))
-                                luaG_methoderror(L, ra + 1, tsvalue(kv));
+
+                            if (raw)
+                            {
+                                setobj2s(L, ra, raw);
+                            }
+                            else
+                            {
+                                // slow-path: handles slot mismatch
+                                L->cachedslot = slot;
+                                VM_PROTECT(luaV_gettable(L, rb, kv, ra));
+                                // save cachedslot to accelerate future lookups; patches currently executing instruction since pc-2 rolls back two pc++
+                                VM_PATCH_C(pc - 2, L->cachedslot);
+                                // recompute ra since stack might have been reallocated
+                                ra = VM_REG(LUAU_INSN_A(insn));
+                                if (ttisnil(ra))
+                                    luaG_methoderror(L, ra + 1, tsvalue(kv));
+                            }
                         }
                     }
                     else
@@ -1123,6 +1271,10 @@ reentry:
                         VM_NEXT();
 
                     case LUA_TSTRING:
+                        pc += luaS_eqstr(tsvalue(ra), tsvalue(rb)) ? LUAU_INSN_D(insn) : 1;
+                        LUAU_ASSERT(unsigned(pc - cl->l.p->code) < unsigned(cl->l.p->sizecode));
+                        VM_NEXT();
+
                     case LUA_TFUNCTION:
                     case LUA_TTHREAD:
                     case LUA_TBUFFER:
@@ -1238,6 +1390,10 @@ reentry:
                         VM_NEXT();
 
                     case LUA_TSTRING:
+                        pc += !luaS_eqstr(tsvalue(ra), tsvalue(rb)) ? LUAU_INSN_D(insn) : 1;
+                        LUAU_ASSERT(unsigned(pc - cl->l.p->code) < unsigned(cl->l.p->sizecode));
+                        VM_NEXT();
+
                     case LUA_TFUNCTION:
                     case LUA_TTHREAD:
                     case LUA_TBUFFER:
@@ -2517,11 +2673,15 @@ reentry:
             VM_CASE(LOP_DUPCLOSURE)
             {
                 Instruction insn = *pc++;
-                StkId ra = VM_REG(LUAU_INSN_A(insn));
                 TValue* kv = VM_KV(LUAU_INSN_D(insn));
 
                 Closure* kcl = clvalue(kv);
 
+                if (LUAU_UNLIKELY(kcl->l.p->lazyoffset))
+                    VM_PROTECT(luaV_materialize(L, kcl->l.p, cl->env));
+
+                StkId ra = VM_REG(LUAU_INSN_A(insn));
+
                 VM_PROTECT_PC(); // luaF_newLclosure may fail due to OOM
 
                 // clone closure if the environment is not shared
@@ -3026,11 +3186,60 @@ reentry:
                 TValue* kv = VM_KV(aux & 0xffffff);
                 LUAU_ASSERT(ttisstring(kv));
 
-                pc += int(ttisstring(ra) && gcvalue(ra) == gcvalue(kv)) != (aux >> 31) ? LUAU_INSN_D(insn) : 1;
+                pc += int(ttisstring(ra) && luaS_eqstr(tsvalue(ra), tsvalue(kv))) != (aux >> 31) ? LUAU_INSN_D(insn) : 1;
                 LUAU_ASSERT(unsigned(pc - cl->l.p->code) < unsigned(cl->l.p->sizecode));
                 VM_NEXT();
             }
 
+            VM_CASE(LOP_FUSED_GETIMPORT_CALL)
+            {
+                Instruction insn = *pc;
+                StkId ra = VM_REG(LUAU_INSN_A(insn));
+                TValue* kv = VM_KV(LUAU_INSN_D(insn));
+
+                // imports that need to be resolved are left to the regular instruction
+                if (LUAU_UNLIKELY(ttisnil(kv) || !cl->env->safeenv))
+                    VM_CONTINUE(LOP_GETIMPORT);
+
+                setobj2s(L, ra, kv);
+                pc += 2; // skip over AUX
+                VM_FUSED_NEXT(LOP_CALL);
+            }
+
+            VM_CASE(LOP_FUSED_GETTABLEKS_NAMECALL)
+            {
+                Instruction insn = *pc;
+                StkId ra = VM_REG(LUAU_INSN_A(insn));
+                StkId rb = VM_REG(LUAU_INSN_B(insn));
+                TValue* kv = VM_KV(pc[1]);
+                LUAU_ASSERT(ttisstring(kv));
+
+                // fast-path: built-in table with the value in the expected slot; any other lookup is left to the regular instruction
+                if (LUAU_LIKELY(ttistable(rb)))
+                {
+                    LuaTable* h = hvalue(rb);
+                    LuaNode* n = &h->node[LUAU_INSN_C(insn) & h->nodemask8];
+
+                    if (LUAU_LIKELY(ttisstring(gkey(n)) && tsvalue(gkey(n)) == tsvalue(kv) && !ttisnil(gval(n))))
+                    {
+                        setobj2s(L, ra, gval(n));
+                        pc += 2; // skip over AUX
+                        VM_FUSED_NEXT(LOP_NAMECALL);
+                    }
+                }
+
+                VM_CONTINUE(LOP_GETTABLEKS);
+            }
+
+            VM_CASE(LOP_FUSED_LOADN_FORNPREP)
+            {
+                Instruction insn = *pc++;
+                StkId ra = VM_REG(LUAU_INSN_A(insn));
+
+                setnvalue(ra, LUAU_INSN_D(insn));
+                VM_FUSED_NEXT(LOP_FORNPREP);
+            }
+
 #if !VM_USE_CGOTO
         default:
             LUAU_ASSERT(!"Unknown opcode");
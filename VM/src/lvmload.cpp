@@ -10,6 +10,8 @@
 #include "lmem.h"
 #include "lbytecode.h"
 #include "lapi.h"
+#include "ldebug.h"
+#include "ldo.h"
 
 #include <string.h>
 
@@ -72,6 +74,49 @@ private:
     size_t originalThreshold = 0;
 };
 
+// bytecode of luau_loadmapped, referenced by every function that still has parts to decode from it
+struct LazyChunk
+{
+    int refs;
+
+    const char* data;
+    size_t size;
+    void (*release)(void* ud, const char* data, size_t size);
+    void* ud;
+
+    uint8_t version;
+    uint8_t typesversion;
+    bool verify;
+    bool fuse;
+    uint8_t userdataRemapping[LBC_TYPE_TAGGED_USERDATA_END - LBC_TYPE_TAGGED_USERDATA_BASE];
+
+    uint32_t* strings; // offset of each string, starting at its length
+    unsigned int stringCount;
+
+    uint32_t* protos; // offset of each function
+    unsigned int protoCount;
+};
+
+struct LoadState
+{
+    lua_State* L;
+    const char* data;
+    size_t size;
+
+    uint8_t version;
+    uint8_t typesversion;
+    bool verify;
+    bool fuse;
+    const uint8_t* userdataRemapping;
+
+    LuaTable* envt;
+
+    // regular loads create all strings and functions upfront, lazy loads create them from the chunk when they are referenced
+    TString** strings;
+    Proto** protos;
+    LazyChunk* chunk;
+};
+
 void luaV_getimport(lua_State* L, LuaTable* env, TValue* k, StkId res, uint32_t id, bool propagatenil)
 {
     int count = id >> 30;
@@ -134,11 +179,21 @@ static unsigned int readVarInt(const char* data, size_t size, size_t& offset)
     return result;
 }
 
-static TString* readString(TempBuffer<TString*>& strings, const char* data, size_t size, size_t& offset)
+static TString* readString(LoadState& ls, size_t& offset)
 {
-    unsigned int id = readVarInt(data, size, offset);
+    unsigned int id = readVarInt(ls.data, ls.size, offset);
 
-    return id == 0 ? NULL : strings[id - 1];
+    if (id == 0)
+        return NULL;
+
+    if (ls.strings)
+        return ls.strings[id - 1];
+
+    LUAU_ASSERT(id <= ls.chunk->stringCount);
+    size_t stroffset = ls.chunk->strings[id - 1];
+    unsigned int length = readVarInt(ls.data, ls.size, stroffset);
+
+    return luaS_newlstr(ls.L, ls.data + stroffset, length);
 }
 
 static void resolveImportSafe(lua_State* L, LuaTable* env, TValue* k, uint32_t id)
@@ -185,7 +240,7 @@ static void resolveImportSafe(lua_State* L, LuaTable* env, TValue* k, uint32_t i
     }
 }
 
-static void remapUserdataTypes(char* data, size_t size, uint8_t* userdataRemapping, uint32_t count)
+static void remapUserdataTypes(char* data, size_t size, const uint8_t* userdataRemapping, uint32_t count)
 {
     size_t offset = 0;
 
@@ -242,7 +297,736 @@ static void remapUserdataTypes(char* data, size_t size, uint8_t* userdataRemappi
     LUAU_ASSERT(offset == size);
 }
 
-int luau_load(lua_State* L, const char* chunkname, const char* data, size_t size, int env)
+static void dropCachedChunk(lua_State* L, int index)
+{
+    global_State* g = L->global;
+    LoadCacheEntry& e = g->loadcache[index];
+
+    luaM_freearray(L, e.data, e.size, char, 0);
+
+    g->loadcache[index] = g->loadcache[--g->loadcachesize];
+    g->metrics.loadcacheevictions++;
+}
+
+static Proto* findCachedChunk(
+    lua_State* L, unsigned int hash, const char* data, size_t size, TString* source, LuaTable* env, bool verify, bool fuse)
+{
+    global_State* g = L->global;
+
+    for (int i = 0; i < g->loadcachesize; ++i)
+    {
+        LoadCacheEntry& e = g->loadcache[i];
+
+        if (e.hash == hash && e.size == size && e.source == source && e.env == env && e.verify == verify && e.fuse == fuse &&
+            memcmp(e.data, data, size) == 0)
+        {
+            e.lastuse = ++g->loadcacheclock;
+            return e.main;
+        }
+    }
+
+    return NULL;
+}
+
+static void cacheChunk(
+    lua_State* L, unsigned int hash, const char* data, size_t size, TString* source, LuaTable* env, bool verify, bool fuse, Proto* main)
+{
+    global_State* g = L->global;
+
+    if (g->loadcachesize == g->loadcachecapacity)
+    {
+        int lru = 0;
+        for (int i = 1; i < g->loadcachesize; ++i)
+            if (g->loadcache[i].lastuse < g->loadcache[lru].lastuse)
+                lru = i;
+
+        dropCachedChunk(L, lru);
+    }
+
+    char* copy = luaM_newarray(L, size, char, 0);
+    memcpy(copy, data, size);
+
+    LoadCacheEntry& e = g->loadcache[g->loadcachesize++];
+    e.hash = hash;
+    e.data = copy;
+    e.size = size;
+    e.source = source;
+    e.env = env;
+    e.verify = verify;
+    e.fuse = fuse;
+    e.main = main;
+    e.lastuse = ++g->loadcacheclock;
+}
+
+void luaV_trimloadcache(lua_State* L)
+{
+    global_State* g = L->global;
+
+    // entries that weren't loaded since the start of the previous cycle are dropped, as is everything when memory is short
+    for (int i = 0; i < g->loadcachesize;)
+    {
+        if (g->gcemergency || g->loadcache[i].lastuse <= g->loadcacheepoch)
+            dropCachedChunk(L, i);
+        else
+            ++i;
+    }
+
+    g->loadcacheepoch = g->loadcacheclock;
+}
+
+void luaV_clearloadcache(lua_State* L)
+{
+    global_State* g = L->global;
+
+    while (g->loadcachesize)
+        dropCachedChunk(L, g->loadcachesize - 1);
+
+    luaM_freearray(L, g->loadcache, g->loadcachecapacity, LoadCacheEntry, 0);
+    g->loadcache = NULL;
+    g->loadcachecapacity = 0;
+}
+
+void luau_setloadcache(lua_State* L, int capacity)
+{
+    global_State* g = L->global;
+
+    luaV_clearloadcache(L);
+
+    if (capacity > 0)
+    {
+        g->loadcache = luaM_newarray(L, capacity, LoadCacheEntry, 0);
+        g->loadcachecapacity = capacity;
+    }
+}
+
+static void pushMainClosure(lua_State* L, LuaTable* envt, Proto* main)
+{
+    luaC_threadbarrier(L);
+
+    Closure* cl = luaF_newLclosure(L, 0, envt, main);
+    setclvalue(L, L->top, cl);
+    incr_top(L);
+}
+
+static int verifyError(lua_State* L, const char* chunkname, int bytecodeid, int pc, const char* what)
+{
+    char chunkbuf[LUA_IDSIZE];
+    const char* chunkid = luaO_chunkid(chunkbuf, sizeof(chunkbuf), chunkname, strlen(chunkname));
+
+    if (pc >= 0)
+        lua_pushfstring(L, "%s: bytecode verification failed (function %d, pc %d): %s", chunkid, bytecodeid, pc, what);
+    else
+        lua_pushfstring(L, "%s: bytecode verification failed (function %d): %s", chunkid, bytecodeid, what);
+
+    return 1;
+}
+
+void luau_setverify(lua_State* L, int enabled)
+{
+    L->global->verifyload = (enabled != 0);
+}
+
+void luau_setfusion(lua_State* L, int enabled)
+{
+    L->global->fuseload = (enabled != 0);
+}
+
+// rewrites the opcode of the first instruction of common pairs, leaving the second instruction and all operands intact
+static void fuseProto(Proto* p)
+{
+    Instruction* code = p->code;
+
+    for (int pc = 0; pc < p->sizecode;)
+    {
+        uint8_t op = LUAU_INSN_OP(code[pc]);
+        int next = pc + getOpLength(op);
+
+        if (next >= p->sizecode)
+            break;
+
+        uint8_t nextop = LUAU_INSN_OP(code[next]);
+        int fused = -1;
+
+        if (op == LOP_GETIMPORT && nextop == LOP_CALL)
+            fused = LOP_FUSED_GETIMPORT_CALL;
+        else if (op == LOP_GETTABLEKS && nextop == LOP_NAMECALL)
+            fused = LOP_FUSED_GETTABLEKS_NAMECALL;
+        else if (op == LOP_LOADN && nextop == LOP_FORNPREP)
+            fused = LOP_FUSED_LOADN_FORNPREP;
+
+        if (fused >= 0)
+            code[pc] = (code[pc] & ~0xffu) | uint8_t(fused);
+
+        pc = next;
+    }
+}
+
+
+static void loadProtoHeader(LoadState& ls, Proto* p, size_t& offset)
+{
+    p->maxstacksize = read<uint8_t>(ls.data, ls.size, offset);
+    p->numparams = read<uint8_t>(ls.data, ls.size, offset);
+    p->nups = read<uint8_t>(ls.data, ls.size, offset);
+    p->is_vararg = read<uint8_t>(ls.data, ls.size, offset);
+
+    if (ls.version >= 4)
+        p->flags = read<uint8_t>(ls.data, ls.size, offset);
+}
+
+static Proto* newLazyProto(LoadState& ls, TString* source, uint32_t fid)
+{
+    LazyChunk* chunk = ls.chunk;
+    LUAU_ASSERT(fid < chunk->protoCount);
+
+    Proto* p = luaF_newproto(ls.L);
+    p->source = source;
+    p->bytecodeid = int(fid);
+
+    size_t offset = chunk->protos[fid];
+    loadProtoHeader(ls, p, offset);
+
+    p->lazychunk = chunk;
+    p->lazyoffset = uint32_t(offset);
+    chunk->refs++;
+
+    return p;
+}
+
+static void skipLineInfo(const char* data, size_t size, size_t& offset, int sizecode)
+{
+    int linegaplog2 = read<uint8_t>(data, size, offset);
+    int intervals = ((sizecode - 1) >> linegaplog2) + 1;
+
+    offset += sizecode + intervals * sizeof(int32_t);
+}
+
+static void loadLineInfo(LoadState& ls, Proto* p, size_t& offset)
+{
+    const char* data = ls.data;
+    size_t size = ls.size;
+
+    p->linegaplog2 = read<uint8_t>(data, size, offset);
+
+    int intervals = ((p->sizecode - 1) >> p->linegaplog2) + 1;
+    int absoffset = (p->sizecode + 3) & ~3;
+
+    const int sizelineinfo = absoffset + intervals * sizeof(int);
+    p->lineinfo = luaM_newarray(ls.L, sizelineinfo, uint8_t, p->memcat);
+    p->sizelineinfo = sizelineinfo;
+
+    p->abslineinfo = (int*)(p->lineinfo + absoffset);
+
+    uint8_t lastoffset = 0;
+    for (int j = 0; j < p->sizecode; ++j)
+    {
+        lastoffset += read<uint8_t>(data, size, offset);
+        p->lineinfo[j] = lastoffset;
+    }
+
+    int lastline = 0;
+    for (int j = 0; j < intervals; ++j)
+    {
+        lastline += read<int32_t>(data, size, offset);
+        p->abslineinfo[j] = lastline;
+    }
+}
+
+static void loadDebugInfo(LoadState& ls, Proto* p, size_t& offset)
+{
+    lua_State* L = ls.L;
+    const char* data = ls.data;
+    size_t size = ls.size;
+
+    // names are cleared first since the function may already be visible to the GC when it's decoded lazily
+    const int sizelocvars = readVarInt(data, size, offset);
+    p->locvars = luaM_newarray(L, sizelocvars, LocVar, p->memcat);
+    p->sizelocvars = sizelocvars;
+
+    for (int j = 0; j < p->sizelocvars; ++j)
+        p->locvars[j].varname = NULL;
+
+    for (int j = 0; j < p->sizelocvars; ++j)
+    {
+        p->locvars[j].varname = readString(ls, offset);
+        p->locvars[j].startpc = readVarInt(data, size, offset);
+        p->locvars[j].endpc = readVarInt(data, size, offset);
+        p->locvars[j].reg = read<uint8_t>(data, size, offset);
+    }
+
+    const int sizeupvalues = readVarInt(data, size, offset);
+    LUAU_ASSERT(sizeupvalues == p->nups);
+
+    p->upvalues = luaM_newarray(L, sizeupvalues, TString*, p->memcat);
+    p->sizeupvalues = sizeupvalues;
+
+    for (int j = 0; j < p->sizeupvalues; ++j)
+        p->upvalues[j] = NULL;
+
+    for (int j = 0; j < p->sizeupvalues; ++j)
+    {
+        p->upvalues[j] = readString(ls, offset);
+    }
+}
+
+// reads everything after the function header; returns the reason if the function fails verification
+static const char* loadProtoBody(LoadState& ls, Proto* p, size_t& offset, int* errpc)
+{
+    lua_State* L = ls.L;
+    const char* data = ls.data;
+    size_t size = ls.size;
+    const uint32_t i = uint32_t(p->bytecodeid);
+
+    if (ls.version >= 4)
+    {
+        if (ls.typesversion == 1)
+        {
+            uint32_t typesize = readVarInt(data, size, offset);
+
+            if (typesize)
+            {
+                uint8_t* types = (uint8_t*)data + offset;
+
+                LUAU_ASSERT(typesize == unsigned(2 + p->numparams));
+                LUAU_ASSERT(types[0] == LBC_TYPE_FUNCTION);
+                LUAU_ASSERT(types[1] == p->numparams);
+
+                // transform v1 into v2 format
+                int headersize = typesize > 127 ? 4 : 3;
+
+                p->typeinfo = luaM_newarray(L, headersize + typesize, uint8_t, p->memcat);
+                p->sizetypeinfo = headersize + typesize;
+
+                if (headersize == 4)
+                {
+                    p->typeinfo[0] = (typesize & 127) | (1 << 7);
+                    p->typeinfo[1] = typesize >> 7;
+                    p->typeinfo[2] = 0;
+                    p->typeinfo[3] = 0;
+                }
+                else
+                {
+                    p->typeinfo[0] = uint8_t(typesize);
+                    p->typeinfo[1] = 0;
+                    p->typeinfo[2] = 0;
+                }
+
+                memcpy(p->typeinfo + headersize, types, typesize);
+            }
+
+            offset += typesize;
+        }
+        else if (ls.typesversion == 2 || ls.typesversion == 3)
+        {
+            uint32_t typesize = readVarInt(data, size, offset);
+
+            if (typesize)
+            {
+                uint8_t* types = (uint8_t*)data + offset;
+
+                p->typeinfo = luaM_newarray(L, typesize, uint8_t, p->memcat);
+                p->sizetypeinfo = typesize;
+                memcpy(p->typeinfo, types, typesize);
+                offset += typesize;
+
+                if (ls.typesversion == 3)
+                {
+                    remapUserdataTypes(
+                        (char*)(uint8_t*)p->typeinfo, p->sizetypeinfo, ls.userdataRemapping, LBC_TYPE_TAGGED_USERDATA_END - LBC_TYPE_TAGGED_USERDATA_BASE
+                    );
+                }
+            }
+        }
+    }
+
+    const int sizecode = readVarInt(data, size, offset);
+    p->code = luaM_newarray(L, sizecode, Instruction, p->memcat);
+    p->sizecode = sizecode;
+
+    // instructions are read as native-endian words like every other field, so the code array can be copied in one go
+    memcpy(p->code, data + offset, sizecode * sizeof(Instruction));
+    offset += sizecode * sizeof(Instruction);
+
+    p->codeentry = p->code;
+
+    const int sizek = readVarInt(data, size, offset);
+    p->k = luaM_newarray(L, sizek, TValue, p->memcat);
+    p->sizek = sizek;
+
+    // Initialize the constants to nil to ensure they have a valid state
+    // in the event that some operation in the following loop fails with
+    // an exception.
+    for (int j = 0; j < p->sizek; ++j)
+    {
+        setnilvalue(&p->k[j]);
+    }
+
+    // closure constants of lazily loaded functions create the child function, which is shared with the child list below
+    int closures = 0;
+
+    for (int j = 0; j < p->sizek; ++j)
+    {
+        switch (read<uint8_t>(data, size, offset))
+        {
+        case LBC_CONSTANT_NIL:
+            // All constants have already been pre-initialized to nil
+            break;
+
+        case LBC_CONSTANT_BOOLEAN:
+        {
+            uint8_t v = read<uint8_t>(data, size, offset);
+            setbvalue(&p->k[j], v);
+            break;
+        }
+
+        case LBC_CONSTANT_NUMBER:
+        {
+            double v = read<double>(data, size, offset);
+            setnvalue(&p->k[j], v);
+            break;
+        }
+
+        case LBC_CONSTANT_VECTOR:
+        {
+            float x = read<float>(data, size, offset);
+            float y = read<float>(data, size, offset);
+            float z = read<float>(data, size, offset);
+            float w = read<float>(data, size, offset);
+            (void)w;
+            setvvalue(&p->k[j], x, y, z, w);
+            break;
+        }
+
+        case LBC_CONSTANT_STRING:
+        {
+            TString* v = readString(ls, offset);
+            setsvalue(L, &p->k[j], v);
+            break;
+        }
+
+        case LBC_CONSTANT_IMPORT:
+        {
+            uint32_t iid = read<uint32_t>(data, size, offset);
+
+            if (ls.verify)
+            {
+                // import resolution reads the path components from constants that were loaded before this one
+                int count = iid >> 30;
+                if (count < 1 || ((iid >> 20) & 1023) >= uint32_t(j) || (count >= 2 && ((iid >> 10) & 1023) >= uint32_t(j)) ||
+                    (count >= 3 && (iid & 1023) >= uint32_t(j)))
+                    return "import refers to an invalid constant";
+            }
+
+            resolveImportSafe(L, ls.envt, p->k, iid);
+            setobj(L, &p->k[j], L->top - 1);
+            L->top--;
+            break;
+        }
+
+        case LBC_CONSTANT_TABLE:
+        {
+            int keys = readVarInt(data, size, offset);
+            LuaTable* h = luaH_new(L, 0, keys);
+            for (int ki = 0; ki < keys; ++ki)
+            {
+                int key = readVarInt(data, size, offset);
+
+                if (ls.verify && unsigned(key) >= unsigned(j))
+                    return "table template refers to an invalid constant";
+
+                TValue* val = luaH_set(L, h, &p->k[key]);
+                setnvalue(val, 0.0);
+            }
+            sethvalue(L, &p->k[j], h);
+            break;
+        }
+
+        case LBC_CONSTANT_CLOSURE:
+        {
+            uint32_t fid = readVarInt(data, size, offset);
+
+            if (ls.verify && fid >= i)
+                return "closure constant refers to an invalid function";
+
+            Proto* cp = ls.protos ? ls.protos[fid] : newLazyProto(ls, p->source, fid);
+
+            Closure* cl = luaF_newLclosure(L, cp->nups, ls.envt, cp);
+            cl->preload = (cl->nupvalues > 0);
+            setclvalue(L, &p->k[j], cl);
+            closures++;
+            break;
+        }
+
+        default:
+            LUAU_ASSERT(!"Unexpected constant kind");
+        }
+    }
+
+    const int sizep = readVarInt(data, size, offset);
+    p->p = luaM_newarray(L, sizep, Proto*, p->memcat);
+    p->sizep = sizep;
+
+    for (int j = 0; j < p->sizep; ++j)
+        p->p[j] = NULL;
+
+    for (int j = 0; j < p->sizep; ++j)
+    {
+        uint32_t fid = readVarInt(data, size, offset);
+
+        // child functions are always serialized before their parents
+        if (ls.verify && fid >= i)
+            return "child function index is invalid";
+
+        if (ls.protos)
+        {
+            p->p[j] = ls.protos[fid];
+            continue;
+        }
+
+        for (int c = 0; c < p->sizek && closures; ++c)
+            if (ttisfunction(&p->k[c]) && clvalue(&p->k[c])->l.p->bytecodeid == int(fid))
+            {
+                p->p[j] = clvalue(&p->k[c])->l.p;
+                break;
+            }
+
+        if (!p->p[j])
+            p->p[j] = newLazyProto(ls, p->source, fid);
+    }
+
+    p->linedefined = readVarInt(data, size, offset);
+    p->debugname = readString(ls, offset);
+
+    uint8_t lineinfo = read<uint8_t>(data, size, offset);
+
+    if (lineinfo)
+    {
+        if (ls.chunk)
+        {
+            p->lazylineinfo = uint32_t(offset);
+            skipLineInfo(data, size, offset, p->sizecode);
+        }
+        else
+        {
+            loadLineInfo(ls, p, offset);
+        }
+    }
+
+    uint8_t debuginfo = read<uint8_t>(data, size, offset);
+
+    if (debuginfo)
+    {
+        // debug info comes last, so lazy loads don't need to know its size
+        if (ls.chunk)
+            p->lazydebuginfo = uint32_t(offset);
+        else
+            loadDebugInfo(ls, p, offset);
+    }
+
+    if (ls.verify)
+    {
+        if (const char* error = luaV_verifyproto(L, p, errpc))
+            return error;
+    }
+
+    // the verifier only knows bytecode opcodes, so fusion has to come after it
+    if (ls.fuse)
+        fuseProto(p);
+
+    return NULL;
+}
+
+// advances past a function without decoding it; lazy loads use this to find where each function starts
+static void skipProto(LoadState& ls, size_t& offset)
+{
+    const char* data = ls.data;
+    size_t size = ls.size;
+
+    offset += 4; // maxstacksize, numparams, nups, is_vararg
+
+    if (ls.version >= 4)
+    {
+        offset += 1; // flags
+
+        uint32_t typesize = readVarInt(data, size, offset);
+        offset += typesize;
+    }
+
+    const int sizecode = readVarInt(data, size, offset);
+    offset += sizecode * sizeof(Instruction);
+
+    const int sizek = readVarInt(data, size, offset);
+
+    for (int j = 0; j < sizek; ++j)
+    {
+        switch (read<uint8_t>(data, size, offset))
+        {
+        case LBC_CONSTANT_NIL:
+            break;
+
+        case LBC_CONSTANT_BOOLEAN:
+            offset += sizeof(uint8_t);
+            break;
+
+        case LBC_CONSTANT_NUMBER:
+            offset += sizeof(double);
+            break;
+
+        case LBC_CONSTANT_VECTOR:
+            offset += 4 * sizeof(float);
+            break;
+
+        case LBC_CONSTANT_STRING:
+        case LBC_CONSTANT_CLOSURE:
+            readVarInt(data, size, offset);
+            break;
+
+        case LBC_CONSTANT_IMPORT:
+            offset += sizeof(uint32_t);
+            break;
+
+        case LBC_CONSTANT_TABLE:
+        {
+            int keys = readVarInt(data, size, offset);
+            for (int i = 0; i < keys; ++i)
+                readVarInt(data, size, offset);
+            break;
+        }
+
+        default:
+            LUAU_ASSERT(!"Unexpected constant kind");
+        }
+    }
+
+    const int sizep = readVarInt(data, size, offset);
+    for (int j = 0; j < sizep; ++j)
+        readVarInt(data, size, offset);
+
+    readVarInt(data, size, offset); // linedefined
+    readVarInt(data, size, offset); // debugname
+
+    if (read<uint8_t>(data, size, offset))
+        skipLineInfo(data, size, offset, sizecode);
+
+    if (read<uint8_t>(data, size, offset))
+    {
+        const int sizelocvars = readVarInt(data, size, offset);
+        for (int j = 0; j < sizelocvars; ++j)
+        {
+            readVarInt(data, size, offset); // varname
+            readVarInt(data, size, offset); // startpc
+            readVarInt(data, size, offset); // endpc
+            offset += sizeof(uint8_t);      // reg
+        }
+
+        const int sizeupvalues = readVarInt(data, size, offset);
+        for (int j = 0; j < sizeupvalues; ++j)
+            readVarInt(data, size, offset);
+    }
+}
+
+static LoadState lazyLoadState(lua_State* L, LazyChunk* chunk, LuaTable* envt)
+{
+    LoadState ls = {
+        L, chunk->data, chunk->size, chunk->version, chunk->typesversion, chunk->verify, chunk->fuse, chunk->userdataRemapping, envt, NULL, NULL, chunk
+    };
+    return ls;
+}
+
+// drops the reference to the chunk once nothing is left to decode, so that the bytecode can be released early
+static void finishLazyProto(lua_State* L, Proto* p)
+{
+    if (p->lazyoffset == 0 && p->lazylineinfo == 0 && p->lazydebuginfo == 0)
+    {
+        luaV_releasechunk(L, p->lazychunk);
+        p->lazychunk = NULL;
+    }
+}
+
+static const char* materializeProto(lua_State* L, Proto* p, LuaTable* envt, int* errpc)
+{
+    // pause GC for the duration of deserialization, see luau_load
+    const ScopedSetGCThreshold pauseGC{L->global, SIZE_MAX};
+
+    LoadState ls = lazyLoadState(L, p->lazychunk, envt);
+
+    size_t offset = p->lazyoffset;
+    const char* error = loadProtoBody(ls, p, offset, errpc);
+
+    // the stub might have been traversed already, and the objects it references now need to be marked
+    if (isblack(obj2gco(p)))
+        luaC_barrierback(L, obj2gco(p), &p->gclist);
+
+    if (error)
+        return error;
+
+    p->lazyoffset = 0;
+    finishLazyProto(L, p);
+
+    return NULL;
+}
+
+void luaV_materialize(lua_State* L, Proto* p, LuaTable* env)
+{
+    LUAU_ASSERT(p->lazyoffset);
+
+    // code is allocated first, so this catches both an earlier failure and a use from import resolution of the same function
+    if (p->code)
+        luaG_runerror(L, "function %d of '%s' could not be loaded", p->bytecodeid, getstr(p->source));
+
+    int errpc = -1;
+    if (const char* error = materializeProto(L, p, env, &errpc))
+    {
+        lua_rawcheckstack(L, 1);
+        verifyError(L, getstr(p->source), p->bytecodeid, errpc, error);
+        luaD_throw(L, LUA_ERRRUN);
+    }
+}
+
+void luaV_loadlineinfo(lua_State* L, Proto* p)
+{
+    LUAU_ASSERT(p->lazylineinfo && p->lazyoffset == 0);
+
+    LoadState ls = lazyLoadState(L, p->lazychunk, NULL);
+
+    // a failure isn't retried, the function just doesn't have line info
+    size_t offset = p->lazylineinfo;
+    p->lazylineinfo = 0;
+
+    loadLineInfo(ls, p, offset);
+    finishLazyProto(L, p);
+}
+
+void luaV_loaddebuginfo(lua_State* L, Proto* p)
+{
+    LUAU_ASSERT(p->lazydebuginfo && p->lazyoffset == 0);
+
+    LoadState ls = lazyLoadState(L, p->lazychunk, NULL);
+
+    size_t offset = p->lazydebuginfo;
+    p->lazydebuginfo = 0;
+
+    loadDebugInfo(ls, p, offset);
+
+    if (isblack(obj2gco(p)))
+        luaC_barrierback(L, obj2gco(p), &p->gclist);
+
+    finishLazyProto(L, p);
+}
+
+void luaV_releasechunk(lua_State* L, LazyChunk* chunk)
+{
+    if (--chunk->refs > 0)
+        return;
+
+    if (chunk->release)
+        chunk->release(chunk->ud, chunk->data, chunk->size);
+
+    luaM_freearray(L, chunk->strings, chunk->stringCount, uint32_t, 0);
+    luaM_freearray(L, chunk->protos, chunk->protoCount, uint32_t, 0);
+    luaM_freearray(L, chunk, 1, LazyChunk, 0);
+}
+
+static int load(lua_State* L, const char* chunkname, const char* data, size_t size, int env, LazyChunk* chunk)
 {
     size_t offset = 0;
 
@@ -277,6 +1061,32 @@ int luau_load(lua_State* L, const char* chunkname, const char* data, size_t size
 
     TString* source = luaS_new(L, chunkname);
 
+    // references between functions and constants are resolved while loading, so verification has to check them here
+    // the code of each function is checked by luaV_verifyproto once the function is complete
+    const bool verify = L->global->verifyload;
+
+    // native code generation reads the code array and only knows bytecode opcodes
+    const bool fuse = L->global->fuseload && !L->global->ecb.enter;
+
+    // repeated loads of a cached chunk get a new closure over the same main function, like lua_clonefunction
+    // mapped chunks aren't cached since hashing them would read the entire file
+    unsigned int hash = 0;
+    const bool cache = L->global->loadcachecapacity && !chunk;
+
+    if (cache)
+    {
+        hash = luaS_hash(data, size);
+
+        if (Proto* main = findCachedChunk(L, hash, data, size, source, envt, verify, fuse))
+        {
+            L->global->metrics.loadcachehits++;
+            pushMainClosure(L, envt, main);
+            return 0;
+        }
+
+        L->global->metrics.loadcachemisses++;
+    }
+
     uint8_t typesversion = 0;
 
     if (version >= 4)
@@ -294,22 +1104,44 @@ int luau_load(lua_State* L, const char* chunkname, const char* data, size_t size
         }
     }
 
+    // userdata type remapping table
+    // for unknown userdata types, the entry will remap to common 'userdata' type
+    const uint32_t userdataTypeLimit = LBC_TYPE_TAGGED_USERDATA_END - LBC_TYPE_TAGGED_USERDATA_BASE;
+    uint8_t userdataRemapping[userdataTypeLimit];
+
+    LoadState ls = {L, data, size, version, typesversion, verify, fuse, userdataRemapping, envt, NULL, NULL, NULL};
+
     // string table
     unsigned int stringCount = readVarInt(data, size, offset);
-    TempBuffer<TString*> strings(L, stringCount);
+    TempBuffer<TString*> strings(L, chunk ? 0 : stringCount);
 
-    for (unsigned int i = 0; i < stringCount; ++i)
+    if (chunk)
     {
-        unsigned int length = readVarInt(data, size, offset);
+        // strings of lazy loads are created when a function that uses them is materialized
+        chunk->strings = luaM_newarray(L, stringCount, uint32_t, 0);
+        chunk->stringCount = stringCount;
+        ls.chunk = chunk;
+
+        for (unsigned int i = 0; i < stringCount; ++i)
+        {
+            chunk->strings[i] = uint32_t(offset);
 
-        strings[i] = luaS_newlstr(L, data + offset, length);
-        offset += length;
+            unsigned int length = readVarInt(data, size, offset);
+            offset += length;
+        }
     }
+    else
+    {
+        ls.strings = strings.data;
 
-    // userdata type remapping table
-    // for unknown userdata types, the entry will remap to common 'userdata' type
-    const uint32_t userdataTypeLimit = LBC_TYPE_TAGGED_USERDATA_END - LBC_TYPE_TAGGED_USERDATA_BASE;
-    uint8_t userdataRemapping[userdataTypeLimit];
+        for (unsigned int i = 0; i < stringCount; ++i)
+        {
+            unsigned int length = readVarInt(data, size, offset);
+
+            strings[i] = luaS_newlstr(L, data + offset, length);
+            offset += length;
+        }
+    }
 
     if (typesversion == 3)
     {
@@ -319,7 +1151,7 @@ int luau_load(lua_State* L, const char* chunkname, const char* data, size_t size
 
         while (index != 0)
         {
-            TString* name = readString(strings, data, size, offset);
+            TString* name = readString(ls, offset);
 
             if (uint32_t(index - 1) < userdataTypeLimit)
             {
@@ -333,262 +1165,114 @@ int luau_load(lua_State* L, const char* chunkname, const char* data, size_t size
 
     // proto table
     unsigned int protoCount = readVarInt(data, size, offset);
-    TempBuffer<Proto*> protos(L, protoCount);
+    TempBuffer<Proto*> protos(L, chunk ? 0 : protoCount);
+
+    Proto* main = NULL;
 
-    for (unsigned int i = 0; i < protoCount; ++i)
+    if (chunk)
     {
-        Proto* p = luaF_newproto(L);
-        p->source = source;
-        p->bytecodeid = int(i);
+        chunk->version = version;
+        chunk->typesversion = typesversion;
+        chunk->verify = verify;
+        chunk->fuse = fuse;
+        memcpy(chunk->userdataRemapping, userdataRemapping, userdataTypeLimit);
 
-        p->maxstacksize = read<uint8_t>(data, size, offset);
-        p->numparams = read<uint8_t>(data, size, offset);
-        p->nups = read<uint8_t>(data, size, offset);
-        p->is_vararg = read<uint8_t>(data, size, offset);
+        // only the offset of each function is recorded; functions are created by their parent and decoded on first use
+        chunk->protos = luaM_newarray(L, protoCount, uint32_t, 0);
+        chunk->protoCount = protoCount;
 
-        if (version >= 4)
+        for (unsigned int i = 0; i < protoCount; ++i)
         {
-            p->flags = read<uint8_t>(data, size, offset);
-
-            if (typesversion == 1)
-            {
-                uint32_t typesize = readVarInt(data, size, offset);
-
-                if (typesize)
-                {
-                    uint8_t* types = (uint8_t*)data + offset;
-
-                    LUAU_ASSERT(typesize == unsigned(2 + p->numparams));
-                    LUAU_ASSERT(types[0] == LBC_TYPE_FUNCTION);
-                    LUAU_ASSERT(types[1] == p->numparams);
-
-                    // transform v1 into v2 format
-                    int headersize = typesize > 127 ? 4 : 3;
-
-                    p->typeinfo = luaM_newarray(L, headersize + typesize, uint8_t, p->memcat);
-                    p->sizetypeinfo = headersize + typesize;
-
-                    if (headersize == 4)
-                    {
-                        p->typeinfo[0] = (typesize & 127) | (1 << 7);
-                        p->typeinfo[1] = typesize >> 7;
-                        p->typeinfo[2] = 0;
-                        p->typeinfo[3] = 0;
-                    }
-                    else
-                    {
-                        p->typeinfo[0] = uint8_t(typesize);
-                        p->typeinfo[1] = 0;
-                        p->typeinfo[2] = 0;
-                    }
-
-                    memcpy(p->typeinfo + headersize, types, typesize);
-                }
-
-                offset += typesize;
-            }
-            else if (typesversion == 2 || typesversion == 3)
-            {
-                uint32_t typesize = readVarInt(data, size, offset);
-
-                if (typesize)
-                {
-                    uint8_t* types = (uint8_t*)data + offset;
-
-                    p->typeinfo = luaM_newarray(L, typesize, uint8_t, p->memcat);
-                    p->sizetypeinfo = typesize;
-                    memcpy(p->typeinfo, types, typesize);
-                    offset += typesize;
-
-                    if (typesversion == 3)
-                    {
-                        remapUserdataTypes((char*)(uint8_t*)p->typeinfo, p->sizetypeinfo, userdataRemapping, userdataTypeLimit);
-                    }
-                }
-            }
+            chunk->protos[i] = uint32_t(offset);
+            skipProto(ls, offset);
         }
 
-        const int sizecode = readVarInt(data, size, offset);
-        p->code = luaM_newarray(L, sizecode, Instruction, p->memcat);
-        p->sizecode = sizecode;
+        uint32_t mainid = readVarInt(data, size, offset);
 
-        for (int j = 0; j < p->sizecode; ++j)
-            p->code[j] = read<uint32_t>(data, size, offset);
+        if (verify && mainid >= protoCount)
+            return verifyError(L, chunkname, int(mainid), -1, "main function index is invalid");
 
-        p->codeentry = p->code;
+        main = newLazyProto(ls, source, mainid);
 
-        const int sizek = readVarInt(data, size, offset);
-        p->k = luaM_newarray(L, sizek, TValue, p->memcat);
-        p->sizek = sizek;
-
-        // Initialize the constants to nil to ensure they have a valid state
-        // in the event that some operation in the following loop fails with
-        // an exception.
-        for (int j = 0; j < p->sizek; ++j)
-        {
-            setnilvalue(&p->k[j]);
-        }
+        int pc = -1;
+        if (const char* error = materializeProto(L, main, envt, &pc))
+            return verifyError(L, chunkname, int(mainid), pc, error);
+    }
+    else
+    {
+        ls.protos = protos.data;
 
-        for (int j = 0; j < p->sizek; ++j)
+        for (unsigned int i = 0; i < protoCount; ++i)
         {
-            switch (read<uint8_t>(data, size, offset))
-            {
-            case LBC_CONSTANT_NIL:
-                // All constants have already been pre-initialized to nil
-                break;
+            Proto* p = luaF_newproto(L);
+            p->source = source;
+            p->bytecodeid = int(i);
 
-            case LBC_CONSTANT_BOOLEAN:
-            {
-                uint8_t v = read<uint8_t>(data, size, offset);
-                setbvalue(&p->k[j], v);
-                break;
-            }
-
-            case LBC_CONSTANT_NUMBER:
-            {
-                double v = read<double>(data, size, offset);
-                setnvalue(&p->k[j], v);
-                break;
-            }
+            loadProtoHeader(ls, p, offset);
 
-            case LBC_CONSTANT_VECTOR:
-            {
-                float x = read<float>(data, size, offset);
-                float y = read<float>(data, size, offset);
-                float z = read<float>(data, size, offset);
-                float w = read<float>(data, size, offset);
-                (void)w;
-                setvvalue(&p->k[j], x, y, z, w);
-                break;
-            }
+            int pc = -1;
+            if (const char* error = loadProtoBody(ls, p, offset, &pc))
+                return verifyError(L, chunkname, int(i), pc, error);
 
-            case LBC_CONSTANT_STRING:
-            {
-                TString* v = readString(strings, data, size, offset);
-                setsvalue(L, &p->k[j], v);
-                break;
-            }
-
-            case LBC_CONSTANT_IMPORT:
-            {
-                uint32_t iid = read<uint32_t>(data, size, offset);
-                resolveImportSafe(L, envt, p->k, iid);
-                setobj(L, &p->k[j], L->top - 1);
-                L->top--;
-                break;
-            }
-
-            case LBC_CONSTANT_TABLE:
-            {
-                int keys = readVarInt(data, size, offset);
-                LuaTable* h = luaH_new(L, 0, keys);
-                for (int i = 0; i < keys; ++i)
-                {
-                    int key = readVarInt(data, size, offset);
-                    TValue* val = luaH_set(L, h, &p->k[key]);
-                    setnvalue(val, 0.0);
-                }
-                sethvalue(L, &p->k[j], h);
-                break;
-            }
-
-            case LBC_CONSTANT_CLOSURE:
-            {
-                uint32_t fid = readVarInt(data, size, offset);
-                Closure* cl = luaF_newLclosure(L, protos[fid]->nups, envt, protos[fid]);
-                cl->preload = (cl->nupvalues > 0);
-                setclvalue(L, &p->k[j], cl);
-                break;
-            }
-
-            default:
-                LUAU_ASSERT(!"Unexpected constant kind");
-            }
-        }
-
-        const int sizep = readVarInt(data, size, offset);
-        p->p = luaM_newarray(L, sizep, Proto*, p->memcat);
-        p->sizep = sizep;
-
-        for (int j = 0; j < p->sizep; ++j)
-        {
-            uint32_t fid = readVarInt(data, size, offset);
-            p->p[j] = protos[fid];
+            protos[i] = p;
         }
 
-        p->linedefined = readVarInt(data, size, offset);
-        p->debugname = readString(strings, data, size, offset);
+        // "main" proto is pushed to Lua stack
+        uint32_t mainid = readVarInt(data, size, offset);
 
-        uint8_t lineinfo = read<uint8_t>(data, size, offset);
+        if (verify && mainid >= protoCount)
+            return verifyError(L, chunkname, int(mainid), -1, "main function index is invalid");
 
-        if (lineinfo)
-        {
-            p->linegaplog2 = read<uint8_t>(data, size, offset);
-
-            int intervals = ((p->sizecode - 1) >> p->linegaplog2) + 1;
-            int absoffset = (p->sizecode + 3) & ~3;
-
-            const int sizelineinfo = absoffset + intervals * sizeof(int);
-            p->lineinfo = luaM_newarray(L, sizelineinfo, uint8_t, p->memcat);
-            p->sizelineinfo = sizelineinfo;
-
-            p->abslineinfo = (int*)(p->lineinfo + absoffset);
-
-            uint8_t lastoffset = 0;
-            for (int j = 0; j < p->sizecode; ++j)
-            {
-                lastoffset += read<uint8_t>(data, size, offset);
-                p->lineinfo[j] = lastoffset;
-            }
-
-            int lastline = 0;
-            for (int j = 0; j < intervals; ++j)
-            {
-                lastline += read<int32_t>(data, size, offset);
-                p->abslineinfo[j] = lastline;
-            }
-        }
-
-        uint8_t debuginfo = read<uint8_t>(data, size, offset);
+        main = protos[mainid];
+    }
 
-        if (debuginfo)
-        {
-            const int sizelocvars = readVarInt(data, size, offset);
-            p->locvars = luaM_newarray(L, sizelocvars, LocVar, p->memcat);
-            p->sizelocvars = sizelocvars;
+    if (cache)
+        cacheChunk(L, hash, data, size, source, envt, verify, fuse, main);
 
-            for (int j = 0; j < p->sizelocvars; ++j)
-            {
-                p->locvars[j].varname = readString(strings, data, size, offset);
-                p->locvars[j].startpc = readVarInt(data, size, offset);
-                p->locvars[j].endpc = readVarInt(data, size, offset);
-                p->locvars[j].reg = read<uint8_t>(data, size, offset);
-            }
+    pushMainClosure(L, envt, main);
 
-            const int sizeupvalues = readVarInt(data, size, offset);
-            LUAU_ASSERT(sizeupvalues == p->nups);
+    return 0;
+}
 
-            p->upvalues = luaM_newarray(L, sizeupvalues, TString*, p->memcat);
-            p->sizeupvalues = sizeupvalues;
+int luau_load(lua_State* L, const char* chunkname, const char* data, size_t size, int env)
+{
+    return load(L, chunkname, data, size, env, NULL);
+}
 
-            for (int j = 0; j < p->sizeupvalues; ++j)
-            {
-                p->upvalues[j] = readString(strings, data, size, offset);
-            }
-        }
+int luau_loadmapped(
+    lua_State* L,
+    const char* chunkname,
+    const char* data,
+    size_t size,
+    int env,
+    void (*release)(void* ud, const char* data, size_t size),
+    void* ud
+)
+{
+    // functions refer to the chunk by 32-bit offsets
+    if (size > UINT32_MAX)
+    {
+        if (release)
+            release(ud, data, size);
 
-        protos[i] = p;
+        char chunkbuf[LUA_IDSIZE];
+        const char* chunkid = luaO_chunkid(chunkbuf, sizeof(chunkbuf), chunkname, strlen(chunkname));
+        lua_pushfstring(L, "%s: bytecode is too large to be mapped", chunkid);
+        return 1;
     }
 
-    // "main" proto is pushed to Lua stack
-    uint32_t mainid = readVarInt(data, size, offset);
-    Proto* main = protos[mainid];
+    LazyChunk* chunk = luaM_newarray(L, 1, LazyChunk, 0);
+    memset(chunk, 0, sizeof(LazyChunk));
+    chunk->refs = 1;
+    chunk->data = data;
+    chunk->size = size;
+    chunk->release = release;
+    chunk->ud = ud;
 
-    luaC_threadbarrier(L);
+    int status = load(L, chunkname, data, size, env, chunk);
 
-    Closure* cl = luaF_newLclosure(L, 0, envt, main);
-    setclvalue(L, L->top, cl);
-    incr_top(L);
+    // the reference held by the load is dropped last, so the bytecode is released right away if nothing uses it
+    luaV_releasechunk(L, chunk);
 
-    return 0;
+    return status;
 }
@@ -0,0 +1,562 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "lvmroblox.h"
+
+#include "lcommon.h"
+
+#include <atomic>
+#include <mutex>
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+/*
+ * Pooled lua_Alloc backend.
+ *
+ * lmem.cpp serves small objects out of its own pages, so the requests that reach lua_Alloc are dominated by whole pages
+ * (kSmallPageSize/kLargePageSize), dedicated pages for large GC objects, and large non-GC blocks such as table arrays and
+ * thread stacks. These requests come in a small number of recurring sizes and are freed and reallocated at a high rate
+ * during sweeping, which makes them a good fit for size-segregated pools instead of a general purpose malloc.
+ *
+ * Requests up to kPoolMaxSize bytes are rounded up to one of kPoolSizeClasses classes; there is one class per
+ * LUA_SIZECLASSES entry, with four classes per power of two starting at kPoolMinSize. Both lmem.cpp page sizes land
+ * in a class that wastes only the allocator metadata reduction (24 bytes) of the page. Larger requests go straight to
+ * the system allocator.
+ *
+ * Each thread keeps a cache of free blocks per class in a thread-local arena, so the fast path of an allocation or a free
+ * is a singly linked list push or pop without atomics. When a cache runs dry it is refilled with a batch of blocks from
+ * the shared central list of the class; when it overflows, half of the cache is returned there. This keeps blocks that
+ * are freed by a different thread than the one that allocated them (states can migrate between threads) from piling up.
+ *
+ * Central lists are fed by carving runs of blocks out of regions that are reserved from the OS in 2 MB units, aligned
+ * and advised for transparent huge pages where the platform supports it, to reduce TLB pressure on large heaps.
+ * Regions are never returned to the OS.
+ */
+
+const int kPoolSizeClasses = LUA_SIZECLASSES;
+
+// Smallest class size; smaller requests are rare since lmem.cpp pages everything up to 1 KB
+const size_t kPoolMinSize = 64;
+
+// Number of size classes per power of two
+const int kPoolClassesPerDoubling = 4;
+
+// Regions are reserved from the OS in units of this size, matching the common huge page size
+const size_t kPoolRegionSize = 2 * 1024 * 1024;
+
+// Minimum amount of memory carved out of a region for one size class at a time
+const size_t kPoolRunSize = 128 * 1024;
+
+// Target amount of memory kept in a thread cache for each size class
+const size_t kPoolCacheBytes = 256 * 1024;
+
+struct PoolSizeClassConfig
+{
+    size_t sizeOfClass[kPoolSizeClasses];
+    size_t maxSize = 0;
+
+    PoolSizeClassConfig()
+    {
+        // four classes per power of two: 64, 80, 96, 112, 128, 160, 192, 224, 256, ...
+        size_t size = kPoolMinSize;
+        size_t step = kPoolMinSize / kPoolClassesPerDoubling;
+
+        for (int klass = 0; klass < kPoolSizeClasses; ++klass)
+        {
+            sizeOfClass[klass] = size;
+            maxSize = size;
+
+            size += step;
+
+            if (size == step * kPoolClassesPerDoubling * 2)
+                step *= 2;
+        }
+    }
+
+    int classForSize(size_t size) const
+    {
+        if (size <= kPoolMinSize)
+            return 0;
+
+        // position of the power of two range, followed by the position inside the range
+        int log2 = 63 - countlz(uint64_t(size - 1));
+        int range = log2 - kMinLog2;
+        size_t step = size_t(1) << (log2 - 2);
+
+        return range * kPoolClassesPerDoubling + int((size - 1 - (size_t(1) << log2)) / step) + 1;
+    }
+
+    size_t cacheLimit(int klass) const
+    {
+        size_t limit = kPoolCacheBytes / sizeOfClass[klass];
+        return limit < 4 ? 4 : limit;
+    }
+
+private:
+    static const int kMinLog2 = 6; // log2(kPoolMinSize)
+
+    static int countlz(uint64_t x)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long r;
+        _BitScanReverse64(&r, x);
+        return 63 - int(r);
+#else
+        return __builtin_clzll(x);
+#endif
+    }
+};
+
+static_assert(kPoolMinSize == 64, "PoolSizeClassConfig::kMinLog2 must match kPoolMinSize");
+
+static const PoolSizeClassConfig kPoolSizeClassConfig;
+
+struct PoolFreeBlock
+{
+    PoolFreeBlock* next;
+};
+
+struct PoolCentralList
+{
+    std::mutex mutex;
+    PoolFreeBlock* head = nullptr;
+};
+
+// Counters are only written by the owning thread, with relaxed load+store pairs, and read by roblox_vm_pool_getstats
+struct PoolCounters
+{
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> frees{0};
+    std::atomic<uint64_t> largeAllocations{0};
+    std::atomic<uint64_t> refills{0};
+    std::atomic<int64_t> pooledBytes{0}; // may be negative for a single thread when blocks are freed by another thread
+    std::atomic<int64_t> largeBytes{0};
+};
+
+template<typename T>
+static inline void bump(std::atomic<T>& counter, T delta)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+struct PoolArena
+{
+    PoolFreeBlock* freeList[kPoolSizeClasses] = {};
+    size_t freeCount[kPoolSizeClasses] = {};
+
+    PoolCounters counters;
+
+    // list of live arenas, guarded by gPoolMutex
+    PoolArena* prev = nullptr;
+    PoolArena* next = nullptr;
+};
+
+// guards region carving, the arena list and the counters of retired arenas
+static std::mutex gPoolMutex;
+
+static char* gRegionCursor = nullptr;
+static char* gRegionEnd = nullptr;
+static size_t gReservedBytes = 0;
+
+static PoolArena* gArenas = nullptr;
+static RobloxVMPoolStats gRetiredStats = {};
+
+static PoolCentralList gCentralLists[kPoolSizeClasses];
+
+static void* reserveregion(size_t size)
+{
+#if defined(_WIN32)
+    return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    // over-reserve to be able to align the region to the huge page size, and trim the excess
+    size_t padded = size + kPoolRegionSize;
+
+    char* base = (char*)mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (base == (char*)MAP_FAILED)
+        return NULL;
+
+    char* aligned = (char*)(((uintptr_t)base + kPoolRegionSize - 1) & ~(uintptr_t)(kPoolRegionSize - 1));
+
+    if (aligned != base)
+        munmap(base, aligned - base);
+
+    if (base + padded != aligned + size)
+        munmap(aligned + size, (base + padded) - (aligned + size));
+
+#if defined(MADV_HUGEPAGE)
+    madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+
+    return aligned;
+#endif
+}
+
+// carve a run of blocks for the class out of the current region; must be called with gPoolMutex held
+static char* carverun(int klass, size_t* runSize)
+{
+    size_t blockSize = kPoolSizeClassConfig.sizeOfClass[klass];
+    size_t size = kPoolRunSize > blockSize * 4 ? kPoolRunSize : blockSize * 4;
+
+    // the run has to contain a whole number of blocks
+    size -= size % blockSize;
+
+    if (size_t(gRegionEnd - gRegionCursor) < size)
+    {
+        size_t regionSize = size > kPoolRegionSize ? (size + kPoolRegionSize - 1) & ~(kPoolRegionSize - 1) : kPoolRegionSize;
+
+        char* region = (char*)reserveregion(regionSize);
+        if (!region)
+            return NULL;
+
+        // the tail of the previous region is abandoned; runs are small compared to the region so little is lost
+        gRegionCursor = region;
+        gRegionEnd = region + regionSize;
+        gReservedBytes += regionSize;
+    }
+
+    char* run = gRegionCursor;
+    gRegionCursor += size;
+
+    *runSize = size;
+    return run;
+}
+
+// take up to 'count' blocks from the central list, carving a new run if it is empty; returns the number of blocks taken
+static size_t takecentral(int klass, size_t count, PoolFreeBlock** head)
+{
+    PoolCentralList& central = gCentralLists[klass];
+
+    {
+        std::lock_guard<std::mutex> lock(central.mutex);
+
+        PoolFreeBlock* first = central.head;
+        PoolFreeBlock* last = NULL;
+        size_t taken = 0;
+
+        for (PoolFreeBlock* block = first; block && taken < count; block = block->next)
+        {
+            last = block;
+            taken++;
+        }
+
+        if (taken)
+        {
+            central.head = last->next;
+            last->next = NULL;
+
+            *head = first;
+            return taken;
+        }
+    }
+
+    size_t runSize = 0;
+    char* run = NULL;
+
+    {
+        std::lock_guard<std::mutex> lock(gPoolMutex);
+        run = carverun(klass, &runSize);
+    }
+
+    if (!run)
+        return 0;
+
+    // link the blocks of the run together, in increasing address order
+    size_t blockSize = kPoolSizeClassConfig.sizeOfClass[klass];
+    size_t blockCount = runSize / blockSize;
+
+    for (size_t i = 0; i < blockCount; ++i)
+        ((PoolFreeBlock*)(run + i * blockSize))->next = i + 1 < blockCount ? (PoolFreeBlock*)(run + (i + 1) * blockSize) : NULL;
+
+    *head = (PoolFreeBlock*)run;
+    return blockCount;
+}
+
+static void returncentral(int klass, PoolFreeBlock* first, PoolFreeBlock* last)
+{
+    PoolCentralList& central = gCentralLists[klass];
+
+    std::lock_guard<std::mutex> lock(central.mutex);
+
+    last->next = central.head;
+    central.head = first;
+}
+
+static void addcounters(RobloxVMPoolStats* stats, const PoolCounters& counters)
+{
+    stats->allocations += counters.allocations.load(std::memory_order_relaxed);
+    stats->frees += counters.frees.load(std::memory_order_relaxed);
+    stats->largeAllocations += counters.largeAllocations.load(std::memory_order_relaxed);
+    stats->refills += counters.refills.load(std::memory_order_relaxed);
+    stats->pooledBytes += counters.pooledBytes.load(std::memory_order_relaxed);
+    stats->largeBytes += counters.largeBytes.load(std::memory_order_relaxed);
+}
+
+/*
+ * Thread-local arena management
+ *
+ * The arena pointer itself is a trivially destructible thread_local that stays safe to read during thread teardown; the owner
+ * object is what actually creates the arena and flushes it back to the central lists when the thread exits. Allocations made
+ * after that point (for example, a state closed from a thread_local destructor) go directly to the central lists.
+ */
+static thread_local PoolArena* tArena = nullptr;
+static thread_local bool tArenaRetired = false;
+
+struct PoolArenaOwner
+{
+    PoolArena* arena;
+
+    PoolArenaOwner()
+    {
+        arena = new PoolArena();
+
+        std::lock_guard<std::mutex> lock(gPoolMutex);
+
+        arena->next = gArenas;
+        if (gArenas)
+            gArenas->prev = arena;
+        gArenas = arena;
+    }
+
+    ~PoolArenaOwner()
+    {
+        tArena = nullptr;
+        tArenaRetired = true;
+
+        for (int klass = 0; klass < kPoolSizeClasses; ++klass)
+        {
+            PoolFreeBlock* first = arena->freeList[klass];
+
+            if (!first)
+                continue;
+
+            PoolFreeBlock* last = first;
+            while (last->next)
+                last = last->next;
+
+            returncentral(klass, first, last);
+        }
+
+        std::lock_guard<std::mutex> lock(gPoolMutex);
+
+        addcounters(&gRetiredStats, arena->counters);
+
+        if (arena->next)
+            arena->next->prev = arena->prev;
+        if (arena->prev)
+            arena->prev->next = arena->next;
+        else
+            gArenas = arena->next;
+
+        delete arena;
+    }
+};
+
+LUAU_NOINLINE static PoolArena* createarena()
+{
+    if (tArenaRetired)
+        return nullptr;
+
+    static thread_local PoolArenaOwner owner;
+
+    tArena = owner.arena;
+    return tArena;
+}
+
+static inline PoolArena* getarena()
+{
+    PoolArena* arena = tArena;
+    return LUAU_LIKELY(arena != nullptr) ? arena : createarena();
+}
+
+// this is part of a cold path in poolalloc; it is marked as noinline to keep the fast path small
+LUAU_NOINLINE static void* refillarena(PoolArena* arena, int klass)
+{
+    size_t limit = kPoolSizeClassConfig.cacheLimit(klass);
+
+    PoolFreeBlock* head = NULL;
+    size_t count = takecentral(klass, limit / 2, &head);
+
+    if (count == 0)
+        return NULL;
+
+    bump(arena->counters.refills, uint64_t(1));
+
+    // the first block is returned to the caller, the rest is cached
+    arena->freeList[klass] = head->next;
+    arena->freeCount[klass] = count - 1;
+
+    return head;
+}
+
+LUAU_NOINLINE static void flusharena(PoolArena* arena, int klass)
+{
+    // return the older half of the cache; the most recently freed blocks are more likely to be hot
+    size_t keep = arena->freeCount[klass] / 2;
+
+    PoolFreeBlock* last = arena->freeList[klass];
+    for (size_t i = 1; i < keep; ++i)
+        last = last->next;
+
+    PoolFreeBlock* first = last->next;
+    last->next = NULL;
+
+    PoolFreeBlock* tail = first;
+    while (tail->next)
+        tail = tail->next;
+
+    returncentral(klass, first, tail);
+
+    arena->freeCount[klass] = keep;
+}
+
+static void* poolalloc(size_t size)
+{
+    if (size > kPoolSizeClassConfig.maxSize)
+    {
+        void* block = malloc(size);
+
+        if (PoolArena* arena = getarena())
+        {
+            bump(arena->counters.largeAllocations, uint64_t(1));
+            bump(arena->counters.largeBytes, int64_t(size));
+        }
+
+        return block;
+    }
+
+    int klass = kPoolSizeClassConfig.classForSize(size);
+    PoolArena* arena = getarena();
+
+    if (LUAU_UNLIKELY(!arena))
+    {
+        PoolFreeBlock* head = NULL;
+        if (takecentral(klass, 1, &head) == 0)
+            return NULL;
+
+        return head;
+    }
+
+    void* block = arena->freeList[klass];
+
+    if (LUAU_LIKELY(block != NULL))
+    {
+        arena->freeList[klass] = ((PoolFreeBlock*)block)->next;
+        arena->freeCount[klass]--;
+    }
+    else
+    {
+        block = refillarena(arena, klass);
+
+        if (!block)
+            return NULL;
+    }
+
+    bump(arena->counters.allocations, uint64_t(1));
+    bump(arena->counters.pooledBytes, int64_t(kPoolSizeClassConfig.sizeOfClass[klass]));
+
+    return block;
+}
+
+static void poolfree(void* ptr, size_t size)
+{
+    if (size > kPoolSizeClassConfig.maxSize)
+    {
+        free(ptr);
+
+        if (PoolArena* arena = getarena())
+        {
+            bump(arena->counters.frees, uint64_t(1));
+            bump(arena->counters.largeBytes, -int64_t(size));
+        }
+
+        return;
+    }
+
+    int klass = kPoolSizeClassConfig.classForSize(size);
+    PoolArena* arena = getarena();
+
+    PoolFreeBlock* block = (PoolFreeBlock*)ptr;
+
+    if (LUAU_UNLIKELY(!arena))
+    {
+        block->next = NULL;
+        returncentral(klass, block, block);
+        return;
+    }
+
+    block->next = arena->freeList[klass];
+    arena->freeList[klass] = block;
+
+    if (LUAU_UNLIKELY(++arena->freeCount[klass] > kPoolSizeClassConfig.cacheLimit(klass)))
+        flusharena(arena, klass);
+
+    bump(arena->counters.frees, uint64_t(1));
+    bump(arena->counters.pooledBytes, -int64_t(kPoolSizeClassConfig.sizeOfClass[klass]));
+}
+
+void* roblox_vm_pool_alloc(void* ud, void* ptr, size_t osize, size_t nsize)
+{
+    (void)ud;
+
+    if (nsize == 0)
+    {
+        if (ptr)
+            poolfree(ptr, osize);
+
+        return NULL;
+    }
+
+    if (!ptr)
+        return poolalloc(nsize);
+
+    size_t maxSize = kPoolSizeClassConfig.maxSize;
+
+    // both blocks are served by the system allocator, which can often resize in place
+    if (osize > maxSize && nsize > maxSize)
+    {
+        void* result = realloc(ptr, nsize);
+
+        if (result)
+        {
+            if (PoolArena* arena = getarena())
+                bump(arena->counters.largeBytes, int64_t(nsize) - int64_t(osize));
+        }
+
+        return result;
+    }
+
+    // resizing within the same size class doesn't need to move the block
+    if (osize <= maxSize && nsize <= maxSize && kPoolSizeClassConfig.classForSize(osize) == kPoolSizeClassConfig.classForSize(nsize))
+        return ptr;
+
+    void* result = poolalloc(nsize);
+    if (!result)
+        return NULL;
+
+    memcpy(result, ptr, osize < nsize ? osize : nsize);
+    poolfree(ptr, osize);
+
+    return result;
+}
+
+void roblox_vm_pool_getstats(RobloxVMPoolStats* stats)
+{
+    std::lock_guard<std::mutex> lock(gPoolMutex);
+
+    *stats = gRetiredStats;
+    stats->reservedBytes = gReservedBytes;
+
+    for (PoolArena* arena = gArenas; arena; arena = arena->next)
+        addcounters(stats, arena->counters);
+}
@@ -14,114 +14,99 @@
 #include "lnumutils.h"
 #include "lbytecode.h"
 
+#include "lvmroblox.h"
+
+#include <stdio.h>
 #include <string.h>
 #include <stdexcept>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // Enhanced VM execution for Roblox with better error handling and optimizations
 
 // Maximum execution time in milliseconds before triggering a timeout
 #define ROBLOX_VM_TIMEOUT_MS 5000
 
-// Maximum memory allocation in bytes before triggering an out-of-memory error
-#define ROBLOX_VM_MAX_MEMORY 100 * 1024 * 1024 // 100 MB
+// Default memory limit in bytes for states created by roblox_vm_newstate; can be changed at runtime with lua_setmemorylimit
+#define ROBLOX_VM_DEFAULT_MAX_MEMORY (100 * 1024 * 1024) // 100 MB
+
+// Number of recently loaded chunks kept by luau_load so that repeated loads skip deserialization
+#define ROBLOX_VM_LOAD_CACHE_SIZE 64
 
 // Maximum call stack depth to prevent stack overflow attacks
 #define ROBLOX_VM_MAX_CALL_DEPTH 200
 
-// Structure to track VM execution metrics
-struct RobloxVMMetrics {
-    int64_t executionTimeMs;
-    size_t memoryUsed;
-    int callDepth;
-    int instructionsExecuted;
-    bool timedOut;
-    bool memoryLimitExceeded;
-    bool stackOverflow;
-    
-    RobloxVMMetrics()
-        : executionTimeMs(0), memoryUsed(0), callDepth(0), 
-          instructionsExecuted(0), timedOut(false), 
-          memoryLimitExceeded(false), stackOverflow(false) {}
-};
-
-// Global metrics for the current execution
-static RobloxVMMetrics g_vmMetrics;
-
-// Execution start time for timeout detection
-static std::chrono::high_resolution_clock::time_point g_executionStartTime;
-
 // Enhanced error handling for Roblox VM
 void roblox_vm_error(lua_State* L, const char* error) {
     luaG_runerror(L, "Roblox VM Error: %s", error);
 }
 
 // Check if execution has timed out
-bool roblox_vm_check_timeout() {
-    auto now = std::chrono::high_resolution_clock::now();
-    g_vmMetrics.executionTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - g_executionStartTime).count();
-    
-    if (g_vmMetrics.executionTimeMs > ROBLOX_VM_TIMEOUT_MS) {
-        g_vmMetrics.timedOut = true;
-        return true;
-    }
-    
-    return false;
+bool roblox_vm_check_timeout(lua_State* L) {
+    double elapsedMs = (lua_clock() - L->global->metrics.starttime) * 1000.0;
+
+    return elapsedMs > ROBLOX_VM_TIMEOUT_MS;
 }
 
 // Check if memory limit has been exceeded
 bool roblox_vm_check_memory(lua_State* L) {
-    g_vmMetrics.memoryUsed = lua_gc(L, LUA_GCCOUNT, 0) * 1024;
-    
-    if (g_vmMetrics.memoryUsed > ROBLOX_VM_MAX_MEMORY) {
-        g_vmMetrics.memoryLimitExceeded = true;
-        return true;
-    }
-    
-    return false;
+    // the limit is enforced by the VM allocator, so an exceeded limit shows up as a failed allocation
+    return L->global->metrics.memerrors != 0;
 }
 
 // Check if call stack depth limit has been exceeded
-bool roblox_vm_check_stack_depth(int depth) {
-    g_vmMetrics.callDepth = depth;
-    
-    if (depth > ROBLOX_VM_MAX_CALL_DEPTH) {
-        g_vmMetrics.stackOverflow = true;
+bool roblox_vm_check_stack_depth(lua_State* L) {
+    if (lua_stackdepth(L) > ROBLOX_VM_MAX_CALL_DEPTH) {
+        L->global->metrics.stackoverflows++;
         return true;
     }
-    
+
     return false;
 }
 
 // Initialize VM metrics for a new execution
-void roblox_vm_init_metrics() {
-    g_vmMetrics = RobloxVMMetrics();
-    g_executionStartTime = std::chrono::high_resolution_clock::now();
+void roblox_vm_init_metrics(lua_State* L) {
+    lua_resetmetrics(L);
 }
 
-// Get current VM metrics
-const RobloxVMMetrics& roblox_vm_get_metrics() {
-    return g_vmMetrics;
+// Get VM metrics of the state as of the last GC step or completed execution; safe to call from any thread
+RobloxVMMetrics roblox_vm_get_metrics(lua_State* L) {
+    lua_Metrics snapshot;
+    lua_getmetrics(L, &snapshot);
+
+    RobloxVMMetrics metrics;
+    metrics.executionTimeMs = int64_t((snapshot.publishtime - snapshot.starttime) * 1000.0);
+    metrics.memoryUsed = snapshot.totalbytes;
+    metrics.peakMemoryUsed = snapshot.peakbytes;
+    metrics.allocations = snapshot.allocations;
+    metrics.gcCycles = snapshot.gccycles;
+    metrics.timedOut = snapshot.timeouts != 0;
+    metrics.memoryLimitExceeded = snapshot.memerrors != 0;
+    metrics.stackOverflow = snapshot.stackoverflows != 0;
+    return metrics;
 }
 
 // Enhanced VM execution with safety checks and metrics
 int roblox_vm_execute(lua_State* L, int nresults) {
     // Initialize metrics
-    roblox_vm_init_metrics();
-    
-    // Save current stack top
-    int base = lua_gettop(L) - nresults;
+    roblox_vm_init_metrics(L);
     
     try {
         // Execute the function
         int status = lua_pcall(L, nresults, LUA_MULTRET, 0);
         
-        // Update final metrics
-        auto now = std::chrono::high_resolution_clock::now();
-        g_vmMetrics.executionTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - g_executionStartTime).count();
-        g_vmMetrics.memoryUsed = lua_gc(L, LUA_GCCOUNT, 0) * 1024;
+        // Publish final metrics
+        lua_publishmetrics(L);
         
         return status;
     }
@@ -138,19 +123,11 @@ int roblox_vm_execute(lua_State* L, int nresults) {
 }
 
 // Enhanced memory allocator with limits and tracking
+// Allocation counters are maintained by the VM per state, so this stays a plain system allocator call
 void* roblox_vm_alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
-    lua_State* L = (lua_State*)ud;
-    
-    // Track memory usage
-    g_vmMetrics.memoryUsed = lua_gc(L, LUA_GCCOUNT, 0) * 1024;
-    
-    // Check memory limit
-    if (g_vmMetrics.memoryUsed > ROBLOX_VM_MAX_MEMORY) {
-        g_vmMetrics.memoryLimitExceeded = true;
-        return NULL; // Allocation failed due to memory limit
-    }
-    
-    // Standard reallocation logic
+    (void)ud;
+    (void)osize;
+
     if (nsize == 0) {
         free(ptr);
         return NULL;
@@ -162,11 +139,23 @@ void* roblox_vm_alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
 
 // Create a new Roblox-optimized Lua state
 lua_State* roblox_vm_newstate() {
-    // Create state with custom allocator
-    lua_State* L = lua_newstate(roblox_vm_alloc, NULL);
+    // Create state with the pooled allocator
+    lua_State* L = lua_newstate(roblox_vm_pool_alloc, NULL);
     if (L) {
+        // Enforce the default memory limit
+        lua_setmemorylimit(L, -1, ROBLOX_VM_DEFAULT_MAX_MEMORY);
+
+        // Verify bytecode at load time so that malformed chunks are rejected before they run
+        luau_setverify(L, 1);
+
+        // Reuse functions of scripts that are executed repeatedly
+        luau_setloadcache(L, ROBLOX_VM_LOAD_CACHE_SIZE);
+
+        // Fuse common instruction pairs of loaded bytecode
+        luau_setfusion(L, 1);
+
         // Initialize metrics
-        roblox_vm_init_metrics();
+        roblox_vm_init_metrics(L);
         
         // Set up custom error handler
         // In a real implementation, you would register a custom error handler here
@@ -174,10 +163,19 @@ lua_State* roblox_vm_newstate() {
     return L;
 }
 
+// Close a state created by roblox_vm_newstate; helper threads that refer to it are stopped first
+void roblox_vm_close(lua_State* L) {
+    roblox_vm_watchdog_disarm(L);
+    roblox_vm_profiler_stop(L, nullptr, false);
+    roblox_vm_background_sweep_stop(L);
+
+    lua_close(L);
+}
+
 // Enhanced bytecode loader with security checks
 int roblox_vm_load(lua_State* L, const char* chunkname, const char* bytecode, size_t bytecode_size) {
     // Initialize metrics
-    roblox_vm_init_metrics();
+    roblox_vm_init_metrics(L);
     
     // Validate bytecode header (simplified check)
     if (bytecode_size < 4 || memcmp(bytecode, LUA_SIGNATURE, 4) != 0) {
@@ -188,31 +186,65 @@ int roblox_vm_load(lua_State* L, const char* chunkname, const char* bytecode, si
     // Load the bytecode
     int status = luau_load(L, chunkname, bytecode, bytecode_size, 0);
     
-    // Update metrics
-    g_vmMetrics.memoryUsed = lua_gc(L, LUA_GCCOUNT, 0) * 1024;
+    // Publish metrics
+    lua_publishmetrics(L);
     
     return status;
 }
 
+static void roblox_vm_unmap(void* ud, const char* data, size_t size) {
+    (void)ud;
+    munmap(const_cast<char*>(data), size);
+}
+
+// Load a bytecode file without reading it upfront; functions are materialized from the mapping when they first run
+int roblox_vm_load_file(lua_State* L, const char* chunkname, const char* path) {
+    roblox_vm_init_metrics(L);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        lua_pushfstring(L, "cannot open %s", path);
+        return LUA_ERRRUN;
+    }
+
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        data = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        lua_pushfstring(L, "cannot map %s", path);
+        return LUA_ERRRUN;
+    }
+
+    // the mapping is released by the VM once no function needs it anymore, even if loading fails
+    int status = luau_loadmapped(L, chunkname, static_cast<const char*>(data), size_t(st.st_size), 0, roblox_vm_unmap, NULL);
+
+    lua_publishmetrics(L);
+
+    return status;
+}
+
 // Enhanced function to safely call a Lua function with timeout and memory checks
 int roblox_vm_pcall(lua_State* L, int nargs, int nresults) {
     // Initialize metrics
-    roblox_vm_init_metrics();
+    roblox_vm_init_metrics(L);
     
     // Set up timeout detection
-    // In a real implementation, you would set up a timer or use a hook
+    // Long-running scripts are interrupted by the watchdog, see roblox_vm_setup_loop_detection
     
     // Call the function
     int status = lua_pcall(L, nargs, nresults, 0);
     
-    // Update final metrics
-    auto now = std::chrono::high_resolution_clock::now();
-    g_vmMetrics.executionTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - g_executionStartTime).count();
-    g_vmMetrics.memoryUsed = lua_gc(L, LUA_GCCOUNT, 0) * 1024;
+    // Publish final metrics
+    lua_publishmetrics(L);
     
     // Check for timeout after execution
-    if (g_vmMetrics.executionTimeMs > ROBLOX_VM_TIMEOUT_MS) {
-        g_vmMetrics.timedOut = true;
+    if (roblox_vm_check_timeout(L)) {
+        L->global->metrics.timeouts++;
         lua_pushstring(L, "Script execution timed out");
         return LUA_ERRRUN;
     }
@@ -231,14 +263,8 @@ void roblox_vm_register_security(lua_State* L) {
 
 // Enhanced garbage collection with metrics
 int roblox_vm_gc(lua_State* L, int what, int data) {
-    int result = lua_gc(L, what, data);
-    
-    // Update memory metrics after GC
-    if (what == LUA_GCCOLLECT || what == LUA_GCSTEP) {
-        g_vmMetrics.memoryUsed = lua_gc(L, LUA_GCCOUNT, 0) * 1024;
-    }
-    
-    return result;
+    // Memory metrics are published by the collector at the end of every step
+    return lua_gc(L, what, data);
 }
 
 // Get detailed error information
@@ -248,13 +274,15 @@ const char* roblox_vm_get_error_details(lua_State* L) {
     // Get the error message from the stack
     const char* errorMsg = lua_tostring(L, -1);
     
+    RobloxVMMetrics metrics = roblox_vm_get_metrics(L);
+    
     // Format with additional information
     snprintf(errorBuffer, sizeof(errorBuffer), 
              "Error: %s\nExecution time: %lld ms\nMemory used: %zu bytes\nCall depth: %d\n",
              errorMsg ? errorMsg : "Unknown error",
-             g_vmMetrics.executionTimeMs,
-             g_vmMetrics.memoryUsed,
-             g_vmMetrics.callDepth);
+             (long long)metrics.executionTimeMs,
+             metrics.memoryUsed,
+             lua_stackdepth(L));
     
     return errorBuffer;
 }
@@ -271,7 +299,7 @@ int roblox_vm_table_access(lua_State* L, int tableIndex, const char* key) {
     lua_getfield(L, tableIndex, key);
     
     // Check for timeout during this operation
-    if (roblox_vm_check_timeout()) {
+    if (roblox_vm_check_timeout(L)) {
         lua_pushstring(L, "Script execution timed out during table access");
         return LUA_ERRRUN;
     }
@@ -304,29 +332,253 @@ void roblox_vm_create_sandbox(lua_State* L) {
     lua_setfenv(L, -2);
 }
 
-// Enhanced function to detect and prevent infinite loops
-void roblox_vm_setup_loop_detection(lua_State* L) {
-    // Set up a hook that checks for timeout every N instructions
-    lua_sethook(L, [](lua_State* L, lua_Debug*) {
-        // Increment instruction count
-        g_vmMetrics.instructionsExecuted++;
-        
-        // Check for timeout
-        if (roblox_vm_check_timeout()) {
-            luaL_error(L, "Script execution timed out (possible infinite loop)");
+// Execution watchdog
+//
+// Scripts are not observed while they are within their deadline: a single timer thread sleeps until the earliest
+// armed deadline and only then raises a timeout request in the expired state. Until that happens the interpreter pays
+// nothing beyond the relaxed load of the request word it performs inline at every safepoint (loop back edges, call/ret),
+// so watchdogged scripts run at full dispatch speed.
+
+// States with an armed deadline that didn't expire yet; guarded by g_watchdogMutex. The timer thread is detached and keeps
+// waiting during static destruction, so the objects it uses are never destroyed
+static std::unordered_set<global_State*>& g_watchdogs = *new std::unordered_set<global_State*>();
+static std::mutex& g_watchdogMutex = *new std::mutex();
+static std::condition_variable& g_watchdogWakeup = *new std::condition_variable();
+static bool g_watchdogThreadStarted = false;
+
+static void roblox_vm_watchdog_thread() {
+    std::unique_lock<std::mutex> lock(g_watchdogMutex);
+
+    for (;;) {
+        double now = lua_clock();
+        double next = 0;
+
+        for (auto it = g_watchdogs.begin(); it != g_watchdogs.end();) {
+            global_State* g = *it;
+            double deadline = g->deadline.load(std::memory_order_relaxed);
+
+            if (deadline <= now) {
+                // the state checks the deadline again when it handles the request, so re-arming it in the meantime is harmless
+                g->interruptrequests.fetch_or(INTERRUPT_TIMEOUT, std::memory_order_relaxed);
+                it = g_watchdogs.erase(it);
+            } else {
+                if (next == 0 || deadline < next)
+                    next = deadline;
+                ++it;
+            }
         }
-        
-        // Check for memory limit
-        if (roblox_vm_check_memory(L)) {
-            luaL_error(L, "Memory limit exceeded");
+
+        if (next == 0)
+            g_watchdogWakeup.wait(lock);
+        else
+            g_watchdogWakeup.wait_for(lock, std::chrono::duration<double>(next - now));
+    }
+}
+
+// Arm the execution watchdog of L's global state; the running script is interrupted with an error once timeoutMs elapses
+void roblox_vm_watchdog_arm(lua_State* L, int timeoutMs) {
+    std::lock_guard<std::mutex> lock(g_watchdogMutex);
+
+    if (!g_watchdogThreadStarted) {
+        std::thread(roblox_vm_watchdog_thread).detach();
+        g_watchdogThreadStarted = true;
+    }
+
+    L->global->deadline.store(lua_clock() + timeoutMs / 1000.0, std::memory_order_relaxed);
+    g_watchdogs.insert(L->global);
+
+    g_watchdogWakeup.notify_one();
+}
+
+// Disarm the execution watchdog of L's global state
+void roblox_vm_watchdog_disarm(lua_State* L) {
+    std::lock_guard<std::mutex> lock(g_watchdogMutex);
+
+    L->global->deadline.store(0, std::memory_order_relaxed);
+    g_watchdogs.erase(L->global);
+}
+
+// Sampling profiler
+//
+// A timer thread per profiled state requests samples at the configured frequency through lua_profilerrequest. The VM
+// takes each sample at its next safepoint, where pending requests are checked inline, so scripts run at full speed between samples.
+struct RobloxVMProfiler {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    bool stopping = false;
+};
+
+// Running profilers, keyed by the global state they belong to; guarded by g_profilerMutex
+static std::unordered_map<global_State*, RobloxVMProfiler*> g_profilers;
+static std::mutex g_profilerMutex;
+
+static void roblox_vm_profiler_thread(lua_State* L, RobloxVMProfiler* profiler, int frequencyHz) {
+    auto period = std::chrono::nanoseconds(1000000000 / frequencyHz);
+    auto next = std::chrono::steady_clock::now() + period;
+
+    std::unique_lock<std::mutex> lock(profiler->mutex);
+
+    while (!profiler->wakeup.wait_until(lock, next, [&] { return profiler->stopping; })) {
+        lua_profilerrequest(L);
+
+        // ticks that were missed while the thread wasn't scheduled are skipped instead of being requested in a burst
+        auto now = std::chrono::steady_clock::now();
+        next += period;
+        if (next < now)
+            next = now + period;
+    }
+}
+
+static void roblox_vm_profiler_write(void* context, const char* data, size_t size) {
+    fwrite(data, 1, size, static_cast<FILE*>(context));
+}
+
+// Start sampling L at frequencyHz into a ring buffer of capacity frames; restarts the profiler if it's already running
+void roblox_vm_profiler_start(lua_State* L, int frequencyHz, int capacity) {
+    roblox_vm_profiler_stop(L, nullptr, false);
+
+    lua_profilerstart(L, capacity);
+
+    RobloxVMProfiler* profiler = new RobloxVMProfiler();
+    profiler->thread = std::thread(roblox_vm_profiler_thread, L->global->mainthread, profiler, frequencyHz);
+
+    std::lock_guard<std::mutex> lock(g_profilerMutex);
+    g_profilers[L->global] = profiler;
+}
+
+// Stop the profiler of L and write the samples to path in folded stack format, which flamegraph tools take as input
+bool roblox_vm_profiler_stop(lua_State* L, const char* path, bool lines) {
+    RobloxVMProfiler* profiler = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(g_profilerMutex);
+
+        auto it = g_profilers.find(L->global);
+        if (it != g_profilers.end()) {
+            profiler = it->second;
+            g_profilers.erase(it);
+        }
+    }
+
+    // the thread has to be gone before the ring buffer is freed since it may be requesting a sample
+    if (profiler) {
+        {
+            std::lock_guard<std::mutex> lock(profiler->mutex);
+            profiler->stopping = true;
+        }
+        profiler->wakeup.notify_one();
+        profiler->thread.join();
+        delete profiler;
+    }
+
+    bool written = false;
+
+    if (path) {
+        if (FILE* file = fopen(path, "w")) {
+            lua_profilerdump(L, lines, file, roblox_vm_profiler_write);
+            written = fclose(file) == 0;
+        }
+    }
+
+    lua_profilerstop(L);
+    return written;
+}
+
+// Background sweeping
+//
+// A helper thread per state sweeps the pages queued by the GC at the end of each mark phase, so that GC steps on the thread
+// running the state only need to return the swept pages to the allocator.
+struct RobloxVMSweeper {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    bool pending = false;
+    bool stopping = false;
+};
+
+// Running sweepers, keyed by the global state they belong to; guarded by g_sweeperMutex
+static std::unordered_map<global_State*, RobloxVMSweeper*> g_sweepers;
+static std::mutex g_sweeperMutex;
+
+// Called by the GC on the thread running the state, so it only wakes the helper up
+static void roblox_vm_sweeper_notify(void* ud) {
+    RobloxVMSweeper* sweeper = static_cast<RobloxVMSweeper*>(ud);
+
+    {
+        std::lock_guard<std::mutex> lock(sweeper->mutex);
+        sweeper->pending = true;
+    }
+    sweeper->wakeup.notify_one();
+}
+
+static void roblox_vm_sweeper_thread(lua_State* L, RobloxVMSweeper* sweeper) {
+    std::unique_lock<std::mutex> lock(sweeper->mutex);
+
+    for (;;) {
+        sweeper->wakeup.wait(lock, [&] { return sweeper->pending || sweeper->stopping; });
+        if (sweeper->stopping)
+            break;
+
+        sweeper->pending = false;
+
+        lock.unlock();
+        lua_gcsweepbackground(L);
+        lock.lock();
+    }
+}
+
+// Sweep the heap of L on a helper thread; only worth it when the device has a core to spare
+void roblox_vm_background_sweep_start(lua_State* L) {
+    roblox_vm_background_sweep_stop(L);
+
+    RobloxVMSweeper* sweeper = new RobloxVMSweeper();
+    sweeper->thread = std::thread(roblox_vm_sweeper_thread, L->global->mainthread, sweeper);
+
+    lua_gcsetbackgroundsweep(L, sweeper, roblox_vm_sweeper_notify);
+
+    std::lock_guard<std::mutex> lock(g_sweeperMutex);
+    g_sweepers[L->global] = sweeper;
+}
+
+// Stop sweeping L in the background; the rest of the current sweep, if any, is finished on the calling thread
+void roblox_vm_background_sweep_stop(lua_State* L) {
+    RobloxVMSweeper* sweeper = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(g_sweeperMutex);
+
+        auto it = g_sweepers.find(L->global);
+        if (it != g_sweepers.end()) {
+            sweeper = it->second;
+            g_sweepers.erase(it);
+        }
+    }
+
+    if (sweeper) {
+        // after this, the GC doesn't notify the helper anymore and no page is left for it to sweep
+        lua_gcsetbackgroundsweep(L, nullptr, nullptr);
+
+        {
+            std::lock_guard<std::mutex> lock(sweeper->mutex);
+            sweeper->stopping = true;
         }
-    }, LUA_MASKCOUNT, 1000); // Check every 1000 instructions
+        sweeper->wakeup.notify_one();
+        sweeper->thread.join();
+        delete sweeper;
+    }
+}
+
+// Enhanced function to detect and prevent infinite loops
+void roblox_vm_setup_loop_detection(lua_State* L) {
+    // Interrupt the script once the execution timeout elapses; memory limits are enforced by the allocator
+    roblox_vm_watchdog_arm(L, ROBLOX_VM_TIMEOUT_MS);
 }
 
 // Enhanced function to safely execute a script with all security measures
 int roblox_vm_execute_script(lua_State* L, const char* script, size_t scriptLen, const char* chunkname) {
     // Initialize metrics
-    roblox_vm_init_metrics();
+    roblox_vm_init_metrics(L);
     
     // Load the script
     if (luaL_loadbuffer(L, script, scriptLen, chunkname) != LUA_OK) {
@@ -340,5 +592,9 @@ int roblox_vm_execute_script(lua_State* L, const char* script, size_t scriptLen,
     roblox_vm_setup_loop_detection(L);
     
     // Execute with all safety measures
-    return roblox_vm_pcall(L, 0, LUA_MULTRET);
+    int status = roblox_vm_pcall(L, 0, LUA_MULTRET);
+
+    roblox_vm_watchdog_disarm(L);
+
+    return status;
 }
@@ -8,6 +8,8 @@
 #include "lgc.h"
 #include "ldo.h"
 #include "lnumutils.h"
+#include "lmem.h"
+#include "lbytecode.h"
 
 #include <string.h>
 
@@ -19,7 +21,7 @@ const TValue* luaV_tonumber(const TValue* obj, TValue* n)
     double num;
     if (ttisnumber(obj))
         return obj;
-    if (ttisstring(obj) && luaO_str2d(svalue(obj), &num))
+    if (ttisstring(obj) && luaS_str2d(tsvalue(obj), &num))
     {
         setnvalue(n, num);
         return n;
@@ -174,6 +176,120 @@ void luaV_settable(lua_State* L, const TValue* t, TValue* key, StkId val)
     luaG_runerror(L, "'__newindex' chain too long; possible loop");
 }
 
+static bool iscached(uint8_t op)
+{
+    return op == LOP_GETTABLEKS || op == LOP_SETTABLEKS || op == LOP_NAMECALL || op == LOP_FUSED_GETTABLEKS_NAMECALL;
+}
+
+// caches are only allocated for functions that perform field accesses on objects with metatables that miss the slot hint
+static void createicache(lua_State* L, Proto* p)
+{
+    int count = 0;
+
+    // breakpoints replace opcodes with LOP_BREAK, but debuginsn keeps the original ones that are needed to find instruction boundaries
+    for (int pc = 0; pc < p->sizecode;)
+    {
+        uint8_t op = p->debuginsn ? p->debuginsn[pc] : LUAU_INSN_OP(p->code[pc]);
+        count += iscached(op);
+        pc += getOpLength(op);
+    }
+
+    // instructions past the limit of 16-bit indices are left without a cache
+    if (count > UINT16_MAX)
+        count = UINT16_MAX;
+
+    // icindex is assigned last since it marks the caches as ready; caches left by an attempt that ran out of memory are replaced
+    if (p->icache)
+    {
+        luaM_freearray(L, p->icache, p->sizeicache, InlineCache, p->memcat);
+        p->icache = NULL;
+        p->sizeicache = 0;
+    }
+
+    p->icache = luaM_newarray(L, count, InlineCache, p->memcat);
+    p->sizeicache = count;
+    memset(p->icache, 0, sizeof(InlineCache) * count);
+
+    uint16_t* icindex = luaM_newarray(L, p->sizecode, uint16_t, p->memcat);
+    memset(icindex, 0, sizeof(uint16_t) * p->sizecode);
+
+    int index = 0;
+
+    for (int pc = 0; pc < p->sizecode;)
+    {
+        uint8_t op = p->debuginsn ? p->debuginsn[pc] : LUAU_INSN_OP(p->code[pc]);
+
+        if (iscached(op) && index < count)
+            icindex[pc] = uint16_t(++index);
+
+        pc += getOpLength(op);
+    }
+
+    p->icindex = icindex;
+}
+
+void luaV_icachefill(lua_State* L, Proto* p, const Instruction* pc, LuaTable* mt, int slot)
+{
+    if (!p->icindex)
+        createicache(L, p);
+
+    int index = p->icindex[pc - p->code];
+
+    if (index == 0)
+        return;
+
+    InlineCache* ic = &p->icache[index - 1];
+
+    // an entry that is already present has failed validation, so its slot is replaced in place
+    for (int i = 0; i < ic->size; ++i)
+    {
+        if (ic->metatable[i] == mt)
+        {
+            ic->slot[i] = slot;
+            return;
+        }
+    }
+
+    int i = ic->size < LUA_ICACHEWAYS ? ic->size++ : ic->next;
+
+    ic->metatable[i] = mt;
+    ic->slot[i] = slot;
+    ic->next = uint8_t((i + 1) % LUA_ICACHEWAYS);
+}
+
+const TValue* luaV_icacheget(lua_State* L, Proto* p, const Instruction* pc, LuaTable* h, LuaTable* mt, TString* key)
+{
+    L->global->metrics.icachemisses++;
+
+    // the lookup doesn't invoke metamethods; anything that isn't a raw field of the receiver or of its __index table is left to luaV_gettable
+    if (h)
+    {
+        const TValue* res = luaH_getstr(h, key);
+
+        if (!ttisnil(res))
+        {
+            luaV_icachefill(L, p, pc, mt, gval2slot(h, res));
+            return res;
+        }
+    }
+
+    const TValue* index = fasttm(L, mt, TM_INDEX);
+
+    if (index && ttistable(index))
+    {
+        LuaTable* t = hvalue(index);
+        const TValue* res = luaH_getstr(t, key);
+
+        if (!ttisnil(res))
+        {
+            luaV_icachefill(L, p, pc, mt, ~gval2slot(t, res));
+            return res;
+        }
+    }
+
+    return NULL;
+}
+
 static int call_binTM(lua_State* L, const TValue* p1, const TValue* p2, StkId res, TMS event)
 {
     const TValue* tm = luaT_gettmbyobj(L, p1, event); // try first operand
@@ -303,6 +419,8 @@ int luaV_equalval(lua_State* L, const TValue* t1, const TValue* t2)
             return hvalue(t1) == hvalue(t2);
         break; // will try TM
     }
+    case LUA_TSTRING:
+        return luaS_eqstr(tsvalue(t1), tsvalue(t2));
     default:
         return gcvalue(t1) == gcvalue(t2);
     }
@@ -338,34 +456,55 @@ void luaV_concat(lua_State* L, int total, int last)
                 tl += l;
             }
 
-            char buf[LUA_BUFFERSIZE];
-            TString* ts = nullptr;
-
-            if (tl < LUA_BUFFERSIZE)
-            {
-                buffer = buf;
-            }
-            else
-            {
-                ts = luaS_bufstart(L, tl);
-                buffer = ts->data;
-            }
-
-            tl = 0;
-            for (i = n; i > 0; i--)
-            { // concat all strings
-                size_t l = tsvalue(top - i)->len;
-                memcpy(buffer + tl, svalue(top - i), l);
-                tl += l;
-            }
-
-            if (tl < LUA_BUFFERSIZE)
+            if (tl >= LUA_MINSTRVIEW)
             {
-                setsvalue(L, top - n, luaS_newlstr(L, buffer, tl));
+                // long results are views into storage that begins with the first operand, which is extended in place when
+                // the first operand is a view at its end; 's = s .. x' in a loop copies every piece once this way
+                TString* first = tsvalue(top - n);
+                TString* storage = luaS_reserve(L, first, tl);
+                size_t offset = storage->used - first->len;
+
+                tl = storage->used;
+                for (i = n - 1; i > 0; i--)
+                {
+                    size_t l = tsvalue(top - i)->len;
+                    memcpy(storage->data + tl, svalue(top - i), l);
+                    tl += l;
+                }
+
+                setsvalue(L, top - n, luaS_newview(L, storage, offset, tl - offset));
             }
             else
             {
-                setsvalue(L, top - n, luaS_buffinish(L, ts));
+                char buf[LUA_BUFFERSIZE];
+                TString* ts = nullptr;
+
+                if (tl < LUA_BUFFERSIZE)
+                {
+                    buffer = buf;
+                }
+                else
+                {
+                    ts = luaS_bufstart(L, tl);
+                    buffer = ts->data;
+                }
+
+                tl = 0;
+                for (i = n; i > 0; i--)
+                { // concat all strings
+                    size_t l = tsvalue(top - i)->len;
+                    memcpy(buffer + tl, svalue(top - i), l);
+                    tl += l;
+                }
+
+                if (tl < LUA_BUFFERSIZE)
+                {
+                    setsvalue(L, top - n, luaS_newlstr(L, buffer, tl));
+                }
+                else
+                {
+                    setsvalue(L, top - n, luaS_buffinish(L, ts));
+                }
             }
         }
         total -= n - 1; // got `n' strings to create 1 new
@@ -0,0 +1,449 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "lvm.h"
+
+#include "lstate.h"
+#include "lmem.h"
+#include "lbytecode.h"
+
+#include <string.h>
+
+/*
+ * Load-time bytecode verification
+ *
+ * The interpreter trusts bytecode: register operands index the stack frame directly, constant operands index Proto::k and jump offsets
+ * move pc without any bounds checks (these are only asserted in debug builds). luaV_verifyproto proves these invariants for a single
+ * function in one pass over its code, so that luau_load can reject malformed chunks before they run.
+ *
+ * Verification expects the function to be fully deserialized: constants are type-checked, and the upvalue counts of child functions
+ * are needed to validate the CAPTURE sequences that follow NEWCLOSURE/DUPCLOSURE.
+ *
+ * Verified functions run in the same interpreter loop as the rest: every check in it that verification makes redundant is one of
+ * the assertions above, which release builds already omit, so there are no runtime checks left to skip.
+ */
+
+// marks[] flags; jump targets are validated after the pass since forward targets are not known to be instruction starts until then
+const uint8_t kInsnStart = 1 << 0;
+const uint8_t kJumpTarget = 1 << 1;
+
+// functions up to this size keep their marks on the C stack
+const int kStackMarks = 1024;
+
+#define VERIFY(cond, what) \
+    if (LUAU_UNLIKELY(!(cond))) \
+    { \
+        *errpc = pc; \
+        return what; \
+    }
+
+#define VERIFY_REG(r) VERIFY(unsigned(r) < maxstack, "register out of range")
+#define VERIFY_REGRANGE(r, n) VERIFY(unsigned(r) + unsigned(n) <= maxstack, "register range out of bounds")
+#define VERIFY_K(i) VERIFY(unsigned(i) < unsigned(p->sizek), "constant index out of range")
+#define VERIFY_KTYPE(i, t) VERIFY(unsigned(i) < unsigned(p->sizek) && ttype(&p->k[i]) == (t), "constant has unexpected type")
+#define VERIFY_UV(u) VERIFY(unsigned(u) < unsigned(p->nups), "upvalue out of range")
+
+// jump offsets are relative to the instruction following the opcode word
+#define VERIFY_JUMP(offset) \
+    { \
+        int target = pc + 1 + (offset); \
+        VERIFY(unsigned(target) < unsigned(sizecode), "jump target out of range"); \
+        marks[target] |= kJumpTarget; \
+    }
+
+// FASTCALL* instructions name the CALL they guard; the fast path resumes right after it
+#define VERIFY_FASTCALL(skip) \
+    { \
+        int call = pc + 1 + (skip); \
+        VERIFY(unsigned(call) < unsigned(sizecode) && LUAU_INSN_OP(code[call]) == LOP_CALL, "fastcall is not followed by a call"); \
+        VERIFY_JUMP(skip); \
+    }
+
+// validates the CAPTURE pseudo-instructions that follow a closure creation at pc; returns their count via ncaptures
+static const char* verifycaptures(const Proto* p, int pc, int nups, bool allowref, int* ncaptures, int* errpc)
+{
+    const Instruction* code = p->code;
+    int sizecode = p->sizecode;
+    unsigned maxstack = p->maxstacksize;
+
+    VERIFY(pc + 1 + nups <= sizecode, "closure captures extend past the end of the function");
+
+    for (int ui = 0; ui < nups; ++ui)
+    {
+        Instruction uinsn = code[pc + 1 + ui];
+
+        VERIFY(LUAU_INSN_OP(uinsn) == LOP_CAPTURE, "closure is missing a capture");
+
+        switch (LUAU_INSN_A(uinsn))
+        {
+        case LCT_VAL:
+            VERIFY_REG(LUAU_INSN_B(uinsn));
+            break;
+
+        case LCT_REF:
+            VERIFY(allowref, "shared closure captures a reference");
+            VERIFY_REG(LUAU_INSN_B(uinsn));
+            break;
+
+        case LCT_UPVAL:
+            VERIFY_UV(LUAU_INSN_B(uinsn));
+            break;
+
+        default:
+            VERIFY(false, "unknown capture type");
+        }
+    }
+
+    *ncaptures = nups;
+    return NULL;
+}
+
+static const char* verifycode(const Proto* p, uint8_t* marks, int* errpc)
+{
+    const Instruction* code = p->code;
+    int sizecode = p->sizecode;
+    unsigned maxstack = p->maxstacksize;
+
+    int pc = 0;
+    int lastpc = 0;
+
+    VERIFY(p->numparams <= maxstack, "parameters exceed stack size");
+
+    while (pc < sizecode)
+    {
+        Instruction insn = code[pc];
+        uint8_t op = LUAU_INSN_OP(insn);
+
+        VERIFY(op < LOP__COUNT, "unknown opcode");
+
+        int len = getOpLength(op);
+        VERIFY(pc + len <= sizecode, "instruction extends past the end of the function");
+
+        uint32_t aux = len > 1 ? code[pc + 1] : 0;
+
+        int a = LUAU_INSN_A(insn);
+        int b = LUAU_INSN_B(insn);
+        int c = LUAU_INSN_C(insn);
+        int d = LUAU_INSN_D(insn);
+
+        marks[pc] |= kInsnStart;
+
+        switch (op)
+        {
+        case LOP_NOP:
+        case LOP_COVERAGE:
+            break;
+
+        case LOP_LOADNIL:
+        case LOP_LOADN:
+        case LOP_NEWTABLE:
+        case LOP_CLOSEUPVALS:
+            VERIFY_REG(a);
+            break;
+
+        case LOP_LOADB:
+            VERIFY_REG(a);
+            if (c != 0)
+                VERIFY_JUMP(c);
+            break;
+
+        case LOP_LOADK:
+            VERIFY_REG(a);
+            VERIFY_K(d);
+            break;
+
+        case LOP_LOADKX:
+            VERIFY_REG(a);
+            VERIFY_K(aux);
+            break;
+
+        case LOP_MOVE:
+        case LOP_NOT:
+        case LOP_MINUS:
+        case LOP_LENGTH:
+        case LOP_GETTABLEN:
+        case LOP_SETTABLEN:
+            VERIFY_REG(a);
+            VERIFY_REG(b);
+            break;
+
+        case LOP_GETGLOBAL:
+        case LOP_SETGLOBAL:
+            VERIFY_REG(a);
+            VERIFY_KTYPE(aux, LUA_TSTRING);
+            break;
+
+        case LOP_GETUPVAL:
+        case LOP_SETUPVAL:
+            VERIFY_REG(a);
+            VERIFY_UV(b);
+            break;
+
+        case LOP_GETIMPORT:
+        {
+            int count = aux >> 30;
+
+            VERIFY_REG(a);
+            VERIFY_K(d);
+            VERIFY(count >= 1, "import path is empty");
+            VERIFY_K((aux >> 20) & 1023);
+            if (count >= 2)
+                VERIFY_K((aux >> 10) & 1023);
+            if (count >= 3)
+                VERIFY_K(aux & 1023);
+            break;
+        }
+
+        case LOP_GETTABLE:
+        case LOP_SETTABLE:
+        case LOP_ADD:
+        case LOP_SUB:
+        case LOP_MUL:
+        case LOP_DIV:
+        case LOP_IDIV:
+        case LOP_MOD:
+        case LOP_POW:
+        case LOP_AND:
+        case LOP_OR:
+            VERIFY_REG(a);
+            VERIFY_REG(b);
+            VERIFY_REG(c);
+            break;
+
+        case LOP_GETTABLEKS:
+        case LOP_SETTABLEKS:
+            VERIFY_REG(a);
+            VERIFY_REG(b);
+            VERIFY_KTYPE(aux, LUA_TSTRING);
+            break;
+
+        case LOP_NAMECALL:
+            VERIFY_REG(a + 1);
+            VERIFY_REG(b);
+            VERIFY_KTYPE(aux, LUA_TSTRING);
+            VERIFY(pc + 2 < sizecode && LUAU_INSN_OP(code[pc + 2]) == LOP_CALL, "namecall is not followed by a call");
+            break;
+
+        case LOP_ADDK:
+        case LOP_SUBK:
+        case LOP_MULK:
+        case LOP_DIVK:
+        case LOP_IDIVK:
+        case LOP_MODK:
+        case LOP_POWK:
+            // arithmetic fast paths read the constant as a number without checking its type
+            VERIFY_REG(a);
+            VERIFY_REG(b);
+            VERIFY_KTYPE(c, LUA_TNUMBER);
+            break;
+
+        case LOP_ANDK:
+        case LOP_ORK:
+            VERIFY_REG(a);
+            VERIFY_REG(b);
+            VERIFY_K(c);
+            break;
+
+        case LOP_SUBRK:
+        case LOP_DIVRK:
+            VERIFY_REG(a);
+            VERIFY_KTYPE(b, LUA_TNUMBER);
+            VERIFY_REG(c);
+            break;
+
+        case LOP_CONCAT:
+            VERIFY_REG(a);
+            VERIFY(b <= c, "concat range is empty");
+            VERIFY_REG(c);
+            break;
+
+        case LOP_DUPTABLE:
+            VERIFY_REG(a);
+            VERIFY_KTYPE(d, LUA_TTABLE);
+            break;
+
+        case LOP_SETLIST:
+            VERIFY_REG(a);
+            VERIFY_REG(b);
+            if (c != 0)
+                VERIFY_REGRANGE(b, c - 1);
+            break;
+
+        case LOP_NEWCLOSURE:
+        {
+            VERIFY_REG(a);
+            VERIFY(unsigned(d) < unsigned(p->sizep), "child function index out of range");
+
+            int ncaptures = 0;
+            if (const char* error = verifycaptures(p, pc, p->p[d]->nups, /* allowref= */ true, &ncaptures, errpc))
+                return error;
+
+            len += ncaptures;
+            break;
+        }
+
+        case LOP_DUPCLOSURE:
+        {
+            VERIFY_REG(a);
+            VERIFY_KTYPE(d, LUA_TFUNCTION);
+
+            // the closure may be shared between calls, so it can't capture locals by reference
+            int ncaptures = 0;
+            if (const char* error = verifycaptures(p, pc, clvalue(&p->k[d])->nupvalues, /* allowref= */ false, &ncaptures, errpc))
+                return error;
+
+            len += ncaptures;
+            break;
+        }
+
+        case LOP_CALL:
+            VERIFY_REG(a);
+            if (b != 0)
+                VERIFY_REGRANGE(a + 1, b - 1);
+            if (c != 0)
+                VERIFY_REGRANGE(a, c - 1);
+            break;
+
+        case LOP_RETURN:
+            // note: with a multiple return the first value can be at the top of the frame
+            VERIFY(unsigned(a) <= maxstack, "register out of range");
+            if (b != 0)
+                VERIFY_REGRANGE(a, b - 1);
+            break;
+
+        case LOP_GETVARARGS:
+            VERIFY(p->is_vararg, "varargs used in a function that isn't vararg");
+            VERIFY_REG(a);
+            if (b != 0)
+                VERIFY_REGRANGE(a, b - 1);
+            break;
+
+        case LOP_PREPVARARGS:
+            VERIFY(pc == 0 && p->is_vararg && a == p->numparams, "vararg prologue is malformed");
+            break;
+
+        case LOP_JUMP:
+        case LOP_JUMPBACK:
+            VERIFY_JUMP(d);
+            break;
+
+        case LOP_JUMPX:
+            VERIFY_JUMP(LUAU_INSN_E(insn));
+            break;
+
+        case LOP_JUMPIF:
+        case LOP_JUMPIFNOT:
+        case LOP_JUMPXEQKNIL:
+        case LOP_JUMPXEQKB:
+            VERIFY_REG(a);
+            VERIFY_JUMP(d);
+            break;
+
+        case LOP_JUMPIFEQ:
+        case LOP_JUMPIFLE:
+        case LOP_JUMPIFLT:
+        case LOP_JUMPIFNOTEQ:
+        case LOP_JUMPIFNOTLE:
+        case LOP_JUMPIFNOTLT:
+            VERIFY_REG(a);
+            VERIFY_REG(aux);
+            VERIFY_JUMP(d);
+            break;
+
+        case LOP_JUMPXEQKN:
+            VERIFY_REG(a);
+            VERIFY_KTYPE(aux & 0xffffff, LUA_TNUMBER);
+            VERIFY_JUMP(d);
+            break;
+
+        case LOP_JUMPXEQKS:
+            VERIFY_REG(a);
+            VERIFY_KTYPE(aux & 0xffffff, LUA_TSTRING);
+            VERIFY_JUMP(d);
+            break;
+
+        case LOP_FORNPREP:
+        case LOP_FORNLOOP:
+        case LOP_FORGPREP:
+        case LOP_FORGPREP_INEXT:
+        case LOP_FORGPREP_NEXT:
+            VERIFY_REGRANGE(a, 3);
+            VERIFY_JUMP(d);
+            break;
+
+        case LOP_FORGLOOP:
+            VERIFY_REGRANGE(a, 3 + (aux & 0xff));
+            VERIFY_JUMP(d);
+            break;
+
+        case LOP_FASTCALL:
+            VERIFY_FASTCALL(c);
+            break;
+
+        case LOP_FASTCALL1:
+            VERIFY_REG(b);
+            VERIFY_FASTCALL(c);
+            break;
+
+        case LOP_FASTCALL2:
+            VERIFY_REG(b);
+            VERIFY_REG(aux & 0xff);
+            VERIFY_FASTCALL(c);
+            break;
+
+        case LOP_FASTCALL2K:
+            VERIFY_REG(b);
+            VERIFY_K(aux);
+            VERIFY_FASTCALL(c);
+            break;
+
+        case LOP_FASTCALL3:
+            VERIFY_REG(b);
+            VERIFY_REG(aux & 0xff);
+            VERIFY_REG((aux >> 8) & 0xff);
+            VERIFY_FASTCALL(c);
+            break;
+
+        case LOP_BREAK:
+        case LOP_NATIVECALL:
+        case LOP_CAPTURE:
+            // breakpoints and native entries are patched in at runtime, and captures are only valid as part of a closure creation
+            VERIFY(false, "opcode is not valid in serialized bytecode");
+            break;
+
+        default:
+            VERIFY(false, "unknown opcode");
+        }
+
+        lastpc = pc;
+        pc += len;
+    }
+
+    // the interpreter doesn't check for running off the end of the code
+    pc = lastpc;
+
+    uint8_t lastop = LUAU_INSN_OP(code[lastpc]);
+    VERIFY(lastop == LOP_RETURN || lastop == LOP_JUMP || lastop == LOP_JUMPBACK || lastop == LOP_JUMPX, "function doesn't end with a return or jump");
+
+    for (pc = 0; pc < sizecode; ++pc)
+        VERIFY((marks[pc] & kJumpTarget) == 0 || (marks[pc] & kInsnStart) != 0, "jump target is inside an instruction");
+
+    return NULL;
+}
+
+const char* luaV_verifyproto(lua_State* L, Proto* p, int* errpc)
+{
+    *errpc = -1;
+
+    if (p->sizecode == 0)
+        return "function has no code";
+
+    uint8_t stackmarks[kStackMarks];
+    uint8_t* marks = p->sizecode <= kStackMarks ? stackmarks : luaM_newarray(L, p->sizecode, uint8_t, 0);
+    memset(marks, 0, p->sizecode);
+
+    const char* error = verifycode(p, marks, errpc);
+
+    if (marks != stackmarks)
+        luaM_freearray(L, marks, p->sizecode, uint8_t, 0);
+
+    return error;
+}
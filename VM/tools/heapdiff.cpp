@@ -0,0 +1,585 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "lua.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Compares two heap snapshots written by luaC_snapshot and reports what grew in between
+// usage: heapdiff before.snap after.snap [count]
+//
+// Objects are matched by address and type, so anything allocated after the first snapshot is treated as new. Addresses
+// are only stable between snapshots when the heap isn't defragmented (see LUA_GCSETDEFRAG), and an address that was
+// reused by an object of the same type looks old; both only make the report more conservative.
+//
+// New objects are charged to their nearest old dominator: the retainer that keeps them alive and that existed in the
+// first snapshot. For a leak, that is usually the cache or registry entry that keeps accumulating.
+
+struct Node
+{
+    uintptr_t ptr;
+    uint8_t tt;
+    uint8_t memcat;
+    uint32_t name;
+    size_t size;
+};
+
+struct Edge
+{
+    uint32_t from;
+    uint32_t to;
+    uint32_t name;
+};
+
+struct Snapshot
+{
+    size_t totalbytes = 0;
+
+    std::vector<std::string> names; // names[0] is empty
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;
+    std::vector<uint32_t> roots;
+
+    size_t catbytes[LUA_MEMORY_CATEGORIES] = {};
+    uint32_t catname[LUA_MEMORY_CATEGORIES] = {};
+
+    // sorted by address for lookups
+    std::vector<std::pair<uintptr_t, uint32_t>> index;
+};
+
+struct Reader
+{
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+
+    bool ok() const
+    {
+        return pos <= size;
+    }
+
+    uint8_t byte()
+    {
+        return pos < size ? data[pos++] : (pos++, 0);
+    }
+
+    uint64_t varint()
+    {
+        uint64_t result = 0;
+        int shift = 0;
+        uint8_t b;
+
+        do
+        {
+            b = byte();
+            result |= uint64_t(b & 127) << shift;
+            shift += 7;
+        } while ((b & 128) && shift < 64 && pos < size);
+
+        return result;
+    }
+
+    uintptr_t delta(uintptr_t base)
+    {
+        uint64_t value = varint();
+        return base + uintptr_t(int64_t(value >> 1) ^ -int64_t(value & 1));
+    }
+};
+
+static const char* typeName(uint8_t tt)
+{
+    switch (tt)
+    {
+    case LUA_TSTRING:
+        return "string";
+    case LUA_TTABLE:
+        return "table";
+    case LUA_TFUNCTION:
+        return "function";
+    case LUA_TUSERDATA:
+        return "userdata";
+    case LUA_TTHREAD:
+        return "thread";
+    case LUA_TBUFFER:
+        return "buffer";
+    case LUA_TPROTO:
+        return "proto";
+    case LUA_TUPVAL:
+        return "upvalue";
+    case uint8_t(LUA_TNONE):
+        return "native";
+    default:
+        return "unknown";
+    }
+}
+
+static uint32_t find(const Snapshot& s, uintptr_t ptr)
+{
+    auto it = std::lower_bound(s.index.begin(), s.index.end(), std::make_pair(ptr, uint32_t(0)));
+
+    return it != s.index.end() && it->first == ptr ? it->second : ~0u;
+}
+
+static bool load(const char* path, Snapshot& s)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "%s: can't open file\n", path);
+        return false;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t buffer[65536];
+
+    while (size_t read = fread(buffer, 1, sizeof(buffer), f))
+        data.insert(data.end(), buffer, buffer + read);
+
+    fclose(f);
+
+    Reader r = {data.data(), data.size(), 0};
+
+    if (data.size() < 4 || memcmp(data.data(), "LHS\x01", 4) != 0)
+    {
+        fprintf(stderr, "%s: not a heap snapshot\n", path);
+        return false;
+    }
+
+    r.pos = 4;
+    s.totalbytes = r.varint();
+    s.names.push_back(std::string());
+
+    // edges are resolved to node indices once all nodes are known
+    struct RawEdge
+    {
+        uintptr_t from;
+        uintptr_t to;
+        uint32_t name;
+    };
+
+    std::vector<RawEdge> rawedges;
+    std::vector<std::pair<uintptr_t, uint32_t>> rawroots;
+    uintptr_t lastnode = 0;
+
+    for (;;)
+    {
+        uint8_t tag = r.byte();
+
+        if (!r.ok())
+        {
+            fprintf(stderr, "%s: truncated snapshot\n", path);
+            return false;
+        }
+
+        if (tag == 'Z')
+            break;
+
+        switch (tag)
+        {
+        case 'S':
+        {
+            size_t len = size_t(r.varint());
+            if (len > r.size - std::min(r.pos, r.size))
+            {
+                fprintf(stderr, "%s: truncated snapshot\n", path);
+                return false;
+            }
+
+            s.names.push_back(std::string((const char*)r.data + r.pos, len));
+            r.pos += len;
+            break;
+        }
+        case 'N':
+        {
+            Node n;
+            n.ptr = r.delta(lastnode);
+            n.tt = r.byte();
+            n.memcat = r.byte();
+            n.size = size_t(r.varint());
+            n.name = uint32_t(r.varint());
+            s.nodes.push_back(n);
+            lastnode = n.ptr;
+            break;
+        }
+        case 'E':
+        {
+            RawEdge e;
+            e.from = r.delta(lastnode);
+            e.to = r.delta(e.from);
+            e.name = uint32_t(r.varint());
+            rawedges.push_back(e);
+            break;
+        }
+        case 'R':
+        {
+            uintptr_t ptr = r.delta(lastnode);
+            rawroots.push_back(std::make_pair(ptr, uint32_t(r.varint())));
+            break;
+        }
+        case 'C':
+        {
+            uint8_t cat = r.byte();
+            s.catbytes[cat] = size_t(r.varint());
+            s.catname[cat] = uint32_t(r.varint());
+            break;
+        }
+        default:
+            fprintf(stderr, "%s: unknown record '%c' at offset %zu\n", path, tag, r.pos - 1);
+            return false;
+        }
+    }
+
+    s.index.reserve(s.nodes.size());
+    for (size_t i = 0; i < s.nodes.size(); ++i)
+        s.index.push_back(std::make_pair(s.nodes[i].ptr, uint32_t(i)));
+
+    std::sort(s.index.begin(), s.index.end());
+
+    // edges to objects that weren't enumerated (there shouldn't be any) are dropped
+    s.edges.reserve(rawedges.size());
+    for (const RawEdge& e : rawedges)
+    {
+        uint32_t from = find(s, e.from);
+        uint32_t to = find(s, e.to);
+
+        if (from != ~0u && to != ~0u)
+            s.edges.push_back({from, to, e.name});
+    }
+
+    for (auto& root : rawroots)
+        if (uint32_t node = find(s, root.first); node != ~0u)
+            s.roots.push_back(node);
+
+    for (uint32_t name : s.catname)
+        if (name >= s.names.size())
+            return false;
+
+    for (const Node& n : s.nodes)
+        if (n.name >= s.names.size())
+            return false;
+
+    for (const Edge& e : s.edges)
+        if (e.name >= s.names.size())
+            return false;
+
+    return true;
+}
+
+// Dominator tree of the graph reachable from the roots, using the iterative algorithm from "A Simple, Fast Dominance Algorithm"
+// (Cooper, Harvey, Kennedy). idom of the roots and unreachable nodes is ~0u; order receives reachable nodes in reverse postorder.
+static void dominators(const Snapshot& s, std::vector<uint32_t>& idom, std::vector<uint32_t>& order, std::vector<uint32_t>& via)
+{
+    size_t count = s.nodes.size();
+
+    std::vector<uint32_t> succOffset(count + 1), succ(s.edges.size()), succName(s.edges.size());
+    for (const Edge& e : s.edges)
+        succOffset[e.from + 1]++;
+    for (size_t i = 0; i < count; ++i)
+        succOffset[i + 1] += succOffset[i];
+
+    {
+        std::vector<uint32_t> fill(succOffset.begin(), succOffset.end() - 1);
+        for (const Edge& e : s.edges)
+        {
+            succName[fill[e.from]] = e.name;
+            succ[fill[e.from]++] = e.to;
+        }
+    }
+
+    // iterative DFS for postorder; via records the name of the edge that first reached the node
+    const uint32_t unvisited = ~0u;
+    std::vector<uint32_t> rpo(count, unvisited);
+    std::vector<uint32_t> postorder;
+    std::vector<std::pair<uint32_t, uint32_t>> stack;
+    std::vector<uint8_t> isroot(count);
+
+    via.assign(count, 0);
+    postorder.reserve(count);
+
+    for (uint32_t root : s.roots)
+    {
+        isroot[root] = 1;
+
+        if (rpo[root] != unvisited)
+            continue;
+
+        rpo[root] = 0;
+        stack.push_back(std::make_pair(root, succOffset[root]));
+
+        while (!stack.empty())
+        {
+            auto& top = stack.back();
+
+            if (top.second < succOffset[top.first + 1])
+            {
+                uint32_t edge = top.second++;
+                uint32_t next = succ[edge];
+
+                if (rpo[next] == unvisited)
+                {
+                    rpo[next] = 0;
+                    via[next] = succName[edge];
+                    stack.push_back(std::make_pair(next, succOffset[next]));
+                }
+            }
+            else
+            {
+                postorder.push_back(top.first);
+                stack.pop_back();
+            }
+        }
+    }
+
+    order.assign(postorder.rbegin(), postorder.rend());
+
+    for (size_t i = 0; i < order.size(); ++i)
+        rpo[order[i]] = uint32_t(i);
+
+    // predecessors of reachable nodes
+    std::vector<uint32_t> predOffset(count + 1), pred;
+    for (const Edge& e : s.edges)
+        if (rpo[e.from] != unvisited)
+            predOffset[e.to + 1]++;
+    for (size_t i = 0; i < count; ++i)
+        predOffset[i + 1] += predOffset[i];
+
+    pred.resize(predOffset[count]);
+    {
+        std::vector<uint32_t> fill(predOffset.begin(), predOffset.end() - 1);
+        for (const Edge& e : s.edges)
+            if (rpo[e.from] != unvisited)
+                pred[fill[e.to]++] = e.from;
+    }
+
+    // roots are dominated by a virtual node that precedes everything in reverse postorder
+    const uint32_t virtualRoot = uint32_t(count);
+    idom.assign(count + 1, unvisited);
+    idom[virtualRoot] = virtualRoot;
+
+    for (uint32_t root : s.roots)
+        idom[root] = virtualRoot;
+
+    auto rpoOf = [&](uint32_t node) -> int64_t
+    {
+        return node == virtualRoot ? -1 : int64_t(rpo[node]);
+    };
+
+    auto intersect = [&](uint32_t a, uint32_t b)
+    {
+        while (a != b)
+        {
+            while (rpoOf(a) > rpoOf(b))
+                a = idom[a];
+            while (rpoOf(b) > rpoOf(a))
+                b = idom[b];
+        }
+
+        return a;
+    };
+
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+
+        for (uint32_t node : order)
+        {
+            if (isroot[node])
+                continue;
+
+            uint32_t newIdom = unvisited;
+
+            for (uint32_t i = predOffset[node]; i < predOffset[node + 1]; ++i)
+            {
+                uint32_t p = pred[i];
+
+                if (idom[p] != unvisited)
+                    newIdom = newIdom == unvisited ? p : intersect(p, newIdom);
+            }
+
+            if (idom[node] != newIdom)
+            {
+                idom[node] = newIdom;
+                changed = true;
+            }
+        }
+    }
+
+    idom.resize(count);
+
+    for (uint32_t& d : idom)
+        if (d == virtualRoot)
+            d = unvisited;
+}
+
+static std::string describe(const Snapshot& s, uint32_t node, const std::vector<uint32_t>& via)
+{
+    const Node& n = s.nodes[node];
+    std::string result = typeName(n.tt);
+
+    if (n.name)
+        result += " " + s.names[n.name];
+    else if (via[node])
+        result += " [" + s.names[via[node]] + "]";
+
+    return result;
+}
+
+static std::string categoryName(const Snapshot& a, const Snapshot& b, int cat)
+{
+    if (b.catname[cat])
+        return b.names[b.catname[cat]];
+    if (a.catname[cat])
+        return a.names[a.catname[cat]];
+
+    return std::to_string(cat);
+}
+
+struct Group
+{
+    size_t count = 0;
+    size_t bytes = 0;
+    size_t oldCount = 0;
+    size_t oldBytes = 0;
+};
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s before.snap after.snap [count]\n", argv[0]);
+        return 1;
+    }
+
+    int top = argc > 3 ? atoi(argv[3]) : 20;
+
+    Snapshot before, after;
+    if (!load(argv[1], before) || !load(argv[2], after))
+        return 1;
+
+    // objects of the second snapshot that were already in the first one
+    std::vector<uint8_t> old(after.nodes.size());
+    for (size_t i = 0; i < after.nodes.size(); ++i)
+    {
+        uint32_t prev = find(before, after.nodes[i].ptr);
+        old[i] = prev != ~0u && before.nodes[prev].tt == after.nodes[i].tt;
+    }
+
+    std::vector<uint32_t> idom, order, via;
+    dominators(after, idom, order, via);
+
+    printf("heap: %zu -> %zu bytes (%+lld), %zu -> %zu objects\n", before.totalbytes, after.totalbytes,
+        (long long)after.totalbytes - (long long)before.totalbytes, before.nodes.size(), after.nodes.size());
+
+    printf("\nby memory category:\n");
+    for (int cat = 0; cat < LUA_MEMORY_CATEGORIES; ++cat)
+        if (before.catbytes[cat] || after.catbytes[cat])
+            printf("  %-24s %12zu -> %12zu (%+lld)\n", categoryName(before, after, cat).c_str(), before.catbytes[cat], after.catbytes[cat],
+                (long long)after.catbytes[cat] - (long long)before.catbytes[cat]);
+
+    // new objects that are still reachable, by category and type; the rest is garbage that the next collection will free
+    std::vector<Group> groups(LUA_MEMORY_CATEGORIES * 256);
+    size_t garbageCount = 0, garbageBytes = 0;
+
+    std::vector<uint8_t> reachable(after.nodes.size());
+    for (uint32_t node : order)
+        reachable[node] = 1;
+
+    for (const Node& n : before.nodes)
+    {
+        Group& group = groups[n.memcat * 256 + n.tt];
+        group.oldCount++;
+        group.oldBytes += n.size;
+    }
+
+    for (size_t i = 0; i < after.nodes.size(); ++i)
+    {
+        const Node& n = after.nodes[i];
+
+        if (!reachable[i])
+        {
+            garbageCount++;
+            garbageBytes += n.size;
+        }
+        else if (!old[i])
+        {
+            Group& group = groups[n.memcat * 256 + n.tt];
+            group.count++;
+            group.bytes += n.size;
+        }
+    }
+
+    std::vector<size_t> groupOrder;
+    for (size_t i = 0; i < groups.size(); ++i)
+        if (groups[i].count)
+            groupOrder.push_back(i);
+
+    std::sort(groupOrder.begin(), groupOrder.end(),
+        [&](size_t a, size_t b)
+        {
+            return groups[a].bytes > groups[b].bytes;
+        });
+
+    printf("\nnew reachable objects by category and type:\n");
+    for (size_t i : groupOrder)
+        printf("  %-24s %-10s %10zu objects %12zu bytes (before: %zu objects, %zu bytes)\n",
+            categoryName(before, after, int(i / 256)).c_str(), typeName(uint8_t(i % 256)), groups[i].count, groups[i].bytes,
+            groups[i].oldCount, groups[i].oldBytes);
+
+    if (garbageCount)
+        printf("  unreachable: %zu objects, %zu bytes\n", garbageCount, garbageBytes);
+
+    // charge new objects to their nearest old dominator; reverse postorder visits dominators first
+    const uint32_t none = ~0u;
+    std::vector<uint32_t> retainer(after.nodes.size(), none);
+    std::vector<size_t> retainedBytes(after.nodes.size()), retainedCount(after.nodes.size());
+
+    for (uint32_t node : order)
+    {
+        uint32_t d = idom[node];
+
+        if (d == none)
+            continue;
+
+        retainer[node] = old[d] ? d : retainer[d];
+
+        if (!old[node] && retainer[node] != none)
+        {
+            retainedBytes[retainer[node]] += after.nodes[node].size;
+            retainedCount[retainer[node]]++;
+        }
+    }
+
+    std::vector<uint32_t> retainers;
+    for (uint32_t node : order)
+        if (retainedBytes[node])
+            retainers.push_back(node);
+
+    std::sort(retainers.begin(), retainers.end(),
+        [&](uint32_t a, uint32_t b)
+        {
+            return retainedBytes[a] > retainedBytes[b];
+        });
+
+    if (retainers.size() > size_t(top))
+        retainers.resize(top);
+
+    printf("\ntop retainers of new objects:\n");
+    for (uint32_t node : retainers)
+    {
+        printf("  %12zu bytes in %zu objects, %s\n", retainedBytes[node], retainedCount[node],
+            categoryName(before, after, after.nodes[node].memcat).c_str());
+
+        std::vector<uint32_t> path;
+        for (uint32_t d = node; d != none; d = idom[d])
+            path.push_back(d);
+
+        for (size_t i = path.size(); i > 0; --i)
+            printf("    %*s%s\n", int(path.size() - i) * 2, "", describe(after, path[i - 1], via).c_str());
+    }
+
+    return 0;
+}